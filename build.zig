@@ -135,6 +135,83 @@ pub fn build(b: *std.Build) void {
         run_cmd.addArgs(args);
     }
 
+    // Benchmarks and load tests get their own executable so they can be built
+    // with `-Doptimize=ReleaseFast` and run without touching the test step:
+    // `zig build bench` runs all of them, `zig build bench -- server` just one.
+    const bench_exe = b.addExecutable(.{
+        .name = "AgenticAIOnWord-bench",
+        .root_module = b.createModule(.{
+            .root_source_file = b.path("src/zig/bench.zig"),
+            .target = target,
+            .optimize = optimize,
+            .imports = &.{
+                .{ .name = "AgenticAIOnWord", .module = mod },
+            },
+        }),
+    });
+
+    const run_bench = b.addRunArtifact(bench_exe);
+    if (b.args) |args| {
+        run_bench.addArgs(args);
+    }
+    const bench_step = b.step("bench", "Run benchmarks and load tests");
+    bench_step.dependOn(&run_bench.step);
+
+    // The add-in is Windows-only, but its platform-neutral pieces (the
+    // streaming Markdown engine, the history and frame decoders, the UTF
+    // transcoder) are compiled as plain C++ here so they can be fuzzed and
+    // benchmarked on any host.
+    const markdown_bench = addCppTool(b, "markdown-bench", "src/cpp/bench/markdown_bench.cpp", target, optimize);
+    const run_markdown_bench = b.addRunArtifact(markdown_bench);
+    if (b.args) |args| {
+        run_markdown_bench.addArgs(args);
+    }
+    bench_step.dependOn(&run_markdown_bench.step);
+
+    const history_bench = addCppTool(b, "history-bench", "src/cpp/bench/history_bench.cpp", target, optimize);
+    const run_history_bench = b.addRunArtifact(history_bench);
+    if (b.args) |args| {
+        run_history_bench.addArgs(args);
+    }
+    bench_step.dependOn(&run_history_bench.step);
+
+    const frame_bench = addCppTool(b, "frame-bench", "src/cpp/bench/frame_bench.cpp", target, optimize);
+    const run_frame_bench = b.addRunArtifact(frame_bench);
+    if (b.args) |args| {
+        run_frame_bench.addArgs(args);
+    }
+    bench_step.dependOn(&run_frame_bench.step);
+
+    const transcode_bench = addCppTool(b, "transcode-bench", "src/cpp/bench/transcode_bench.cpp", target, optimize);
+    const run_transcode_bench = b.addRunArtifact(transcode_bench);
+    if (b.args) |args| {
+        run_transcode_bench.addArgs(args);
+    }
+    bench_step.dependOn(&run_transcode_bench.step);
+
+    const markdown_fuzz = addCppTool(b, "markdown-fuzz", "src/cpp/test/markdown_fuzz.cpp", target, optimize);
+    const run_markdown_fuzz = b.addRunArtifact(markdown_fuzz);
+
+    const transcode_test = addCppTool(b, "transcode-test", "src/cpp/test/transcode_test.cpp", target, optimize);
+    const run_transcode_test = b.addRunArtifact(transcode_test);
+
+    const history_test = addCppTool(b, "history-test", "src/cpp/test/history_test.cpp", target, optimize);
+    const run_history_test = b.addRunArtifact(history_test);
+
+    const frame_test = addCppTool(b, "frame-test", "src/cpp/test/frame_test.cpp", target, optimize);
+    const run_frame_test = b.addRunArtifact(frame_test);
+
+    const dispatcher_test = addCppTool(b, "dispatcher-test", "src/cpp/test/dispatcher_test.cpp", target, optimize);
+    const run_dispatcher_test = b.addRunArtifact(dispatcher_test);
+
+    // The ring's memory ordering is only really checked under
+    // ThreadSanitizer, which Zig does not offer for Windows targets
+    const spscring_test = addCppTool(b, "spscring-test", "src/cpp/test/spscring_test.cpp", target, optimize);
+    if (target.result.os.tag != .windows) {
+        spscring_test.root_module.sanitize_thread = true;
+    }
+    const run_spscring_test = b.addRunArtifact(spscring_test);
+
     // Creates an executable that will run `test` blocks from the provided module.
     // Here `mod` needs to define a target, which is why earlier we made sure to
     // set the releative field.
@@ -161,6 +238,12 @@ pub fn build(b: *std.Build) void {
     const test_step = b.step("test", "Run tests");
     test_step.dependOn(&run_mod_tests.step);
     test_step.dependOn(&run_exe_tests.step);
+    test_step.dependOn(&run_markdown_fuzz.step);
+    test_step.dependOn(&run_transcode_test.step);
+    test_step.dependOn(&run_history_test.step);
+    test_step.dependOn(&run_frame_test.step);
+    test_step.dependOn(&run_dispatcher_test.step);
+    test_step.dependOn(&run_spscring_test.step);
 
     // Just like flags, top level steps are also listed in the `--help` menu.
     //
@@ -174,3 +257,28 @@ pub fn build(b: *std.Build) void {
     // Lastly, the Zig build system is relatively simple and self-contained,
     // and reading its source code will allow you to master it.
 }
+
+/// Host executable built from a single C++ source plus the add-in's
+/// `include/` directory.
+fn addCppTool(
+    b: *std.Build,
+    name: []const u8,
+    source: []const u8,
+    target: std.Build.ResolvedTarget,
+    optimize: std.builtin.OptimizeMode,
+) *std.Build.Step.Compile {
+    const exe = b.addExecutable(.{
+        .name = name,
+        .root_module = b.createModule(.{
+            .target = target,
+            .optimize = optimize,
+            .link_libcpp = true,
+        }),
+    });
+    exe.root_module.addCSourceFile(.{
+        .file = b.path(source),
+        .flags = &.{"-std=c++17"},
+    });
+    exe.root_module.addIncludePath(b.path("include"));
+    return exe;
+}
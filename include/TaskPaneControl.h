@@ -29,6 +29,9 @@ static const GUID CLSID_TaskPaneControl = {
 
 using namespace ATL;
 
+// Posted by the shared MCPClient; WPARAM is an MCPClient::Notification
+const UINT WM_MCP_NOTIFY = WM_APP + 1;
+
 // CTaskPaneControl - ActiveX control that displays in the Task Pane
 class ATL_NO_VTABLE CTaskPaneControl
     : public CComObjectRootEx<CComSingleThreadModel>,
@@ -78,6 +81,8 @@ public:
   MESSAGE_HANDLER(WM_SIZE, OnSize)
   MESSAGE_HANDLER(WM_CTLCOLORSTATIC, OnCtlColorStatic)
   MESSAGE_HANDLER(WM_COMMAND, OnCommand)
+  MESSAGE_HANDLER(WM_MCP_NOTIFY, OnMcpNotify)
+  MESSAGE_HANDLER(WM_DESTROY, OnDestroy)
   DEFAULT_REFLECTION_HANDLER()
   END_MSG_MAP()
 
@@ -98,9 +103,12 @@ public:
   LRESULT OnCtlColorStatic(UINT uMsg, WPARAM wParam, LPARAM lParam,
                            BOOL &bHandled);
   LRESULT OnCommand(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
+  LRESULT OnMcpNotify(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
+  LRESULT OnDestroy(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL &bHandled);
 
 private:
-  MCPClient client;
+  // Connected in the background since the add-in loaded
+  MCPClient &client = MCPClient::Shared();
 
   // Child controls
   CWindow m_wndTitleLabel;
@@ -0,0 +1,144 @@
+#pragma once
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string_view>
+#include <vector>
+
+// Platform-neutral: no Windows headers.
+
+namespace MCPHelper {
+
+// Counters for the current request, cleared by RequestArena::Reset()
+struct ArenaStats {
+  size_t allocations = 0; // Allocate() calls
+  size_t peakBytes = 0;   // handed out, padding included; nothing is freed
+                          // before Reset, so this is the high-water mark
+  size_t heapBlocks = 0;  // blocks that had to come from the heap
+};
+
+// Monotonic allocator for the transient buffers of one request. Allocation
+// is a pointer bump; nothing is freed individually, everything is released
+// by one Reset() when the request completes. Reset() keeps the regular
+// blocks, so once a request of a given size has been seen, the next one is
+// served without touching the heap (heapBlocks stays 0).
+//
+// Not thread-safe: one thread allocates. Others may read memory it handed
+// over (e.g. through a release/acquire queue) until the next Reset().
+class RequestArena {
+public:
+  static const size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+  explicit RequestArena(size_t blockSize = DEFAULT_BLOCK_SIZE)
+      : blockSize(blockSize) {}
+
+  ~RequestArena() {
+    for (auto &block : blocks)
+      std::free(block.data);
+  }
+
+  RequestArena(const RequestArena &) = delete;
+  RequestArena &operator=(const RequestArena &) = delete;
+
+  // `alignment`: a power of two up to alignof(std::max_align_t)
+  void *Allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+    stats.allocations++;
+    for (;;) {
+      if (current < blocks.size()) {
+        Block &block = blocks[current];
+        size_t start = (used + alignment - 1) & ~(alignment - 1);
+        if (start + size <= block.size) {
+          stats.peakBytes += start + size - used;
+          used = start + size;
+          return block.data + start;
+        }
+        if (current + 1 < blocks.size() &&
+            blocks[current + 1].size >= size + alignment) {
+          current++;
+          used = 0;
+          continue;
+        }
+      }
+      AddBlock(size + alignment);
+    }
+  }
+
+  // Uninitialized room for `length` chars
+  char *AllocateChars(size_t length) {
+    return static_cast<char *>(Allocate(length ? length : 1, 1));
+  }
+
+  std::string_view Copy(const char *text, size_t length) {
+    char *copy = AllocateChars(length);
+    if (length > 0)
+      std::memcpy(copy, text, length);
+    return std::string_view(copy, length);
+  }
+
+  // Gives back the unused end of the most recent allocation, e.g. after
+  // unescaping into a worst-case sized buffer
+  void Shrink(const void *last, size_t oldSize, size_t newSize) {
+    if (current < blocks.size() && newSize < oldSize &&
+        static_cast<const char *>(last) + oldSize ==
+            blocks[current].data + used) {
+      used -= oldSize - newSize;
+      stats.peakBytes -= oldSize - newSize;
+    }
+  }
+
+  // Releases every allocation at once. Blocks larger than the regular
+  // size (single oversized buffers) go back to the heap.
+  void Reset() {
+    size_t kept = 0;
+    for (auto &block : blocks) {
+      if (block.size > blockSize)
+        std::free(block.data);
+      else
+        blocks[kept++] = block;
+    }
+    blocks.resize(kept);
+    current = 0;
+    used = 0;
+    stats = ArenaStats();
+  }
+
+  const ArenaStats &Stats() const { return stats; }
+
+  // Bytes held from the heap, used or not
+  size_t Capacity() const {
+    size_t total = 0;
+    for (const auto &block : blocks)
+      total += block.size;
+    return total;
+  }
+
+private:
+  struct Block {
+    char *data;
+    size_t size;
+  };
+
+  size_t blockSize;
+  std::vector<Block> blocks;
+  size_t current = 0; // block being filled
+  size_t used = 0;    // bytes used in blocks[current]
+  ArenaStats stats;
+
+  // Inserted after the current block so retained blocks further on stay
+  // available for later allocations
+  void AddBlock(size_t minimum) {
+    size_t size = minimum > blockSize ? minimum : blockSize;
+    char *data = static_cast<char *>(std::malloc(size));
+    if (!data)
+      throw std::bad_alloc();
+    stats.heapBlocks++;
+
+    size_t at = current < blocks.size() ? current + 1 : blocks.size();
+    blocks.insert(blocks.begin() + at, Block{data, size});
+    current = at;
+    used = 0;
+  }
+};
+
+} // namespace MCPHelper
@@ -0,0 +1,49 @@
+#pragma once
+#include <chrono>
+#include <random>
+
+// Platform-neutral: no Windows headers.
+
+namespace MCPHelper {
+
+// Delays between reconnect attempts. The ceiling doubles from `initial` up
+// to `cap` with each failed attempt and every delay is drawn uniformly from
+// [ceiling/2, ceiling], so add-ins in several Word processes do not all
+// reconnect in lockstep when the server restarts. Reset() after a success.
+class ReconnectBackoff {
+public:
+  static constexpr std::chrono::milliseconds DEFAULT_INITIAL{250};
+  static constexpr std::chrono::milliseconds DEFAULT_CAP{30000};
+
+  explicit ReconnectBackoff(
+      std::chrono::milliseconds initial = DEFAULT_INITIAL,
+      std::chrono::milliseconds cap = DEFAULT_CAP,
+      unsigned seed = std::random_device{}())
+      : initial(initial), cap(cap), ceiling(initial), rng(seed) {}
+
+  std::chrono::milliseconds Next() {
+    attempts++;
+    long long high = ceiling.count();
+    std::uniform_int_distribution<long long> spread(high / 2, high);
+    std::chrono::milliseconds delay(spread(rng));
+    ceiling = ceiling * 2 < cap ? ceiling * 2 : cap;
+    return delay;
+  }
+
+  void Reset() {
+    ceiling = initial;
+    attempts = 0;
+  }
+
+  // Delays handed out since the last Reset()
+  unsigned Attempts() const { return attempts; }
+
+private:
+  std::chrono::milliseconds initial;
+  std::chrono::milliseconds cap;
+  std::chrono::milliseconds ceiling;
+  std::mt19937 rng;
+  unsigned attempts = 0;
+};
+
+} // namespace MCPHelper
@@ -0,0 +1,65 @@
+#pragma once
+#include "dispatch.hpp"
+#include <chrono>
+
+namespace MCPHelper {
+
+// Suspends Application.ScreenUpdating and background repagination
+// (Options.Pagination) while a response is inserted, so Word does not
+// relayout and repaint after every InsertAfter. The destructor puts back
+// whatever it changed, so any exit path (end of response, cancellation,
+// teardown, exception) restores Word. Settings that were already off are
+// left alone.
+class BulkWriteScope {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr std::chrono::milliseconds DEFAULT_REFRESH_INTERVAL{250};
+
+  BulkWriteScope(IDispatch *pWordApp,
+                 std::chrono::milliseconds newRefreshInterval =
+                     DEFAULT_REFRESH_INTERVAL)
+      : app(pWordApp), refreshInterval(newRefreshInterval),
+        lastRefresh(Clock::now()) {
+    bool enabled = false;
+    if (SUCCEEDED(app.Get(L"ScreenUpdating", enabled)) && enabled &&
+        SUCCEEDED(app.Put(L"ScreenUpdating", false))) {
+      restoreScreenUpdating = true;
+    }
+
+    if (SUCCEEDED(app.Get(L"Options", options)) &&
+        SUCCEEDED(options.Get(L"Pagination", enabled)) && enabled &&
+        SUCCEEDED(options.Put(L"Pagination", false))) {
+      restorePagination = true;
+    }
+  }
+
+  ~BulkWriteScope() {
+    if (restorePagination)
+      options.Put(L"Pagination", true);
+    if (restoreScreenUpdating)
+      app.Put(L"ScreenUpdating", true);
+  }
+
+  BulkWriteScope(const BulkWriteScope &) = delete;
+  BulkWriteScope &operator=(const BulkWriteScope &) = delete;
+
+  // Repaint once the refresh interval has passed, so progress stays
+  // visible while updating is off
+  void MaybeRefresh(Clock::time_point now = Clock::now()) {
+    if (!restoreScreenUpdating || now - lastRefresh < refreshInterval)
+      return;
+    app.Call(L"ScreenRefresh");
+    lastRefresh = now;
+  }
+
+private:
+  Com::Object<Com::Application> app;
+  Com::Object<Com::Options> options;
+  bool restoreScreenUpdating = false;
+  bool restorePagination = false;
+  std::chrono::milliseconds refreshInterval;
+  Clock::time_point lastRefresh;
+};
+
+} // namespace MCPHelper
@@ -2,10 +2,27 @@
 #include "../../third_party/nfd/include/nfd.hpp"
 #include "../../third_party/nlohmann/json.hpp"
 #include "../debugger.hpp"
+#include "arena.hpp"
+#include "backoff.hpp"
+#include "bulkwrite.hpp"
+#include "dispatch.hpp"
+#include "historydecoder.hpp"
+#include "markdown.hpp"
+#include "markdowntable.hpp"
+#include "rangeformat.hpp"
+#include "requestdispatcher.hpp"
+#include "spscring.hpp"
+#include "streamdecoder.hpp"
+#include "transcode.hpp"
+#include "wordml.hpp"
+#include "writecoalescer.hpp"
 #include <OleAuto.h>
+#include <atomic>
 #include <chrono>
-#include <cwctype>
+#include <condition_variable>
 #include <fstream>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <thread>
@@ -23,17 +40,47 @@ class MCPClient {
 public:
   const wstring wsHost = L"localhost";
   const INTERNET_PORT wsPort = 9910;
-  bool isConnected = false;
 
   MCPClient() {}
-  ~MCPClient() { Disconnect(); }
+  ~MCPClient();
 
-  // WebSocket connection
-  bool ConnectToMCP();
-  void Disconnect();
+  // The add-in's one client, shared by the add-in object and every task pane
+  static MCPClient &Shared();
 
-  // Send JSON message and get response
-  string SendMessageToWebsocket(const string &jsonMessage);
+  // Connection manager. Start() returns at once: the WebSocket handshake
+  // runs on the session thread, which then routes every incoming message to
+  // the request it answers by id (so history and health requests work while
+  // a stream is in flight) and reconnects with jittered backoff whenever the
+  // server goes away. Stop() closes the socket and joins the thread; call it
+  // before the DLL unloads.
+  void Start();
+  void Stop();
+  bool IsConnected() const { return connected.load(memory_order_acquire); }
+
+  // What the UI hears about asynchronously, as the WPARAM of the message
+  // given to SetNotificationWindow()
+  enum Notification : WPARAM {
+    NOTIFY_READY,           // a connection is ready (health check answered)
+    NOTIFY_STREAM_ENDED,    // the streaming answer finished or was cancelled
+    NOTIFY_HISTORY_CHANGED, // the server saved history after a cancel
+  };
+
+  // `message` is posted to `hwnd` for each notification; NOTIFY_READY right
+  // away if a connection already is. NULL stops them.
+  void SetNotificationWindow(HWND hwnd, UINT message);
+
+  struct ConnectionStats {
+    long long loadToReadyMs = -1; // Start() to the first ready connection
+    unsigned connects = 0;        // handshakes that succeeded
+    unsigned failedAttempts = 0;  // handshakes that did not
+  };
+  ConnectionStats GetConnectionStats() const;
+
+  // Send `request` under a fresh id and wait for its reply. Failures come
+  // back as {"error":"..."}.
+  static constexpr chrono::milliseconds REQUEST_TIMEOUT{10000};
+  string SendRequest(json request,
+                     chrono::milliseconds timeout = REQUEST_TIMEOUT);
 
   // File picker
   vector<string> getFilePath();
@@ -44,68 +91,175 @@ public:
   static IDispatch *s_pWordApp;
   bool IsDocumentSaved();
 
-  // Send prompt to AI
-  void SendPrompt(const int &id, const string &prompt, const string &filePath,
+  // Send prompt to AI and wait for the whole answer
+  static constexpr chrono::milliseconds PROMPT_TIMEOUT{300000};
+  void SendPrompt(const string &prompt, const string &filePath,
                   const string &currentFile);
 
-  // Send prompt with streaming response
-  void SendPromptWithStream(const int &id, const string &prompt,
-                            const string &filePath, const string &currentFile);
+  // Send prompt with streaming response. Returns as soon as the request is
+  // sent; frames are received on a background thread and written to the
+  // document from a UI-thread timer.
+  void SendPromptWithStream(const string &prompt, const string &filePath,
+                            const string &currentFile);
+  bool IsStreaming() const { return activeStream != nullptr; }
 
-  struct historyChat {
-    string message;
-    string timestamp;
-    string role;
-  };
-  vector<historyChat> historyChat;
+  // Stops the streaming answer: nothing more is written, the text already
+  // in the document stays, and the server aborts the model request
+  void CancelStream();
+  // Arena use of the last finished streaming request
+  const ArenaStats &GetLastArenaStats() const { return lastArenaStats; }
+
+  vector<HistoryEntry> historyChat;
 
   void SetHistoryChat();
+  bool dumpHistory = false; // also write each history response to history.json
   // Helper function
   wstring StringToWstring(const string &str);
   string WstringToString(const wstring &str);
 
   void Write(const wstring &message);
-  void Stream(const wstring &message);
-  void StreamByWords(const wstring &message);
-  void StreamByLines(const wstring &message);
-
-  // Markdown Parsing Helpers
-  void ProcessStreamChunk(const wstring &chunk);
-  void ParseMarkdown(const wstring &text);
-  void ProcessTableBuffer();
+  // Queue text for the document; writes are merged and paced by
+  // writeCoalescer instead of Sleep() between fragments. `style` holds
+  // MarkdownStyle bits applied once the text is in the document.
+  void Stream(const wstring &message, uint16_t style = MD_PLAIN,
+              uint8_t headingLevel = 0);
+  bool FlushWrites(bool force);
+
+  // Markdown: UTF-8 chunks in, styled runs out. Tokens split across chunks
+  // are held by the streamer until they resolve.
+  void ProcessStreamChunk(const char *chunk, size_t length);
+  void FinishMarkdown();
+  void ResetMarkdown();
   void CollectDocumentInfo(json &requestJson);
 
-  // Markdown State
-  bool isBoldMode = false;
-  bool isItalicMode = false;
-  bool isUnderlineMode = false;
-  wstring pendingBuffer;       // buffer for incomplete tokens like * or #
-  vector<wstring> tableBuffer; // buffer for table rows
-  bool isTableMode = false;
+  MarkdownStreamer markdown;
+  MarkdownTableBuilder tableBuilder; // rows of the table being received
+
+  // Write pacing (Frame by default, Instant disables pacing entirely)
+  WriteCoalescer writeCoalescer;
+
+  // Screen updating and repagination are suspended for each response and
+  // the document repainted at this cadence. Off: Word repaints per write.
+  bool useBulkWrite = true;
+  chrono::milliseconds bulkWriteRefreshInterval =
+      BulkWriteScope::DEFAULT_REFRESH_INTERVAL;
+
+  // Complete answers go in as one WordML fragment (one InsertXML call)
+  // instead of through the streaming writer. Off: always stream.
+  bool useWordML = true;
 
 private:
+  RequestDispatcher dispatcher;
+
+  // Session thread state. hWebSocket is swapped under socketMutex, which
+  // every send holds; hSession/hConnect belong to the session thread.
+  static const DWORD CONNECT_TIMEOUT_MS = 2000;
+  thread sessionThread;
+  mutable mutex socketMutex;
+  HINTERNET hSession = NULL;
+  HINTERNET hConnect = NULL;
+  HINTERNET hWebSocket = NULL;
+  atomic<bool> connected{false};
+
+  mutex stopMutex;
+  condition_variable stopSignal;
+  bool stopping = false; // guarded by stopMutex
+
+  mutable mutex statsMutex; // guards the members below
+  chrono::steady_clock::time_point startTime;
+  ConnectionStats connectionStats;
+  HWND notifyWindow = NULL;
+  UINT notifyMessage = 0;
+  void PostNotification(Notification what);
+
+  void RunSession();
+  HINTERNET OpenWebSocket();
+  void CloseWebSocket(HINTERNET socket);
+  void SendHealthCheck();
+  void ReceiveSession(HINTERNET socket);
+  bool SendText(const string &message);
+
   // Cached COM objects for better performance
   struct StreamContext {
-    IDispatch *pDoc = nullptr;
-    IDispatch *pRange = nullptr;
-    DISPID insertAfterDispId = 0;
+    Com::Object<Com::Document> doc;
+    Com::Object<Com::Range> range;
     bool isValid = false;
   };
 
+  // One context per response: opened by BeginDocumentWrite, reused by every
+  // flush and only re-resolved when the target document goes away
+  StreamContext streamContext;
+  bool isDocumentWriteOpen = false;
+  unique_ptr<BulkWriteScope> bulkWrite; // open while a response is written
+  static const size_t BULK_WRITE_MIN_CHARS = 4096; // for one-off Write()
+  void BeginDocumentWrite();
+  void EndDocumentWrite();
+  void AbortDocumentWrite();
+  bool EnsureStreamContext();
+  bool IsStreamContextCurrent();
+
   StreamContext InitStreamContext();
-  void WriteWithContext(StreamContext &ctx, const wstring &text);
-  void WriteBold(const wstring &text);
-  void WriteHeader(const wstring &text);
-  void CreateTableFromBuffer();
+  HRESULT WriteWithContext(StreamContext &ctx, const wstring &text);
+  void WriteMarkdownRun(const MarkdownRun &run);
+  void StreamUtf8(const char *text, size_t length, uint16_t style,
+                  uint8_t headingLevel);
+  wstring runBuffer; // reused by StreamUtf8
+
+  // Buffered Markdown table -> native Word table
+  void FlushTable();
+  void FormatTable(Com::Object<Com::Table> &table,
+                   const vector<ColumnAlignment> &alignments);
+  // Whole response at once: WordML when possible, streamed otherwise
+  void WriteCompleteResponse(const char *markdownText, size_t length);
+  bool InsertWordML(const char *markdownText, size_t length);
   void CleanupStreamContext(StreamContext &ctx);
+  void ReportWriteStats();
+  wstring flushBuffer; // reused by FlushWrites
+  vector<StyledSpan> flushSpans;
+
+  // Formatting is applied per contiguous range after each InsertAfter
+  RangeFormatPlanner formatPlanner;
+  vector<FormatOp> formatOps;
+  wstring bodyFontName; // restored when a code span ends
+  void ApplyFormatting(size_t insertedLength);
+  void ApplyFormatOp(long base, const FormatOp &op);
+  // Document position where the last `insertedLength` characters written
+  // with InsertAfter begin
+  bool InsertedStart(size_t insertedLength, long &start);
+
+  // Background receive state for the in-flight streaming request
+  static const size_t STREAM_QUEUE_CAPACITY = 1024;
+  static const UINT STREAM_DRAIN_INTERVAL_MS = 16;
+  static const size_t STREAM_DRAIN_BATCH = 256;
+
+  struct StreamState {
+    // The receive thread is shared by every routed reply, so it never
+    // waits for the drain timer: past the ring's capacity events spill
+    SpillingSpscQueue<StreamEvent, STREAM_QUEUE_CAPACITY> queue;
+    uint64_t requestId = 0;
+    UINT_PTR drainTimer = 0;
+    bool isDraining = false;
+  };
+  unique_ptr<StreamState> activeStream;
+  // Backs the content of every queued StreamEvent. Filled by the receive
+  // thread, read by the drain timer, reset in one go by FinishStream once
+  // the request has been cancelled in the dispatcher, i.e. the receive
+  // thread is done with it; its blocks are kept for the next request.
+  RequestArena streamArena;
+  ArenaStats lastArenaStats;
+  static MCPClient *s_pStreamingClient;
+
+  bool RouteStreamMessage(StreamState *state, const char *message,
+                          size_t length);
+  static void CALLBACK DrainTimerProc(HWND hwnd, UINT uMsg, UINT_PTR idEvent,
+                                      DWORD dwTime);
+  void DrainStreamQueue();
+  void FinishStream();
 
   using StreamCallback = function<void(const string &)>;
 
-  string ExtractJsonString(const string &json, size_t start, size_t end);
   // string SendMessageToWebsocketWithStream(const string &message,
   //                                         StreamCallback callback);
-  void StreamChunked(const wstring &message);
-  vector<wstring> SplitIntoChunks(const wstring &text, size_t chunkSize);
 };
 
 } // namespace MCPHelper
\ No newline at end of file
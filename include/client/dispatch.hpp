@@ -0,0 +1,263 @@
+#pragma once
+#include <OleAuto.h>
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+#include <windows.h>
+
+namespace MCPHelper {
+namespace Com {
+
+// Interface tags. DISPIDs are cached per (tag, member name), so every
+// Object<Tag> must wrap the same Word interface type.
+struct Application {};
+struct Document {};
+struct Range {};
+struct Font {};
+struct Options {};
+struct Selection {};
+struct ParagraphFormat {};
+struct Table {};
+struct Rows {};
+struct Row {};
+struct Columns {};
+struct Column {};
+struct Borders {};
+
+// Call counters for measuring per-call overhead
+struct DispatchStats {
+  size_t invokes = 0;      // IDispatch::Invoke calls
+  size_t nameLookups = 0;  // GetIDsOfNames calls (cache misses)
+  size_t cacheHits = 0;    // member names served from the DISPID cache
+  double invokeMicros = 0; // wall time spent inside Invoke
+};
+DispatchStats GetDispatchStats();
+void ResetDispatchStats();
+
+// Member name -> DISPID for one interface type. A handful of members per
+// type, so a linear scan beats hashing and never allocates on a hit.
+class MemberCache {
+public:
+  bool Find(const wchar_t *member, DISPID &dispid) const;
+  void Add(const wchar_t *member, DISPID dispid);
+
+private:
+  std::vector<std::pair<std::wstring, DISPID>> entries;
+};
+
+template <typename Tag> MemberCache &CacheFor() {
+  static MemberCache cache;
+  return cache;
+}
+
+// Resolve `member` through `cache` and invoke it. `args` are in natural
+// order; `named` is DISPID_PROPERTYPUT for property puts.
+HRESULT InvokeMember(IDispatch *pDisp, MemberCache &cache,
+                     const wchar_t *member, WORD flags, VARIANT *args,
+                     UINT argCount, VARIANT *result, DISPID *named = nullptr);
+
+// RAII VARIANT
+class Variant {
+public:
+  Variant() { VariantInit(&value); }
+  ~Variant() { VariantClear(&value); }
+  Variant(const Variant &) = delete;
+  Variant &operator=(const Variant &) = delete;
+  Variant(Variant &&other) noexcept : value(other.value) {
+    VariantInit(&other.value);
+  }
+  Variant &operator=(Variant &&other) noexcept {
+    if (this != &other) {
+      VariantClear(&value);
+      value = other.value;
+      VariantInit(&other.value);
+    }
+    return *this;
+  }
+
+  VARIANT &Raw() { return value; }
+  const VARIANT &Raw() const { return value; }
+
+private:
+  VARIANT value;
+};
+
+template <typename Tag> class Object;
+
+// ---------------------------------------------------------------------------
+// Argument conversion (C++ -> VARIANT)
+// ---------------------------------------------------------------------------
+inline void ToVariant(VARIANT &v, const wchar_t *text) {
+  v.vt = VT_BSTR;
+  v.bstrVal = SysAllocString(text);
+}
+inline void ToVariant(VARIANT &v, const std::wstring &text) {
+  v.vt = VT_BSTR;
+  v.bstrVal = SysAllocStringLen(text.data(), (UINT)text.size());
+}
+inline void ToVariant(VARIANT &v, bool flag) {
+  v.vt = VT_BOOL;
+  v.boolVal = flag ? VARIANT_TRUE : VARIANT_FALSE;
+}
+inline void ToVariant(VARIANT &v, int number) {
+  v.vt = VT_I4;
+  v.lVal = number;
+}
+inline void ToVariant(VARIANT &v, long number) {
+  v.vt = VT_I4;
+  v.lVal = number;
+}
+inline void ToVariant(VARIANT &v, const VARIANT &source) {
+  VariantCopy(&v, &source);
+}
+template <typename Tag> void ToVariant(VARIANT &v, const Object<Tag> &object);
+
+// ---------------------------------------------------------------------------
+// Result conversion (VARIANT -> C++)
+// ---------------------------------------------------------------------------
+HRESULT FromVariant(Variant &raw, std::wstring &out);
+HRESULT FromVariant(Variant &raw, std::string &out); // UTF-8
+HRESULT FromVariant(Variant &raw, bool &out);
+HRESULT FromVariant(Variant &raw, long &out);
+inline HRESULT FromVariant(Variant &raw, Variant &out) {
+  out = std::move(raw);
+  return S_OK;
+}
+template <typename Tag> HRESULT FromVariant(Variant &raw, Object<Tag> &out);
+
+// Typed, ref-counted IDispatch wrapper
+template <typename Tag> class Object {
+public:
+  Object() = default;
+  explicit Object(IDispatch *p) : pDisp(p) {
+    if (pDisp)
+      pDisp->AddRef();
+  }
+  ~Object() { Reset(); }
+
+  Object(const Object &other) : Object(other.pDisp) {}
+  Object &operator=(const Object &other) {
+    if (this != &other) {
+      Reset();
+      pDisp = other.pDisp;
+      if (pDisp)
+        pDisp->AddRef();
+    }
+    return *this;
+  }
+  Object(Object &&other) noexcept : pDisp(other.pDisp) {
+    other.pDisp = nullptr;
+  }
+  Object &operator=(Object &&other) noexcept {
+    if (this != &other) {
+      Reset();
+      pDisp = other.pDisp;
+      other.pDisp = nullptr;
+    }
+    return *this;
+  }
+
+  void Reset() {
+    if (pDisp) {
+      pDisp->Release();
+      pDisp = nullptr;
+    }
+  }
+
+  IDispatch *Get() const { return pDisp; }
+  explicit operator bool() const { return pDisp != nullptr; }
+
+  // COM identity comparison through IUnknown
+  template <typename OtherTag>
+  bool IsSameObject(const Object<OtherTag> &other) const {
+    if (!pDisp || !other.Get())
+      return false;
+    IUnknown *pLeft = nullptr;
+    IUnknown *pRight = nullptr;
+    bool same = false;
+    if (SUCCEEDED(pDisp->QueryInterface(IID_IUnknown, (void **)&pLeft)) &&
+        SUCCEEDED(
+            other.Get()->QueryInterface(IID_IUnknown, (void **)&pRight))) {
+      same = (pLeft == pRight);
+    }
+    if (pLeft)
+      pLeft->Release();
+    if (pRight)
+      pRight->Release();
+    return same;
+  }
+
+  // Method call, result discarded
+  template <typename... Args>
+  HRESULT Call(const wchar_t *member, const Args &...args) {
+    return Dispatch(member, DISPATCH_METHOD, nullptr, args...);
+  }
+
+  // Method call with a typed result
+  template <typename R, typename... Args>
+  HRESULT CallFor(const wchar_t *member, R &result, const Args &...args) {
+    Variant raw;
+    HRESULT hr = Dispatch(member, DISPATCH_METHOD, &raw, args...);
+    return SUCCEEDED(hr) ? FromVariant(raw, result) : hr;
+  }
+
+  // Property get (optionally indexed) with a typed result
+  template <typename R, typename... Args>
+  HRESULT Get(const wchar_t *member, R &result, const Args &...args) {
+    Variant raw;
+    HRESULT hr = Dispatch(member, DISPATCH_PROPERTYGET, &raw, args...);
+    return SUCCEEDED(hr) ? FromVariant(raw, result) : hr;
+  }
+
+  // Property put
+  template <typename V> HRESULT Put(const wchar_t *member, const V &value) {
+    if (!pDisp)
+      return E_POINTER;
+    Variant arg;
+    ToVariant(arg.Raw(), value);
+    DISPID named = DISPID_PROPERTYPUT;
+    return InvokeMember(pDisp, CacheFor<Tag>(), member, DISPATCH_PROPERTYPUT,
+                        &arg.Raw(), 1, nullptr, &named);
+  }
+
+private:
+  IDispatch *pDisp = nullptr;
+
+  template <typename... Args>
+  HRESULT Dispatch(const wchar_t *member, WORD flags, Variant *result,
+                   const Args &...args) {
+    if (!pDisp)
+      return E_POINTER;
+    constexpr size_t count = sizeof...(Args);
+    // Owned copies keep the BSTRs alive; `raw` is the shallow array
+    // IDispatch expects.
+    Variant owned[count > 0 ? count : 1];
+    VARIANT raw[count > 0 ? count : 1];
+    size_t index = 0;
+    ((ToVariant(owned[index].Raw(), args), raw[index] = owned[index].Raw(),
+      index++),
+     ...);
+    (void)index;
+    return InvokeMember(pDisp, CacheFor<Tag>(), member, flags,
+                        count > 0 ? raw : nullptr, (UINT)count,
+                        result ? &result->Raw() : nullptr);
+  }
+};
+
+template <typename Tag> void ToVariant(VARIANT &v, const Object<Tag> &object) {
+  v.vt = VT_DISPATCH;
+  v.pdispVal = object.Get();
+  if (v.pdispVal)
+    v.pdispVal->AddRef();
+}
+
+template <typename Tag> HRESULT FromVariant(Variant &raw, Object<Tag> &out) {
+  if (raw.Raw().vt != VT_DISPATCH || !raw.Raw().pdispVal)
+    return DISP_E_TYPEMISMATCH;
+  out = Object<Tag>(raw.Raw().pdispVal);
+  return S_OK;
+}
+
+} // namespace Com
+} // namespace MCPHelper
@@ -0,0 +1,135 @@
+#pragma once
+#include "../../third_party/nlohmann/json.hpp"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Platform-neutral: no Windows headers.
+
+namespace MCPHelper {
+
+// One record of the server's chat history
+struct HistoryEntry {
+  std::string message;
+  std::string timestamp;
+  std::string role;
+};
+
+// Decodes {"type":"history","status":"ok","data":[{...},...]} straight into
+// HistoryEntry records through nlohmann's SAX interface: no DOM is built,
+// escapes are resolved by the JSON lexer and each string value is moved
+// into its entry, so record text is copied once. Keys other than message,
+// timestamp and role, and values of other types, are skipped.
+class HistoryDecoder : public nlohmann::json_sax<nlohmann::json> {
+public:
+  // Appends the records of `data` to `entries`. Returns false on malformed
+  // JSON; records completed before the error are kept.
+  static bool Decode(const char *data, size_t length,
+                     std::vector<HistoryEntry> &entries) {
+    HistoryDecoder decoder(entries);
+    return nlohmann::json::sax_parse(data, data + length, &decoder);
+  }
+
+  static bool Decode(const std::string &response,
+                     std::vector<HistoryEntry> &entries) {
+    return Decode(response.data(), response.size(), entries);
+  }
+
+  bool null() override { return Skip(); }
+  bool boolean(bool) override { return Skip(); }
+  bool number_integer(number_integer_t) override { return Skip(); }
+  bool number_unsigned(number_unsigned_t) override { return Skip(); }
+  bool number_float(number_float_t, const string_t &) override {
+    return Skip();
+  }
+  bool binary(binary_t &) override { return Skip(); }
+
+  bool string(string_t &value) override {
+    if (field)
+      *field = std::move(value);
+    return Skip();
+  }
+
+  bool start_object(std::size_t) override {
+    depth++;
+    // Objects directly inside "data" are records
+    if (inData && depth == RECORD_DEPTH) {
+      entries.emplace_back();
+      inRecord = true;
+    }
+    field = nullptr;
+    return true;
+  }
+
+  bool end_object() override {
+    if (inRecord && depth == RECORD_DEPTH)
+      inRecord = false;
+    depth--;
+    field = nullptr;
+    return true;
+  }
+
+  bool start_array(std::size_t) override {
+    depth++;
+    if (depth == DATA_DEPTH && dataKey)
+      inData = true;
+    dataKey = false;
+    field = nullptr;
+    return true;
+  }
+
+  bool end_array() override {
+    if (inData && depth == DATA_DEPTH)
+      inData = false;
+    depth--;
+    return true;
+  }
+
+  bool key(string_t &name) override {
+    dataKey = depth == 1 && name == "data";
+    field = nullptr;
+    if (!inRecord || depth != RECORD_DEPTH)
+      return true;
+
+    HistoryEntry &entry = entries.back();
+    if (name == "message")
+      field = &entry.message;
+    else if (name == "timestamp")
+      field = &entry.timestamp;
+    else if (name == "role")
+      field = &entry.role;
+    return true;
+  }
+
+  bool parse_error(std::size_t, const std::string &,
+                   const nlohmann::detail::exception &) override {
+    // The record being read when the error hit is incomplete
+    if (inRecord)
+      entries.pop_back();
+    inRecord = false;
+    return false;
+  }
+
+private:
+  // Top-level object = 1, "data" array = 2, record = 3
+  static const int DATA_DEPTH = 2;
+  static const int RECORD_DEPTH = 3;
+
+  std::vector<HistoryEntry> &entries;
+  std::string *field = nullptr; // destination of the next string value
+  int depth = 0;
+  bool dataKey = false; // last top-level key was "data"
+  bool inData = false;
+  bool inRecord = false;
+
+  explicit HistoryDecoder(std::vector<HistoryEntry> &entries)
+      : entries(entries) {}
+
+  bool Skip() {
+    field = nullptr;
+    dataKey = false;
+    return true;
+  }
+};
+
+} // namespace MCPHelper
@@ -0,0 +1,439 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Platform-neutral: no Windows headers, builds and is tested on Linux.
+
+namespace MCPHelper {
+
+// Style bits carried by every run
+enum MarkdownStyle : uint16_t {
+  MD_PLAIN = 0,
+  MD_BOLD = 1 << 0,
+  MD_ITALIC = 1 << 1,
+  MD_UNDERLINE = 1 << 2,
+  MD_CODE = 1 << 3,      // inline code span or fenced code block
+  MD_HEADING = 1 << 4,   // see MarkdownRun::headingLevel
+  MD_LIST_ITEM = 1 << 5, // bullet item, marker dropped
+  MD_TABLE = 1 << 6,     // raw "| a | b |" row, pipes included
+};
+
+// A span of output text with one style. `text` points either into the chunk
+// passed to Feed() or into the streamer itself and is only valid for the
+// duration of the sink call.
+struct MarkdownRun {
+  const char *text;
+  size_t length;
+  uint16_t style;
+  uint8_t headingLevel; // 1-6 when MD_HEADING is set, else 0
+};
+
+// Incremental Markdown -> styled runs. Single pass over UTF-8 bytes with no
+// allocation: the only state carried between chunks is a few flags and at
+// most HELD_CAPACITY bytes of an unresolved line-start marker, so input may
+// be split at any byte boundary and produces the same runs as if it had
+// arrived in one piece (modulo where runs are split).
+//
+// Supported subset: **bold**, *italic* / _italic_, __underline__, `code`,
+// ``` fences, # headings, -/*/+ bullet items, | table rows. Numbered items
+// ("1. ") already carry their marker as text and pass through unflagged.
+// Markers are ASCII, so runs never split a multi-byte UTF-8 character that
+// was whole in the input.
+class MarkdownStreamer {
+public:
+  // `sink` is any callable taking `const MarkdownRun &`
+  template <typename Sink> void Feed(const char *data, size_t length, Sink &&sink) {
+    for (size_t i = 0; i < length;) {
+      if (atLineStart) {
+        ConsumeLineStart(data[i], sink);
+        i++;
+        continue;
+      }
+      if (skipToEndOfLine) {
+        if (data[i] == '\n') {
+          skipToEndOfLine = false;
+          atLineStart = true;
+        }
+        i++;
+        continue;
+      }
+      if (inCodeBlock) {
+        // Literal until the newline that may precede a closing fence
+        size_t start = i;
+        while (i < length && data[i] != '\n')
+          i++;
+        if (i < length)
+          i++;
+        Emit(data + start, i - start, sink);
+        if (data[i - 1] == '\n')
+          EndLine();
+        continue;
+      }
+
+      // Fast path: plain bytes extend the current run
+      if (pendingMarker == 0) {
+        size_t start = i;
+        while (i < length && !IsSpecial(data[i]))
+          i++;
+        if (i > start) {
+          Emit(data + start, i - start, sink);
+          previous = data[i - 1];
+          continue;
+        }
+      }
+      ConsumeInline(data + i, sink);
+      i++;
+    }
+    Flush(sink);
+  }
+
+  // End of input: resolve anything held back and reset for the next
+  // response
+  template <typename Sink> void Finish(Sink &&sink) {
+    if (heldCount > 0)
+      ReplayHeld(sink);
+    Flush(sink);
+    Reset();
+  }
+
+  void Reset() { *this = MarkdownStreamer(); }
+
+  static const size_t HELD_CAPACITY = 8;
+
+private:
+  // Line-start resolution
+  enum class LinePrefix : uint8_t { None, Indent, Hashes, Bullet, Ticks };
+
+  bool atLineStart = true;
+  bool skipToEndOfLine = false; // rest of a fence line (info string)
+  bool inCodeBlock = false;
+  bool inInlineCode = false;
+
+  uint16_t inlineStyle = MD_PLAIN;
+  uint16_t lineStyle = MD_PLAIN;
+  uint8_t headingLevel = 0;
+
+  // Unresolved inline marker ('*' or '_'): emphasis or strong depends on
+  // the next byte
+  char pendingMarker = 0;
+  char previous = '\n';
+
+  LinePrefix prefix = LinePrefix::None;
+  char held[HELD_CAPACITY] = {};
+  size_t heldCount = 0;
+
+  // Current run being built
+  const char *runText = nullptr;
+  size_t runLength = 0;
+  uint16_t runStyle = 0;
+  uint8_t runHeadingLevel = 0;
+
+  static bool IsSpecial(char c) {
+    return c == '*' || c == '_' || c == '`' || c == '\n';
+  }
+
+  static bool IsWordByte(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+           (c >= 'A' && c <= 'Z') || (unsigned char)c >= 0x80;
+  }
+
+  uint16_t CurrentStyle() const {
+    if (inCodeBlock)
+      return MD_CODE;
+    return inlineStyle | lineStyle | (inInlineCode ? MD_CODE : 0);
+  }
+
+  template <typename Sink> void Emit(const char *text, size_t length, Sink &sink) {
+    if (length == 0)
+      return;
+    uint16_t style = CurrentStyle();
+    uint8_t level = (style & MD_HEADING) ? headingLevel : 0;
+    if (runLength > 0 && runStyle == style && runHeadingLevel == level &&
+        runText + runLength == text) {
+      runLength += length;
+      return;
+    }
+    Flush(sink);
+    runText = text;
+    runLength = length;
+    runStyle = style;
+    runHeadingLevel = level;
+  }
+
+  template <typename Sink> void Flush(Sink &sink) {
+    if (runLength == 0)
+      return;
+    MarkdownRun run{runText, runLength, runStyle, runHeadingLevel};
+    runLength = 0;
+    sink(run);
+  }
+
+  void EndLine() {
+    atLineStart = true;
+    lineStyle = MD_PLAIN;
+    headingLevel = 0;
+    previous = '\n';
+  }
+
+  // Paragraph break: emphasis never spans a blank line
+  void EndParagraph() {
+    inlineStyle = MD_PLAIN;
+    inInlineCode = false;
+    pendingMarker = 0;
+  }
+
+  template <typename Sink> void BlankLine(Sink &sink) {
+    if (!inCodeBlock)
+      EndParagraph();
+    Emit(LiteralFor('\n'), 1, sink);
+    Flush(sink);
+    EndLine();
+  }
+
+  // -------------------------------------------------------------------------
+  // Line start: hold bytes until we know whether they form a block marker
+  // -------------------------------------------------------------------------
+  template <typename Sink> void ConsumeLineStart(char c, Sink &sink) {
+    if (c == '\n' && (heldCount == 0 || prefix == LinePrefix::Indent)) {
+      // Empty or whitespace-only line
+      DropHeld();
+      BlankLine(sink);
+      return;
+    }
+
+    if (inCodeBlock) {
+      // Only a closing fence is special inside a code block
+      if (c == '`' && heldCount < 3) {
+        Hold(c);
+        prefix = LinePrefix::Ticks;
+        if (heldCount == 3) {
+          DropHeld();
+          inCodeBlock = false;
+          skipToEndOfLine = true;
+          atLineStart = false;
+        }
+        return;
+      }
+      atLineStart = false;
+      ReplayHeld(sink);
+      Reprocess(c, sink);
+      return;
+    }
+
+    if (HoldLinePrefix(c))
+      return;
+
+    // Not a block marker: the held bytes are ordinary inline text
+    atLineStart = false;
+    ReplayHeld(sink);
+    Reprocess(c, sink);
+  }
+
+  // Returns true while `c` may still be part of a block marker. Decides
+  // headings, bullets and fences as soon as they are complete.
+  bool HoldLinePrefix(char c) {
+    if (heldCount == HELD_CAPACITY)
+      return false;
+
+    switch (prefix) {
+    case LinePrefix::None:
+    case LinePrefix::Indent:
+      if (c == ' ' && heldCount < HELD_CAPACITY - 1) {
+        Hold(c);
+        prefix = LinePrefix::Indent;
+        return true;
+      }
+      if (c == '#') {
+        Hold(c);
+        prefix = LinePrefix::Hashes;
+        return true;
+      }
+      if (c == '-' || c == '*' || c == '+') {
+        Hold(c);
+        prefix = LinePrefix::Bullet;
+        return true;
+      }
+      if (c == '`') {
+        Hold(c);
+        prefix = LinePrefix::Ticks;
+        return true;
+      }
+      if (c == '|') {
+        lineStyle |= MD_TABLE;
+      }
+      return false;
+
+    case LinePrefix::Hashes:
+      if (c == '#' && HeldMarkers('#') < 6) {
+        Hold(c);
+        return true;
+      }
+      if (c == ' ') {
+        headingLevel = (uint8_t)HeldMarkers('#');
+        lineStyle |= MD_HEADING;
+        DropHeld();
+        atLineStart = false;
+        return true;
+      }
+      return false;
+
+    case LinePrefix::Bullet:
+      if (c == ' ') {
+        lineStyle |= MD_LIST_ITEM;
+        DropHeld();
+        atLineStart = false;
+        return true;
+      }
+      return false;
+
+    case LinePrefix::Ticks:
+      if (c == '`') {
+        Hold(c);
+        if (HeldMarkers('`') == 3) {
+          DropHeld();
+          inCodeBlock = true;
+          skipToEndOfLine = true;
+          atLineStart = false;
+        }
+        return true;
+      }
+      return false;
+    }
+    return false;
+  }
+
+  void Hold(char c) { held[heldCount++] = c; }
+
+  void DropHeld() {
+    heldCount = 0;
+    prefix = LinePrefix::None;
+  }
+
+  size_t HeldMarkers(char marker) const {
+    size_t count = 0;
+    for (size_t n = 0; n < heldCount; n++) {
+      if (held[n] == marker)
+        count++;
+    }
+    return count;
+  }
+
+  // Run held bytes through the inline machine. Runs point into `held`, so
+  // flush before it can be overwritten.
+  template <typename Sink> void ReplayHeld(Sink &sink) {
+    size_t count = heldCount;
+    heldCount = 0;
+    prefix = LinePrefix::None;
+    bool wasLineStart = atLineStart;
+    atLineStart = false;
+    for (size_t n = 0; n < count; n++)
+      Reprocess(held[n], sink, &held[n]);
+    Flush(sink);
+    atLineStart = wasLineStart;
+  }
+
+  // Process one byte outside the line-start state. `stable` points to a copy
+  // of the byte that outlives this call when it may be emitted as text.
+  template <typename Sink>
+  void Reprocess(char c, Sink &sink, const char *stable = nullptr) {
+    if (inCodeBlock) {
+      EmitByte(c, stable, sink);
+      if (c == '\n')
+        EndLine();
+      return;
+    }
+    if (IsSpecial(c) || pendingMarker != 0) {
+      ConsumeInline(stable ? stable : LiteralFor(c), sink);
+      return;
+    }
+    EmitByte(c, stable, sink);
+    previous = c;
+  }
+
+  template <typename Sink>
+  void EmitByte(char c, const char *stable, Sink &sink) {
+    Emit(stable ? stable : LiteralFor(c), 1, sink);
+  }
+
+  // Single-byte literals for bytes that no longer live in any buffer
+  static const char *LiteralFor(char c) {
+    struct Bytes {
+      char values[256];
+      Bytes() {
+        for (int n = 0; n < 256; n++)
+          values[n] = (char)n;
+      }
+    };
+    static const Bytes bytes;
+    return &bytes.values[(unsigned char)c];
+  }
+
+  // -------------------------------------------------------------------------
+  // Inline markers
+  // -------------------------------------------------------------------------
+  template <typename Sink> void ConsumeInline(const char *at, Sink &sink) {
+    char c = *at;
+
+    if (pendingMarker != 0) {
+      if (c == pendingMarker) {
+        // Doubled marker: ** is bold, __ is underline
+        Flush(sink);
+        inlineStyle ^= (c == '*') ? MD_BOLD : MD_UNDERLINE;
+        pendingMarker = 0;
+        previous = c;
+        return;
+      }
+      ResolveSingleMarker(c, sink);
+    }
+
+    if (inInlineCode) {
+      if (c == '`') {
+        Flush(sink);
+        inInlineCode = false;
+      } else {
+        Emit(at, 1, sink);
+        if (c == '\n')
+          EndLine();
+      }
+      previous = c;
+      return;
+    }
+
+    switch (c) {
+    case '*':
+    case '_':
+      pendingMarker = c;
+      return;
+    case '`':
+      Flush(sink);
+      inInlineCode = true;
+      previous = c;
+      return;
+    case '\n':
+      Emit(at, 1, sink);
+      Flush(sink);
+      EndLine();
+      return;
+    default:
+      Emit(at, 1, sink);
+      previous = c;
+      return;
+    }
+  }
+
+  // A lone '*' or '_' followed by `next`: emphasis toggle, except for an
+  // intraword underscore (snake_case stays literal)
+  template <typename Sink> void ResolveSingleMarker(char next, Sink &sink) {
+    char marker = pendingMarker;
+    pendingMarker = 0;
+    if (marker == '_' && IsWordByte(previous) && IsWordByte(next)) {
+      Emit(LiteralFor('_'), 1, sink);
+      previous = '_';
+      return;
+    }
+    Flush(sink);
+    inlineStyle ^= MD_ITALIC;
+  }
+};
+
+} // namespace MCPHelper
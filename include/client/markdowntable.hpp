@@ -0,0 +1,178 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Platform-neutral: no Windows headers.
+
+namespace MCPHelper {
+
+enum class ColumnAlignment : unsigned char { Left, Center, Right };
+
+// Collects the MD_TABLE runs of one Markdown table into a cell matrix.
+// Rows are parsed as each line completes; the "|---|:--:|" separator row
+// sets column alignment and is not part of the matrix. A block without a
+// separator row is not a table and is handed back as its original lines.
+class MarkdownTableBuilder {
+public:
+  // Bytes of table rows as the streamer emits them, newlines included
+  void Append(const char *text, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+      if (text[i] == '\n') {
+        EndLine();
+      } else {
+        line += text[i];
+      }
+    }
+  }
+
+  bool Empty() const { return rawLines.empty() && line.empty(); }
+
+  // Completes a trailing row that had no newline yet
+  void Finish() {
+    if (!line.empty())
+      EndLine();
+  }
+
+  bool IsTable() const { return hasSeparator && !rows.empty(); }
+
+  const std::vector<std::vector<std::string>> &Rows() const { return rows; }
+  const std::vector<ColumnAlignment> &Alignments() const { return alignments; }
+  size_t ColumnCount() const { return columnCount; }
+
+  // Rows joined for Range.ConvertToTable: cells by '\t', rows by '\n',
+  // short rows padded so every row has ColumnCount() cells
+  std::string ToTabDelimited() const {
+    std::string out;
+    for (const auto &row : rows) {
+      for (size_t column = 0; column < columnCount; column++) {
+        if (column > 0)
+          out += '\t';
+        if (column < row.size())
+          out += row[column];
+      }
+      out += '\n';
+    }
+    return out;
+  }
+
+  // The block exactly as received, for when it turns out not to be a table
+  std::string RawText() const {
+    std::string out;
+    for (const auto &raw : rawLines)
+      out += raw + '\n';
+    return out + line;
+  }
+
+  void Reset() {
+    line.clear();
+    rawLines.clear();
+    rows.clear();
+    alignments.clear();
+    columnCount = 0;
+    hasSeparator = false;
+  }
+
+private:
+  std::string line;
+  std::vector<std::string> rawLines;
+  std::vector<std::vector<std::string>> rows;
+  std::vector<ColumnAlignment> alignments;
+  size_t columnCount = 0;
+  bool hasSeparator = false;
+
+  void EndLine() {
+    rawLines.push_back(line);
+    std::vector<std::string> cells = SplitCells(line);
+    line.clear();
+
+    // The separator must directly follow the header row
+    if (!hasSeparator && rows.size() == 1 && IsSeparatorRow(cells)) {
+      hasSeparator = true;
+      alignments.clear();
+      for (const auto &cell : cells)
+        alignments.push_back(AlignmentOf(cell));
+      alignments.resize(columnCount, ColumnAlignment::Left);
+      return;
+    }
+
+    if (cells.size() > columnCount)
+      columnCount = cells.size();
+    rows.push_back(std::move(cells));
+    alignments.resize(columnCount, ColumnAlignment::Left);
+  }
+
+  // "| a | b \| c |" -> ["a", "b | c"]; outer pipes are optional
+  static std::vector<std::string> SplitCells(const std::string &row) {
+    std::vector<std::string> cells;
+    size_t begin = 0;
+    size_t end = row.size();
+    while (begin < end && IsBlank(row[begin]))
+      begin++;
+    while (end > begin && IsBlank(row[end - 1]))
+      end--;
+    if (begin < end && row[begin] == '|')
+      begin++;
+    if (end > begin && row[end - 1] == '|' &&
+        !(end - begin >= 2 && row[end - 2] == '\\'))
+      end--;
+
+    std::string cell;
+    for (size_t i = begin; i < end; i++) {
+      char c = row[i];
+      if (c == '\\' && i + 1 < end && row[i + 1] == '|') {
+        cell += '|';
+        i++;
+      } else if (c == '|') {
+        cells.push_back(Trim(cell));
+        cell.clear();
+      } else {
+        // A tab would split the cell again in ConvertToTable
+        cell += (c == '\t') ? ' ' : c;
+      }
+    }
+    cells.push_back(Trim(cell));
+    return cells;
+  }
+
+  static bool IsSeparatorRow(const std::vector<std::string> &cells) {
+    for (const auto &cell : cells) {
+      size_t dashes = 0;
+      for (size_t i = 0; i < cell.size(); i++) {
+        char c = cell[i];
+        if (c == '-') {
+          dashes++;
+        } else if (c != ':' || (i != 0 && i + 1 != cell.size())) {
+          return false;
+        }
+      }
+      if (dashes == 0)
+        return false;
+    }
+    return !cells.empty();
+  }
+
+  static ColumnAlignment AlignmentOf(const std::string &separator) {
+    bool left = !separator.empty() && separator.front() == ':';
+    bool right = !separator.empty() && separator.back() == ':';
+    if (left && right)
+      return ColumnAlignment::Center;
+    if (right)
+      return ColumnAlignment::Right;
+    return ColumnAlignment::Left;
+  }
+
+  static bool IsBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+  static std::string Trim(const std::string &text) {
+    size_t begin = 0;
+    size_t end = text.size();
+    while (begin < end && IsBlank(text[begin]))
+      begin++;
+    while (end > begin && IsBlank(text[end - 1]))
+      end--;
+    return text.substr(begin, end - begin);
+  }
+};
+
+} // namespace MCPHelper
@@ -0,0 +1,118 @@
+#pragma once
+#include "markdown.hpp"
+#include "writecoalescer.hpp"
+#include <cstddef>
+#include <vector>
+
+namespace MCPHelper {
+
+// What one range-level operation changes
+enum class FormatAttribute : uint8_t {
+  ParagraphStyle, // Range.Style = value (WdBuiltinStyle)
+  Bold,           // Font.Bold
+  Italic,         // Font.Italic
+  Underline,      // Font.Underline
+  Code,           // Font.Name = monospace / back to the body font
+};
+
+// Apply `attribute` = `value` to [start, end) of the text just inserted
+struct FormatOp {
+  size_t start;
+  size_t end;
+  FormatAttribute attribute;
+  long value;
+};
+
+// Turns the style spans of one flush into the fewest range operations.
+// Inserted text takes the formatting of the character in front of it, so
+// only attributes that differ from that are touched, and each attribute is
+// applied once per contiguous stretch, even when the stretch crosses spans
+// that differ in other attributes ("**bold _both_ bold**" is one Bold op
+// plus one Italic op).
+class RangeFormatPlanner {
+public:
+  // WdBuiltinStyle ids, independent of the UI language
+  static const long STYLE_NORMAL = -1;
+  static const long STYLE_LIST_BULLET = -49;
+  static long HeadingStyle(uint8_t level) { return -1 - (long)level; }
+
+  // Paragraph style a span's lines should carry
+  static long ParagraphStyleFor(const StyledSpan &span) {
+    if (span.style & MD_HEADING)
+      return HeadingStyle(span.headingLevel);
+    if (span.style & MD_LIST_ITEM)
+      return STYLE_LIST_BULLET;
+    return STYLE_NORMAL;
+  }
+
+  // Start of a response: assume plain text in a Normal paragraph at the
+  // insertion point
+  void Reset() {
+    characterStyle = MD_PLAIN;
+    paragraphStyle = STYLE_NORMAL;
+  }
+
+  // Fills `ops` (paragraph styles first, then character attributes) and
+  // advances the tracked formatting to the end of the flushed text
+  void Plan(const std::vector<StyledSpan> &spans, std::vector<FormatOp> &ops) {
+    ops.clear();
+    if (spans.empty())
+      return;
+
+    // Paragraph styles apply to every paragraph a range touches. A new
+    // paragraph inherits the style of the one it was split from, so only
+    // changes need an op.
+    for (const auto &span : spans) {
+      long wanted = ParagraphStyleFor(span);
+      if (wanted == paragraphStyle)
+        continue;
+      AddOrExtend(ops, span, FormatAttribute::ParagraphStyle, wanted);
+      paragraphStyle = wanted;
+    }
+
+    PlanCharacter(spans, ops, MD_BOLD, FormatAttribute::Bold);
+    PlanCharacter(spans, ops, MD_ITALIC, FormatAttribute::Italic);
+    PlanCharacter(spans, ops, MD_UNDERLINE, FormatAttribute::Underline);
+    PlanCharacter(spans, ops, MD_CODE, FormatAttribute::Code);
+
+    characterStyle = spans.back().style & CHARACTER_MASK;
+  }
+
+private:
+  static const uint16_t CHARACTER_MASK =
+      MD_BOLD | MD_ITALIC | MD_UNDERLINE | MD_CODE;
+
+  uint16_t characterStyle = MD_PLAIN;
+  long paragraphStyle = STYLE_NORMAL;
+
+  void PlanCharacter(const std::vector<StyledSpan> &spans,
+                     std::vector<FormatOp> &ops, uint16_t bit,
+                     FormatAttribute attribute) {
+    bool inherited = (characterStyle & bit) != 0;
+    size_t first = ops.size();
+    for (const auto &span : spans) {
+      bool wanted = (span.style & bit) != 0;
+      if (wanted == inherited)
+        continue;
+      // Extend only ops of this attribute added by this call
+      if (ops.size() > first && ops.back().end == span.offset) {
+        ops.back().end = span.offset + span.length;
+      } else {
+        ops.push_back(
+            {span.offset, span.offset + span.length, attribute, wanted ? 1 : 0});
+      }
+    }
+  }
+
+  static void AddOrExtend(std::vector<FormatOp> &ops, const StyledSpan &span,
+                          FormatAttribute attribute, long value) {
+    if (!ops.empty() && ops.back().attribute == attribute &&
+        ops.back().value == value && ops.back().end == span.offset) {
+      ops.back().end = span.offset + span.length;
+      return;
+    }
+    ops.push_back({span.offset, span.offset + span.length, attribute, value});
+  }
+};
+
+} // namespace MCPHelper
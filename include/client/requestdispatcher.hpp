@@ -0,0 +1,260 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+// Platform-neutral: no Windows headers.
+
+namespace MCPHelper {
+
+namespace detail {
+
+inline const char *SkipJsonSpace(const char *p, const char *end) {
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+    p++;
+  return p;
+}
+
+// `p` is on an opening quote; returns the byte after the closing one
+inline const char *SkipJsonString(const char *p, const char *end) {
+  for (p++; p < end; p++) {
+    if (*p == '\\')
+      p++;
+    else if (*p == '"')
+      return p + 1;
+  }
+  return nullptr;
+}
+
+// Skips one value of any shape without validating it
+inline const char *SkipJsonValue(const char *p, const char *end) {
+  if (p == end)
+    return nullptr;
+  if (*p == '"')
+    return SkipJsonString(p, end);
+  if (*p == '{' || *p == '[') {
+    int depth = 0;
+    while (p < end) {
+      if (*p == '"') {
+        p = SkipJsonString(p, end);
+        if (!p)
+          return nullptr;
+        continue;
+      }
+      if (*p == '{' || *p == '[')
+        depth++;
+      else if ((*p == '}' || *p == ']') && --depth == 0)
+        return p + 1;
+      p++;
+    }
+    return nullptr;
+  }
+  // Number, true, false or null
+  const char *start = p;
+  while (p < end && *p != ',' && *p != '}' && *p != ' ' && *p != '\t' &&
+         *p != '\n' && *p != '\r')
+    p++;
+  return p > start ? p : nullptr;
+}
+
+} // namespace detail
+
+// Reads the top-level "id" of a server message without parsing the rest.
+// The server echoes ids the way the client sends them, as a string of digits
+// ("42"); a bare number is accepted too. The server writes "id" first, so
+// this usually stops after a few bytes. False if there is no usable id.
+inline bool PeekRequestId(const char *message, size_t length, uint64_t &id) {
+  const char *end = message + length;
+  const char *p = detail::SkipJsonSpace(message, end);
+  if (p == end || *p++ != '{')
+    return false;
+
+  for (;;) {
+    p = detail::SkipJsonSpace(p, end);
+    if (p == end || *p != '"')
+      return false;
+    const char *key = p + 1;
+    p = detail::SkipJsonString(p, end);
+    if (!p)
+      return false;
+    bool isId = p - key == 3 && key[0] == 'i' && key[1] == 'd';
+
+    p = detail::SkipJsonSpace(p, end);
+    if (p == end || *p++ != ':')
+      return false;
+    p = detail::SkipJsonSpace(p, end);
+
+    if (isId) {
+      bool quoted = p < end && *p == '"';
+      if (quoted)
+        p++;
+      const char *digits = p;
+      uint64_t value = 0;
+      for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        unsigned digit = *p - '0';
+        if (value > (UINT64_MAX - digit) / 10)
+          return false;
+        value = value * 10 + digit;
+      }
+      if (p == digits || (quoted && (p == end || *p != '"')))
+        return false;
+      id = value;
+      return true;
+    }
+
+    p = detail::SkipJsonValue(p, end);
+    if (!p)
+      return false;
+    p = detail::SkipJsonSpace(p, end);
+    if (p == end || *p++ != ',')
+      return false;
+  }
+}
+
+// Routes the messages of one WebSocket session to the request they answer,
+// so several requests (a streaming answer, a history page, a health check)
+// can be outstanding on the same socket. The receive thread calls
+// Dispatch(); any thread registers and cancels requests.
+class RequestDispatcher {
+public:
+  // Runs on the receive thread for each message of its request and returns
+  // true when that message was the last one. If the connection is lost
+  // first it runs once more with `message` == nullptr.
+  using Handler = std::function<bool(const char *message, size_t length)>;
+
+  RequestDispatcher() = default;
+  RequestDispatcher(const RequestDispatcher &) = delete;
+  RequestDispatcher &operator=(const RequestDispatcher &) = delete;
+
+  // Increasing and never reused for the lifetime of the client, so a late
+  // reply to a cancelled request can't be taken for a newer one
+  uint64_t NextId() { return nextId.fetch_add(1, std::memory_order_relaxed); }
+
+  // Register before sending the request. False once the session is closed.
+  bool Register(uint64_t id, Handler handler) {
+    auto route = std::make_shared<Route>();
+    route->handler = std::move(handler);
+    std::lock_guard<std::mutex> lock(tableMutex);
+    if (closed)
+      return false;
+    routes[id] = std::move(route);
+    return true;
+  }
+
+  // A request answered by exactly one message. The future receives it, or
+  // an empty string if the connection is lost first.
+  std::future<std::string> Expect(uint64_t id) {
+    auto reply = std::make_shared<std::promise<std::string>>();
+    std::future<std::string> result = reply->get_future();
+    bool registered =
+        Register(id, [reply](const char *message, size_t length) {
+          reply->set_value(message ? std::string(message, length)
+                                   : std::string());
+          return true;
+        });
+    if (!registered)
+      reply->set_value(std::string());
+    return result;
+  }
+
+  // Forgets `id`: once this returns its handler is not running and will not
+  // run again; later messages for it are dropped
+  void Cancel(uint64_t id) {
+    std::shared_ptr<Route> route;
+    {
+      std::lock_guard<std::mutex> lock(tableMutex);
+      auto it = routes.find(id);
+      if (it == routes.end())
+        return;
+      route = std::move(it->second);
+      routes.erase(it);
+    }
+    std::lock_guard<std::mutex> call(route->callMutex);
+    route->done = true;
+  }
+
+  // Receive thread: hands one complete message to its request. False if no
+  // request is waiting for it (no id, or an unknown or cancelled one).
+  bool Dispatch(const char *message, size_t length) {
+    uint64_t id;
+    if (!PeekRequestId(message, length, id))
+      return false;
+
+    std::shared_ptr<Route> route;
+    {
+      std::lock_guard<std::mutex> lock(tableMutex);
+      auto it = routes.find(id);
+      if (it == routes.end())
+        return false;
+      route = it->second;
+    }
+
+    // Only this route is locked while its handler runs; registering and
+    // cancelling other requests never waits for it
+    {
+      std::lock_guard<std::mutex> call(route->callMutex);
+      if (route->done)
+        return false;
+      route->done = route->handler(message, length);
+      if (!route->done)
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(tableMutex);
+    auto it = routes.find(id);
+    if (it != routes.end() && it->second == route)
+      routes.erase(it);
+    return true;
+  }
+
+  // Connection lost: every pending request hears about it once, and new
+  // ones are refused until Open()
+  void Close() {
+    std::unordered_map<uint64_t, std::shared_ptr<Route>> pending;
+    {
+      std::lock_guard<std::mutex> lock(tableMutex);
+      closed = true;
+      pending.swap(routes);
+    }
+    for (auto &entry : pending) {
+      Route &route = *entry.second;
+      std::lock_guard<std::mutex> call(route.callMutex);
+      if (!route.done) {
+        route.done = true;
+        route.handler(nullptr, 0);
+      }
+    }
+  }
+
+  // A new session: requests are accepted again
+  void Open() {
+    std::lock_guard<std::mutex> lock(tableMutex);
+    closed = false;
+  }
+
+  size_t Pending() const {
+    std::lock_guard<std::mutex> lock(tableMutex);
+    return routes.size();
+  }
+
+private:
+  struct Route {
+    Handler handler;
+    std::mutex callMutex; // held while the handler runs
+    bool done = false;    // finished or cancelled; guarded by callMutex
+  };
+
+  std::atomic<uint64_t> nextId{1};
+  mutable std::mutex tableMutex;
+  std::unordered_map<uint64_t, std::shared_ptr<Route>> routes;
+  bool closed = false;
+};
+
+} // namespace MCPHelper
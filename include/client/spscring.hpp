@@ -0,0 +1,126 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+namespace MCPHelper {
+
+// Bounded single-producer/single-consumer ring.
+// Exactly one thread may call TryPush and exactly one other thread may call
+// TryPop. Neither side takes a lock or blocks; a full or empty ring simply
+// returns false and the caller decides how to wait.
+// Deliberately free of Windows headers so it can be stress-tested anywhere.
+template <typename T, size_t Capacity> class SpscRing {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                "SpscRing capacity must be a power of two");
+
+public:
+  // Producer side. `value` is only moved from when the push succeeds.
+  bool TryPush(T &&value) {
+    const size_t writeIndex = tail.load(std::memory_order_relaxed);
+    if (writeIndex - cachedHead == Capacity) {
+      cachedHead = head.load(std::memory_order_acquire);
+      if (writeIndex - cachedHead == Capacity)
+        return false;
+    }
+
+    slots[writeIndex & (Capacity - 1)] = std::move(value);
+    tail.store(writeIndex + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side
+  bool TryPop(T &out) {
+    const size_t readIndex = head.load(std::memory_order_relaxed);
+    if (readIndex == cachedTail) {
+      cachedTail = tail.load(std::memory_order_acquire);
+      if (readIndex == cachedTail)
+        return false;
+    }
+
+    out = std::move(slots[readIndex & (Capacity - 1)]);
+    head.store(readIndex + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Approximate when called concurrently; exact once the producer is done
+  bool Empty() const {
+    return head.load(std::memory_order_acquire) ==
+           tail.load(std::memory_order_acquire);
+  }
+
+  static constexpr size_t capacity() { return Capacity; }
+
+private:
+  // Consumer-owned line: read index plus its cached view of the tail
+  alignas(64) std::atomic<size_t> head{0};
+  size_t cachedTail = 0;
+
+  // Producer-owned line: write index plus its cached view of the head
+  alignas(64) std::atomic<size_t> tail{0};
+  size_t cachedHead = 0;
+
+  alignas(64) T slots[Capacity];
+};
+
+// SpscRing whose producer never waits: once the ring is full, values go to
+// a locked overflow list until the consumer has taken all of it, and only
+// then to the ring again. Order is kept. For a producer that must not stall,
+// such as a receive thread shared by other requests; the overflow is
+// unbounded, so the consumer is trusted to catch up eventually.
+template <typename T, size_t Capacity> class SpillingSpscQueue {
+public:
+  // Producer side
+  void Push(T &&value) {
+    if (!spilling.load(std::memory_order_acquire) &&
+        ring.TryPush(std::move(value)))
+      return;
+
+    std::lock_guard<std::mutex> lock(overflowMutex);
+    overflow.push_back(std::move(value));
+    spilled++;
+    // Every earlier ring push is published along with this
+    spilling.store(true, std::memory_order_release);
+  }
+
+  // Consumer side
+  bool TryPop(T &out) {
+    if (taken.empty()) {
+      // Read first: while it is set the producer leaves the ring alone, so
+      // an empty ring then means everything older than the overflow is out
+      bool overflowing = spilling.load(std::memory_order_acquire);
+      if (ring.TryPop(out))
+        return true;
+      if (!overflowing)
+        return false;
+
+      std::lock_guard<std::mutex> lock(overflowMutex);
+      taken.swap(overflow);
+      spilling.store(false, std::memory_order_release);
+    }
+
+    // Newer pushes may reach the ring now; these go out first
+    out = std::move(taken.front());
+    taken.pop_front();
+    return true;
+  }
+
+  // Values that went to the overflow so far. Exact once the producer is
+  // done.
+  size_t Spilled() {
+    std::lock_guard<std::mutex> lock(overflowMutex);
+    return spilled;
+  }
+
+private:
+  SpscRing<T, Capacity> ring;
+  std::atomic<bool> spilling{false};
+  std::mutex overflowMutex;
+  std::deque<T> overflow; // guarded by overflowMutex
+  size_t spilled = 0;     // guarded by overflowMutex
+  std::deque<T> taken;    // consumer-owned: overflow being handed out
+};
+
+} // namespace MCPHelper
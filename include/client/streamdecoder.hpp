@@ -0,0 +1,533 @@
+#pragma once
+#include "../../third_party/nlohmann/json.hpp"
+#include "arena.hpp"
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace MCPHelper {
+
+// What a single server frame means to the streaming writer
+enum class StreamEventKind {
+  Ignored,   // unparseable or unknown frame, keep receiving
+  Chunk,     // {"status":"streaming","content":...}
+  Complete,  // {"status":"complete"}
+  Cancelled, // {"status":"cancelled"}, the server stopped after a cancel
+  Error,     // {"status":"error"} or {"success":false}, or a transport failure
+  Response,  // {"success":true,"content":...} non-streaming fallback
+};
+
+// Events carry no heap memory: `content` (chunk text, full response or
+// error message) lives in the request's arena or is a string literal
+struct StreamEvent {
+  StreamEventKind kind = StreamEventKind::Ignored;
+  std::string_view content;
+
+  bool IsTerminal() const {
+    return kind == StreamEventKind::Complete ||
+           kind == StreamEventKind::Cancelled ||
+           kind == StreamEventKind::Error ||
+           kind == StreamEventKind::Response;
+  }
+};
+
+// Reassembles WebSocket message fragments into complete text messages.
+// Only messages split across receives are copied; Reset() keeps the
+// buffer's capacity for the next one.
+class StreamFrameAssembler {
+public:
+  // Returns true once `isFinal` closes a message; read it with Message()
+  bool Append(const char *data, size_t length, bool isFinal) {
+    message.append(data, length);
+    return isFinal;
+  }
+
+  bool Empty() const { return message.empty(); }
+  const std::string &Message() const { return message; }
+  void Reset() { message.clear(); }
+
+private:
+  std::string message;
+};
+
+// Zero-DOM decoder for the flat frames the server sends per token. Scans
+// the top-level object once, remembering where the status, content, error
+// and success values are, and unescapes only the string the event needs.
+// Anything outside that shape (nested values, duplicate known keys, bad
+// escapes, invalid UTF-8, trailing bytes) is rejected so the caller can fall
+// back to the full parser, which then decides exactly as it always did.
+class StreamFrameScanner {
+public:
+  // True if the message was decoded into `event`; its content is copied
+  // into `arena`
+  static bool TryDecode(const char *message, size_t length,
+                        RequestArena &arena, StreamEvent &event) {
+    StreamFrameScanner scanner(message, message + length, arena);
+    return scanner.Scan() && scanner.Build(event);
+  }
+
+private:
+  struct Span {
+    const char *begin = nullptr; // first byte inside the quotes
+    const char *end = nullptr;   // closing quote
+    bool escaped = false;
+  };
+
+  enum class Value { None, String, True, False, Other };
+
+  const char *at;
+  const char *limit;
+  RequestArena &arena;
+
+  Span status, content, error;
+  Value statusType = Value::None;
+  Value contentType = Value::None;
+  Value errorType = Value::None;
+  Value successType = Value::None;
+
+  StreamFrameScanner(const char *begin, const char *end, RequestArena &arena)
+      : at(begin), limit(end), arena(arena) {}
+
+  bool Scan() {
+    SkipSpace();
+    if (!Consume('{'))
+      return false;
+    SkipSpace();
+    if (!Consume('}')) {
+      for (;;) {
+        Span key;
+        if (!ScanString(key))
+          return false;
+        SkipSpace();
+        if (!Consume(':'))
+          return false;
+        SkipSpace();
+        if (!ScanMember(key))
+          return false;
+        SkipSpace();
+        if (Consume(',')) {
+          SkipSpace();
+          continue;
+        }
+        if (Consume('}'))
+          break;
+        return false;
+      }
+    }
+    SkipSpace();
+    return at == limit;
+  }
+
+  // A key spelled with escapes might decode to a known one; leave such
+  // frames to the full parser
+  bool ScanMember(const Span &key) {
+    if (key.escaped)
+      return false;
+    if (KeyIs(key, "status"))
+      return ScanKnown(status, statusType);
+    if (KeyIs(key, "content"))
+      return ScanKnown(content, contentType);
+    if (KeyIs(key, "error"))
+      return ScanKnown(error, errorType);
+    if (KeyIs(key, "success")) {
+      Span unused;
+      return ScanKnown(unused, successType);
+    }
+    Value ignored;
+    Span unused;
+    return ScanValue(unused, ignored);
+  }
+
+  bool ScanKnown(Span &span, Value &type) {
+    if (type != Value::None)
+      return false; // duplicate key
+    return ScanValue(span, type);
+  }
+
+  bool ScanValue(Span &span, Value &type) {
+    if (at == limit)
+      return false;
+    switch (*at) {
+    case '"':
+      type = Value::String;
+      return ScanString(span);
+    case 't':
+      type = Value::True;
+      return ConsumeWord("true");
+    case 'f':
+      type = Value::False;
+      return ConsumeWord("false");
+    case 'n':
+      type = Value::Other;
+      return ConsumeWord("null");
+    default:
+      type = Value::Other;
+      return ScanNumber();
+    }
+  }
+
+  // Finds the closing quote and validates every string, used or not, the
+  // way the full parser would; only strings an event needs are copied
+  bool ScanString(Span &span) {
+    if (!Consume('"'))
+      return false;
+    span.begin = at;
+    while (at < limit) {
+      unsigned char c = (unsigned char)*at;
+      if (c == '"') {
+        span.end = at++;
+        return true;
+      }
+      if (c < 0x20)
+        return false;
+      if (c == '\\') {
+        unsigned long code;
+        span.escaped = true;
+        at++;
+        if (!DecodeEscape(at, limit, code))
+          return false;
+      } else if (c >= 0x80) {
+        size_t length = Utf8SequenceLength(at, limit);
+        if (length == 0)
+          return false;
+        at += length;
+      } else {
+        at++;
+      }
+    }
+    return false;
+  }
+
+  // JSON number grammar: -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+  bool ScanNumber() {
+    if (at < limit && *at == '-')
+      at++;
+    if (at < limit && *at == '0') {
+      at++;
+    } else if (!ScanDigits()) {
+      return false;
+    }
+    if (at < limit && *at == '.') {
+      at++;
+      if (!ScanDigits())
+        return false;
+    }
+    if (at < limit && (*at == 'e' || *at == 'E')) {
+      at++;
+      if (at < limit && (*at == '+' || *at == '-'))
+        at++;
+      if (!ScanDigits())
+        return false;
+    }
+    return true;
+  }
+
+  bool ScanDigits() {
+    const char *start = at;
+    while (at < limit && *at >= '0' && *at <= '9')
+      at++;
+    return at > start;
+  }
+
+  void SkipSpace() {
+    while (at < limit &&
+           (*at == ' ' || *at == '\t' || *at == '\n' || *at == '\r'))
+      at++;
+  }
+
+  bool Consume(char c) {
+    if (at < limit && *at == c) {
+      at++;
+      return true;
+    }
+    return false;
+  }
+
+  bool ConsumeWord(const char *word) {
+    size_t length = std::strlen(word);
+    if ((size_t)(limit - at) < length || std::memcmp(at, word, length) != 0)
+      return false;
+    at += length;
+    return true;
+  }
+
+  static bool KeyIs(const Span &key, const char *name) {
+    size_t length = std::strlen(name);
+    return (size_t)(key.end - key.begin) == length &&
+           std::memcmp(key.begin, name, length) == 0;
+  }
+
+  static bool SpanIs(const Span &span, const char *text) {
+    return !span.escaped && KeyIs(span, text);
+  }
+
+  // Same decisions as DecodeStreamEventDom. A known key holding the wrong
+  // type is left to the full parser, which reports it.
+  bool Build(StreamEvent &event) {
+    if (statusType != Value::None) {
+      if (statusType != Value::String || status.escaped)
+        return false;
+      if (SpanIs(status, "streaming")) {
+        if (contentType == Value::None)
+          return true;
+        event.kind = StreamEventKind::Chunk;
+        return TakeString(content, contentType, event.content);
+      }
+      if (SpanIs(status, "complete")) {
+        event.kind = StreamEventKind::Complete;
+        return true;
+      }
+      if (SpanIs(status, "cancelled")) {
+        event.kind = StreamEventKind::Cancelled;
+        return true;
+      }
+      if (SpanIs(status, "error")) {
+        event.kind = StreamEventKind::Error;
+        if (contentType == Value::None) {
+          event.content = "Unknown error";
+          return true;
+        }
+        return TakeString(content, contentType, event.content);
+      }
+      return true;
+    }
+
+    if (successType == Value::True) {
+      event.kind = StreamEventKind::Response;
+      if (contentType == Value::None)
+        return true;
+      return TakeString(content, contentType, event.content);
+    }
+    if (successType == Value::False) {
+      event.kind = StreamEventKind::Error;
+      if (errorType == Value::None) {
+        event.content = "Unknown error";
+        return true;
+      }
+      return TakeString(error, errorType, event.content);
+    }
+    return successType == Value::None;
+  }
+
+  // The span was validated by ScanString. Unescaped text is never longer
+  // than its escaped form, so it is written into an arena allocation of the
+  // raw length, which is then trimmed.
+  bool TakeString(const Span &span, Value type, std::string_view &out) {
+    if (type != Value::String)
+      return false;
+    size_t rawLength = span.end - span.begin;
+    if (!span.escaped) {
+      out = arena.Copy(span.begin, rawLength);
+      return true;
+    }
+
+    char *begin = arena.AllocateChars(rawLength);
+    char *cursor = begin;
+    const char *p = span.begin;
+    while (p < span.end) {
+      const char *plain = p;
+      while (p < span.end && *p != '\\')
+        p++;
+      std::memcpy(cursor, plain, p - plain);
+      cursor += p - plain;
+      if (p == span.end)
+        break;
+      unsigned long code;
+      p++;
+      DecodeEscape(p, span.end, code);
+      AppendUtf8(code, cursor);
+    }
+    arena.Shrink(begin, rawLength, cursor - begin);
+    out = std::string_view(begin, cursor - begin);
+    return true;
+  }
+
+  // The escape after a backslash, surrogate pairs joined. False for
+  // anything the full parser rejects, lone surrogates included.
+  static bool DecodeEscape(const char *&p, const char *end,
+                           unsigned long &code) {
+    if (p == end)
+      return false;
+    switch (*p++) {
+    case '"':
+      code = '"';
+      return true;
+    case '\\':
+      code = '\\';
+      return true;
+    case '/':
+      code = '/';
+      return true;
+    case 'b':
+      code = '\b';
+      return true;
+    case 'f':
+      code = '\f';
+      return true;
+    case 'n':
+      code = '\n';
+      return true;
+    case 'r':
+      code = '\r';
+      return true;
+    case 't':
+      code = '\t';
+      return true;
+    case 'u':
+      break;
+    default:
+      return false;
+    }
+
+    if (!ReadHex4(p, end, code))
+      return false;
+    if (code >= 0xDC00 && code <= 0xDFFF)
+      return false;
+    if (code < 0xD800 || code > 0xDBFF)
+      return true;
+
+    unsigned long low;
+    if (end - p < 2 || p[0] != '\\' || p[1] != 'u')
+      return false;
+    p += 2;
+    if (!ReadHex4(p, end, low) || low < 0xDC00 || low > 0xDFFF)
+      return false;
+    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+    return true;
+  }
+
+  static bool ReadHex4(const char *&p, const char *end, unsigned long &code) {
+    if (end - p < 4)
+      return false;
+    code = 0;
+    for (int n = 0; n < 4; n++) {
+      char c = *p++;
+      code <<= 4;
+      if (c >= '0' && c <= '9')
+        code |= c - '0';
+      else if (c >= 'a' && c <= 'f')
+        code |= c - 'a' + 10;
+      else if (c >= 'A' && c <= 'F')
+        code |= c - 'A' + 10;
+      else
+        return false;
+    }
+    return true;
+  }
+
+  static void AppendUtf8(unsigned long code, char *&out) {
+    if (code < 0x80) {
+      *out++ = (char)code;
+    } else if (code < 0x800) {
+      *out++ = (char)(0xC0 | (code >> 6));
+      *out++ = (char)(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+      *out++ = (char)(0xE0 | (code >> 12));
+      *out++ = (char)(0x80 | ((code >> 6) & 0x3F));
+      *out++ = (char)(0x80 | (code & 0x3F));
+    } else {
+      *out++ = (char)(0xF0 | (code >> 18));
+      *out++ = (char)(0x80 | ((code >> 12) & 0x3F));
+      *out++ = (char)(0x80 | ((code >> 6) & 0x3F));
+      *out++ = (char)(0x80 | (code & 0x3F));
+    }
+  }
+
+  // Length of the well-formed UTF-8 sequence at `p` (lead byte >= 0x80), or
+  // 0 if it is one the full parser rejects: overlongs, surrogates, anything
+  // above U+10FFFF, truncation
+  static size_t Utf8SequenceLength(const char *p, const char *end) {
+    unsigned char c = (unsigned char)*p;
+    size_t extra;
+    unsigned char low = 0x80, high = 0xBF;
+    if (c >= 0xC2 && c <= 0xDF) {
+      extra = 1;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+      extra = 2;
+      if (c == 0xE0)
+        low = 0xA0;
+      else if (c == 0xED)
+        high = 0x9F;
+    } else if (c >= 0xF0 && c <= 0xF4) {
+      extra = 3;
+      if (c == 0xF0)
+        low = 0x90;
+      else if (c == 0xF4)
+        high = 0x8F;
+    } else {
+      return 0;
+    }
+    if ((size_t)(end - p) <= extra)
+      return 0;
+    unsigned char second = (unsigned char)p[1];
+    if (second < low || second > high)
+      return 0;
+    for (size_t n = 2; n <= extra; n++) {
+      if (((unsigned char)p[n] & 0xC0) != 0x80)
+        return 0;
+    }
+    return extra + 1;
+  }
+};
+
+// Full-parser path: builds a DOM, handles any shape. Strings are copied
+// into `arena` like the scanner's.
+inline StreamEvent DecodeStreamEventDom(const char *message, size_t length,
+                                        RequestArena &arena) {
+  StreamEvent event;
+  auto keep = [&arena](const std::string &text) {
+    return arena.Copy(text.data(), text.size());
+  };
+
+  try {
+    nlohmann::json responseJson = nlohmann::json::parse(message, message + length);
+
+    if (responseJson.contains("status")) {
+      const std::string status = responseJson["status"].get<std::string>();
+
+      if (status == "streaming") {
+        if (responseJson.contains("content")) {
+          event.kind = StreamEventKind::Chunk;
+          event.content = keep(responseJson["content"].get<std::string>());
+        }
+      } else if (status == "complete") {
+        event.kind = StreamEventKind::Complete;
+      } else if (status == "cancelled") {
+        event.kind = StreamEventKind::Cancelled;
+      } else if (status == "error") {
+        event.kind = StreamEventKind::Error;
+        event.content = responseJson.contains("content")
+                            ? keep(responseJson["content"].get<std::string>())
+                            : "Unknown error";
+      }
+    } else if (responseJson.contains("success")) {
+      if (responseJson["success"].get<bool>()) {
+        event.kind = StreamEventKind::Response;
+        if (responseJson.contains("content"))
+          event.content = keep(responseJson["content"].get<std::string>());
+      } else {
+        event.kind = StreamEventKind::Error;
+        event.content = responseJson.contains("error")
+                            ? keep(responseJson["error"].get<std::string>())
+                            : "Unknown error";
+      }
+    }
+  } catch (nlohmann::json::exception &e) {
+    event.kind = StreamEventKind::Ignored;
+    event.content = keep(e.what());
+  }
+
+  return event;
+}
+
+// Translate one complete server message into a StreamEvent
+inline StreamEvent DecodeStreamEvent(const char *message, size_t length,
+                                     RequestArena &arena) {
+  StreamEvent event;
+  if (StreamFrameScanner::TryDecode(message, length, arena, event))
+    return event;
+  return DecodeStreamEventDom(message, length, arena);
+}
+
+} // namespace MCPHelper
@@ -0,0 +1,266 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MCP_TRANSCODE_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MCP_TRANSCODE_SSE2 1
+#endif
+
+// Platform-neutral: no Windows headers. UTF-16 strings are any
+// std::basic_string of a 16-bit unit, so std::wstring on Windows and
+// std::u16string everywhere.
+
+namespace MCPHelper {
+namespace Utf {
+
+// UTF-8 <-> UTF-16 without MultiByteToWideChar's sizing pass. Output goes
+// into a caller-owned string whose capacity is reused across calls.
+//
+// Runs of ASCII are converted a vector at a time (AVX2 when the build
+// enables it, otherwise SSE2 on any x86/x64 target); everything else takes
+// the scalar path. Malformed input is handled like Windows does for CP_UTF8
+// without MB_ERR_INVALID_CHARS: each maximal invalid subsequence, and each
+// unpaired surrogate, becomes U+FFFD.
+
+const char16_t REPLACEMENT = 0xFFFD;
+
+namespace detail {
+
+template <typename Unit> inline void CheckUnit() {
+  static_assert(sizeof(Unit) == 2, "UTF-16 strings need 16-bit units");
+}
+
+// One sequence starting at text[i] (a non-ASCII lead byte); returns the
+// bytes consumed
+template <typename Unit>
+inline size_t DecodeSequence(const unsigned char *text, size_t i,
+                             size_t length, Unit *&out) {
+  unsigned char lead = text[i];
+  size_t need;
+  uint32_t code;
+  unsigned char low = 0x80, high = 0xBF;
+  if (lead >= 0xC2 && lead <= 0xDF) {
+    need = 1;
+    code = lead & 0x1F;
+  } else if (lead >= 0xE0 && lead <= 0xEF) {
+    need = 2;
+    code = lead & 0x0F;
+    if (lead == 0xE0)
+      low = 0xA0; // overlong
+    else if (lead == 0xED)
+      high = 0x9F; // surrogates
+  } else if (lead >= 0xF0 && lead <= 0xF4) {
+    need = 3;
+    code = lead & 0x07;
+    if (lead == 0xF0)
+      low = 0x90; // overlong
+    else if (lead == 0xF4)
+      high = 0x8F; // above U+10FFFF
+  } else {
+    *out++ = (Unit)REPLACEMENT;
+    return 1;
+  }
+
+  size_t n = 1;
+  for (; n <= need && i + n < length; n++) {
+    unsigned char next = text[i + n];
+    bool valid = n == 1 ? (next >= low && next <= high) : (next & 0xC0) == 0x80;
+    if (!valid)
+      break;
+    code = (code << 6) | (next & 0x3F);
+  }
+  if (n <= need) {
+    // Lead byte plus the continuation bytes that were valid so far
+    *out++ = (Unit)REPLACEMENT;
+    return n;
+  }
+
+  if (code >= 0x10000) {
+    code -= 0x10000;
+    *out++ = (Unit)(0xD800 + (code >> 10));
+    *out++ = (Unit)(0xDC00 + (code & 0x3FF));
+  } else {
+    *out++ = (Unit)code;
+  }
+  return need + 1;
+}
+
+// One code point starting at text[i] (not ASCII); returns the units consumed
+template <typename Unit>
+inline size_t EncodeCodePoint(const Unit *text, size_t i, size_t length,
+                              unsigned char *&out) {
+  uint32_t code = (uint16_t)text[i];
+  size_t used = 1;
+  if (code >= 0xD800 && code <= 0xDFFF) {
+    uint32_t next = i + 1 < length ? (uint16_t)text[i + 1] : 0;
+    if (code <= 0xDBFF && next >= 0xDC00 && next <= 0xDFFF) {
+      code = 0x10000 + ((code - 0xD800) << 10) + (next - 0xDC00);
+      used = 2;
+    } else {
+      code = REPLACEMENT;
+    }
+  }
+
+  if (code < 0x800) {
+    *out++ = (unsigned char)(0xC0 | (code >> 6));
+    *out++ = (unsigned char)(0x80 | (code & 0x3F));
+  } else if (code < 0x10000) {
+    *out++ = (unsigned char)(0xE0 | (code >> 12));
+    *out++ = (unsigned char)(0x80 | ((code >> 6) & 0x3F));
+    *out++ = (unsigned char)(0x80 | (code & 0x3F));
+  } else {
+    *out++ = (unsigned char)(0xF0 | (code >> 18));
+    *out++ = (unsigned char)(0x80 | ((code >> 12) & 0x3F));
+    *out++ = (unsigned char)(0x80 | ((code >> 6) & 0x3F));
+    *out++ = (unsigned char)(0x80 | (code & 0x3F));
+  }
+  return used;
+}
+
+// Widens ASCII bytes from text[i] while whole vectors are ASCII; returns the
+// new position
+template <typename Unit>
+inline size_t WidenAscii(const unsigned char *text, size_t i, size_t length,
+                         Unit *&out) {
+#if defined(MCP_TRANSCODE_AVX2)
+  while (i + 32 <= length) {
+    __m256i bytes = _mm256_loadu_si256((const __m256i *)(text + i));
+    if (_mm256_movemask_epi8(bytes) != 0)
+      break;
+    __m256i first = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(bytes));
+    __m256i second = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(bytes, 1));
+    _mm256_storeu_si256((__m256i *)out, first);
+    _mm256_storeu_si256((__m256i *)(out + 16), second);
+    out += 32;
+    i += 32;
+  }
+#endif
+#if defined(MCP_TRANSCODE_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  while (i + 16 <= length) {
+    __m128i bytes = _mm_loadu_si128((const __m128i *)(text + i));
+    if (_mm_movemask_epi8(bytes) != 0)
+      break;
+    _mm_storeu_si128((__m128i *)out, _mm_unpacklo_epi8(bytes, zero));
+    _mm_storeu_si128((__m128i *)(out + 8), _mm_unpackhi_epi8(bytes, zero));
+    out += 16;
+    i += 16;
+  }
+#endif
+  return i;
+}
+
+// Narrows units below 0x80 from text[i] while whole vectors are ASCII;
+// returns the new position
+template <typename Unit>
+inline size_t NarrowAscii(const Unit *text, size_t i, size_t length,
+                          unsigned char *&out) {
+#if defined(MCP_TRANSCODE_AVX2)
+  const __m256i highMask = _mm256_set1_epi16((short)0xFF80);
+  while (i + 32 <= length) {
+    __m256i first = _mm256_loadu_si256((const __m256i *)(text + i));
+    __m256i second = _mm256_loadu_si256((const __m256i *)(text + i + 16));
+    __m256i high = _mm256_and_si256(_mm256_or_si256(first, second), highMask);
+    if (!_mm256_testz_si256(high, high))
+      break;
+    // packus works per 128-bit lane; restore the order afterwards
+    __m256i packed = _mm256_packus_epi16(first, second);
+    packed = _mm256_permute4x64_epi64(packed, 0xD8);
+    _mm256_storeu_si256((__m256i *)out, packed);
+    out += 32;
+    i += 32;
+  }
+#endif
+#if defined(MCP_TRANSCODE_SSE2)
+  const __m128i mask = _mm_set1_epi16((short)0xFF80);
+  const __m128i zero = _mm_setzero_si128();
+  while (i + 16 <= length) {
+    __m128i first = _mm_loadu_si128((const __m128i *)(text + i));
+    __m128i second = _mm_loadu_si128((const __m128i *)(text + i + 8));
+    __m128i high = _mm_and_si128(_mm_or_si128(first, second), mask);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, zero)) != 0xFFFF)
+      break;
+    _mm_storeu_si128((__m128i *)out, _mm_packus_epi16(first, second));
+    out += 16;
+    i += 16;
+  }
+#endif
+  return i;
+}
+
+} // namespace detail
+
+// Replaces `out` with the UTF-16 form of `text`. Returns the unit count.
+template <typename Unit>
+size_t Utf8ToUtf16(const char *text, size_t length,
+                   std::basic_string<Unit> &out) {
+  detail::CheckUnit<Unit>();
+  // Never more units than bytes
+  out.resize(length);
+  if (length == 0)
+    return 0;
+
+  const unsigned char *bytes = (const unsigned char *)text;
+  Unit *begin = &out[0];
+  Unit *cursor = begin;
+  size_t i = 0;
+  while (i < length) {
+    if (bytes[i] >= 0x80) {
+      i += detail::DecodeSequence(bytes, i, length, cursor);
+      continue;
+    }
+    // An ASCII run: whole vectors first, then the rest of the run
+    i = detail::WidenAscii(bytes, i, length, cursor);
+    while (i < length && bytes[i] < 0x80)
+      *cursor++ = (Unit)bytes[i++];
+  }
+
+  out.resize(cursor - begin);
+  return out.size();
+}
+
+template <typename Unit>
+size_t Utf8ToUtf16(const std::string &text, std::basic_string<Unit> &out) {
+  return Utf8ToUtf16(text.data(), text.size(), out);
+}
+
+// Replaces `out` with the UTF-8 form of `text`. Returns the byte count.
+template <typename Unit>
+size_t Utf16ToUtf8(const Unit *text, size_t length, std::string &out) {
+  detail::CheckUnit<Unit>();
+  // At most three bytes per unit (a surrogate pair is four bytes for two)
+  out.resize(length * 3);
+  if (length == 0)
+    return 0;
+
+  unsigned char *begin = (unsigned char *)&out[0];
+  unsigned char *cursor = begin;
+  size_t i = 0;
+  while (i < length) {
+    if ((uint16_t)text[i] >= 0x80) {
+      i += detail::EncodeCodePoint(text, i, length, cursor);
+      continue;
+    }
+    i = detail::NarrowAscii(text, i, length, cursor);
+    while (i < length && (uint16_t)text[i] < 0x80)
+      *cursor++ = (unsigned char)text[i++];
+  }
+
+  out.resize(cursor - begin);
+  return out.size();
+}
+
+template <typename Unit>
+size_t Utf16ToUtf8(const std::basic_string<Unit> &text, std::string &out) {
+  return Utf16ToUtf8(text.data(), text.size(), out);
+}
+
+} // namespace Utf
+} // namespace MCPHelper
@@ -0,0 +1,238 @@
+#pragma once
+#include "markdown.hpp"
+#include "markdowntable.hpp"
+#include <string>
+
+// Platform-neutral: no Windows headers.
+
+namespace MCPHelper {
+
+// Renders Markdown runs into one WordprocessingML (Word 2003 XML) document
+// for Range.InsertXML, so a finished answer is inserted, fully formatted, in
+// a single call. Mirrors the streaming path: built-in Heading1-6 and
+// ListBullet paragraph styles, bold/italic/underline, Consolas for code and
+// real tables with a bold, repeating header row.
+class WordMLWriter {
+public:
+  // Whole response -> XML
+  static std::string Render(const char *markdownText, size_t length) {
+    MarkdownStreamer streamer;
+    WordMLWriter writer;
+    auto sink = [&writer](const MarkdownRun &run) { writer.Write(run); };
+    streamer.Feed(markdownText, length, sink);
+    streamer.Finish(sink);
+    return writer.Finish();
+  }
+
+  static std::string Render(const std::string &markdownText) {
+    return Render(markdownText.data(), markdownText.size());
+  }
+
+  WordMLWriter() { xml = PROLOG; }
+
+  void Write(const MarkdownRun &run) {
+    if (run.style & MD_TABLE) {
+      table.Append(run.text, run.length);
+      return;
+    }
+    if (!table.Empty())
+      WriteTable();
+
+    size_t start = 0;
+    for (size_t i = 0; i < run.length; i++) {
+      if (run.text[i] != '\n')
+        continue;
+      WriteText(run, run.text + start, i - start);
+      EndParagraph();
+      start = i + 1;
+    }
+    WriteText(run, run.text + start, run.length - start);
+  }
+
+  // Closes open elements and hands out the document
+  std::string Finish() {
+    if (!table.Empty())
+      WriteTable();
+    if (paragraphOpen)
+      EndParagraph();
+    xml += EPILOG;
+    return std::move(xml);
+  }
+
+private:
+  static constexpr const char *PROLOG =
+      "<?xml version=\"1.0\" standalone=\"yes\"?>"
+      "<w:wordDocument "
+      "xmlns:w=\"http://schemas.microsoft.com/office/word/2003/wordml\">"
+      // Style ids are only names local to this fragment; each maps to the
+      // language-neutral name of a built-in style, which Word resolves in
+      // any UI language as the streaming path's WdBuiltinStyle ids do
+      "<w:styles>"
+      "<w:style w:type=\"paragraph\" w:styleId=\"Heading1\">"
+      "<w:name w:val=\"heading 1\"/></w:style>"
+      "<w:style w:type=\"paragraph\" w:styleId=\"Heading2\">"
+      "<w:name w:val=\"heading 2\"/></w:style>"
+      "<w:style w:type=\"paragraph\" w:styleId=\"Heading3\">"
+      "<w:name w:val=\"heading 3\"/></w:style>"
+      "<w:style w:type=\"paragraph\" w:styleId=\"Heading4\">"
+      "<w:name w:val=\"heading 4\"/></w:style>"
+      "<w:style w:type=\"paragraph\" w:styleId=\"Heading5\">"
+      "<w:name w:val=\"heading 5\"/></w:style>"
+      "<w:style w:type=\"paragraph\" w:styleId=\"Heading6\">"
+      "<w:name w:val=\"heading 6\"/></w:style>"
+      "<w:style w:type=\"paragraph\" w:styleId=\"ListBullet\">"
+      "<w:name w:val=\"List Bullet\"/></w:style>"
+      "</w:styles>"
+      "<w:body>";
+  static constexpr const char *EPILOG = "</w:body></w:wordDocument>";
+
+  // Table width in twips, split evenly between columns
+  static const int TABLE_WIDTH = 9000;
+
+  std::string xml;
+  bool paragraphOpen = false;
+  MarkdownTableBuilder table;
+
+  // The first text of a line opens its paragraph, so the paragraph takes
+  // that line's style
+  void WriteText(const MarkdownRun &run, const char *text, size_t length) {
+    if (length == 0)
+      return;
+    if (!paragraphOpen)
+      BeginParagraph(run);
+
+    xml += "<w:r>";
+    WriteRunProperties(run.style);
+    AppendText(text, length);
+    xml += "</w:r>";
+  }
+
+  void BeginParagraph(const MarkdownRun &run) {
+    paragraphOpen = true;
+    if (run.style & MD_HEADING) {
+      xml += "<w:p><w:pPr><w:pStyle w:val=\"Heading";
+      xml += (char)('0' + run.headingLevel);
+      xml += "\"/></w:pPr>";
+    } else if (run.style & MD_LIST_ITEM) {
+      xml += "<w:p><w:pPr><w:pStyle w:val=\"ListBullet\"/></w:pPr>";
+    } else {
+      xml += "<w:p>";
+    }
+  }
+
+  // A newline with nothing before it is an empty paragraph
+  void EndParagraph() {
+    if (!paragraphOpen) {
+      xml += "<w:p/>";
+      return;
+    }
+    xml += "</w:p>";
+    paragraphOpen = false;
+  }
+
+  void WriteRunProperties(uint16_t style) {
+    if (!(style & (MD_BOLD | MD_ITALIC | MD_UNDERLINE | MD_CODE)))
+      return;
+    xml += "<w:rPr>";
+    if (style & MD_CODE)
+      xml += "<w:rFonts w:ascii=\"Consolas\" w:h-ansi=\"Consolas\" "
+             "w:cs=\"Consolas\"/>";
+    if (style & MD_BOLD)
+      xml += "<w:b/>";
+    if (style & MD_ITALIC)
+      xml += "<w:i/>";
+    if (style & MD_UNDERLINE)
+      xml += "<w:u w:val=\"single\"/>";
+    xml += "</w:rPr>";
+  }
+
+  // Escaped text; tabs become <w:tab/>, XML-invalid control bytes are dropped
+  void AppendText(const char *text, size_t length) {
+    xml += "<w:t xml:space=\"preserve\">";
+    for (size_t i = 0; i < length; i++) {
+      char c = text[i];
+      switch (c) {
+      case '&':
+        xml += "&amp;";
+        break;
+      case '<':
+        xml += "&lt;";
+        break;
+      case '>':
+        xml += "&gt;";
+        break;
+      case '\t':
+        xml += "</w:t><w:tab/><w:t xml:space=\"preserve\">";
+        break;
+      case '\r':
+        break;
+      default:
+        if ((unsigned char)c >= 0x20)
+          xml += c;
+        break;
+      }
+    }
+    xml += "</w:t>";
+  }
+
+  void WriteTable() {
+    table.Finish();
+    if (!table.IsTable()) {
+      // No separator row: plain lines
+      std::string raw = table.RawText();
+      table.Reset();
+      MarkdownRun run{raw.data(), raw.size(), MD_PLAIN, 0};
+      Write(run);
+      return;
+    }
+
+    if (paragraphOpen)
+      EndParagraph();
+
+    size_t columns = table.ColumnCount();
+    int columnWidth = TABLE_WIDTH / (int)(columns > 0 ? columns : 1);
+    std::string width = std::to_string(columnWidth);
+
+    xml += "<w:tbl><w:tblPr><w:tblW w:w=\"0\" w:type=\"auto\"/><w:tblBorders>";
+    for (const char *edge :
+         {"top", "left", "bottom", "right", "insideH", "insideV"}) {
+      xml += "<w:";
+      xml += edge;
+      xml += " w:val=\"single\" w:sz=\"4\" w:space=\"0\" w:color=\"auto\"/>";
+    }
+    xml += "</w:tblBorders></w:tblPr><w:tblGrid>";
+    for (size_t column = 0; column < columns; column++)
+      xml += "<w:gridCol w:w=\"" + width + "\"/>";
+    xml += "</w:tblGrid>";
+
+    const auto &rows = table.Rows();
+    const auto &alignments = table.Alignments();
+    for (size_t row = 0; row < rows.size(); row++) {
+      xml += row == 0 ? "<w:tr><w:trPr><w:tblHeader/></w:trPr>" : "<w:tr>";
+      for (size_t column = 0; column < columns; column++) {
+        xml += "<w:tc><w:tcPr><w:tcW w:w=\"" + width +
+               "\" w:type=\"dxa\"/></w:tcPr><w:p>";
+        ColumnAlignment alignment = column < alignments.size()
+                                        ? alignments[column]
+                                        : ColumnAlignment::Left;
+        if (alignment == ColumnAlignment::Center)
+          xml += "<w:pPr><w:jc w:val=\"center\"/></w:pPr>";
+        else if (alignment == ColumnAlignment::Right)
+          xml += "<w:pPr><w:jc w:val=\"right\"/></w:pPr>";
+
+        if (column < rows[row].size() && !rows[row][column].empty()) {
+          xml += "<w:r>";
+          WriteRunProperties(row == 0 ? MD_BOLD : MD_PLAIN);
+          AppendText(rows[row][column].data(), rows[row][column].size());
+          xml += "</w:r>";
+        }
+        xml += "</w:p></w:tc>";
+      }
+      xml += "</w:tr>";
+    }
+    xml += "</w:tbl>";
+    table.Reset();
+  }
+};
+
+} // namespace MCPHelper
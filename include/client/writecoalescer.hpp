@@ -0,0 +1,118 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace MCPHelper {
+
+// A stretch of pending text with one Markdown style (MarkdownStyle bits).
+// Offsets are in UTF-16 units of the text handed out by Take().
+struct StyledSpan {
+  size_t offset;
+  size_t length;
+  uint16_t style;
+  uint8_t headingLevel;
+};
+
+// How often coalesced text is pushed into the document
+enum class WritePacing {
+  Instant,  // write whatever is pending on every flush check
+  Frame,    // at most one write per display frame (~16 ms)
+  Interval, // at most one write per configured interval
+};
+
+// Merges every fragment that arrived since the last flush into a single
+// write. Replaces fixed-size chunking with Sleep() between InsertAfter calls:
+// the only pacing left is a time budget between flushes.
+class WriteCoalescer {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr std::chrono::milliseconds FRAME_INTERVAL{16};
+
+  struct Stats {
+    size_t fragments = 0; // Append() calls that carried text
+    size_t flushes = 0;   // writes actually issued
+    size_t characters = 0;
+
+    // One write per fragment is what the unpaced writer would have issued
+    size_t Saved() const { return fragments > flushes ? fragments - flushes : 0; }
+  };
+
+  explicit WriteCoalescer(
+      WritePacing newPacing = WritePacing::Frame,
+      std::chrono::milliseconds newInterval = FRAME_INTERVAL) {
+    Configure(newPacing, newInterval);
+  }
+
+  void Configure(WritePacing newPacing,
+                 std::chrono::milliseconds newInterval = FRAME_INTERVAL) {
+    pacing = newPacing;
+    interval = newPacing == WritePacing::Frame ? FRAME_INTERVAL : newInterval;
+  }
+
+  WritePacing Pacing() const { return pacing; }
+
+  void Append(const std::wstring &text, uint16_t style = 0,
+              uint8_t headingLevel = 0) {
+    if (text.empty())
+      return;
+    if (!spans.empty() && spans.back().style == style &&
+        spans.back().headingLevel == headingLevel) {
+      spans.back().length += text.size();
+    } else {
+      spans.push_back({pending.size(), text.size(), style, headingLevel});
+    }
+    pending += text;
+    stats.fragments++;
+  }
+
+  bool HasPending() const { return !pending.empty(); }
+
+  // True when pending text should be written now
+  bool FlushDue(Clock::time_point now = Clock::now()) const {
+    if (pending.empty())
+      return false;
+    if (pacing == WritePacing::Instant)
+      return true;
+    return now - lastFlush >= interval;
+  }
+
+  // Move the pending text and its style spans into `out`/`outSpans` (reusing
+  // their capacity) and start a new interval. Returns false when there is
+  // nothing to write.
+  bool Take(std::wstring &out, std::vector<StyledSpan> &outSpans,
+            Clock::time_point now = Clock::now()) {
+    if (pending.empty())
+      return false;
+    out.swap(pending);
+    pending.clear();
+    outSpans.swap(spans);
+    spans.clear();
+    lastFlush = now;
+    stats.flushes++;
+    stats.characters += out.size();
+    return true;
+  }
+
+  // Drop pending text without writing it
+  void Discard() {
+    pending.clear();
+    spans.clear();
+  }
+
+  const Stats &GetStats() const { return stats; }
+  void ResetStats() { stats = Stats(); }
+
+private:
+  WritePacing pacing = WritePacing::Frame;
+  std::chrono::milliseconds interval = FRAME_INTERVAL;
+  Clock::time_point lastFlush{};
+  std::wstring pending;
+  std::vector<StyledSpan> spans;
+  Stats stats;
+};
+
+} // namespace MCPHelper
@@ -8,7 +8,6 @@
 #include <vector>
 #include <winuser.h>
 
-MCPHelper::MCPClient client;
 // IDTExtensibility2 Implementation
 // Called when the add-in is loaded into Word
 STDMETHODIMP
@@ -26,9 +25,8 @@ CConnect::OnConnection(IDispatch *Application,
     MCPHelper::MCPClient::SetWordApp(m_pApplication);
   }
 
-  // client.ConnectToMCP();
-
-  // client.SetHistoryChat();
+  // Connects in the background; Word's startup does not wait for it
+  MCPHelper::MCPClient::Shared().Start();
 
   return S_OK;
 }
@@ -40,6 +38,10 @@ CConnect::OnDisconnection(AddInDesignerObjects::ext_DisconnectMode RemoveMode,
   UNREFERENCED_PARAMETER(RemoveMode);
   UNREFERENCED_PARAMETER(custom);
 
+  // Joins the session thread while that is still allowed (not from the
+  // static destructor, which runs under the loader lock)
+  MCPHelper::MCPClient::Shared().Stop();
+
   if (m_pCustomTaskPane) {
     m_pCustomTaskPane->Release();
     m_pCustomTaskPane = nullptr;
@@ -250,13 +250,47 @@ LRESULT CTaskPaneControl::OnCreate(UINT uMsg, WPARAM wParam, LPARAM lParam,
                         WS_CHILD | WS_VISIBLE | SS_CENTER);
   m_wndInfoLabel.SendMessage(WM_SETFONT, (WPARAM)m_hTextFont, TRUE);
 
-  // ===== Connect & Load History =====
-  if (client.ConnectToMCP()) {
-    MSGBOX_INFO(L"Connected to MCP");
-    client.SetHistoryChat();
+  // ===== Load History =====
+  // The pane paints right away; history is fetched once the connection is
+  // ready, which may already be the case
+  client.SetNotificationWindow(m_hWnd, WM_MCP_NOTIFY);
+
+  return 0;
+}
+
+// Posted by the shared client from its background threads
+LRESULT CTaskPaneControl::OnMcpNotify(UINT uMsg, WPARAM wParam, LPARAM lParam,
+                                      BOOL &bHandled) {
+  UNREFERENCED_PARAMETER(uMsg);
+  UNREFERENCED_PARAMETER(lParam);
+  bHandled = TRUE;
+
+  switch (wParam) {
+  case MCPClient::NOTIFY_STREAM_ENDED:
+    // The drain has already reloaded the history
+    m_wndSendButton.SetWindowText(L"Send \x27A4");
     UpdateChatArea();
+    break;
+  case MCPClient::NOTIFY_READY:
+  case MCPClient::NOTIFY_HISTORY_CHANGED:
+    if (client.IsConnected()) {
+      client.SetHistoryChat();
+      UpdateChatArea();
+    }
+    break;
   }
+  return 0;
+}
+
+LRESULT CTaskPaneControl::OnDestroy(UINT uMsg, WPARAM wParam, LPARAM lParam,
+                                    BOOL &bHandled) {
+  UNREFERENCED_PARAMETER(uMsg);
+  UNREFERENCED_PARAMETER(wParam);
+  UNREFERENCED_PARAMETER(lParam);
+  // Let CComControl see it too
+  bHandled = FALSE;
 
+  client.SetNotificationWindow(NULL, 0);
   return 0;
 }
 
@@ -354,6 +388,13 @@ LRESULT CTaskPaneControl::OnCommand(UINT uMsg, WPARAM wParam, LPARAM lParam,
       bHandled = TRUE;
       return 0;
     } else if (ctrlId == IDC_SEND_BUTTON) {
+      // While an answer streams the button stops it
+      if (client.IsStreaming()) {
+        client.CancelStream();
+        bHandled = TRUE;
+        return 0;
+      }
+
       // Handle send button click
       int len = m_wndInputEdit.GetWindowTextLength();
       if (len > 0) {
@@ -378,8 +419,11 @@ LRESULT CTaskPaneControl::OnCommand(UINT uMsg, WPARAM wParam, LPARAM lParam,
           MSGBOX_WARNING(L"File Tidak boleh kosong");
           return 0;
         }
-        client.SendPromptWithStream(1, client.WstringToString(buffer),
+        client.SendPromptWithStream(client.WstringToString(buffer),
                                     selectedFiles, currentDocument);
+        if (client.IsStreaming()) {
+          m_wndSendButton.SetWindowText(L"Stop \x25A0");
+        }
         // // Clear input
         m_wndInputEdit.SetWindowText(L"");
         delete[] buffer;
@@ -0,0 +1,96 @@
+// Stream frames decoded per second: StreamFrameScanner (with its full-parser
+// fallback) against the json::parse path every frame used to take. Content is
+// copied into a RequestArena reset once per round, as once per request in
+// the client. Run with `zig build bench -Doptimize=ReleaseFast -- frames`.
+#include "client/streamdecoder.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace MCPHelper;
+
+namespace {
+
+// A typical response: many short token frames, a few with escapes and
+// non-ASCII text, one terminal frame
+std::vector<std::string> BuildFrames() {
+  const char *tokens[] = {
+      "The",     " quick",         " **brown**", " fox",
+      "\\n\\n",  " \\\"quoted\\\"", " caf\xC3\xA9", " \\u2014",
+      " jumps",  " over",          " the",       " `lazy`",
+      " dog.\\n", "| a | b |\\n",  " \xF0\x9F\x98\x80", " done"};
+  std::vector<std::string> frames;
+  for (size_t n = 0; n < 4096; n++) {
+    frames.push_back(std::string("{\"status\":\"streaming\",\"content\":\"") +
+                     tokens[n % (sizeof(tokens) / sizeof(tokens[0]))] +
+                     "\"}");
+  }
+  frames.push_back("{\"status\":\"complete\"}");
+  return frames;
+}
+
+template <typename Decode>
+double Measure(const std::vector<std::string> &frames, Decode decode,
+               RequestArena &arena, size_t &bytes) {
+  const int ROUNDS = 20;
+  double bestSeconds = 1e9;
+
+  for (int round = 0; round < ROUNDS; round++) {
+    bytes = 0;
+    arena.Reset();
+    auto start = std::chrono::steady_clock::now();
+    for (const auto &frame : frames) {
+      StreamEvent event = decode(frame.data(), frame.size(), arena);
+      bytes += event.content.size();
+    }
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    if (seconds < bestSeconds)
+      bestSeconds = seconds;
+  }
+  return frames.size() / bestSeconds;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  // Same filter convention as the Zig benchmarks
+  if (argc > 1 && std::strcmp(argv[1], "frames") != 0)
+    return 0;
+
+  std::printf("\n=== frames ===\n");
+  std::vector<std::string> frames = BuildFrames();
+
+  RequestArena arena;
+
+  // Both paths must agree before their speed means anything
+  for (const auto &frame : frames) {
+    StreamEvent fast = DecodeStreamEvent(frame.data(), frame.size(), arena);
+    StreamEvent full = DecodeStreamEventDom(frame.data(), frame.size(), arena);
+    if (fast.kind != full.kind || fast.content != full.content) {
+      std::printf("  decoders disagree on %s\n", frame.c_str());
+      return 1;
+    }
+  }
+
+  size_t scannerBytes = 0;
+  size_t domBytes = 0;
+  double scanner = Measure(frames, DecodeStreamEvent, arena, scannerBytes);
+  ArenaStats scannerArena = arena.Stats();
+  double dom = Measure(frames, DecodeStreamEventDom, arena, domBytes);
+
+  std::printf("  %zu frames\n", frames.size());
+  std::printf("  scanner  %10.0f frames/s  (%zu content bytes)\n", scanner,
+              scannerBytes);
+  std::printf("  dom      %10.0f frames/s  (%zu content bytes)\n", dom,
+              domBytes);
+  std::printf("  speedup  %10.1fx\n", scanner / dom);
+  std::printf("  arena    %zu allocations, %zu bytes, %zu heap blocks in the "
+              "last round\n",
+              scannerArena.allocations, scannerArena.peakBytes,
+              scannerArena.heapBlocks);
+  return 0;
+}
@@ -0,0 +1,146 @@
+// Decoding a 10k-record history response: HistoryDecoder (SAX) against a
+// full json::parse DOM and the find()-based slicing it replaced. Run with
+// `zig build bench -Doptimize=ReleaseFast -- history`.
+#include "client/historydecoder.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace MCPHelper;
+
+namespace {
+
+const size_t RECORDS = 10000;
+
+// Same shape as the server's handleGetHistory
+std::string BuildResponse() {
+  std::string out = "{\"type\":\"history\",\"status\":\"ok\",\"data\":[";
+  for (size_t n = 0; n < RECORDS; n++) {
+    if (n > 0)
+      out += ',';
+    out += "{\"uuid\":\"6f1c2b9e-0d4a-4c7e-9a51-" + std::to_string(100000 + n) +
+           "\",\"message\":\"Summarize section " + std::to_string(n) +
+           " of \\\"report.docx\\\" in three bullet points.\\nKeep the "
+           "tone neutral \\u2014 and cite page numbers.\",\"timestamp\":"
+           "\"2025-06-01 12:00:00\",\"role\":\"" +
+           (n % 2 ? "assistant" : "user") +
+           "\",\"current_file\":\"C:\\\\Users\\\\me\\\\report.docx\"}";
+  }
+  return out + "]}";
+}
+
+// The parser HistoryDecoder replaced, kept for comparison
+void LegacyDecode(const std::string &response,
+                  std::vector<HistoryEntry> &entries) {
+  size_t dataStart = response.find("\"data\":[");
+  if (dataStart == std::string::npos)
+    return;
+  size_t pos = dataStart + 8;
+  while (pos < response.length()) {
+    size_t objStart = response.find('{', pos);
+    if (objStart == std::string::npos)
+      break;
+    int braceCount = 1;
+    size_t objEnd = objStart + 1;
+    while (objEnd < response.length() && braceCount > 0) {
+      if (response[objEnd] == '{')
+        braceCount++;
+      else if (response[objEnd] == '}')
+        braceCount--;
+      objEnd++;
+    }
+    if (braceCount != 0)
+      break;
+    std::string obj = response.substr(objStart, objEnd - objStart);
+    HistoryEntry entry;
+    size_t msgStart = obj.find("\"message\":\"");
+    if (msgStart != std::string::npos) {
+      msgStart += 11;
+      size_t msgEnd = msgStart;
+      while (msgEnd < obj.length()) {
+        if (obj[msgEnd] == '"' && obj[msgEnd - 1] != '\\')
+          break;
+        msgEnd++;
+      }
+      entry.message = obj.substr(msgStart, msgEnd - msgStart);
+    }
+    size_t tsStart = obj.find("\"timestamp\":\"");
+    if (tsStart != std::string::npos) {
+      tsStart += 13;
+      size_t tsEnd = obj.find('"', tsStart);
+      if (tsEnd != std::string::npos)
+        entry.timestamp = obj.substr(tsStart, tsEnd - tsStart);
+    }
+    size_t roleStart = obj.find("\"role\":\"");
+    if (roleStart != std::string::npos) {
+      roleStart += 8;
+      size_t roleEnd = obj.find('"', roleStart);
+      if (roleEnd != std::string::npos)
+        entry.role = obj.substr(roleStart, roleEnd - roleStart);
+    }
+    entries.push_back(entry);
+    pos = objEnd;
+    size_t nextComma = response.find(',', pos);
+    size_t arrayEnd = response.find(']', pos);
+    if (arrayEnd != std::string::npos &&
+        (nextComma == std::string::npos || arrayEnd < nextComma))
+      break;
+  }
+}
+
+void DomDecode(const std::string &response,
+               std::vector<HistoryEntry> &entries) {
+  nlohmann::json parsed = nlohmann::json::parse(response);
+  for (const auto &record : parsed["data"]) {
+    entries.push_back({record.value("message", ""),
+                       record.value("timestamp", ""),
+                       record.value("role", "")});
+  }
+}
+
+template <typename Decode>
+void Measure(const char *name, const std::string &response, Decode decode) {
+  const int ROUNDS = 20;
+  double bestSeconds = 1e9;
+  std::vector<HistoryEntry> entries;
+
+  for (int round = 0; round < ROUNDS; round++) {
+    entries.clear();
+    auto start = std::chrono::steady_clock::now();
+    decode(response, entries);
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    if (seconds < bestSeconds)
+      bestSeconds = seconds;
+  }
+
+  std::printf("  %-8s %8.2f ms  %8.1f MB/s  (%zu records, message[1]: %zu "
+              "bytes)\n",
+              name, bestSeconds * 1000.0,
+              response.size() / (1024.0 * 1024.0) / bestSeconds,
+              entries.size(), entries.size() > 1 ? entries[1].message.size() : 0);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  // Same filter convention as the Zig benchmarks
+  if (argc > 1 && std::strcmp(argv[1], "history") != 0)
+    return 0;
+
+  std::printf("\n=== history ===\n");
+  std::string response = BuildResponse();
+  std::printf("  input: %zu records, %.1f MB\n", RECORDS,
+              response.size() / (1024.0 * 1024.0));
+
+  Measure("sax", response,
+          [](const std::string &r, std::vector<HistoryEntry> &e) {
+            HistoryDecoder::Decode(r, e);
+          });
+  Measure("dom", response, DomDecode);
+  Measure("legacy", response, LegacyDecode);
+  return 0;
+}
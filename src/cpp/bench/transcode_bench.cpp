@@ -0,0 +1,115 @@
+// Throughput of the UTF-8 <-> UTF-16 transcoder in MB of UTF-8 per second,
+// vector path against a scalar loop, for stream-sized and bulk chunks. The
+// "fresh" column allocates its output per chunk like the old
+// StringToWstring did. Run with `zig build bench -Doptimize=ReleaseFast --
+// transcode`.
+#include "client/transcode.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+using namespace MCPHelper;
+
+namespace {
+
+struct Sample {
+  const char *name;
+  const char *text;
+};
+
+const Sample SAMPLES[] = {
+    {"ascii", "The quick brown fox jumps over the lazy dog. Markdown **bold** "
+              "and `code` with | table | rows |\n"},
+    {"latin", "Caf\xC3\xA9 na\xC3\xAFve r\xC3\xA9sum\xC3\xA9 \xE2\x80\x94 "
+              "the text is mostly ASCII with a few accents.\n"},
+    {"cjk", "\xE6\x96\x87\xE6\xA1\xA3\xE3\x81\xAE\xE8\xA6\x81\xE7\xB4\x84\xE3"
+            "\x82\x92\xE4\xBD\x9C\xE6\x88\x90\xE3\x81\x97\xE3\x81\xBE\xE3\x81"
+            "\x99\xE3\x80\x82\n"},
+    {"emoji", "ok \xF0\x9F\x98\x80 \xF0\x9F\x9A\x80 done \xF0\x9F\x8E\x89\n"},
+};
+
+// Scalar reference shaped like the old path: output allocated per call
+std::u16string ScalarFresh(const char *text, size_t length) {
+  std::u16string out(length, 0);
+  const unsigned char *bytes = (const unsigned char *)text;
+  char16_t *cursor = &out[0];
+  for (size_t i = 0; i < length;) {
+    if (bytes[i] < 0x80)
+      *cursor++ = bytes[i++];
+    else
+      i += Utf::detail::DecodeSequence(bytes, i, length, cursor);
+  }
+  out.resize(cursor - out.data());
+  return out;
+}
+
+// MB/s of `megabytes` worth of text, fed in `chunkSize`-unit pieces
+template <typename Text, typename Convert>
+double Measure(const Text &input, size_t chunkSize, double megabytes,
+               Convert convert) {
+  const int ROUNDS = 5;
+  double bestSeconds = 1e9;
+  for (int round = 0; round < ROUNDS; round++) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t pos = 0; pos < input.size(); pos += chunkSize) {
+      size_t length = std::min(chunkSize, input.size() - pos);
+      convert(input.data() + pos, length);
+    }
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    bestSeconds = std::min(bestSeconds, seconds);
+  }
+  return megabytes / bestSeconds;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  // Same filter convention as the Zig benchmarks
+  if (argc > 1 && std::strcmp(argv[1], "transcode") != 0)
+    return 0;
+
+  std::printf("\n=== transcode ===\n");
+#if defined(MCP_TRANSCODE_AVX2)
+  std::printf("  vector path: AVX2 + SSE2\n");
+#elif defined(MCP_TRANSCODE_SSE2)
+  std::printf("  vector path: SSE2\n");
+#else
+  std::printf("  vector path: none (scalar only)\n");
+#endif
+
+  std::u16string wide;
+  std::string narrow;
+  for (const Sample &sample : SAMPLES) {
+    std::string input;
+    while (input.size() < 16 * 1024 * 1024)
+      input += sample.text;
+
+    std::u16string whole;
+    Utf::Utf8ToUtf16(input, whole);
+    double megabytes = input.size() / (1024.0 * 1024.0);
+
+    for (size_t chunkSize : {64, 65536}) {
+      double vector =
+          Measure(input, chunkSize, megabytes, [&](const char *text, size_t n) {
+            Utf::Utf8ToUtf16(text, n, wide);
+          });
+      double fresh =
+          Measure(input, chunkSize, megabytes, [](const char *text, size_t n) {
+            ScalarFresh(text, n);
+          });
+      // Same text back to UTF-8, in pieces of as many units
+      double back = Measure(whole, chunkSize, megabytes,
+                            [&](const char16_t *text, size_t n) {
+                              Utf::Utf16ToUtf8(text, n, narrow);
+                            });
+      std::printf("  %-6s chunk %6zu: to UTF-16 %8.1f MB/s (scalar, fresh "
+                  "buffer %7.1f)  to UTF-8 %8.1f MB/s\n",
+                  sample.name, chunkSize, vector, fresh, back);
+    }
+  }
+  return 0;
+}
@@ -7,15 +7,17 @@
 
 namespace MCPHelper {
 
-// WebSocket connection handles
-static HINTERNET hSession = NULL;
-static HINTERNET hConnect = NULL;
-static HINTERNET hRequest = NULL;
-static HINTERNET hWebSocket = NULL;
-
 // Static Word Application pointer
 IDispatch *MCPClient::s_pWordApp = nullptr;
 
+// Client whose stream the drain timer is currently feeding
+MCPClient *MCPClient::s_pStreamingClient = nullptr;
+
+MCPClient::~MCPClient() {
+  Stop();
+  FinishStream();
+}
+
 // Set Word Application pointer (called from Connect.cpp)
 void MCPClient::SetWordApp(IDispatch *pApp) { s_pWordApp = pApp; }
 
@@ -25,70 +27,20 @@ string MCPClient::GetCurrentWordDocument() {
     return "[No Word App]";
   }
 
-  // Get ActiveDocument property from Word Application
-  DISPID dispid;
-  OLECHAR *szMember = (OLECHAR *)L"ActiveDocument";
-  HRESULT hr = s_pWordApp->GetIDsOfNames(IID_NULL, &szMember, 1,
-                                         LOCALE_USER_DEFAULT, &dispid);
-
-  if (FAILED(hr)) {
-    return "[No Active Document]";
-  }
-
-  DISPPARAMS dp = {NULL, NULL, 0, 0};
-  VARIANT result;
-  VariantInit(&result);
-
-  hr = s_pWordApp->Invoke(dispid, IID_NULL, LOCALE_USER_DEFAULT,
-                          DISPATCH_PROPERTYGET, &dp, &result, NULL, NULL);
-
-  if (FAILED(hr) || result.vt != VT_DISPATCH || !result.pdispVal) {
-    VariantClear(&result);
+  Com::Object<Com::Application> app(s_pWordApp);
+  Com::Object<Com::Document> doc;
+  if (FAILED(app.Get(L"ActiveDocument", doc))) {
     return "[No Document Open]";
   }
 
-  IDispatch *pDoc = result.pdispVal;
-
   // Try to get FullName first (full path), fallback to Name (just filename for
   // unsaved docs)
-  szMember = (OLECHAR *)L"FullName";
-  hr =
-      pDoc->GetIDsOfNames(IID_NULL, &szMember, 1, LOCALE_USER_DEFAULT, &dispid);
-
-  if (FAILED(hr)) {
-    // Try Name property instead
-    szMember = (OLECHAR *)L"Name";
-    hr = pDoc->GetIDsOfNames(IID_NULL, &szMember, 1, LOCALE_USER_DEFAULT,
-                             &dispid);
-    if (FAILED(hr)) {
-      pDoc->Release();
-      return "[Unknown Document]";
-    }
-  }
-
-  VARIANT nameResult;
-  VariantInit(&nameResult);
-
-  hr = pDoc->Invoke(dispid, IID_NULL, LOCALE_USER_DEFAULT, DISPATCH_PROPERTYGET,
-                    &dp, &nameResult, NULL, NULL);
-
   string docName;
-  if (SUCCEEDED(hr) && nameResult.vt == VT_BSTR && nameResult.bstrVal) {
-    // Convert BSTR to string
-    int len = WideCharToMultiByte(CP_UTF8, 0, nameResult.bstrVal, -1, NULL, 0,
-                                  NULL, NULL);
-    if (len > 0) {
-      docName.resize(len - 1);
-      WideCharToMultiByte(CP_UTF8, 0, nameResult.bstrVal, -1, &docName[0], len,
-                          NULL, NULL);
-    }
-  } else {
-    docName = "[Document]";
+  if (FAILED(doc.Get(L"FullName", docName)) &&
+      FAILED(doc.Get(L"Name", docName))) {
+    return "[Document]";
   }
 
-  VariantClear(&nameResult);
-  pDoc->Release();
-
   return docName;
 }
 
@@ -98,279 +50,378 @@ bool MCPClient::IsDocumentSaved() {
     return false; // No Word App
   }
 
-  // Get ActiveDocument property from Word Application
-  DISPID dispid;
-  OLECHAR *szMember = (OLECHAR *)L"ActiveDocument";
-  HRESULT hr = s_pWordApp->GetIDsOfNames(IID_NULL, &szMember, 1,
-                                         LOCALE_USER_DEFAULT, &dispid);
+  Com::Object<Com::Application> app(s_pWordApp);
+  Com::Object<Com::Document> doc;
+  if (FAILED(app.Get(L"ActiveDocument", doc))) {
+    return false; // No Document Open
+  }
 
-  if (FAILED(hr)) {
-    return false; // No Active Document property
+  // Get Path property - if empty, document is not saved
+  wstring path;
+  if (FAILED(doc.Get(L"Path", path))) {
+    return false;
   }
 
-  DISPPARAMS dp = {NULL, NULL, 0, 0};
-  VARIANT result;
-  VariantInit(&result);
+  return !path.empty();
+}
 
-  hr = s_pWordApp->Invoke(dispid, IID_NULL, LOCALE_USER_DEFAULT,
-                          DISPATCH_PROPERTYGET, &dp, &result, NULL, NULL);
+MCPClient &MCPClient::Shared() {
+  static MCPClient client;
+  return client;
+}
 
-  if (FAILED(hr) || result.vt != VT_DISPATCH || !result.pdispVal) {
-    VariantClear(&result);
-    return false; // No Document Open
+void MCPClient::Start() {
+  if (sessionThread.joinable()) {
+    return; // Already running
   }
 
-  IDispatch *pDoc = result.pdispVal;
-
-  // Get Path property - if empty, document is not saved
-  szMember = (OLECHAR *)L"Path";
-  hr =
-      pDoc->GetIDsOfNames(IID_NULL, &szMember, 1, LOCALE_USER_DEFAULT, &dispid);
+  {
+    lock_guard<mutex> lock(stopMutex);
+    stopping = false;
+  }
+  {
+    lock_guard<mutex> lock(statsMutex);
+    startTime = chrono::steady_clock::now();
+    connectionStats = ConnectionStats();
+  }
+  sessionThread = thread(&MCPClient::RunSession, this);
+}
 
-  if (FAILED(hr)) {
-    pDoc->Release();
-    return false;
+void MCPClient::Stop() {
+  {
+    lock_guard<mutex> lock(stopMutex);
+    stopping = true;
   }
+  stopSignal.notify_all();
 
-  VARIANT pathResult;
-  VariantInit(&pathResult);
+  HINTERNET socket;
+  {
+    lock_guard<mutex> lock(socketMutex);
+    socket = hWebSocket;
+  }
+  if (socket) {
+    CloseWebSocket(socket);
+  }
 
-  hr = pDoc->Invoke(dispid, IID_NULL, LOCALE_USER_DEFAULT, DISPATCH_PROPERTYGET,
-                    &dp, &pathResult, NULL, NULL);
+  if (sessionThread.joinable()) {
+    sessionThread.join();
+  }
+}
 
-  bool isSaved = false;
-  if (SUCCEEDED(hr) && pathResult.vt == VT_BSTR && pathResult.bstrVal) {
-    // If path has content, document is saved
-    isSaved = (SysStringLen(pathResult.bstrVal) > 0);
+void MCPClient::SetNotificationWindow(HWND hwnd, UINT message) {
+  {
+    lock_guard<mutex> lock(statsMutex);
+    notifyWindow = hwnd;
+    notifyMessage = message;
+  }
+  if (hwnd && IsConnected()) {
+    PostMessage(hwnd, message, NOTIFY_READY, 0);
   }
+}
 
-  VariantClear(&pathResult);
-  pDoc->Release();
+// Any thread
+void MCPClient::PostNotification(Notification what) {
+  HWND window;
+  UINT message;
+  {
+    lock_guard<mutex> lock(statsMutex);
+    window = notifyWindow;
+    message = notifyMessage;
+  }
+  if (window) {
+    PostMessage(window, message, what, 0);
+  }
+}
 
-  return isSaved;
+MCPClient::ConnectionStats MCPClient::GetConnectionStats() const {
+  lock_guard<mutex> lock(statsMutex);
+  return connectionStats;
 }
 
-bool MCPClient::ConnectToMCP() {
-  if (isConnected && hWebSocket != NULL) {
-    return true; // Already connected
+// Session thread: connects, serves the connection until it drops, and tries
+// again after a backoff delay until Stop()
+void MCPClient::RunSession() {
+  ReconnectBackoff backoff;
+
+  for (;;) {
+    HINTERNET socket = OpenWebSocket();
+    if (socket) {
+      backoff.Reset();
+      {
+        lock_guard<mutex> lock(statsMutex);
+        connectionStats.connects++;
+      }
+
+      // Everything received from here on goes through the dispatcher
+      dispatcher.Open();
+      {
+        lock_guard<mutex> lock(socketMutex);
+        hWebSocket = socket;
+      }
+      // Stop() may have looked for the socket just before it was stored
+      bool stopNow;
+      {
+        lock_guard<mutex> lock(stopMutex);
+        stopNow = stopping;
+      }
+      if (stopNow) {
+        CloseWebSocket(socket);
+        break;
+      }
+
+      DEBUG_LOG("WebSocket connected to ws://localhost:%u", wsPort);
+      SendHealthCheck();
+      ReceiveSession(socket);
+
+      connected.store(false, memory_order_release);
+      CloseWebSocket(socket);
+    } else {
+      lock_guard<mutex> lock(statsMutex);
+      connectionStats.failedAttempts++;
+    }
+
+    chrono::milliseconds delay = backoff.Next();
+    unique_lock<mutex> lock(stopMutex);
+    if (stopSignal.wait_for(lock, delay, [this] { return stopping; })) {
+      break;
+    }
+    DEBUG_LOG("Reconnecting (attempt %u)", backoff.Attempts());
   }
 
-  // Initialize WinHTTP session
-  hSession = WinHttpOpen(L"AgenticAI/1.0", WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
-                         WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
+  if (hConnect) {
+    WinHttpCloseHandle(hConnect);
+    hConnect = NULL;
+  }
+  if (hSession) {
+    WinHttpCloseHandle(hSession);
+    hSession = NULL;
+  }
+}
 
+// The WebSocket handshake. The session and connection handles are kept for
+// later attempts; only the upgrade request is made each time. NULL on
+// failure, which is expected while the server is not running.
+HINTERNET MCPClient::OpenWebSocket() {
   if (!hSession) {
-    DEBUG_LOG("WinHttpOpen failed: %lu", GetLastError());
-    return false;
-  }
+    hSession = WinHttpOpen(L"AgenticAI/1.0", WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
+                           WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
+    if (!hSession) {
+      DEBUG_LOG("WinHttpOpen failed: %lu", GetLastError());
+      return NULL;
+    }
 
-  // Connect to localhost:9910
-  hConnect = WinHttpConnect(hSession, L"localhost", 9910, 0);
+    // A local server either answers or refuses at once; don't let a stuck
+    // attempt hold up Stop() for WinHTTP's default minute
+    DWORD connectTimeout = CONNECT_TIMEOUT_MS;
+    WinHttpSetOption(hSession, WINHTTP_OPTION_CONNECT_TIMEOUT, &connectTimeout,
+                     sizeof(connectTimeout));
+  }
 
   if (!hConnect) {
-    DEBUG_LOG("WinHttpConnect failed: %lu", GetLastError());
-    WinHttpCloseHandle(hSession);
-    hSession = NULL;
-    return false;
+    hConnect = WinHttpConnect(hSession, wsHost.c_str(), wsPort, 0);
+    if (!hConnect) {
+      DEBUG_LOG("WinHttpConnect failed: %lu", GetLastError());
+      return NULL;
+    }
   }
 
   // Create HTTP request for WebSocket upgrade
-  hRequest =
+  HINTERNET hRequest =
       WinHttpOpenRequest(hConnect, L"GET", L"/", NULL, WINHTTP_NO_REFERER,
                          WINHTTP_DEFAULT_ACCEPT_TYPES, 0);
-
   if (!hRequest) {
     DEBUG_LOG("WinHttpOpenRequest failed: %lu", GetLastError());
-    WinHttpCloseHandle(hConnect);
-    WinHttpCloseHandle(hSession);
-    hConnect = NULL;
-    hSession = NULL;
-    return false;
+    return NULL;
   }
 
-  // Set WebSocket upgrade option
-  BOOL bResult =
-      WinHttpSetOption(hRequest, WINHTTP_OPTION_UPGRADE_TO_WEB_SOCKET, NULL, 0);
-
-  if (!bResult) {
+  HINTERNET socket = NULL;
+  if (!WinHttpSetOption(hRequest, WINHTTP_OPTION_UPGRADE_TO_WEB_SOCKET, NULL,
+                        0)) {
     DEBUG_LOG("WinHttpSetOption for WebSocket failed: %lu", GetLastError());
-    WinHttpCloseHandle(hRequest);
-    WinHttpCloseHandle(hConnect);
-    WinHttpCloseHandle(hSession);
-    hRequest = NULL;
-    hConnect = NULL;
-    hSession = NULL;
-    return false;
-  }
-
-  // Send the request
-  bResult = WinHttpSendRequest(hRequest, WINHTTP_NO_ADDITIONAL_HEADERS, 0,
-                               WINHTTP_NO_REQUEST_DATA, 0, 0, 0);
-
-  if (!bResult) {
+  } else if (!WinHttpSendRequest(hRequest, WINHTTP_NO_ADDITIONAL_HEADERS, 0,
+                                 WINHTTP_NO_REQUEST_DATA, 0, 0, 0)) {
     DEBUG_LOG("WinHttpSendRequest failed: %lu", GetLastError());
-    WinHttpCloseHandle(hRequest);
-    WinHttpCloseHandle(hConnect);
-    WinHttpCloseHandle(hSession);
-    hRequest = NULL;
-    hConnect = NULL;
-    hSession = NULL;
-    return false;
-  }
-
-  // Receive response
-  bResult = WinHttpReceiveResponse(hRequest, NULL);
-
-  if (!bResult) {
+  } else if (!WinHttpReceiveResponse(hRequest, NULL)) {
     DEBUG_LOG("WinHttpReceiveResponse failed: %lu", GetLastError());
-    WinHttpCloseHandle(hRequest);
-    WinHttpCloseHandle(hConnect);
-    WinHttpCloseHandle(hSession);
-    hRequest = NULL;
-    hConnect = NULL;
-    hSession = NULL;
-    return false;
+  } else {
+    socket = WinHttpWebSocketCompleteUpgrade(hRequest, NULL);
+    if (!socket) {
+      DEBUG_LOG("WinHttpWebSocketCompleteUpgrade failed: %lu", GetLastError());
+    }
   }
 
-  // Complete the WebSocket upgrade
-  hWebSocket = WinHttpWebSocketCompleteUpgrade(hRequest, NULL);
+  // The request handle is not needed once upgraded
+  WinHttpCloseHandle(hRequest);
+  return socket;
+}
 
-  if (!hWebSocket) {
-    DEBUG_LOG("WinHttpWebSocketCompleteUpgrade failed: %lu", GetLastError());
-    WinHttpCloseHandle(hRequest);
-    WinHttpCloseHandle(hConnect);
-    WinHttpCloseHandle(hSession);
-    hRequest = NULL;
-    hConnect = NULL;
-    hSession = NULL;
-    return false;
+// Takes `socket` out of use and closes it, unless that has already been done
+void MCPClient::CloseWebSocket(HINTERNET socket) {
+  {
+    lock_guard<mutex> lock(socketMutex);
+    if (hWebSocket != socket) {
+      return;
+    }
+    hWebSocket = NULL;
   }
+  WinHttpWebSocketClose(socket, WINHTTP_WEB_SOCKET_SUCCESS_CLOSE_STATUS, NULL,
+                        0);
+  // Cancels the session's pending receive
+  WinHttpCloseHandle(socket);
+}
 
-  // Close the request handle (no longer needed)
-  WinHttpCloseHandle(hRequest);
-  hRequest = NULL;
+// The connection counts as ready once the server answers a health check.
+// Not waited for: the reply arrives on the session thread like any other.
+void MCPClient::SendHealthCheck() {
+  uint64_t id = dispatcher.NextId();
+  json request = {{"id", to_string(id)}, {"type", "health"}};
 
-  isConnected = true;
-  DEBUG_LOG("WebSocket connected to ws://localhost:9910");
+  dispatcher.Register(id, [this](const char *message, size_t length) {
+    if (!message) {
+      return true; // Lost before it was answered
+    }
+    DEBUG_LOG("Health check response: %.*s", (int)length, message);
+    connected.store(true, memory_order_release);
+
+    {
+      lock_guard<mutex> lock(statsMutex);
+      if (connectionStats.loadToReadyMs < 0) {
+        connectionStats.loadToReadyMs =
+            chrono::duration_cast<chrono::milliseconds>(
+                chrono::steady_clock::now() - startTime)
+                .count();
+        DEBUG_LOG("MCP connection ready %lld ms after add-in load",
+                  connectionStats.loadToReadyMs);
+      }
+    }
+    PostNotification(NOTIFY_READY);
+    return true;
+  });
 
-  // Send health check
-  string healthJson = "{\"id\":\"1\",\"type\":\"health\"}";
-  DWORD dwError = WinHttpWebSocketSend(
-      hWebSocket, WINHTTP_WEB_SOCKET_UTF8_MESSAGE_BUFFER_TYPE,
-      (PVOID)healthJson.c_str(), (DWORD)healthJson.length());
+  if (!SendText(request.dump())) {
+    dispatcher.Cancel(id);
+  }
+}
 
-  if (dwError != ERROR_SUCCESS) {
-    DEBUG_LOG("Health check send failed: %lu", dwError);
-  } else {
-    DEBUG_LOG("Health check sent successfully");
+// Session receive thread: reassembles messages and hands each one to the
+// request it answers. Runs on the session thread until the socket closes.
+void MCPClient::ReceiveSession(HINTERNET socket) {
+  StreamFrameAssembler assembler;
+  char recvBuffer[8192];
 
-    // Receive response
-    char recvBuffer[4096];
+  for (;;) {
     DWORD dwBytesRead = 0;
     WINHTTP_WEB_SOCKET_BUFFER_TYPE bufferType;
 
-    dwError =
-        WinHttpWebSocketReceive(hWebSocket, recvBuffer, sizeof(recvBuffer) - 1,
-                                &dwBytesRead, &bufferType);
+    DWORD dwError = WinHttpWebSocketReceive(
+        socket, recvBuffer, sizeof(recvBuffer), &dwBytesRead, &bufferType);
 
-    if (dwError == ERROR_SUCCESS) {
-      recvBuffer[dwBytesRead] = '\0';
-      string response = string(recvBuffer);
-      wstring responseW = StringToWstring(response);
-      // MSGBOX_INFO(L"Health check response: " + responseW);
-      DEBUG_LOG("Health check response: %s", recvBuffer);
+    if (dwError != ERROR_SUCCESS ||
+        bufferType == WINHTTP_WEB_SOCKET_CLOSE_BUFFER_TYPE) {
+      DEBUG_LOG("WebSocket session ended: %lu", dwError);
+      break;
+    }
+
+    bool isFinal = bufferType == WINHTTP_WEB_SOCKET_UTF8_MESSAGE_BUFFER_TYPE ||
+                   bufferType == WINHTTP_WEB_SOCKET_BINARY_MESSAGE_BUFFER_TYPE;
+    bool routed;
+    if (isFinal && assembler.Empty()) {
+      // The usual case: the whole message arrived in one receive and is
+      // routed straight from the receive buffer
+      routed = dispatcher.Dispatch(recvBuffer, dwBytesRead);
     } else {
-      DEBUG_LOG("Health check receive failed: %lu", dwError);
+      if (!assembler.Append(recvBuffer, dwBytesRead, isFinal))
+        continue;
+      const string &message = assembler.Message();
+      routed = dispatcher.Dispatch(message.data(), message.size());
+      assembler.Reset();
+    }
+
+    if (!routed) {
+      DEBUG_LOG("Dropped a message no request is waiting for");
     }
   }
 
-  return true;
+  // Whatever is still pending learns that no reply is coming
+  dispatcher.Close();
 }
 
-void MCPClient::Disconnect() {
-  if (hWebSocket) {
-    WinHttpWebSocketClose(hWebSocket, WINHTTP_WEB_SOCKET_SUCCESS_CLOSE_STATUS,
-                          NULL, 0);
-    WinHttpCloseHandle(hWebSocket);
-    hWebSocket = NULL;
-  }
-  if (hConnect) {
-    WinHttpCloseHandle(hConnect);
-    hConnect = NULL;
+// Holds socketMutex for the send: WinHTTP allows one send at a time per
+// socket, and the session thread may be swapping the handle
+bool MCPClient::SendText(const string &message) {
+  lock_guard<mutex> lock(socketMutex);
+  if (!hWebSocket) {
+    DEBUG_LOG("WebSocket send failed: not connected");
+    return false;
   }
-  if (hSession) {
-    WinHttpCloseHandle(hSession);
-    hSession = NULL;
+  DWORD dwError = WinHttpWebSocketSend(
+      hWebSocket, WINHTTP_WEB_SOCKET_UTF8_MESSAGE_BUFFER_TYPE,
+      (PVOID)message.c_str(), (DWORD)message.length());
+  if (dwError != ERROR_SUCCESS) {
+    DEBUG_LOG("WebSocket send failed: %lu", dwError);
+    return false;
   }
-  isConnected = false;
+  return true;
 }
 
-string MCPClient::SendMessageToWebsocket(const string &jsonMessage) {
-  if (!isConnected || !hWebSocket) {
+// The reply is matched by id, so this works while other requests, a
+// streaming answer included, are in flight on the same socket. While the UI
+// thread waits here the drain timer does not run; the stream's queue holds
+// far more than a local history or health reply takes to arrive.
+string MCPClient::SendRequest(json request, chrono::milliseconds timeout) {
+  if (!IsConnected()) {
     MSGBOX_ERROR(L"Not connected to WebSocket");
     return "{\"error\":\"Not connected\"}";
   }
 
-  // Send message
-  DWORD dwError = WinHttpWebSocketSend(
-      hWebSocket, WINHTTP_WEB_SOCKET_UTF8_MESSAGE_BUFFER_TYPE,
-      (PVOID)jsonMessage.c_str(), (DWORD)jsonMessage.length());
+  uint64_t id = dispatcher.NextId();
+  request["id"] = to_string(id);
+  // Registered before sending so the reply can't arrive unclaimed
+  future<string> reply = dispatcher.Expect(id);
 
-  if (dwError != ERROR_SUCCESS) {
+  if (!SendText(request.dump())) {
+    dispatcher.Cancel(id);
     MSGBOX_ERROR(L"WebSocket send failed");
     return "{\"error\":\"Send failed\"}";
   }
 
-  // Receive response - handle potentially large/fragmented messages
-  string fullResponse;
-  char recvBuffer[8192]; // Smaller buffer for each chunk
-  DWORD dwBytesRead = 0;
-  WINHTTP_WEB_SOCKET_BUFFER_TYPE bufferType;
-
-  // Keep receiving until we get the complete message
-  do {
-    dwError =
-        WinHttpWebSocketReceive(hWebSocket, recvBuffer, sizeof(recvBuffer) - 1,
-                                &dwBytesRead, &bufferType);
-
-    if (dwError != ERROR_SUCCESS) {
-      MSGBOX_ERRORF(L"Agentic Extension", L"Websocket receive Failed %lu",
-                    dwError);
-      DEBUG_LOG("WebSocket receive failed: %lu", dwError);
-      return "{\"error\":\"Receive failed\"}";
-    }
-
-    // Append received data to full response
-    recvBuffer[dwBytesRead] = '\0';
-    fullResponse.append(recvBuffer, dwBytesRead);
+  if (reply.wait_for(timeout) != future_status::ready) {
+    dispatcher.Cancel(id);
+    DEBUG_LOG("Request %llu timed out", (unsigned long long)id);
+    return "{\"error\":\"Timed out\"}";
+  }
 
-    // Check if this is the final fragment
-    // WINHTTP_WEB_SOCKET_UTF8_MESSAGE_BUFFER_TYPE = 0x80000002 means final text
-    // frame WINHTTP_WEB_SOCKET_UTF8_FRAGMENT_BUFFER_TYPE = 0x80000003 means
-    // fragment
-  } while (bufferType == WINHTTP_WEB_SOCKET_UTF8_FRAGMENT_BUFFER_TYPE ||
-           bufferType == WINHTTP_WEB_SOCKET_BINARY_FRAGMENT_BUFFER_TYPE);
+  string response = reply.get();
+  if (response.empty()) {
+    DEBUG_LOG("Request %llu: connection lost", (unsigned long long)id);
+    return "{\"error\":\"Receive failed\"}";
+  }
 
-  // MSGBOX_INFO(L"WebSocket receive " + StringToWstring(fullResponse));
-  DEBUG_LOG("Received full response: %zu bytes", fullResponse.length());
-  return fullResponse;
+  DEBUG_LOG("Request %llu: %zu bytes", (unsigned long long)id,
+            response.length());
+  return response;
 }
 
-void MCPClient::SendPrompt(const int &id, const string &prompt,
-                           const string &filePath, const string &currentFile) {
-  if (!isConnected) {
-    ConnectToMCP();
+void MCPClient::SendPrompt(const string &prompt, const string &filePath,
+                           const string &currentFile) {
+  // Its document write would take over the stream's
+  if (IsStreaming()) {
+    MSGBOX_WARNING(L"A response is still being written");
+    return;
+  }
+
+  if (!IsConnected()) {
+    MSGBOX_ERROR(L"Not connected to WebSocket");
+    return;
   }
 
   // Build JSON request using nlohmann/json
-  json requestJson = {{"id", to_string(id)},
-                      {"type", "analyze"},
+  json requestJson = {{"type", "analyze"},
                       {"prompt", prompt},
                       {"file_path", filePath},
                       {"current_file", currentFile}};
 
-  string jsonRequest = requestJson.dump();
-  string response = SendMessageToWebsocket(jsonRequest);
+  string response = SendRequest(requestJson, PROMPT_TIMEOUT);
 
   // Parse JSON response
   try {
@@ -379,16 +430,19 @@ void MCPClient::SendPrompt(const int &id, const string &prompt,
     // Extract content field
     if (responseJson.contains("content")) {
       string content = responseJson["content"].get<string>();
-      wstring wContent = StringToWstring(content);
 
-      // Split by sentences for more natural streaming
-      vector<wstring> chunks = SplitIntoChunks(wContent, 100);
-
-      // Stream each chunk
-      for (const auto &chunk : chunks) {
-        Stream(chunk);
-        Sleep(100); // Delay between sentences
-      }
+      // The whole answer is already here; write it without pacing
+      writeCoalescer.ResetStats();
+      BeginDocumentWrite();
+      // Puts Word's screen updating back even if writing throws
+      struct WriteGuard {
+        MCPClient *client;
+        ~WriteGuard() { client->AbortDocumentWrite(); }
+      } guard{this};
+      ResetMarkdown();
+      WriteCompleteResponse(content.data(), content.size());
+      EndDocumentWrite();
+      ReportWriteStats();
     } else if (responseJson.contains("error")) {
       string error = responseJson["error"].get<string>();
       MSGBOX_WARNING(L"Error: " + StringToWstring(error));
@@ -403,15 +457,22 @@ void MCPClient::SendPrompt(const int &id, const string &prompt,
   SetHistoryChat();
 }
 
-void MCPClient::SendPromptWithStream(const int &id, const string &prompt,
+void MCPClient::SendPromptWithStream(const string &prompt,
                                      const string &filePath,
                                      const string &currentFile) {
-  if (!isConnected) {
-    ConnectToMCP();
+  if (IsStreaming()) {
+    MSGBOX_WARNING(L"A response is still being written");
+    return;
+  }
+
+  if (!IsConnected()) {
+    MSGBOX_ERROR(L"Not connected to WebSocket");
+    return;
   }
 
   // Build JSON request with isStream: true
-  json requestJson = {{"id", std::to_string(id)},
+  uint64_t id = dispatcher.NextId();
+  json requestJson = {{"id", to_string(id)},
                       {"type", "explain"},
                       {"prompt", prompt},
                       {"file_path", filePath},
@@ -423,136 +484,201 @@ void MCPClient::SendPromptWithStream(const int &id, const string &prompt,
 
   string jsonRequest = requestJson.dump();
 
-  // Send the request
-  if (!isConnected || hWebSocket == NULL) {
-    MSGBOX_ERROR(L"Not connected to WebSocket");
+  // Frames are decoded on the session's receive thread and drained by a
+  // timer so a stalled network never freezes Word. The route is in place
+  // before the request goes out.
+  activeStream.reset(new StreamState());
+  StreamState *state = activeStream.get();
+  state->requestId = id;
+  bool registered = dispatcher.Register(
+      id, [this, state](const char *message, size_t length) {
+        return RouteStreamMessage(state, message, length);
+      });
+
+  if (!registered || !SendText(jsonRequest)) {
+    MSGBOX_ERROR(L"WebSocket send failed");
+    FinishStream();
     return;
   }
 
-  DWORD dwError = WinHttpWebSocketSend(
-      hWebSocket, WINHTTP_WEB_SOCKET_UTF8_MESSAGE_BUFFER_TYPE,
-      (PVOID)jsonRequest.c_str(), (DWORD)jsonRequest.length());
+  DEBUG_LOG("Streaming request %llu sent: %s", (unsigned long long)id,
+            jsonRequest.c_str());
 
-  if (dwError != ERROR_SUCCESS) {
-    MSGBOX_ERROR(L"WebSocket send failed");
-    return;
-  }
+  // Reset state
+  ResetMarkdown();
+  writeCoalescer.Discard();
+  writeCoalescer.ResetStats();
+  BeginDocumentWrite();
 
-  DEBUG_LOG("Streaming request sent: %s", jsonRequest.c_str());
+  s_pStreamingClient = this;
+  state->drainTimer =
+      SetTimer(NULL, 0, STREAM_DRAIN_INTERVAL_MS, &MCPClient::DrainTimerProc);
 
-  // Receive streaming responses until complete
-  string accumulatedContent;
-  char recvBuffer[8192];
-  DWORD dwBytesRead = 0;
-  WINHTTP_WEB_SOCKET_BUFFER_TYPE bufferType;
-  bool streamComplete = false;
+  if (!state->drainTimer) {
+    DEBUG_LOG("SetTimer failed: %lu", GetLastError());
+  }
+}
 
-  // Reset state
-  isBoldMode = false;
-  isTableMode = false;
-  pendingBuffer.clear();
-  tableBuffer.clear();
-
-  while (!streamComplete) {
-    // Message Pump to keep UI responsive
-    MSG msg;
-    while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
-      TranslateMessage(&msg);
-      DispatchMessage(&msg);
+// Receive thread: one message of the streaming request, decoded into
+// streamArena and handed to the UI thread through the queue. Returns true
+// once the terminal event is queued.
+bool MCPClient::RouteStreamMessage(StreamState *state, const char *message,
+                                   size_t length) {
+  StreamEvent event;
+  if (!message) {
+    event.kind = StreamEventKind::Error;
+    event.content = "Stream receive failed";
+  } else {
+    event = DecodeStreamEvent(message, length, streamArena);
+    if (event.kind == StreamEventKind::Ignored) {
+      DEBUG_LOG("Ignoring stream frame: %.*s", (int)event.content.size(),
+                event.content.data());
+      return false;
     }
+  }
 
-    // Receive a WebSocket message
-    string fullMessage;
+  bool terminal = event.IsTerminal();
+  state->queue.Push(std::move(event));
+  return terminal;
+}
 
-    do {
-      dwError = WinHttpWebSocketReceive(hWebSocket, recvBuffer,
-                                        sizeof(recvBuffer) - 1, &dwBytesRead,
-                                        &bufferType);
+void CALLBACK MCPClient::DrainTimerProc(HWND hwnd, UINT uMsg, UINT_PTR idEvent,
+                                        DWORD dwTime) {
+  UNREFERENCED_PARAMETER(hwnd);
+  UNREFERENCED_PARAMETER(uMsg);
+  UNREFERENCED_PARAMETER(idEvent);
+  UNREFERENCED_PARAMETER(dwTime);
 
-      if (dwError != ERROR_SUCCESS) {
-        DEBUG_LOG("WebSocket receive failed: %lu", dwError);
-        MSGBOX_ERRORF(L"Agentic Extension", L"Stream receive failed %lu",
-                      dwError);
-        return;
-      }
+  if (s_pStreamingClient) {
+    s_pStreamingClient->DrainStreamQueue();
+  }
+}
 
-      recvBuffer[dwBytesRead] = '\0';
-      fullMessage.append(recvBuffer, dwBytesRead);
-
-    } while (bufferType == WINHTTP_WEB_SOCKET_UTF8_FRAGMENT_BUFFER_TYPE ||
-             bufferType == WINHTTP_WEB_SOCKET_BINARY_FRAGMENT_BUFFER_TYPE);
-
-    // Parse the received JSON message
-    try {
-      json responseJson = json::parse(fullMessage);
-
-      // Check for status field
-      if (responseJson.contains("status")) {
-        string status = responseJson["status"].get<string>();
-
-        if (status == "streaming") {
-          // Extract and stream the content chunk
-          if (responseJson.contains("content")) {
-            string contentChunk = responseJson["content"].get<string>();
-            wstring wChunk = StringToWstring(contentChunk);
-
-            // Process chunk with Markdown parser
-            ProcessStreamChunk(wChunk);
-
-            // Accumulate for history
-            accumulatedContent += contentChunk;
-          }
-        } else if (status == "complete") {
-          // Process any remaining buffer
-          if (!pendingBuffer.empty()) {
-            Stream(pendingBuffer);
-            pendingBuffer.clear();
-          }
-          if (isTableMode) {
-            CreateTableFromBuffer();
-          }
-
-          // Streaming is complete
-          streamComplete = true;
-          SetHistoryChat();
-          DEBUG_LOG("Stream completed");
-        } else if (status == "error") {
-          // Handle error
-          string errorMsg = responseJson.contains("content")
-                                ? responseJson["content"].get<string>()
-                                : "Unknown error";
-          MSGBOX_WARNING(L"Streaming error: " + StringToWstring(errorMsg));
-          streamComplete = true;
-        }
-      } else if (responseJson.contains("success")) {
-        // Non-streaming response format (fallback)
-        if (responseJson["success"].get<bool>()) {
-          if (responseJson.contains("content")) {
-            string content = responseJson["content"].get<string>();
-            wstring wContent = StringToWstring(content);
-
-            vector<wstring> chunks = SplitIntoChunks(wContent, 100);
-            for (const auto &chunk : chunks) {
-              Stream(chunk);
-              Sleep(50);
-            }
-          }
-        } else if (responseJson.contains("error")) {
-          string error = responseJson["error"].get<string>();
-          MSGBOX_WARNING(L"Error: " + StringToWstring(error));
-        }
-        streamComplete = true;
-      }
+// UI thread: pull everything queued since the last tick and write it as one
+// batch. Chunk text is read in place from streamArena; the writer merges it.
+void MCPClient::DrainStreamQueue() {
+  StreamState *state = activeStream.get();
+  if (!state || state->isDraining)
+    return;
+  state->isDraining = true;
+
+  StreamEvent event;
+  bool finished = false;
+
+  for (size_t n = 0; n < STREAM_DRAIN_BATCH && state->queue.TryPop(event);
+       n++) {
+    if (event.kind == StreamEventKind::Chunk) {
+      ProcessStreamChunk(event.content.data(), event.content.size());
+      continue;
+    }
 
-    } catch (json::exception &e) {
-      MSGBOX_ERROR(L"Json parse error during streaming: " +
-                   StringToWstring(e.what()));
-      DEBUG_LOG("JSON parse error during streaming: %s", e.what());
-      // Continue receiving - might be partial data
+    if (event.kind == StreamEventKind::Complete ||
+        event.kind == StreamEventKind::Cancelled) {
+      // Resolve markers still held at the end of the text
+      FinishMarkdown();
+      DEBUG_LOG("Stream %s", event.kind == StreamEventKind::Complete
+                                 ? "completed"
+                                 : "cancelled by the server");
+    } else if (event.kind == StreamEventKind::Response) {
+      // Non-streaming response format (fallback)
+      WriteCompleteResponse(event.content.data(), event.content.size());
+    } else if (event.kind == StreamEventKind::Error) {
+      MSGBOX_WARNING(L"Streaming error: " +
+                     StringToWstring(string(event.content)));
     }
+
+    EndDocumentWrite();
+    ReportWriteStats();
+    finished = true;
+    break;
   }
 
-  SetHistoryChat();
+  // Text left over from an earlier tick goes out once its interval elapses
+  if (!finished) {
+    FlushWrites(false);
+  }
+
+  state->isDraining = false;
+
+  if (finished) {
+    FinishStream();
+    SetHistoryChat();
+  }
+}
+
+// Stop the drain timer and detach the request from the session
+void MCPClient::FinishStream() {
+  if (!activeStream)
+    return;
+
+  if (activeStream->drainTimer) {
+    KillTimer(NULL, activeStream->drainTimer);
+    activeStream->drainTimer = 0;
+  }
+
+  // Once Cancel returns the receive thread is done with this request for
+  // good
+  dispatcher.Cancel(activeStream->requestId);
+
+  // Nothing refers to the request's frames any more
+  lastArenaStats = streamArena.Stats();
+  DEBUG_LOG("Arena: %zu allocations, %zu bytes, %zu heap blocks (%zu bytes "
+            "held)",
+            lastArenaStats.allocations, lastArenaStats.peakBytes,
+            lastArenaStats.heapBlocks, streamArena.Capacity());
+  streamArena.Reset();
+
+  if (s_pStreamingClient == this) {
+    s_pStreamingClient = nullptr;
+  }
+  activeStream.reset();
+
+  // Normally already closed by the terminal event; covers teardown
+  AbortDocumentWrite();
+
+  PostNotification(NOTIFY_STREAM_ENDED);
+}
+
+// UI thread. The writer stops here, without waiting for the server: frames
+// queued or still arriving are dropped. Markdown held back (a table being
+// collected, an unclosed span) is written out so the document ends on a
+// whole paragraph rather than mid-construct.
+void MCPClient::CancelStream() {
+  if (!activeStream) {
+    return;
+  }
+  uint64_t id = activeStream->requestId;
+
+  FinishMarkdown();
+  EndDocumentWrite();
+  ReportWriteStats();
+  FinishStream();
+
+  // The server aborts the model request and saves what was generated to
+  // history, then ends the request with a terminal status. History is
+  // reloaded once that arrives, so it shows the partial answer.
+  auto arena = make_shared<RequestArena>(1024);
+  bool registered =
+      dispatcher.Register(id, [this, arena](const char *message, size_t length) {
+        if (!message) {
+          return true;
+        }
+        StreamEvent event = DecodeStreamEvent(message, length, *arena);
+        arena->Reset();
+        if (!event.IsTerminal()) {
+          return false; // chunks sent before the server saw the cancel
+        }
+        PostNotification(NOTIFY_HISTORY_CHANGED);
+        return true;
+      });
+
+  json request = {{"id", to_string(id)}, {"type", "cancel"}};
+  if (!registered || !SendText(request.dump())) {
+    dispatcher.Cancel(id);
+    DEBUG_LOG("Cancel for request %llu not sent", (unsigned long long)id);
+    return;
+  }
+  DEBUG_LOG("Request %llu cancelled", (unsigned long long)id);
 }
 
 vector<string> MCPClient::getFilePath() {
@@ -585,39 +711,22 @@ vector<string> MCPClient::getFilePath() {
   return currentPath;
 }
 
+// One pass each way; hot paths convert into reused buffers with Utf::
+// directly instead
 wstring MCPClient::StringToWstring(const string &str) {
-  if (str.empty())
-    return L"";
-
-  int sizeNeeded =
-      MultiByteToWideChar(CP_UTF8, 0, str.c_str(), (int)str.size(), NULL, 0);
-
-  wstring wstr(sizeNeeded, 0);
-  MultiByteToWideChar(CP_UTF8, 0, str.c_str(), (int)str.size(), &wstr[0],
-                      sizeNeeded);
-
+  wstring wstr;
+  Utf::Utf8ToUtf16(str, wstr);
   return wstr;
 }
 
 string MCPClient::WstringToString(const wstring &str) {
-  if (str.empty())
-    return "";
-
-  int sizeNeeded = WideCharToMultiByte(CP_UTF8, // output UTF-8
-                                       0, str.c_str(), (int)str.size(), nullptr,
-                                       0, nullptr, nullptr);
-
-  string result(sizeNeeded, 0);
-
-  WideCharToMultiByte(CP_UTF8, 0, str.c_str(), (int)str.size(), &result[0],
-                      sizeNeeded, nullptr, nullptr);
-
+  string result;
+  Utf::Utf16ToUtf8(str, result);
   return result;
 }
 
 void MCPClient::SetHistoryChat() {
-  wstring messageLoaded;
-  if (!isConnected) {
+  if (!IsConnected()) {
     MSGBOX_ERROR(L"Not connected to WebSocket");
     return;
   }
@@ -625,290 +734,83 @@ void MCPClient::SetHistoryChat() {
   // Clear existing history
   historyChat.clear();
 
-  string response =
-      SendMessageToWebsocket("{\"id\":\"1\",\"type\":\"history\"}");
+  string response = SendRequest({{"type", "history"}});
 
-  // Save to file for debugging
-  ofstream his("history.json");
-  if (his.is_open()) {
-    his << response << endl;
-    his.close();
+  if (dumpHistory) {
+    ofstream his("history.json");
+    if (his.is_open()) {
+      his << response << endl;
+      his.close();
+    }
   }
 
-  // Simple JSON parsing for our specific structure
   // Expected format: {"type":"history","status":"ok","data":[{...},{...}]}
-
-  // Find "data":[
-  size_t dataStart = response.find("\"data\":[");
-  if (dataStart == string::npos) {
-    DEBUG_LOG("No data array found in response");
-    return;
-  }
-  dataStart += 8; // Skip past "data":[
-
-  // Find each object in the array
-  size_t pos = dataStart;
-  while (pos < response.length()) {
-    // Find start of object
-    size_t objStart = response.find('{', pos);
-    if (objStart == string::npos || objStart >= response.length())
-      break;
-
-    // Find end of object (matching brace)
-    int braceCount = 1;
-    size_t objEnd = objStart + 1;
-    while (objEnd < response.length() && braceCount > 0) {
-      if (response[objEnd] == '{')
-        braceCount++;
-      else if (response[objEnd] == '}')
-        braceCount--;
-      objEnd++;
-    }
-
-    if (braceCount != 0)
-      break;
-
-    string obj = response.substr(objStart, objEnd - objStart);
-
-    // Extract fields from object
-    struct historyChat entry;
-
-    // Extract message
-    size_t msgStart = obj.find("\"message\":\"");
-    if (msgStart != string::npos) {
-      msgStart += 11;
-      size_t msgEnd = msgStart;
-      while (msgEnd < obj.length()) {
-        if (obj[msgEnd] == '"' && (msgEnd == 0 || obj[msgEnd - 1] != '\\'))
-          break;
-        msgEnd++;
-      }
-      entry.message = obj.substr(msgStart, msgEnd - msgStart);
-      messageLoaded = StringToWstring(entry.message) + L"\n";
-    }
-
-    // Extract timestamp
-    size_t tsStart = obj.find("\"timestamp\":\"");
-    if (tsStart != string::npos) {
-      tsStart += 13;
-      size_t tsEnd = obj.find('"', tsStart);
-      if (tsEnd != string::npos) {
-        entry.timestamp = obj.substr(tsStart, tsEnd - tsStart);
-      }
-    }
-
-    // Extract role
-    size_t roleStart = obj.find("\"role\":\"");
-    if (roleStart != string::npos) {
-      roleStart += 8;
-      size_t roleEnd = obj.find('"', roleStart);
-      if (roleEnd != string::npos) {
-        entry.role = obj.substr(roleStart, roleEnd - roleStart);
-      }
-    }
-
-    historyChat.push_back(entry);
-
-    // Move to next object
-    pos = objEnd;
-
-    // Check if we've reached the end of the array
-    size_t nextComma = response.find(',', pos);
-    size_t arrayEnd = response.find(']', pos);
-    if (arrayEnd != string::npos &&
-        (nextComma == string::npos || arrayEnd < nextComma)) {
-      break;
-    }
+  if (!HistoryDecoder::Decode(response, historyChat)) {
+    DEBUG_LOG("Malformed history response, kept %zu entries",
+              historyChat.size());
   }
 
   // MSGBOX_INFO(L"Loaded " + to_wstring(historyChat.size()) +
   //             L" history entries");
 }
 
-void MCPClient::ProcessStreamChunk(const wstring &chunk) {
-  // Combine pending buffer with new chunk
-  wstring text = pendingBuffer + chunk;
-  pendingBuffer.clear();
-
-  size_t processed = 0;
-
-  // If we are in table mode, we need to handle line by line
-  if (isTableMode) {
-    size_t pos = 0;
-    while (pos < text.length()) {
-      size_t newline = text.find(L'\n', pos);
-      if (newline == wstring::npos) {
-        // Incomplete line, save to buffer
-        pendingBuffer = text.substr(pos);
-        processed = text.length();
-        break;
-      }
-
-      wstring line = text.substr(pos, newline - pos + 1); // include newline
-
-      // Check if line looks like a table row
-      wstring trimmed = line;
-      // Simple trim for check
-      while (!trimmed.empty() && iswspace(trimmed.back()))
-        trimmed.pop_back();
-      while (!trimmed.empty() && iswspace(trimmed.front()))
-        trimmed.erase(0, 1);
-
-      if (!trimmed.empty() && trimmed.front() == L'|') {
-        tableBuffer.push_back(line);
-      } else if (!trimmed.empty()) {
-        // End of table
-        CreateTableFromBuffer();
-        ParseMarkdown(line);
-      } else {
-        // Empty line, could be end of table or just spacing?
-        if (!tableBuffer.empty()) {
-          CreateTableFromBuffer();
-        }
-        Stream(line);
-      }
+void MCPClient::ProcessStreamChunk(const char *chunk, size_t length) {
+  markdown.Feed(chunk, length,
+                [this](const MarkdownRun &run) { WriteMarkdownRun(run); });
+}
 
-      pos = newline + 1;
-      processed = pos;
-    }
-    return;
+void MCPClient::FinishMarkdown() {
+  markdown.Finish([this](const MarkdownRun &run) { WriteMarkdownRun(run); });
+  if (!tableBuilder.Empty()) {
+    FlushTable();
   }
-
-  // Not in table mode, normal parsing
-  ParseMarkdown(text);
 }
 
-void MCPClient::ParseMarkdown(const wstring &text) {
-  // If text starts with '|', and we are not in table mode, start table mode
-  wstring trimmed = text;
-  while (!trimmed.empty() && iswspace(trimmed.back()))
-    trimmed.pop_back();
-  while (!trimmed.empty() && iswspace(trimmed.front()))
-    trimmed.erase(0, 1);
+void MCPClient::ResetMarkdown() {
+  markdown.Reset();
+  tableBuilder.Reset();
+}
 
-  if (!isTableMode && !trimmed.empty() && trimmed.front() == L'|') {
-    isTableMode = true;
-    tableBuffer.push_back(text);
+void MCPClient::WriteMarkdownRun(const MarkdownRun &run) {
+  // Table rows are held until the table ends, then inserted in one go
+  if (run.style & MD_TABLE) {
+    tableBuilder.Append(run.text, run.length);
     return;
   }
-
-  size_t i = 0;
-  while (i < text.length()) {
-    // Toggle Bold on "**"
-    if (i + 1 < text.length() && text[i] == L'*' && text[i + 1] == L'*') {
-      isBoldMode = !isBoldMode;
-      i += 2;
-      continue;
-    }
-
-    // Toggle Underline on "__"
-    if (i + 1 < text.length() && text[i] == L'_' && text[i + 1] == L'_') {
-      isUnderlineMode = !isUnderlineMode;
-      i += 2;
-      continue;
-    }
-
-    // Toggle Italic on "_" (if not double)
-    if (text[i] == L'_') {
-      isItalicMode = !isItalicMode;
-      i++;
-      continue;
-    }
-
-    // Handle Header "## "
-    if (i + 2 < text.length() && text[i] == L'#' && text[i + 1] == L'#' &&
-        text[i + 2] == L' ') {
-      WriteHeader(L"");
-      Stream(L"\n");
-      i += 3;
-      isBoldMode = true;
-      continue;
-    }
-
-    // Buffer standard text until next token
-    size_t start = i;
-    while (i < text.length()) {
-      if (i + 1 < text.length() && text[i] == L'*' && text[i + 1] == L'*')
-        break;
-      if (i + 1 < text.length() && text[i] == L'_' && text[i + 1] == L'_')
-        break;
-      if (text[i] == L'_')
-        break;
-      if (i + 2 < text.length() && text[i] == L'#' && text[i + 1] == L'#' &&
-          text[i + 2] == L' ')
-        break;
-      i++;
-    }
-
-    wstring sub = text.substr(start, i - start);
-    // Apply formatting (simulated via Stream for now)
-    // In real implementation we would set Selection.Font properties here
-    Stream(sub);
+  if (!tableBuilder.Empty()) {
+    FlushTable();
   }
-}
 
-void MCPClient::WriteBold(const wstring &text) { Stream(text); }
-
-void MCPClient::WriteHeader(const wstring &text) { Stream(L"\n"); }
-
-void MCPClient::CreateTableFromBuffer() {
-  isTableMode = false;
-  if (tableBuffer.empty())
-    return;
+  StreamUtf8(run.text, run.length, run.style, run.headingLevel);
+}
 
-  Stream(L"\n");
-  for (const auto &line : tableBuffer) {
-    Stream(line);
-  }
-  tableBuffer.clear();
+void MCPClient::StreamUtf8(const char *text, size_t length, uint16_t style,
+                           uint8_t headingLevel) {
+  Utf::Utf8ToUtf16(text, length, runBuffer);
+  Stream(runBuffer, style, headingLevel);
 }
 
 void MCPClient::CollectDocumentInfo(json &requestJson) {
   if (!s_pWordApp)
     return;
 
-  // Collect Active Document Name
-  {
-    DISPID dispid;
-    OLECHAR *szMember = (OLECHAR *)L"ActiveDocument";
-    HRESULT hr = s_pWordApp->GetIDsOfNames(IID_NULL, &szMember, 1,
-                                           LOCALE_USER_DEFAULT, &dispid);
-    if (SUCCEEDED(hr)) {
-      DISPPARAMS dp = {NULL, NULL, 0, 0};
-      VARIANT result;
-      VariantInit(&result);
-      hr = s_pWordApp->Invoke(dispid, IID_NULL, LOCALE_USER_DEFAULT,
-                              DISPATCH_PROPERTYGET, &dp, &result, NULL, NULL);
-      if (SUCCEEDED(hr) && result.pdispVal) {
-        IDispatch *pDoc = result.pdispVal;
-
-        // Get Name
-        szMember = (OLECHAR *)L"Name";
-        hr = pDoc->GetIDsOfNames(IID_NULL, &szMember, 1, LOCALE_USER_DEFAULT,
-                                 &dispid);
-        if (SUCCEEDED(hr)) {
-          VARIANT nameRes;
-          VariantInit(&nameRes);
-          pDoc->Invoke(dispid, IID_NULL, LOCALE_USER_DEFAULT,
-                       DISPATCH_PROPERTYGET, &dp, &nameRes, NULL, NULL);
-          if (nameRes.vt == VT_BSTR) {
-            requestJson["active_document"] = WstringToString(nameRes.bstrVal);
-            wstring space = L"\n";
-            MSGBOX_INFO(szMember + space + StringToWstring(requestJson.dump()));
-          }
-          VariantClear(&nameRes);
-        }
-
-        // Get Page Count (ComputeStatistics(2) = wdStatisticPages)
-        // This is expensive, maybe skip or use simpler property?
-        // Information(wdNumberOfPagesInDocument) (wdNumberOfPagesInDocument =
-        // 4) on Selection/Range
+  Com::Object<Com::Application> app(s_pWordApp);
+  Com::Object<Com::Document> doc;
+  if (FAILED(app.Get(L"ActiveDocument", doc)))
+    return;
 
-        pDoc->Release();
-      }
-      VariantClear(&result);
-    }
+  // Collect Active Document Name
+  string name;
+  if (SUCCEEDED(doc.Get(L"Name", name))) {
+    requestJson["active_document"] = name;
+    wstring space = L"\n";
+    MSGBOX_INFO(L"Name" + space + StringToWstring(requestJson.dump()));
   }
+
+  // Get Page Count (ComputeStatistics(2) = wdStatisticPages)
+  // This is expensive, maybe skip or use simpler property?
+  // Information(wdNumberOfPagesInDocument) (wdNumberOfPagesInDocument =
+  // 4) on Selection/Range
 }
 
 } // namespace MCPHelper
\ No newline at end of file
@@ -0,0 +1,112 @@
+#include "client/dispatch.hpp"
+#include "client/transcode.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cwchar>
+
+namespace MCPHelper {
+namespace Com {
+
+// Word's object model is only touched from the UI (STA) thread, so the
+// counters and caches need no locking.
+static DispatchStats s_stats;
+
+DispatchStats GetDispatchStats() { return s_stats; }
+
+void ResetDispatchStats() { s_stats = DispatchStats(); }
+
+bool MemberCache::Find(const wchar_t *member, DISPID &dispid) const {
+  for (const auto &entry : entries) {
+    if (wcscmp(entry.first.c_str(), member) == 0) {
+      dispid = entry.second;
+      return true;
+    }
+  }
+  return false;
+}
+
+void MemberCache::Add(const wchar_t *member, DISPID dispid) {
+  entries.emplace_back(member, dispid);
+}
+
+HRESULT InvokeMember(IDispatch *pDisp, MemberCache &cache,
+                     const wchar_t *member, WORD flags, VARIANT *args,
+                     UINT argCount, VARIANT *result, DISPID *named) {
+  if (!pDisp)
+    return E_POINTER;
+
+  DISPID dispid;
+  if (cache.Find(member, dispid)) {
+    s_stats.cacheHits++;
+  } else {
+    OLECHAR *szMember = const_cast<OLECHAR *>(member);
+    s_stats.nameLookups++;
+    HRESULT hr = pDisp->GetIDsOfNames(IID_NULL, &szMember, 1,
+                                      LOCALE_USER_DEFAULT, &dispid);
+    if (FAILED(hr))
+      return hr;
+    cache.Add(member, dispid);
+  }
+
+  // IDispatch takes positional arguments last-to-first
+  std::reverse(args, args + argCount);
+
+  DISPPARAMS dp = {args, named, argCount, named ? 1u : 0u};
+  auto start = std::chrono::steady_clock::now();
+  HRESULT hr = pDisp->Invoke(dispid, IID_NULL, LOCALE_USER_DEFAULT, flags,
+                             &dp, result, NULL, NULL);
+  s_stats.invokeMicros +=
+      std::chrono::duration<double, std::micro>(
+          std::chrono::steady_clock::now() - start)
+          .count();
+  s_stats.invokes++;
+
+  std::reverse(args, args + argCount);
+  return hr;
+}
+
+HRESULT FromVariant(Variant &raw, std::wstring &out) {
+  VARIANT &v = raw.Raw();
+  if (v.vt != VT_BSTR) {
+    HRESULT hr = VariantChangeType(&v, &v, 0, VT_BSTR);
+    if (FAILED(hr))
+      return hr;
+  }
+  out.assign(v.bstrVal ? v.bstrVal : L"", v.bstrVal ? SysStringLen(v.bstrVal)
+                                                    : 0);
+  return S_OK;
+}
+
+HRESULT FromVariant(Variant &raw, std::string &out) {
+  std::wstring wide;
+  HRESULT hr = FromVariant(raw, wide);
+  if (FAILED(hr))
+    return hr;
+  Utf::Utf16ToUtf8(wide, out);
+  return S_OK;
+}
+
+HRESULT FromVariant(Variant &raw, bool &out) {
+  VARIANT &v = raw.Raw();
+  if (v.vt != VT_BOOL) {
+    HRESULT hr = VariantChangeType(&v, &v, 0, VT_BOOL);
+    if (FAILED(hr))
+      return hr;
+  }
+  out = (v.boolVal != VARIANT_FALSE);
+  return S_OK;
+}
+
+HRESULT FromVariant(Variant &raw, long &out) {
+  VARIANT &v = raw.Raw();
+  if (v.vt != VT_I4) {
+    HRESULT hr = VariantChangeType(&v, &v, 0, VT_I4);
+    if (FAILED(hr))
+      return hr;
+  }
+  out = v.lVal;
+  return S_OK;
+}
+
+} // namespace Com
+} // namespace MCPHelper
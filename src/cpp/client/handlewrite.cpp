@@ -9,109 +9,34 @@ void MCPClient::Write(const wstring &response) {
     return;
   }
 
-  // Get ActiveDocument property from Word Application
-  DISPID dispid;
-  OLECHAR *szMember = (OLECHAR *)L"ActiveDocument";
-  HRESULT hr = s_pWordApp->GetIDsOfNames(IID_NULL, &szMember, 1,
-                                         LOCALE_USER_DEFAULT, &dispid);
-
-  if (FAILED(hr)) {
-    MSGBOX_ERROR(L"No active document to write to");
-    return;
+  // A single large write gets the same relayout suppression as a response
+  unique_ptr<BulkWriteScope> scope;
+  if (useBulkWrite && !bulkWrite && response.size() >= BULK_WRITE_MIN_CHARS) {
+    scope.reset(new BulkWriteScope(s_pWordApp, bulkWriteRefreshInterval));
   }
 
-  DISPPARAMS dp = {NULL, NULL, 0, 0};
-  VARIANT docResult;
-  VariantInit(&docResult);
-
-  hr = s_pWordApp->Invoke(dispid, IID_NULL, LOCALE_USER_DEFAULT,
-                          DISPATCH_PROPERTYGET, &dp, &docResult, NULL, NULL);
-
-  if (FAILED(hr) || docResult.vt != VT_DISPATCH || !docResult.pdispVal) {
-    VariantClear(&docResult);
+  Com::Object<Com::Application> app(s_pWordApp);
+  Com::Object<Com::Document> doc;
+  if (FAILED(app.Get(L"ActiveDocument", doc))) {
     MSGBOX_ERROR(L"Failed to get active document");
     return;
   }
 
-  IDispatch *pDoc = docResult.pdispVal;
-
-  // Get Content property (returns Range)
-  szMember = (OLECHAR *)L"Content";
-  hr =
-      pDoc->GetIDsOfNames(IID_NULL, &szMember, 1, LOCALE_USER_DEFAULT, &dispid);
-
-  if (FAILED(hr)) {
-    pDoc->Release();
-    MSGBOX_ERROR(L"Failed to get Content property");
-    return;
-  }
-
-  VARIANT contentResult;
-  VariantInit(&contentResult);
-  hr = pDoc->Invoke(dispid, IID_NULL, LOCALE_USER_DEFAULT, DISPATCH_PROPERTYGET,
-                    &dp, &contentResult, NULL, NULL);
-
-  if (FAILED(hr) || contentResult.vt != VT_DISPATCH ||
-      !contentResult.pdispVal) {
-    VariantClear(&contentResult);
-    pDoc->Release();
+  // Content returns the whole-document Range
+  Com::Object<Com::Range> range;
+  if (FAILED(doc.Get(L"Content", range))) {
     MSGBOX_ERROR(L"Failed to get document content range");
     return;
   }
 
-  IDispatch *pRange = contentResult.pdispVal;
-
   // Call InsertAfter method on the Range to insert text at end
-  szMember = (OLECHAR *)L"InsertAfter";
-  hr = pRange->GetIDsOfNames(IID_NULL, &szMember, 1, LOCALE_USER_DEFAULT,
-                             &dispid);
-
-  if (FAILED(hr)) {
-    pRange->Release();
-    pDoc->Release();
-    MSGBOX_ERROR(L"Failed to get InsertAfter method");
-    return;
-  }
-
-  // Create BSTR from wstring
-  BSTR bstrText = SysAllocString(response.c_str());
-  if (!bstrText) {
-    pRange->Release();
-    pDoc->Release();
-    MSGBOX_ERROR(L"Failed to allocate string");
-    return;
-  }
-
-  VARIANT textArg;
-  VariantInit(&textArg);
-  textArg.vt = VT_BSTR;
-  textArg.bstrVal = bstrText;
-
-  // Set up DISPPARAMS for InsertAfter call
-  DISPPARAMS insertParams;
-  insertParams.rgvarg = &textArg;
-  insertParams.rgdispidNamedArgs = NULL;
-  insertParams.cArgs = 1;
-  insertParams.cNamedArgs = 0;
-
-  VARIANT vResult;
-  VariantInit(&vResult);
-
-  hr = pRange->Invoke(dispid, IID_NULL, LOCALE_USER_DEFAULT, DISPATCH_METHOD,
-                      &insertParams, &vResult, NULL, NULL);
-
-  SysFreeString(bstrText);
-  VariantClear(&vResult);
-  pRange->Release();
-  pDoc->Release();
-
-  if (FAILED(hr)) {
+  if (FAILED(range.Call(L"InsertAfter", response))) {
     MSGBOX_ERROR(L"Failed to insert text into document");
     return;
   }
 }
 
-// Initialize streaming context (call once before streaming)
+// Initialize streaming context (call once per response)
 MCPClient::StreamContext MCPClient::InitStreamContext() {
   StreamContext ctx;
 
@@ -119,196 +44,371 @@ MCPClient::StreamContext MCPClient::InitStreamContext() {
     return ctx;
   }
 
-  // Get ActiveDocument
-  DISPID dispid;
-  OLECHAR *szMember = (OLECHAR *)L"ActiveDocument";
-  HRESULT hr = s_pWordApp->GetIDsOfNames(IID_NULL, &szMember, 1,
-                                         LOCALE_USER_DEFAULT, &dispid);
-  if (FAILED(hr))
-    return ctx;
+  Com::Object<Com::Application> app(s_pWordApp);
+  if (FAILED(app.Get(L"ActiveDocument", ctx.doc)) ||
+      FAILED(ctx.doc.Get(L"Content", ctx.range))) {
+    return StreamContext();
+  }
 
-  DISPPARAMS dp = {NULL, NULL, 0, 0};
-  VARIANT docResult;
-  VariantInit(&docResult);
+  ctx.isValid = true;
+  return ctx;
+}
 
-  hr = s_pWordApp->Invoke(dispid, IID_NULL, LOCALE_USER_DEFAULT,
-                          DISPATCH_PROPERTYGET, &dp, &docResult, NULL, NULL);
-  if (FAILED(hr))
-    return ctx;
+// Write using cached context (much faster)
+HRESULT MCPClient::WriteWithContext(StreamContext &ctx, const wstring &text) {
+  if (!ctx.isValid)
+    return E_UNEXPECTED;
 
-  ctx.pDoc = docResult.pdispVal;
+  return ctx.range.Call(L"InsertAfter", text);
+}
 
-  // Get Content Range
-  szMember = (OLECHAR *)L"Content";
-  hr = ctx.pDoc->GetIDsOfNames(IID_NULL, &szMember, 1, LOCALE_USER_DEFAULT,
-                               &dispid);
-  if (FAILED(hr)) {
-    ctx.pDoc->Release();
-    return ctx;
-  }
+// Cleanup context
+void MCPClient::CleanupStreamContext(StreamContext &ctx) {
+  ctx = StreamContext();
+}
 
-  VARIANT contentResult;
-  VariantInit(&contentResult);
-  hr = ctx.pDoc->Invoke(dispid, IID_NULL, LOCALE_USER_DEFAULT,
-                        DISPATCH_PROPERTYGET, &dp, &contentResult, NULL, NULL);
-  if (FAILED(hr)) {
-    ctx.pDoc->Release();
-    return ctx;
+// Pin the stream context for the lifetime of one response
+void MCPClient::BeginDocumentWrite() {
+  isDocumentWriteOpen = true;
+  if (useBulkWrite && s_pWordApp && !bulkWrite) {
+    bulkWrite.reset(new BulkWriteScope(s_pWordApp, bulkWriteRefreshInterval));
   }
+  formatPlanner.Reset();
+  bodyFontName.clear();
+  Com::ResetDispatchStats();
+  EnsureStreamContext();
+}
 
-  ctx.pRange = contentResult.pdispVal;
+// Flush what is left and release the per-response context
+void MCPClient::EndDocumentWrite() {
+  FlushWrites(true);
+  isDocumentWriteOpen = false;
+  CleanupStreamContext(streamContext);
+  bulkWrite.reset(); // screen updating back on: Word repaints once
+}
 
-  // Cache InsertAfter DISPID
-  szMember = (OLECHAR *)L"InsertAfter";
-  hr = ctx.pRange->GetIDsOfNames(IID_NULL, &szMember, 1, LOCALE_USER_DEFAULT,
-                                 &ctx.insertAfterDispId);
-  if (FAILED(hr)) {
-    ctx.pRange->Release();
-    ctx.pDoc->Release();
-    return ctx;
+// Drop the response without writing what is pending (cancellation,
+// teardown, exceptions). No-op once EndDocumentWrite has run.
+void MCPClient::AbortDocumentWrite() {
+  if (isDocumentWriteOpen) {
+    isDocumentWriteOpen = false;
+    writeCoalescer.Discard();
+    CleanupStreamContext(streamContext);
   }
+  bulkWrite.reset();
+}
 
-  ctx.isValid = true;
-  return ctx;
+// Resolve ActiveDocument/Content/InsertAfter only if we have nothing valid
+bool MCPClient::EnsureStreamContext() {
+  if (!streamContext.isValid) {
+    streamContext = InitStreamContext();
+  }
+  return streamContext.isValid;
 }
 
-// Write using cached context (much faster)
-void MCPClient::WriteWithContext(StreamContext &ctx, const wstring &text) {
-  if (!ctx.isValid)
-    return;
+// One cached-DISPID property get per flush: is the document we resolved
+// still the active one? Closing or switching documents invalidates it.
+bool MCPClient::IsStreamContextCurrent() {
+  if (!streamContext.isValid || !s_pWordApp)
+    return false;
+
+  Com::Object<Com::Application> app(s_pWordApp);
+  Com::Object<Com::Document> active;
+  if (FAILED(app.Get(L"ActiveDocument", active)))
+    return false;
 
-  BSTR bstrText = SysAllocString(text.c_str());
-  if (!bstrText)
+  return active.IsSameObject(streamContext.doc);
+}
+
+// Queue text; the coalescer decides when it actually reaches the document
+void MCPClient::Stream(const wstring &message, uint16_t style,
+                       uint8_t headingLevel) {
+  if (message.empty())
     return;
 
-  VARIANT textArg;
-  VariantInit(&textArg);
-  textArg.vt = VT_BSTR;
-  textArg.bstrVal = bstrText;
+  writeCoalescer.Append(message, style, headingLevel);
+  FlushWrites(false);
+}
 
-  DISPPARAMS insertParams;
-  insertParams.rgvarg = &textArg;
-  insertParams.rgdispidNamedArgs = NULL;
-  insertParams.cArgs = 1;
-  insertParams.cNamedArgs = 0;
+// Write everything queued since the last flush with a single InsertAfter,
+// then format it range by range. Without `force` this only happens once the
+// pacing interval has elapsed. Returns true when text reached the document.
+bool MCPClient::FlushWrites(bool force) {
+  if (!force && !writeCoalescer.FlushDue())
+    return false;
+  if (!writeCoalescer.Take(flushBuffer, flushSpans))
+    return false;
+
+  if (!IsStreamContextCurrent()) {
+    CleanupStreamContext(streamContext);
+  }
 
-  VARIANT vResult;
-  VariantInit(&vResult);
+  if (!EnsureStreamContext()) {
+    MSGBOX_ERROR(L"Failed to initialize stream context");
+    return false;
+  }
 
-  ctx.pRange->Invoke(ctx.insertAfterDispId, IID_NULL, LOCALE_USER_DEFAULT,
-                     DISPATCH_METHOD, &insertParams, &vResult, NULL, NULL);
+  HRESULT hr = WriteWithContext(streamContext, flushBuffer);
+  if (FAILED(hr)) {
+    // Document closed between the check and the write: re-resolve once
+    CleanupStreamContext(streamContext);
+    if (EnsureStreamContext()) {
+      hr = WriteWithContext(streamContext, flushBuffer);
+    }
+    if (FAILED(hr)) {
+      DEBUG_LOG("InsertAfter failed: 0x%08lx", (unsigned long)hr);
+    }
+  }
 
-  SysFreeString(bstrText);
-  VariantClear(&vResult);
-}
+  if (SUCCEEDED(hr)) {
+    ApplyFormatting(flushBuffer.size());
+  }
 
-// Cleanup context
-void MCPClient::CleanupStreamContext(StreamContext &ctx) {
-  if (ctx.pRange)
-    ctx.pRange->Release();
-  if (ctx.pDoc)
-    ctx.pDoc->Release();
-  ctx.isValid = false;
+  if (bulkWrite) {
+    bulkWrite->MaybeRefresh();
+  }
+
+  // Outside a response the context is not pinned. Callers that still need
+  // it (FlushTable) run inside one.
+  if (!isDocumentWriteOpen) {
+    CleanupStreamContext(streamContext);
+  }
+  return SUCCEEDED(hr);
 }
 
-// Optimized Stream using context (FASTEST)
-void MCPClient::Stream(const wstring &message) {
-  if (message.empty())
+// One property get locates the inserted text; each op then costs a Range, an
+// optional Font and one property put.
+void MCPClient::ApplyFormatting(size_t insertedLength) {
+  formatPlanner.Plan(flushSpans, formatOps);
+  if (formatOps.empty())
     return;
 
-  StreamContext ctx = InitStreamContext();
-  if (!ctx.isValid) {
-    MSGBOX_ERROR(L"Failed to initialize stream context");
+  long base = 0;
+  if (!InsertedStart(insertedLength, base)) {
+    DEBUG_LOG("Formatting skipped: Content.End unavailable");
     return;
   }
 
-  const size_t CHUNK_SIZE = 50;
-  const DWORD DELAY_MS = 50;
-
-  wstring buffer;
-  buffer.reserve(CHUNK_SIZE);
+  for (const FormatOp &op : formatOps) {
+    ApplyFormatOp(base, op);
+  }
+}
 
-  for (size_t i = 0; i < message.length(); i++) {
-    buffer += message[i];
+// InsertAfter on Document.Content puts the text in front of the document's
+// final paragraph mark, so it ends one character before Content.End
+bool MCPClient::InsertedStart(size_t insertedLength, long &start) {
+  long end = 0;
+  if (FAILED(streamContext.range.Get(L"End", end)))
+    return false;
+  start = end - 1 - (long)insertedLength;
+  return true;
+}
 
-    if (buffer.length() >= CHUNK_SIZE || i == message.length() - 1) {
-      WriteWithContext(ctx, buffer);
-      buffer.clear();
+void MCPClient::ApplyFormatOp(long base, const FormatOp &op) {
+  Com::Object<Com::Range> target;
+  HRESULT hr = streamContext.doc.CallFor(L"Range", target, base + (long)op.start,
+                                         base + (long)op.end);
+  if (FAILED(hr))
+    return;
 
-      if (i < message.length() - 1) {
-        Sleep(DELAY_MS);
+  if (op.attribute == FormatAttribute::ParagraphStyle) {
+    hr = target.Put(L"Style", op.value);
+  } else {
+    Com::Object<Com::Font> font;
+    hr = target.Get(L"Font", font);
+    if (SUCCEEDED(hr)) {
+      switch (op.attribute) {
+      case FormatAttribute::Bold:
+        hr = font.Put(L"Bold", op.value != 0);
+        break;
+      case FormatAttribute::Italic:
+        hr = font.Put(L"Italic", op.value != 0);
+        break;
+      case FormatAttribute::Underline:
+        // wdUnderlineSingle / wdUnderlineNone
+        hr = font.Put(L"Underline", op.value ? 1L : 0L);
+        break;
+      case FormatAttribute::Code:
+        if (op.value) {
+          if (bodyFontName.empty())
+            font.Get(L"Name", bodyFontName);
+          hr = font.Put(L"Name", L"Consolas");
+        } else if (!bodyFontName.empty()) {
+          hr = font.Put(L"Name", bodyFontName);
+        }
+        break;
+      default:
+        break;
       }
     }
   }
 
-  CleanupStreamContext(ctx);
+  if (FAILED(hr)) {
+    DEBUG_LOG("Formatting op %d failed: 0x%08lx", (int)op.attribute,
+              (unsigned long)hr);
+  }
 }
 
-// Alternative: Stream by words (more natural)
-void MCPClient::StreamByWords(const wstring &message) {
-  if (!s_pWordApp) {
-    MSGBOX_ERROR(L"No Word Application available");
+void MCPClient::WriteCompleteResponse(const char *markdownText,
+                                      size_t length) {
+  // Anything streamed before this lands first
+  FinishMarkdown();
+  FlushWrites(true);
+
+  if (useWordML && InsertWordML(markdownText, length))
     return;
+
+  ProcessStreamChunk(markdownText, length);
+  FinishMarkdown();
+}
+
+// Renders the whole Markdown answer as WordprocessingML and inserts it at the
+// end of the document with a single Range.InsertXML, formatting included
+bool MCPClient::InsertWordML(const char *markdownText, size_t length) {
+  if (length == 0 || !EnsureStreamContext())
+    return false;
+
+  long end = 0;
+  if (FAILED(streamContext.range.Get(L"End", end)))
+    return false;
+
+  // In front of the final paragraph mark, which cannot be written past
+  Com::Object<Com::Range> target;
+  HRESULT hr = streamContext.doc.CallFor(L"Range", target, end - 1, end - 1);
+  if (SUCCEEDED(hr)) {
+    string xml = WordMLWriter::Render(markdownText, length);
+    hr = target.Call(L"InsertXML", StringToWstring(xml));
+    DEBUG_LOG("InsertXML: %zu bytes Markdown -> %zu bytes XML, hr=0x%08lx",
+              length, xml.size(), (unsigned long)hr);
   }
+  return SUCCEEDED(hr);
+}
 
-  if (message.empty()) {
+// The rows go out as tab-delimited text in the same InsertAfter as whatever
+// text preceded them, and one ConvertToTable turns them into a table. Header
+// formatting and column alignment then cost a fixed number of calls per table
+// or per aligned column, never per row or cell.
+void MCPClient::FlushTable() {
+  tableBuilder.Finish();
+
+  if (!tableBuilder.IsTable()) {
+    // No separator row: not a table, write the lines as they came
+    string raw = tableBuilder.RawText();
+    tableBuilder.Reset();
+    StreamUtf8(raw.data(), raw.size(), MD_PLAIN, 0);
     return;
   }
 
-  wstringstream ss(message);
-  wstring word;
-  wstring buffer;
-  const size_t WORDS_PER_CHUNK = 5;
-  size_t wordCount = 0;
-
-  while (ss >> word) {
-    buffer += word + L" ";
-    wordCount++;
-
-    if (wordCount >= WORDS_PER_CHUNK) {
-      Write(buffer);
-      buffer.clear();
-      wordCount = 0;
-      Sleep(100); // Shorter delay for word-based streaming
-    }
-  }
+  wstring cells = StringToWstring(tableBuilder.ToTabDelimited());
+  long rowCount = (long)tableBuilder.Rows().size();
+  long columnCount = (long)tableBuilder.ColumnCount();
+  vector<ColumnAlignment> alignments = tableBuilder.Alignments();
+  tableBuilder.Reset();
+
+  Stream(cells);
+  if (!FlushWrites(true) || !streamContext.isValid)
+    return;
 
-  // Write remaining buffer
-  if (!buffer.empty()) {
-    Write(buffer);
+  long start = 0;
+  if (!InsertedStart(cells.size(), start))
+    return;
+
+  Com::Object<Com::Range> target;
+  Com::Object<Com::Table> table;
+  HRESULT hr = streamContext.doc.CallFor(L"Range", target, start,
+                                         start + (long)cells.size());
+  if (SUCCEEDED(hr)) {
+    // wdSeparateByTabs
+    hr = target.CallFor(L"ConvertToTable", table, 1L, rowCount, columnCount);
+  }
+  if (FAILED(hr)) {
+    DEBUG_LOG("ConvertToTable failed: 0x%08lx", (unsigned long)hr);
+    return;
   }
+
+  FormatTable(table, alignments);
 }
 
-// Alternative: Stream by lines (best for formatted text)
-void MCPClient::StreamByLines(const wstring &message) {
-  if (!s_pWordApp) {
-    MSGBOX_ERROR(L"No Word Application available");
-    return;
+void MCPClient::FormatTable(Com::Object<Com::Table> &table,
+                            const vector<ColumnAlignment> &alignments) {
+  Com::Object<Com::Borders> borders;
+  if (SUCCEEDED(table.Get(L"Borders", borders))) {
+    borders.Put(L"Enable", true);
   }
 
-  if (message.empty()) {
-    return;
+  // Header row: bold, repeated at the top of each page
+  Com::Object<Com::Rows> rows;
+  Com::Object<Com::Row> header;
+  if (SUCCEEDED(table.Get(L"Rows", rows)) &&
+      SUCCEEDED(rows.CallFor(L"Item", header, 1L))) {
+    header.Put(L"HeadingFormat", true);
+    Com::Object<Com::Range> headerRange;
+    Com::Object<Com::Font> font;
+    if (SUCCEEDED(header.Get(L"Range", headerRange)) &&
+        SUCCEEDED(headerRange.Get(L"Font", font))) {
+      font.Put(L"Bold", true);
+    }
   }
 
-  wstringstream ss(message);
-  wstring line;
+  bool needsAlignment = false;
+  for (ColumnAlignment alignment : alignments) {
+    if (alignment != ColumnAlignment::Left)
+      needsAlignment = true;
+  }
+  if (!needsAlignment || !s_pWordApp)
+    return;
 
-  while (getline(ss, line)) {
-    line += L"\n"; // Preserve newline
-    Write(line);
-    Sleep(100); // Delay between lines
+  // Columns have no Range, so alignment goes through the selection, which
+  // is put back afterwards
+  Com::Object<Com::Application> app(s_pWordApp);
+  Com::Object<Com::Selection> selection;
+  Com::Object<Com::Range> userSelection;
+  Com::Object<Com::Columns> columns;
+  if (FAILED(app.Get(L"Selection", selection)) ||
+      FAILED(selection.Get(L"Range", userSelection)) ||
+      FAILED(table.Get(L"Columns", columns))) {
+    return;
   }
-}
 
-vector<wstring> MCPClient::SplitIntoChunks(const wstring &text,
-                                           size_t chunkSize) {
-  vector<wstring> chunks;
+  for (size_t index = 0; index < alignments.size(); index++) {
+    if (alignments[index] == ColumnAlignment::Left)
+      continue;
 
-  for (size_t i = 0; i < text.length(); i += chunkSize) {
-    chunks.push_back(text.substr(i, min(chunkSize, text.length() - i)));
+    Com::Object<Com::Column> column;
+    Com::Object<Com::ParagraphFormat> format;
+    if (FAILED(columns.CallFor(L"Item", column, (long)(index + 1))) ||
+        FAILED(column.Call(L"Select")) ||
+        FAILED(selection.Get(L"ParagraphFormat", format))) {
+      continue;
+    }
+    // wdAlignParagraphCenter / wdAlignParagraphRight
+    format.Put(L"Alignment",
+               alignments[index] == ColumnAlignment::Center ? 1L : 2L);
   }
 
-  return chunks;
+  userSelection.Call(L"Select");
+}
+
+// Log how many InsertAfter calls coalescing saved for this response, and
+// what the object-model traffic behind them cost
+void MCPClient::ReportWriteStats() {
+  const WriteCoalescer::Stats &stats = writeCoalescer.GetStats();
+  DEBUG_LOG("Writer: %zu fragments, %zu chars in %zu InsertAfter calls "
+            "(%zu COM calls saved)",
+            stats.fragments, stats.characters, stats.flushes, stats.Saved());
+
+  // Everything the response cost in object-model calls: inserts, context
+  // checks and formatting
+  Com::DispatchStats dispatch = Com::GetDispatchStats();
+  double kilobytes = stats.characters / 1024.0;
+  DEBUG_LOG("Dispatch: %zu Invoke calls (%.1f us avg, %.1f per KB), "
+            "%zu name lookups, %zu cache hits",
+            dispatch.invokes,
+            dispatch.invokes ? dispatch.invokeMicros / dispatch.invokes : 0.0,
+            kilobytes > 0 ? dispatch.invokes / kilobytes : 0.0,
+            dispatch.nameLookups, dispatch.cacheHits);
+  Com::ResetDispatchStats();
+  writeCoalescer.ResetStats();
 }
 
 } // namespace MCPHelper
\ No newline at end of file
@@ -0,0 +1,234 @@
+// Cases for RequestDispatcher and PeekRequestId: ids as strings of digits,
+// bare numbers and missing or malformed ones, an "id" inside a value that
+// is not the message's own, routing of interleaved replies, cancelling a
+// request while its handler runs on the receive thread, and the
+// Expect/timeout/Cancel sequence SendRequest uses. Run with `zig build test`.
+#include "client/requestdispatcher.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace MCPHelper;
+
+namespace {
+
+int failures = 0;
+
+void Check(bool condition, const char *name, const char *what) {
+  if (condition)
+    return;
+  std::fprintf(stderr, "FAIL: %s: %s\n", name, what);
+  failures++;
+}
+
+void ExpectId(const std::string &message, uint64_t expected) {
+  uint64_t id = 0;
+  if (!PeekRequestId(message.data(), message.size(), id)) {
+    std::fprintf(stderr, "FAIL: no id in %s\n", message.c_str());
+    failures++;
+  } else if (id != expected) {
+    std::fprintf(stderr, "FAIL: id %llu, expected %llu in %s\n",
+                 (unsigned long long)id, (unsigned long long)expected,
+                 message.c_str());
+    failures++;
+  }
+}
+
+void ExpectNoId(const std::string &message) {
+  uint64_t id = 0;
+  if (PeekRequestId(message.data(), message.size(), id)) {
+    std::fprintf(stderr, "FAIL: id %llu read from %s\n",
+                 (unsigned long long)id, message.c_str());
+    failures++;
+  }
+}
+
+void PeekCases() {
+  ExpectId("{\"id\":\"42\",\"status\":\"streaming\"}", 42);
+  ExpectId("{\"id\":7}", 7);
+  ExpectId(" \r\n{ \"id\" : \"0\" }", 0);
+  ExpectId("{\"id\":\"18446744073709551615\"}", UINT64_MAX);
+
+  // Only the top-level key counts, wherever it is
+  ExpectId("{\"status\":\"streaming\",\"content\":\"{\\\"id\\\":\\\"9\\\"}\","
+           "\"id\":\"5\"}",
+           5);
+  ExpectId("{\"data\":[{\"id\":1},{\"id\":2}],\"meta\":{\"id\":\"3\"},"
+           "\"id\":\"4\"}",
+           4);
+  ExpectId("{\"idx\":\"1\",\"i\":2,\"id\":\"3\"}", 3);
+  ExpectId("{\"success\":true,\"n\":-1.5e3,\"x\":null,\"id\":8}", 8);
+
+  ExpectNoId("{\"status\":\"complete\"}");
+  ExpectNoId("{\"content\":\"\\\"id\\\":\\\"9\\\"\"}");
+  ExpectNoId("{\"meta\":{\"id\":\"3\"}}");
+  ExpectNoId("{\"id\":\"abc\"}");
+  ExpectNoId("{\"id\":\"\"}");
+  ExpectNoId("{\"id\":\"12x\"}");
+  ExpectNoId("{\"id\":\"12");
+  ExpectNoId("{\"id\":null}");
+  ExpectNoId("{\"id\":-1}");
+  ExpectNoId("{\"id\":\"18446744073709551616\"}");
+  ExpectNoId("[{\"id\":1}]");
+  ExpectNoId("{\"status\":\"x\" \"id\":1}");
+  ExpectNoId("");
+}
+
+std::string Reply(uint64_t id, const char *status) {
+  return "{\"id\":\"" + std::to_string(id) + "\",\"status\":\"" + status + "\"}";
+}
+
+bool Dispatch(RequestDispatcher &dispatcher, const std::string &message) {
+  return dispatcher.Dispatch(message.data(), message.size());
+}
+
+// Replies of two requests interleaved reach their own handler, in order,
+// and the route goes once its handler says the last one came
+void RoutingCases() {
+  RequestDispatcher dispatcher;
+  uint64_t stream = dispatcher.NextId();
+  uint64_t health = dispatcher.NextId();
+  Check(stream != health, "routing", "ids repeat");
+
+  std::vector<std::string> streamSeen;
+  dispatcher.Register(stream, [&](const char *message, size_t length) {
+    std::string text(message, length);
+    streamSeen.push_back(text);
+    return text.find("complete") != std::string::npos;
+  });
+  std::future<std::string> reply = dispatcher.Expect(health);
+
+  Check(Dispatch(dispatcher, Reply(stream, "streaming")), "routing",
+        "first chunk not routed");
+  Check(Dispatch(dispatcher, Reply(health, "ok")), "routing",
+        "health reply not routed");
+  Check(Dispatch(dispatcher, Reply(stream, "streaming")), "routing",
+        "second chunk not routed");
+  Check(dispatcher.Pending() == 1, "routing", "answered request kept");
+  Check(Dispatch(dispatcher, Reply(stream, "complete")), "routing",
+        "last chunk not routed");
+  Check(dispatcher.Pending() == 0, "routing", "finished request kept");
+
+  Check(streamSeen.size() == 3 && streamSeen[2] == Reply(stream, "complete"),
+        "routing", "stream handler saw the wrong messages");
+  Check(reply.wait_for(std::chrono::seconds(0)) == std::future_status::ready &&
+            reply.get() == Reply(health, "ok"),
+        "routing", "health future not fulfilled");
+
+  // Finished, unknown or id-less messages go nowhere
+  Check(!Dispatch(dispatcher, Reply(stream, "streaming")), "routing",
+        "message after the last one routed");
+  Check(!Dispatch(dispatcher, Reply(999, "ok")), "routing",
+        "unknown id routed");
+  Check(!Dispatch(dispatcher, "{\"status\":\"ok\"}"), "routing",
+        "message without id routed");
+}
+
+// Cancel from another thread while the handler is running: Cancel waits
+// for it, and the handler never runs again
+void CancelInFlightCases() {
+  RequestDispatcher dispatcher;
+  uint64_t id = dispatcher.NextId();
+
+  std::mutex mutex;
+  std::condition_variable changed;
+  bool entered = false, release = false;
+  int calls = 0;
+  dispatcher.Register(id, [&](const char *, size_t) {
+    std::unique_lock<std::mutex> lock(mutex);
+    calls++;
+    entered = true;
+    changed.notify_all();
+    changed.wait(lock, [&] { return release; });
+    return false;
+  });
+
+  std::thread receiver([&] { Dispatch(dispatcher, Reply(id, "streaming")); });
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [&] { return entered; });
+  }
+
+  std::atomic<bool> cancelled{false};
+  std::thread canceller([&] {
+    dispatcher.Cancel(id);
+    cancelled = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  Check(!cancelled, "cancel in flight", "Cancel returned while the handler ran");
+  Check(dispatcher.Pending() == 0, "cancel in flight",
+        "cancelled request still listed");
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    release = true;
+  }
+  changed.notify_all();
+  receiver.join();
+  canceller.join();
+  Check(cancelled, "cancel in flight", "Cancel never returned");
+
+  Check(!Dispatch(dispatcher, Reply(id, "streaming")), "cancel in flight",
+        "message after Cancel routed");
+  Check(calls == 1, "cancel in flight", "handler ran again after Cancel");
+}
+
+// SendRequest's sequence: no reply in time, Cancel, and the late reply is
+// dropped rather than fulfilling the abandoned future or another request's
+void TimeoutCases() {
+  RequestDispatcher dispatcher;
+  uint64_t late = dispatcher.NextId();
+  std::future<std::string> reply = dispatcher.Expect(late);
+  Check(reply.wait_for(std::chrono::milliseconds(20)) ==
+            std::future_status::timeout,
+        "timeout", "future ready without a reply");
+  dispatcher.Cancel(late);
+
+  uint64_t next = dispatcher.NextId();
+  std::future<std::string> nextReply = dispatcher.Expect(next);
+  Check(!Dispatch(dispatcher, Reply(late, "ok")), "timeout",
+        "late reply routed");
+  Check(nextReply.wait_for(std::chrono::seconds(0)) ==
+            std::future_status::timeout,
+        "timeout", "late reply fulfilled the next request");
+  Check(Dispatch(dispatcher, Reply(next, "ok")), "timeout",
+        "next reply not routed");
+  Check(nextReply.get() == Reply(next, "ok"), "timeout",
+        "next reply garbled");
+
+  // A lost connection answers whatever is pending with an empty reply,
+  // and requests are refused until the next session
+  std::future<std::string> lost = dispatcher.Expect(dispatcher.NextId());
+  dispatcher.Close();
+  Check(lost.wait_for(std::chrono::seconds(0)) == std::future_status::ready &&
+            lost.get().empty(),
+        "timeout", "pending request not told of the lost connection");
+  Check(!dispatcher.Register(dispatcher.NextId(),
+                             [](const char *, size_t) { return true; }),
+        "timeout", "request accepted on a closed session");
+  dispatcher.Open();
+  Check(dispatcher.Register(dispatcher.NextId(),
+                            [](const char *, size_t) { return true; }),
+        "timeout", "request refused after Open");
+}
+
+} // namespace
+
+int main() {
+  PeekCases();
+  RoutingCases();
+  CancelInFlightCases();
+  TimeoutCases();
+
+  if (failures > 0) {
+    std::fprintf(stderr, "%d failure(s)\n", failures);
+    return 1;
+  }
+  std::printf("dispatcher test: OK\n");
+  return 0;
+}
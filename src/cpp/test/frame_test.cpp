@@ -0,0 +1,285 @@
+// Differential fuzz for StreamFrameScanner: whenever the scanner accepts a
+// frame, its event must be exactly the one the full nlohmann parser
+// (DecodeStreamEventDom) produces, and anything the full parser rejects
+// must be rejected. Generated frames mix the keys the client knows with
+// others, and values with every kind of escape, surrogate, malformed UTF-8,
+// bad number, nesting, duplicate or escaped key and trailing byte; a share
+// of them are then mutated byte by byte. Run with `zig build test`, or pass
+// an iteration count and seed: `frame-test 6000000 42`.
+#include "client/streamdecoder.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+using namespace MCPHelper;
+
+namespace {
+
+int failures = 0;
+
+std::string Printable(const std::string &frame) {
+  std::string out;
+  char buffer[8];
+  for (unsigned char c : frame) {
+    if (c >= 0x20 && c < 0x7F && c != '\\') {
+      out += (char)c;
+    } else {
+      std::snprintf(buffer, sizeof(buffer), "\\x%02X", c);
+      out += buffer;
+    }
+  }
+  return out;
+}
+
+const char *KindName(StreamEventKind kind) {
+  switch (kind) {
+  case StreamEventKind::Ignored:
+    return "ignored";
+  case StreamEventKind::Chunk:
+    return "chunk";
+  case StreamEventKind::Complete:
+    return "complete";
+  case StreamEventKind::Cancelled:
+    return "cancelled";
+  case StreamEventKind::Error:
+    return "error";
+  case StreamEventKind::Response:
+    return "response";
+  }
+  return "?";
+}
+
+// Returns whether the scanner accepted the frame
+bool Compare(const std::string &frame, RequestArena &arena) {
+  arena.Reset();
+  StreamEvent fast;
+  bool accepted =
+      StreamFrameScanner::TryDecode(frame.data(), frame.size(), arena, fast);
+  if (!accepted)
+    return false;
+
+  if (!nlohmann::json::accept(frame)) {
+    std::fprintf(stderr, "FAIL: scanner accepted what the parser rejects\n"
+                         "  frame: %s\n",
+                 Printable(frame).c_str());
+    failures++;
+    return true;
+  }
+  StreamEvent full = DecodeStreamEventDom(frame.data(), frame.size(), arena);
+  if (fast.kind != full.kind || fast.content != full.content) {
+    std::fprintf(stderr,
+                 "FAIL: decoders disagree\n  frame:   %s\n"
+                 "  scanner: %s \"%s\"\n  parser:  %s \"%s\"\n",
+                 Printable(frame).c_str(), KindName(fast.kind),
+                 Printable(std::string(fast.content)).c_str(),
+                 KindName(full.kind),
+                 Printable(std::string(full.content)).c_str());
+    failures++;
+  }
+  return true;
+}
+
+// Frames the scanner must decode itself, not hand to the full parser
+void ExpectAccepted(const std::string &frame, RequestArena &arena) {
+  if (!Compare(frame, arena)) {
+    std::fprintf(stderr, "FAIL: scanner rejected %s\n",
+                 Printable(frame).c_str());
+    failures++;
+  }
+}
+
+// Frames the scanner must leave to the full parser
+void ExpectRejected(const std::string &frame, RequestArena &arena) {
+  if (Compare(frame, arena)) {
+    std::fprintf(stderr, "FAIL: scanner accepted %s\n",
+                 Printable(frame).c_str());
+    failures++;
+  }
+}
+
+void KnownFrames(RequestArena &arena) {
+  ExpectAccepted("{\"id\":\"r1\",\"status\":\"streaming\",\"content\":\"Hi\"}",
+                 arena);
+  ExpectAccepted("{\"id\":\"r1\",\"status\":\"complete\"}", arena);
+  ExpectAccepted("{\"id\":\"r1\",\"status\":\"complete\",\"cached\":true}",
+                 arena);
+  ExpectAccepted("{\"status\":\"cancelled\"}", arena);
+  ExpectAccepted("{\"status\":\"error\",\"content\":\"boom\"}", arena);
+  ExpectAccepted("{\"status\":\"error\"}", arena);
+  ExpectAccepted("{\"status\":\"unknown\"}", arena);
+  ExpectAccepted("{\"success\":true,\"content\":\"all\"}", arena);
+  ExpectAccepted("{\"success\":false,\"error\":\"nope\"}", arena);
+  ExpectAccepted("{\"success\":false}", arena);
+  ExpectAccepted("{}", arena);
+  ExpectAccepted(" \t\r\n{ \"status\" : \"streaming\" , \"content\" : \"x\" } \n",
+                 arena);
+  ExpectAccepted("{\"status\":\"streaming\",\"content\":"
+                 "\"q\\\" b\\\\ s\\/ \\b\\f\\n\\r\\t \\u00e9\\u20AC "
+                 "\\ud83d\\ude00 \xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80\"}",
+                 arena);
+  ExpectAccepted("{\"status\":\"streaming\",\"n\":-0.5e+10,\"content\":\"x\"}",
+                 arena);
+
+  // Duplicate known keys: the full parser's last-one-wins decides
+  ExpectRejected("{\"status\":\"complete\",\"status\":\"streaming\"}", arena);
+  // A key spelled with an escape may be a known one
+  ExpectRejected("{\"st\\u0061tus\":\"complete\"}", arena);
+  ExpectRejected("{\"status\":\"compl\\u0065te\"}", arena);
+  // Nested values
+  ExpectRejected("{\"status\":\"complete\",\"usage\":{\"tokens\":3}}", arena);
+  ExpectRejected("{\"status\":\"complete\",\"list\":[1]}", arena);
+  // Wrong types under known keys
+  ExpectRejected("{\"status\":1}", arena);
+  ExpectRejected("{\"status\":\"streaming\",\"content\":null}", arena);
+  ExpectRejected("{\"success\":\"yes\"}", arena);
+  // Lone and reversed surrogates
+  ExpectRejected("{\"status\":\"streaming\",\"content\":\"\\ud83d\"}", arena);
+  ExpectRejected("{\"status\":\"streaming\",\"content\":\"\\ude00\"}", arena);
+  ExpectRejected("{\"status\":\"streaming\",\"content\":\"\\ud83d\\u0041\"}",
+                 arena);
+  // Invalid UTF-8: overlong, encoded surrogate, above U+10FFFF, truncated
+  ExpectRejected("{\"content\":\"\xC0\xAF\"}", arena);
+  ExpectRejected("{\"content\":\"\xED\xA0\x80\"}", arena);
+  ExpectRejected("{\"content\":\"\xF4\x90\x80\x80\"}", arena);
+  ExpectRejected("{\"content\":\"\xE2\x82\"}", arena);
+  ExpectRejected("{\"content\":\"\xFF\"}", arena);
+  // Control byte, bad escape, bad numbers
+  ExpectRejected("{\"content\":\"a\nb\"}", arena);
+  ExpectRejected("{\"content\":\"\\x41\"}", arena);
+  ExpectRejected("{\"n\":01}", arena);
+  ExpectRejected("{\"n\":1.}", arena);
+  ExpectRejected("{\"n\":-}", arena);
+  // Trailing bytes and truncation
+  ExpectRejected("{\"status\":\"complete\"}x", arena);
+  ExpectRejected("{\"status\":\"complete\"}{}", arena);
+  ExpectRejected("{\"status\":\"complete\",}", arena);
+  ExpectRejected("{\"status\":\"complete\"", arena);
+  ExpectRejected("", arena);
+}
+
+const char *const KEYS[] = {"status",  "content", "error",   "success",
+                            "id",      "cached",  "model",   "st\\u0061tus",
+                            "content\\u0000", "",  "\xC3\xA9", "Status"};
+
+const char *const STATUSES[] = {"streaming", "complete", "cancelled",
+                                "error",     "unknown",  "Streaming",
+                                "compl\\u0065te", ""};
+
+const char *const STRING_PIECES[] = {
+    "a", "word ", "\\\"", "\\\\", "\\/", "\\b", "\\f", "\\n", "\\r", "\\t",
+    "\\u0041", "\\u00e9", "\\u20AC", "\\uFFFF", "\\u0000",
+    "\\ud83d\\ude00", "\\uD83D\\uDE00",
+    // Lone, reversed and half-written surrogates
+    "\\ud83d", "\\ude00", "\\ud83d\\u0041", "\\ud83d\\n", "\\ud83d\\ud83d",
+    // Bad escapes
+    "\\x41", "\\u12", "\\uZZZZ", "\\", "\\'",
+    // Well-formed UTF-8
+    "\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80", "\xEF\xBF\xBD",
+    "\xF4\x8F\xBF\xBF",
+    // Malformed UTF-8
+    "\x80", "\xC3", "\xC0\xAF", "\xC1\xBF", "\xE0\x80\x80", "\xED\xA0\x80",
+    "\xE2\x82", "\xF0\x80\x80\x80", "\xF4\x90\x80\x80", "\xF5\x80\x80\x80",
+    "\xFF",
+    // Raw control bytes
+    "\n", "\t", "\x01", "\x7F"};
+
+const char *const OTHER_VALUES[] = {
+    "true", "false", "null", "0", "-0", "12", "-3.25", "1e5", "2E-3", "0.5e+1",
+    // Malformed
+    "01", "1.", ".5", "-", "1e", "+1", "tru", "nul", "True", "NaN",
+    // Nested
+    "{}", "[]", "{\"a\":1}", "[\"status\"]", "{\"status\":\"complete\"}"};
+
+const char *const SPACES[] = {"", "", "", " ", "\n", "\t", "\r\n  "};
+
+const char *const TRAILERS[] = {"", "", "", "", " ", "\n", "x", "}", ",",
+                                "{}", "\x00", "\xC3"};
+
+template <size_t N> const char *Pick(const char *const (&list)[N],
+                                     std::mt19937 &rng) {
+  return list[rng() % N];
+}
+
+std::string RandomString(std::mt19937 &rng) {
+  std::string out = "\"";
+  size_t pieces = rng() % 6;
+  for (size_t n = 0; n < pieces; n++)
+    out += Pick(STRING_PIECES, rng);
+  return out + "\"";
+}
+
+std::string RandomValue(const std::string &key, std::mt19937 &rng) {
+  unsigned choice = rng() % 10;
+  if (key == "status" && choice < 6)
+    return std::string("\"") + Pick(STATUSES, rng) + "\"";
+  if (key == "success" && choice < 6)
+    return choice % 2 ? "true" : "false";
+  if (choice < 7)
+    return RandomString(rng);
+  return Pick(OTHER_VALUES, rng);
+}
+
+std::string RandomFrame(std::mt19937 &rng) {
+  std::string frame = Pick(SPACES, rng);
+  frame += '{';
+  size_t members = rng() % 5;
+  for (size_t n = 0; n < members; n++) {
+    if (n > 0)
+      frame += ',';
+    std::string key = Pick(KEYS, rng);
+    frame += Pick(SPACES, rng);
+    frame += "\"" + key + "\"";
+    frame += Pick(SPACES, rng);
+    frame += ':';
+    frame += Pick(SPACES, rng);
+    frame += RandomValue(key, rng);
+    frame += Pick(SPACES, rng);
+  }
+  frame += '}';
+  frame += Pick(TRAILERS, rng);
+
+  // Flip, drop or insert a byte
+  if (rng() % 4 == 0 && !frame.empty()) {
+    size_t at = rng() % frame.size();
+    switch (rng() % 3) {
+    case 0:
+      frame[at] = (char)(rng() % 256);
+      break;
+    case 1:
+      frame.erase(at, 1);
+      break;
+    default:
+      frame.insert(at, 1, "\"\\{}:,u0"[rng() % 8]);
+      break;
+    }
+  }
+  return frame;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  long iterations = argc > 1 ? std::atol(argv[1]) : 200000;
+  unsigned seed = argc > 2 ? (unsigned)std::atol(argv[2]) : 1;
+
+  RequestArena arena;
+  KnownFrames(arena);
+
+  std::mt19937 rng(seed);
+  long accepted = 0;
+  for (long iteration = 0; iteration < iterations && failures < 10;
+       iteration++) {
+    if (Compare(RandomFrame(rng), arena))
+      accepted++;
+  }
+
+  if (failures > 0) {
+    std::fprintf(stderr, "%d failure(s)\n", failures);
+    return 1;
+  }
+  std::printf("frame test: %ld frames OK, %ld decoded by the scanner "
+              "(seed %u)\n",
+              iterations, accepted, seed);
+  return 0;
+}
@@ -0,0 +1,117 @@
+// Cases for HistoryDecoder: escaped quotes (the bug it was written for),
+// \uXXXX escapes and surrogate pairs, nested values inside a record,
+// non-string values under known keys, and malformed documents, which keep
+// the records completed before the error. Run with `zig build test`.
+#include "client/historydecoder.hpp"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace MCPHelper;
+
+namespace {
+
+int failures = 0;
+
+void Check(bool condition, const char *name, const char *what) {
+  if (condition)
+    return;
+  std::fprintf(stderr, "FAIL: %s: %s\n", name, what);
+  failures++;
+}
+
+void ExpectEntries(const char *name, const std::string &response,
+                   bool expectOk, const std::vector<HistoryEntry> &expected) {
+  std::vector<HistoryEntry> entries;
+  bool ok = HistoryDecoder::Decode(response, entries);
+  Check(ok == expectOk, name, expectOk ? "rejected" : "accepted");
+  if (entries.size() != expected.size()) {
+    std::fprintf(stderr, "FAIL: %s: %zu records, expected %zu\n", name,
+                 entries.size(), expected.size());
+    failures++;
+    return;
+  }
+  for (size_t i = 0; i < expected.size(); i++) {
+    const HistoryEntry &got = entries[i];
+    const HistoryEntry &want = expected[i];
+    if (got.message != want.message || got.timestamp != want.timestamp ||
+        got.role != want.role) {
+      std::fprintf(stderr,
+                   "FAIL: %s: record %zu\n  got  {%s | %s | %s}\n"
+                   "  want {%s | %s | %s}\n",
+                   name, i, got.message.c_str(), got.timestamp.c_str(),
+                   got.role.c_str(), want.message.c_str(),
+                   want.timestamp.c_str(), want.role.c_str());
+      failures++;
+    }
+  }
+}
+
+std::string Wrap(const std::string &records) {
+  return "{\"type\":\"history\",\"status\":\"ok\",\"data\":[" + records + "]}";
+}
+
+} // namespace
+
+int main() {
+  ExpectEntries("empty", Wrap(""), true, {});
+
+  ExpectEntries(
+      "escaped quotes",
+      Wrap("{\"message\":\"say \\\"hi\\\", then \\\"bye\\\"\","
+           "\"timestamp\":\"t1\",\"role\":\"user\"},"
+           "{\"message\":\"a \\\\\\\"b\\\\\\\" c\",\"role\":\"assistant\"}"),
+      true,
+      {{"say \"hi\", then \"bye\"", "t1", "user"},
+       {"a \\\"b\\\" c", "", "assistant"}});
+
+  ExpectEntries(
+      "unicode escapes",
+      Wrap("{\"message\":\"caf\\u00e9 \\u2014 \\ud83d\\ude00\\n\\ttab\","
+           "\"role\":\"user\"}"),
+      true, {{"caf\xC3\xA9 \xE2\x80\x94 \xF0\x9F\x98\x80\n\ttab", "", "user"}});
+
+  ExpectEntries("lone surrogate",
+                Wrap("{\"message\":\"\\ud83d\",\"role\":\"user\"}"), false,
+                {});
+
+  // Keys of nested objects and arrays are not the record's own
+  ExpectEntries(
+      "nested values",
+      Wrap("{\"meta\":{\"message\":\"inner\",\"role\":\"x\"},"
+           "\"message\":\"outer\",\"tags\":[\"role\",{\"role\":\"y\"}],"
+           "\"role\":\"user\",\"timestamp\":\"t\"}"),
+      true, {{"outer", "t", "user"}});
+
+  // A known key with another type of value leaves the field empty, and the
+  // string after it is not taken for that key
+  ExpectEntries("non-string values",
+                Wrap("{\"message\":42,\"uuid\":\"u\",\"role\":null,"
+                     "\"timestamp\":[\"t\"],\"current_file\":\"f\"},"
+                     "{\"message\":{\"text\":\"x\"},\"role\":true}"),
+                true, {{"", "", ""}, {"", "", ""}});
+
+  // "data" elsewhere than at the top level holds no records
+  ExpectEntries("data key nested",
+                "{\"type\":\"history\",\"meta\":{\"data\":[{\"message\":"
+                "\"no\"}]},\"data\":[{\"message\":\"yes\"}]}",
+                true, {{"yes", "", ""}});
+
+  // Cut in the middle of the third record: the first two are kept
+  ExpectEntries("truncated",
+                "{\"type\":\"history\",\"status\":\"ok\",\"data\":["
+                "{\"message\":\"one\",\"role\":\"user\"},"
+                "{\"message\":\"two\",\"role\":\"assistant\"},"
+                "{\"message\":\"thr",
+                false, {{"one", "", "user"}, {"two", "", "assistant"}});
+
+  ExpectEntries("trailing garbage",
+                Wrap("{\"message\":\"one\"}") + "x", false, {{"one", "", ""}});
+
+  if (failures > 0) {
+    std::fprintf(stderr, "%d failure(s)\n", failures);
+    return 1;
+  }
+  std::printf("history test: OK\n");
+  return 0;
+}
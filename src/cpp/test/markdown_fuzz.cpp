@@ -0,0 +1,181 @@
+// Fuzz test for MarkdownStreamer: any split of the input must render the
+// same styled text as feeding it whole. Run with `zig build test`, or pass
+// an iteration count and seed: `markdown-fuzz 100000 42`.
+#include "client/markdown.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace MCPHelper;
+
+namespace {
+
+struct Segment {
+  uint16_t style;
+  uint8_t headingLevel;
+  std::string text;
+
+  bool operator==(const Segment &other) const {
+    return style == other.style && headingLevel == other.headingLevel &&
+           text == other.text;
+  }
+};
+
+// Runs may be cut anywhere; merge neighbours with equal style
+struct Collector {
+  std::vector<Segment> segments;
+
+  void operator()(const MarkdownRun &run) {
+    if (run.length == 0) {
+      std::fprintf(stderr, "empty run\n");
+      std::exit(1);
+    }
+    if (!segments.empty() && segments.back().style == run.style &&
+        segments.back().headingLevel == run.headingLevel) {
+      segments.back().text.append(run.text, run.length);
+    } else {
+      segments.push_back({run.style, run.headingLevel,
+                          std::string(run.text, run.length)});
+    }
+  }
+};
+
+std::vector<Segment> Render(const std::string &input,
+                            const std::vector<size_t> &cuts) {
+  MarkdownStreamer streamer;
+  Collector collector;
+  size_t start = 0;
+  for (size_t cut : cuts) {
+    // Copy each chunk so runs can never point at the next one
+    std::string chunk = input.substr(start, cut - start);
+    streamer.Feed(chunk.data(), chunk.size(), collector);
+    start = cut;
+  }
+  std::string tail = input.substr(start);
+  streamer.Feed(tail.data(), tail.size(), collector);
+  streamer.Finish(collector);
+  return collector.segments;
+}
+
+std::string Dump(const std::vector<Segment> &segments) {
+  std::string out;
+  for (const auto &segment : segments) {
+    out += "[" + std::to_string(segment.style) + ":" +
+           std::to_string(segment.headingLevel) + "]" + segment.text;
+  }
+  return out;
+}
+
+bool IsValidUtf8(const std::string &text) {
+  for (size_t i = 0; i < text.size();) {
+    unsigned char c = (unsigned char)text[i];
+    size_t extra = c < 0x80 ? 0 : (c >> 5) == 0x6 ? 1 : (c >> 4) == 0xE ? 2
+                                : (c >> 3) == 0x1E ? 3 : 99;
+    if (extra == 99 || i + extra >= text.size() + (extra == 0 ? 1 : 0))
+      return false;
+    for (size_t n = 1; n <= extra; n++) {
+      if (((unsigned char)text[i + n] >> 6) != 0x2)
+        return false;
+    }
+    i += extra + 1;
+  }
+  return true;
+}
+
+int failures = 0;
+
+void Expect(bool condition, const char *what, const std::string &input) {
+  if (!condition) {
+    std::fprintf(stderr, "FAIL: %s\ninput: %s\n", what, input.c_str());
+    failures++;
+  }
+}
+
+void ExpectRender(const std::string &input, const std::string &expected) {
+  std::string actual = Dump(Render(input, {}));
+  if (actual != expected) {
+    std::fprintf(stderr, "FAIL: render\ninput:    %s\nexpected: %s\nactual:   %s\n",
+                 input.c_str(), expected.c_str(), actual.c_str());
+    failures++;
+  }
+}
+
+void KnownCases() {
+  ExpectRender("plain", "[0:0]plain");
+  ExpectRender("a **b** c", "[0:0]a [1:0]b[0:0] c");
+  ExpectRender("*i* _j_ __u__", "[2:0]i[0:0] [2:0]j[0:0] [4:0]u");
+  ExpectRender("file_name and snake_case_id", "[0:0]file_name and snake_case_id");
+  ExpectRender("## Title\nbody", "[16:2]Title\n[0:0]body");
+  ExpectRender("- one\n* two\n3. three", "[32:0]one\ntwo\n[0:0]3. three");
+  ExpectRender("`a*b*`", "[8:0]a*b*");
+  ExpectRender("```cpp\nx = *p;\n```\nafter",
+               "[8:0]x = *p;\n[0:0]after");
+  ExpectRender("| a | b |\n|---|---|\n", "[64:0]| a | b |\n|---|---|\n");
+  ExpectRender("**open\n\nclosed", "[1:0]open\n[0:0]\nclosed");
+  ExpectRender("#hashtag", "[0:0]#hashtag");
+  ExpectRender("1.5 apples", "[0:0]1.5 apples");
+  ExpectRender("caf\xC3\xA9 **\xC3\xA9t\xC3\xA9**",
+               "[0:0]caf\xC3\xA9 [1:0]\xC3\xA9t\xC3\xA9");
+
+  // Marker split across chunks
+  std::string input = "x **bold** y";
+  for (size_t cut = 1; cut < input.size(); cut++) {
+    Expect(Dump(Render(input, {cut})) == "[0:0]x [1:0]bold[0:0] y",
+           "split bold", input);
+  }
+}
+
+std::string RandomInput(std::mt19937 &rng) {
+  static const char *pieces[] = {
+      "*",  "**", "_",   "__",   "`",    "```", "#",  "## ", "- ",  "* ",
+      "1.", " ",  "\n",  "\n\n", "|",    "| a |", "word", "x_y", "\xC3\xA9",
+      "\xE2\x82\xAC", "+ ", "   ", "####### ", "42. ", "```js\n"};
+  const size_t count = sizeof(pieces) / sizeof(pieces[0]);
+  std::string input;
+  size_t length = rng() % 40;
+  for (size_t n = 0; n < length; n++)
+    input += pieces[rng() % count];
+  return input;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  long iterations = argc > 1 ? std::atol(argv[1]) : 20000;
+  unsigned seed = argc > 2 ? (unsigned)std::atol(argv[2]) : 1;
+
+  KnownCases();
+
+  std::mt19937 rng(seed);
+  for (long iteration = 0; iteration < iterations && failures == 0;
+       iteration++) {
+    std::string input = RandomInput(rng);
+    std::vector<Segment> reference = Render(input, {});
+
+    std::string text;
+    for (const auto &segment : reference)
+      text += segment.text;
+    Expect(text.size() <= input.size(), "output longer than input", input);
+    Expect(IsValidUtf8(text), "broke a UTF-8 sequence", input);
+
+    // Random cuts, and the worst case of one byte per chunk
+    for (int attempt = 0; attempt < 4; attempt++) {
+      std::vector<size_t> cuts;
+      for (size_t pos = 1; pos < input.size(); pos++) {
+        if (attempt == 0 || rng() % 4 == 0)
+          cuts.push_back(pos);
+      }
+      Expect(Render(input, cuts) == reference, "split changed the output",
+             input);
+    }
+  }
+
+  if (failures > 0) {
+    std::fprintf(stderr, "%d failure(s)\n", failures);
+    return 1;
+  }
+  std::printf("markdown fuzz: %ld inputs OK (seed %u)\n", iterations, seed);
+  return 0;
+}
@@ -0,0 +1,102 @@
+// Stress test for SpscRing and SpillingSpscQueue: one producer and one
+// consumer thread move numbered events through a small ring; every event
+// must arrive once, in order, with its payload intact. The spilling queue
+// runs against a consumer that keeps pausing, so its producer spills to the
+// overflow and comes back to the ring many times. Built with
+// ThreadSanitizer where the host supports it, so a missing acquire/release
+// shows up as a race. Run with `zig build test`, or pass an event count:
+// `spscring-test 10000000`.
+#include "client/spscring.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+using namespace MCPHelper;
+
+namespace {
+
+// A payload that owns heap memory, like the frames the client queues, so a
+// slot read before its write is published is a race on the string too
+struct Event {
+  unsigned long sequence = 0;
+  std::string text;
+};
+
+std::string TextFor(unsigned long sequence) {
+  // Past the small-string buffer every few events
+  return sequence % 4 == 0 ? std::string(40, (char)('a' + sequence % 26))
+                           : std::to_string(sequence);
+}
+
+// Pops `events` events, checking each; `pause` runs after every pop
+template <typename Queue, typename Pause>
+unsigned long Consume(Queue &queue, unsigned long events, Pause pause) {
+  unsigned long expected = 0;
+  unsigned long failures = 0;
+  Event event;
+  while (expected < events) {
+    if (!queue.TryPop(event)) {
+      std::this_thread::yield();
+      continue;
+    }
+    if (event.sequence != expected || event.text != TextFor(expected)) {
+      if (failures++ < 10)
+        std::fprintf(stderr, "FAIL: expected event %lu, got %lu \"%s\"\n",
+                     expected, event.sequence, event.text.c_str());
+    }
+    expected++;
+    pause(expected);
+  }
+  if (queue.TryPop(event)) {
+    std::fprintf(stderr, "FAIL: queue not empty after the last event\n");
+    failures++;
+  }
+  return failures;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const unsigned long events = argc > 1 ? std::strtoul(argv[1], nullptr, 10)
+                                        : 2000000;
+  unsigned long failures = 0;
+
+  static SpscRing<Event, 1024> ring;
+  std::thread producer([&] {
+    for (unsigned long sequence = 0; sequence < events; sequence++) {
+      Event event{sequence, TextFor(sequence)};
+      while (!ring.TryPush(std::move(event)))
+        std::this_thread::yield();
+    }
+  });
+  failures += Consume(ring, events, [](unsigned long) {});
+  producer.join();
+
+  // A quarter of the events, as every pause lets the overflow grow
+  const unsigned long spillEvents = events / 4;
+  static SpillingSpscQueue<Event, 64> spilling;
+  std::thread spiller([&] {
+    for (unsigned long sequence = 0; sequence < spillEvents; sequence++)
+      spilling.Push(Event{sequence, TextFor(sequence)});
+  });
+  failures += Consume(spilling, spillEvents, [](unsigned long popped) {
+    if (popped % 5000 == 0)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  });
+  spiller.join();
+  if (spilling.Spilled() == 0) {
+    std::fprintf(stderr, "FAIL: the spilling queue never spilled\n");
+    failures++;
+  }
+
+  if (failures > 0) {
+    std::fprintf(stderr, "%lu failure(s)\n", failures);
+    return 1;
+  }
+  std::printf("spscring test: %lu events through %zu slots, %lu through a "
+              "spilling queue (%zu spilled) OK\n",
+              events, ring.capacity(), spillEvents, spilling.Spilled());
+  return 0;
+}
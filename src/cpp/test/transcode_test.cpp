@@ -0,0 +1,270 @@
+// Validation for the UTF-8 <-> UTF-16 transcoder: known vectors, malformed
+// input, and random text checked against a plain code-point-at-a-time
+// reference, with ASCII runs long enough to exercise the vector paths at
+// every alignment. Run with `zig build test`, or pass an iteration count and
+// seed: `transcode-test 100000 42`.
+#include "client/transcode.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+using namespace MCPHelper;
+
+namespace {
+
+int failures = 0;
+
+std::string Hex(const std::string &bytes) {
+  std::string out;
+  char buffer[4];
+  for (unsigned char c : bytes) {
+    std::snprintf(buffer, sizeof(buffer), "%02X ", c);
+    out += buffer;
+  }
+  return out;
+}
+
+std::string Hex(const std::u16string &units) {
+  std::string out;
+  char buffer[6];
+  for (char16_t unit : units) {
+    std::snprintf(buffer, sizeof(buffer), "%04X ", (unsigned)unit);
+    out += buffer;
+  }
+  return out;
+}
+
+// Reference decoder: one code point at a time, Unicode's maximal-subpart
+// replacement, no vector code
+std::u16string ReferenceToUtf16(const std::string &text) {
+  std::u16string out;
+  const unsigned char *bytes = (const unsigned char *)text.data();
+  size_t i = 0;
+  while (i < text.size()) {
+    unsigned char lead = bytes[i];
+    uint32_t code;
+    size_t need;
+    if (lead < 0x80) {
+      out += (char16_t)lead;
+      i++;
+      continue;
+    } else if ((lead & 0xE0) == 0xC0) {
+      code = lead & 0x1F;
+      need = 1;
+    } else if ((lead & 0xF0) == 0xE0) {
+      code = lead & 0x0F;
+      need = 2;
+    } else if ((lead & 0xF8) == 0xF0) {
+      code = lead & 0x07;
+      need = 3;
+    } else {
+      out += u'\xFFFD';
+      i++;
+      continue;
+    }
+
+    size_t n = 1;
+    for (; n <= need && i + n < text.size(); n++) {
+      if ((bytes[i + n] & 0xC0) != 0x80)
+        break;
+      uint32_t next = (code << 6) | (bytes[i + n] & 0x3F);
+      // Reject as soon as the prefix can no longer be a valid scalar value
+      uint32_t shift = 6 * (uint32_t)(need - n);
+      uint32_t least = next << shift;
+      uint32_t most = least | ((1u << shift) - 1);
+      uint32_t minimum = need == 1 ? 0x80 : need == 2 ? 0x800 : 0x10000;
+      if (most < minimum || least > 0x10FFFF ||
+          (least >= 0xD800 && most <= 0xDFFF))
+        break;
+      code = next;
+    }
+    if (lead < 0xC2 || lead > 0xF4 || n <= need) {
+      out += u'\xFFFD';
+      i += (lead < 0xC2 || lead > 0xF4) ? 1 : n;
+      continue;
+    }
+    if (code >= 0x10000) {
+      code -= 0x10000;
+      out += (char16_t)(0xD800 + (code >> 10));
+      out += (char16_t)(0xDC00 + (code & 0x3FF));
+    } else {
+      out += (char16_t)code;
+    }
+    i += need + 1;
+  }
+  return out;
+}
+
+std::string ReferenceToUtf8(const std::u16string &text) {
+  std::string out;
+  for (size_t i = 0; i < text.size(); i++) {
+    uint32_t code = text[i];
+    if (code >= 0xD800 && code <= 0xDBFF && i + 1 < text.size() &&
+        text[i + 1] >= 0xDC00 && text[i + 1] <= 0xDFFF) {
+      code = 0x10000 + ((code - 0xD800) << 10) + (text[i + 1] - 0xDC00);
+      i++;
+    } else if (code >= 0xD800 && code <= 0xDFFF) {
+      code = 0xFFFD;
+    }
+    if (code < 0x80) {
+      out += (char)code;
+    } else if (code < 0x800) {
+      out += (char)(0xC0 | (code >> 6));
+      out += (char)(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+      out += (char)(0xE0 | (code >> 12));
+      out += (char)(0x80 | ((code >> 6) & 0x3F));
+      out += (char)(0x80 | (code & 0x3F));
+    } else {
+      out += (char)(0xF0 | (code >> 18));
+      out += (char)(0x80 | ((code >> 12) & 0x3F));
+      out += (char)(0x80 | ((code >> 6) & 0x3F));
+      out += (char)(0x80 | (code & 0x3F));
+    }
+  }
+  return out;
+}
+
+// Reused across checks, as callers reuse theirs
+std::u16string wide;
+std::string narrow;
+
+void ExpectToUtf16(const std::string &input, const std::u16string &expected) {
+  Utf::Utf8ToUtf16(input, wide);
+  if (wide != expected) {
+    std::fprintf(stderr,
+                 "FAIL: UTF-8 -> UTF-16\ninput:    %s\nexpected: %s\nactual:   "
+                 "%s\n",
+                 Hex(input).c_str(), Hex(expected).c_str(), Hex(wide).c_str());
+    failures++;
+  }
+}
+
+void ExpectToUtf8(const std::u16string &input, const std::string &expected) {
+  Utf::Utf16ToUtf8(input, narrow);
+  if (narrow != expected) {
+    std::fprintf(stderr,
+                 "FAIL: UTF-16 -> UTF-8\ninput:    %s\nexpected: %s\nactual:   "
+                 "%s\n",
+                 Hex(input).c_str(), Hex(expected).c_str(), Hex(narrow).c_str());
+    failures++;
+  }
+}
+
+void KnownCases() {
+  ExpectToUtf16("", u"");
+  ExpectToUtf16("plain ascii", u"plain ascii");
+  ExpectToUtf16("caf\xC3\xA9", u"café");
+  ExpectToUtf16("\xE2\x82\xAC 5", u"€ 5");
+  ExpectToUtf16("\xF0\x9F\x98\x80", u"\U0001F600");
+  ExpectToUtf16("\xF4\x8F\xBF\xBF", u"\U0010FFFF");
+
+  // Malformed: one U+FFFD per maximal invalid subsequence
+  ExpectToUtf16("\x80", u"\xFFFD");
+  ExpectToUtf16("a\xC3", u"a\xFFFD");
+  ExpectToUtf16("\xC0\xAF", u"\xFFFD\xFFFD");          // overlong
+  ExpectToUtf16("\xE0\x80\x80", u"\xFFFD\xFFFD\xFFFD"); // overlong
+  ExpectToUtf16("\xED\xA0\x80", u"\xFFFD\xFFFD\xFFFD"); // surrogate
+  ExpectToUtf16("\xF4\x90\x80\x80", u"\xFFFD\xFFFD\xFFFD\xFFFD");
+  ExpectToUtf16("\xE2\x82x", u"\xFFFDx");
+  ExpectToUtf16("\xF0\x9F\x98", u"\xFFFD");
+  ExpectToUtf16("\xFF\xFE", u"\xFFFD\xFFFD");
+
+  ExpectToUtf8(u"", "");
+  ExpectToUtf8(u"plain ascii", "plain ascii");
+  ExpectToUtf8(u"café €", "caf\xC3\xA9 \xE2\x82\xAC");
+  ExpectToUtf8(u"\U0001F600", "\xF0\x9F\x98\x80");
+  ExpectToUtf8(std::u16string(1, (char16_t)0xD83D), "\xEF\xBF\xBD");
+  ExpectToUtf8(std::u16string(1, (char16_t)0xDE00) + u"x", "\xEF\xBF\xBDx");
+
+  // Non-ASCII right after, inside and right before a vector block
+  std::string ascii(70, 'a');
+  for (size_t at = 0; at <= ascii.size(); at++) {
+    std::string input = ascii.substr(0, at) + "\xC3\xA9" + ascii.substr(at);
+    ExpectToUtf16(input, ReferenceToUtf16(input));
+    std::u16string units = ReferenceToUtf16(input);
+    ExpectToUtf8(units, input);
+  }
+}
+
+std::string RandomUtf8(std::mt19937 &rng) {
+  static const char *pieces[] = {
+      "a",  "word ", "\n", "\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80",
+      "\x80", "\xC3", "\xE2\x82", "\xED\xA0\x80", "\xF4\x90\x80\x80",
+      "\xC0\xAF", "\xFF", "\xEF\xBF\xBD", "\x7F"};
+  const size_t count = sizeof(pieces) / sizeof(pieces[0]);
+  std::string input;
+  size_t length = rng() % 24;
+  for (size_t n = 0; n < length; n++) {
+    // Long ASCII runs reach the vector paths
+    if (rng() % 4 == 0)
+      input += std::string(rng() % 80, (char)('A' + rng() % 26));
+    else
+      input += pieces[rng() % count];
+  }
+  return input;
+}
+
+std::u16string RandomUtf16(std::mt19937 &rng) {
+  std::u16string input;
+  size_t length = rng() % 24;
+  for (size_t n = 0; n < length; n++) {
+    switch (rng() % 6) {
+    case 0:
+      input += std::u16string(rng() % 80, (char16_t)('a' + rng() % 26));
+      break;
+    case 1:
+      input += (char16_t)(0x80 + rng() % 0x780);
+      break;
+    case 2:
+      input += (char16_t)(0x800 + rng() % 0xD000);
+      break;
+    case 3:
+      input += u"\U0001F600";
+      break;
+    case 4:
+      input += (char16_t)(0xD800 + rng() % 0x800); // maybe unpaired
+      break;
+    default:
+      input += (char16_t)(rng() % 0x80);
+      break;
+    }
+  }
+  return input;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  long iterations = argc > 1 ? std::atol(argv[1]) : 20000;
+  unsigned seed = argc > 2 ? (unsigned)std::atol(argv[2]) : 1;
+
+  KnownCases();
+
+  std::mt19937 rng(seed);
+  for (long iteration = 0; iteration < iterations && failures == 0;
+       iteration++) {
+    std::string utf8 = RandomUtf8(rng);
+    ExpectToUtf16(utf8, ReferenceToUtf16(utf8));
+
+    std::u16string utf16 = RandomUtf16(rng);
+    ExpectToUtf8(utf16, ReferenceToUtf8(utf16));
+
+    // Well-formed text survives the round trip
+    std::string clean = ReferenceToUtf8(ReferenceToUtf16(utf8));
+    Utf::Utf8ToUtf16(clean, wide);
+    Utf::Utf16ToUtf8(wide, narrow);
+    if (narrow != clean) {
+      std::fprintf(stderr, "FAIL: round trip\ninput: %s\n", Hex(clean).c_str());
+      failures++;
+    }
+  }
+
+  if (failures > 0) {
+    std::fprintf(stderr, "%d failure(s)\n", failures);
+    return 1;
+  }
+  std::printf("transcode test: %ld inputs OK (seed %u)\n", iterations, seed);
+  return 0;
+}
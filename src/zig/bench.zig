@@ -0,0 +1,599 @@
+//! Benchmarks and load tests for the server side.
+//! Run with `zig build bench -Doptimize=ReleaseFast`, optionally naming a
+//! single benchmark: `zig build bench -Doptimize=ReleaseFast -- server`.
+const std = @import("std");
+const AgenticAIOnWord = @import("AgenticAIOnWord");
+const net = std.net;
+const print = std.debug.print;
+
+const Allocator = std.mem.Allocator;
+
+const Benchmark = struct {
+    name: []const u8,
+    run: *const fn (allocator: Allocator) anyerror!void,
+};
+
+const benchmarks = [_]Benchmark{
+    .{ .name = "server", .run = benchServerScaling },
+    .{ .name = "stream", .run = benchStreamCoalescing },
+    .{ .name = "sse", .run = benchSseDecode },
+    .{ .name = "e2e", .run = benchEndToEnd },
+    .{ .name = "ingest", .run = benchIngest },
+};
+
+pub fn main() !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const allocator = gpa.allocator();
+
+    const args = try std.process.argsAlloc(allocator);
+    defer std.process.argsFree(allocator, args);
+    const filter: ?[]const u8 = if (args.len > 1) args[1] else null;
+
+    for (benchmarks) |bench| {
+        if (filter) |f| {
+            if (!std.mem.eql(u8, f, bench.name)) continue;
+        }
+        print("\n=== {s} ===\n", .{bench.name});
+        try bench.run(allocator);
+    }
+}
+
+// ============================================================================
+// Server load test
+// ============================================================================
+
+/// Health round trips each client performs over its own WebSocket
+const SERVER_REQUESTS_PER_CLIENT: usize = 2000;
+
+/// One client per core hammers the server with `health` requests while the
+/// worker count doubles from 1 up to the core count.
+fn benchServerScaling(allocator: Allocator) !void {
+    var db = try AgenticAIOnWord.database.SqliteHandler.init(allocator, ":memory:");
+    defer db.deinit();
+
+    var mcp_handler = AgenticAIOnWord.mcp.MCPHandler.init(allocator, &db, "");
+    defer mcp_handler.deinit();
+
+    const cpu_count = std.Thread.getCpuCount() catch 1;
+    const clients = @max(cpu_count, 2);
+
+    var workers: usize = 1;
+    while (true) : (workers *= 2) {
+        const round_workers = @min(workers, cpu_count);
+        try runServerRound(allocator, &db, &mcp_handler, round_workers, clients);
+        if (round_workers == cpu_count) break;
+    }
+}
+
+fn runServerRound(
+    allocator: Allocator,
+    db: *AgenticAIOnWord.database.SqliteHandler,
+    mcp_handler: *AgenticAIOnWord.mcp.MCPHandler,
+    workers: usize,
+    clients: usize,
+) !void {
+    var server = AgenticAIOnWord.server.Server.init(allocator, db, mcp_handler, .{
+        .worker_count = workers,
+        .verbose = false,
+    });
+    defer server.deinit();
+
+    const address = try server.listen(0);
+    const serve_thread = try std.Thread.spawn(.{}, serveInBackground, .{&server});
+
+    const threads = try allocator.alloc(std.Thread, clients);
+    defer allocator.free(threads);
+
+    var failures = std.atomic.Value(usize).init(0);
+    var timer = try std.time.Timer.start();
+    for (threads) |*t| {
+        t.* = try std.Thread.spawn(.{}, healthClient, .{ address, SERVER_REQUESTS_PER_CLIENT, &failures });
+    }
+    for (threads) |t| t.join();
+    const elapsed_ns = timer.read();
+
+    server.stop();
+    serve_thread.join();
+
+    const total = clients * SERVER_REQUESTS_PER_CLIENT;
+    const seconds = @as(f64, @floatFromInt(elapsed_ns)) / std.time.ns_per_s;
+    print("workers={d:>3} clients={d:>3} requests={d:>7} time={d:>8.1} ms  {d:>10.0} req/s  failures={d}\n", .{
+        workers,
+        clients,
+        total,
+        seconds * 1000.0,
+        @as(f64, @floatFromInt(total)) / seconds,
+        failures.load(.monotonic),
+    });
+}
+
+fn serveInBackground(server: *AgenticAIOnWord.server.Server) void {
+    server.serve() catch |err| {
+        print("[Bench] serve failed: {}\n", .{err});
+    };
+}
+
+fn healthClient(address: net.Address, requests: usize, failures: *std.atomic.Value(usize)) void {
+    runHealthClient(address, requests) catch |err| {
+        print("[Bench] client error: {}\n", .{err});
+        _ = failures.fetchAdd(1, .monotonic);
+    };
+}
+
+fn runHealthClient(address: net.Address, requests: usize) !void {
+    const stream = try net.tcpConnectToAddress(address);
+    defer stream.close();
+
+    try wsHandshake(stream);
+
+    var frame_buf: [128]u8 = undefined;
+    const frame = encodeClientFrame(&frame_buf, "{\"id\":\"1\",\"type\":\"health\"}");
+
+    var response_buf: [4096]u8 = undefined;
+    for (0..requests) |_| {
+        _ = try stream.writeAll(frame);
+        _ = try readServerFrame(stream, &response_buf);
+    }
+}
+
+// ============================================================================
+// Streamed answer framing
+// ============================================================================
+
+/// Deltas in the synthetic streamed answer, each a few bytes like a token
+const STREAM_DELTAS: usize = 4000;
+
+/// Forwards a synthetic SSE answer through the streaming path to a loopback
+/// socket, once with every delta in its own frame and once with the default
+/// coalescing, and reports frames and socket write calls per response.
+/// Before vectored writes every frame took two write calls.
+fn benchStreamCoalescing(allocator: Allocator) !void {
+    var db = try AgenticAIOnWord.database.SqliteHandler.init(allocator, ":memory:");
+    defer db.deinit();
+
+    var mcp_handler = AgenticAIOnWord.mcp.MCPHandler.init(allocator, &db, "");
+    defer mcp_handler.deinit();
+
+    const sse = try buildSseAnswer(allocator, STREAM_DELTAS);
+    defer allocator.free(sse);
+
+    const rounds = [_]AgenticAIOnWord.mcp.CoalesceOptions{ .{ .max_bytes = 0 }, .{} };
+    for (rounds) |options| {
+        mcp_handler.coalesce = options;
+
+        const address = net.Address.initIp4(.{ 127, 0, 0, 1 }, 0);
+        var listener = try address.listen(.{ .reuse_address = true });
+        defer listener.deinit();
+
+        const client = try net.tcpConnectToAddress(listener.listen_address);
+        defer client.close();
+        const conn = try listener.accept();
+        defer conn.stream.close();
+
+        var received: usize = 0;
+        const drain_thread = try std.Thread.spawn(.{}, drainSocket, .{ client, &received });
+
+        var channel = AgenticAIOnWord.server.Channel.init(conn.stream);
+        var cancellation: AgenticAIOnWord.server.Cancellation = .{};
+        var reader = std.Io.Reader.fixed(sse);
+        var timer = try std.time.Timer.start();
+        try mcp_handler.processStreamingResponse(allocator, &channel, "1", &reader, &timer, &cancellation, null);
+        const elapsed_ns = timer.read();
+
+        std.posix.shutdown(conn.stream.handle, .send) catch {};
+        drain_thread.join();
+
+        const stats = channel.stats();
+        print("max_bytes={d:>5} max_delay_us={d:>6}  deltas={d}  frames={d:>5}  write calls={d:>5} (two-write framing: {d:>5})  {d} bytes  {d:.2} ms\n", .{
+            options.max_bytes,
+            options.max_delay_us,
+            STREAM_DELTAS,
+            stats.frames,
+            stats.write_calls,
+            stats.frames * 2,
+            received,
+            @as(f64, @floatFromInt(elapsed_ns)) / std.time.ns_per_ms,
+        });
+    }
+}
+
+/// An upstream SSE body: `deltas` short content deltas, then [DONE]
+fn buildSseAnswer(allocator: Allocator, deltas: usize) ![]u8 {
+    var body: std.ArrayList(u8) = .empty;
+    errdefer body.deinit(allocator);
+
+    const words = [_][]const u8{ "The ", "quick ", "brown ", "fox\\n", "jumps ", "over ", "the ", "lazy ", "dog. " };
+    for (0..deltas) |i| {
+        try body.appendSlice(allocator, "data: {\"choices\":[{\"delta\":{\"content\":\"");
+        try body.appendSlice(allocator, words[i % words.len]);
+        try body.appendSlice(allocator, "\"}}]}\n\n");
+    }
+    try body.appendSlice(allocator, "data: [DONE]\n\n");
+    return try body.toOwnedSlice(allocator);
+}
+
+/// Read until the peer shuts its side down, counting bytes
+fn drainSocket(stream: net.Stream, received: *usize) void {
+    var buf: [16384]u8 = undefined;
+    while (true) {
+        const n = std.posix.recv(stream.handle, &buf, 0) catch return;
+        if (n == 0) return;
+        received.* += n;
+    }
+}
+
+// ============================================================================
+// SSE decoding
+// ============================================================================
+
+/// Sample upstream answer (see testdata/), decoded back to back this often
+const SSE_REPEATS: usize = 2000;
+
+/// Extracts the answer text from a long SSE body two ways: a JSON tree per
+/// `data:` line, as the streaming path used to, and sse.Decoder with
+/// parseChunk. Both must produce the same text.
+fn benchSseDecode(allocator: Allocator) !void {
+    const sample = @embedFile("testdata/nvidia_stream.sse");
+    const body = try allocator.alloc(u8, sample.len * SSE_REPEATS);
+    defer allocator.free(body);
+    for (0..SSE_REPEATS) |i| @memcpy(body[i * sample.len ..][0..sample.len], sample);
+
+    var tree_text: std.ArrayList(u8) = .empty;
+    defer tree_text.deinit(allocator);
+    var timer = try std.time.Timer.start();
+    try decodeWithTree(allocator, body, &tree_text);
+    const tree_ns = timer.lap();
+
+    var scan_text: std.ArrayList(u8) = .empty;
+    defer scan_text.deinit(allocator);
+    try decodeWithScanner(allocator, body, &scan_text);
+    const scan_ns = timer.lap();
+
+    if (!std.mem.eql(u8, tree_text.items, scan_text.items)) return error.TextMismatch;
+
+    const mb = @as(f64, @floatFromInt(body.len)) / (1024 * 1024);
+    for ([_]struct { name: []const u8, ns: u64 }{
+        .{ .name = "json tree", .ns = tree_ns },
+        .{ .name = "sse.Decoder", .ns = scan_ns },
+    }) |result| {
+        const seconds = @as(f64, @floatFromInt(result.ns)) / std.time.ns_per_s;
+        print("{s:<12} {d:.1} MiB in {d:.2} ms  {d:.0} MiB/s\n", .{
+            result.name,
+            mb,
+            seconds * 1000,
+            mb / seconds,
+        });
+    }
+}
+
+fn decodeWithTree(allocator: Allocator, body: []const u8, text: *std.ArrayList(u8)) !void {
+    var lines = std.mem.splitScalar(u8, body, '\n');
+    while (lines.next()) |line| {
+        if (!std.mem.startsWith(u8, line, "data: ")) continue;
+        const data = std.mem.trim(u8, line[6..], " \r");
+        if (std.mem.eql(u8, data, AgenticAIOnWord.sse.DONE)) continue;
+
+        const parsed = std.json.parseFromSlice(std.json.Value, allocator, data, .{}) catch continue;
+        defer parsed.deinit();
+        const choices = parsed.value.object.get("choices") orelse continue;
+        if (choices.array.items.len == 0) continue;
+        const delta = choices.array.items[0].object.get("delta") orelse continue;
+        const content = delta.object.get("content") orelse continue;
+        if (content == .string) try text.appendSlice(allocator, content.string);
+    }
+}
+
+fn decodeWithScanner(allocator: Allocator, body: []const u8, text: *std.ArrayList(u8)) !void {
+    const sse = AgenticAIOnWord.sse;
+    var decoder: sse.Decoder = .{};
+    defer decoder.deinit(allocator);
+
+    // Fed in socket-read sized pieces, so events straddle feeds
+    var start: usize = 0;
+    while (start < body.len) {
+        const end = @min(start + 8192, body.len);
+        decoder.feed(body[start..end]);
+        while (try decoder.next(allocator)) |data| {
+            if (std.mem.eql(u8, data, sse.DONE)) continue;
+            const chunk = sse.parseChunk(data) catch continue;
+            if (chunk.content) |raw| try sse.appendUnescaped(allocator, text, raw);
+        }
+        start = end;
+    }
+}
+
+// ============================================================================
+// End to end, against the mock provider
+// ============================================================================
+
+/// Streamed prompts per round, one after the other on one WebSocket
+const E2E_PROMPTS: usize = 20;
+
+/// Input file the prompts name, written to the working directory
+const E2E_INPUT = "e2e-bench-input.txt";
+
+/// The whole path of a streamed answer: a prompt over the WebSocket, the
+/// server's request to the model API (the mock provider, over loopback
+/// HTTP), SSE decoding, coalesced frames back, and the client decoding
+/// them. Time to first token is reported over the mock's fixed first-token
+/// delay, so it is what the stack itself adds.
+fn benchEndToEnd(allocator: Allocator) !void {
+    try std.fs.cwd().writeFile(.{ .sub_path = E2E_INPUT, .data = "fn main() void {}\n" });
+    defer std.fs.cwd().deleteFile(E2E_INPUT) catch {};
+
+    const rounds = [_]AgenticAIOnWord.mock.Options{
+        // As fast as the pipeline goes
+        .{ .first_token_delay_ms = 50, .tokens_per_second = 0, .answer_tokens = 2000 },
+        // Paced like a fast model
+        .{ .first_token_delay_ms = 50, .tokens_per_second = 2000, .answer_tokens = 600, .tokens_per_chunk = 2 },
+    };
+    for (rounds) |options| {
+        try runEndToEndRound(allocator, options);
+    }
+}
+
+fn runEndToEndRound(allocator: Allocator, options: AgenticAIOnWord.mock.Options) !void {
+    const provider = try AgenticAIOnWord.mock.MockProvider.start(allocator, options, 0);
+    defer provider.stop();
+    const url = try AgenticAIOnWord.mcp.chatCompletionsUrl(allocator, provider.url());
+    defer allocator.free(url);
+
+    var db = try AgenticAIOnWord.database.SqliteHandler.init(allocator, ":memory:");
+    defer db.deinit();
+    var mcp_handler = try AgenticAIOnWord.mcp.MCPHandler.initWithUpstream(allocator, &db, "", url, .{});
+    defer mcp_handler.deinit();
+    // Every prompt is the same; each must reach the provider
+    mcp_handler.cache.enabled = false;
+
+    var server = AgenticAIOnWord.server.Server.init(allocator, &db, &mcp_handler, .{ .verbose = false });
+    defer server.deinit();
+    const address = try server.listen(0);
+    const serve_thread = try std.Thread.spawn(.{}, serveInBackground, .{&server});
+    defer {
+        server.stop();
+        serve_thread.join();
+    }
+
+    const stream = try net.tcpConnectToAddress(address);
+    defer stream.close();
+    try wsHandshake(stream);
+
+    var ttft_ns: [E2E_PROMPTS]u64 = undefined;
+    var total_ns: [E2E_PROMPTS]u64 = undefined;
+    var frames: usize = 0;
+    var text_bytes: usize = 0;
+    var failures: usize = 0;
+
+    const frame_buf = try allocator.alloc(u8, 1 << 20);
+    defer allocator.free(frame_buf);
+    for (0..E2E_PROMPTS) |i| {
+        var request_buf: [128]u8 = undefined;
+        const request = try std.fmt.bufPrint(&request_buf, "{{\"id\":\"{d}\",\"type\":\"analyze\",\"file_path\":\"" ++ E2E_INPUT ++ "\",\"isStream\":true}}", .{i + 1});
+        var client_frame: [134]u8 = undefined;
+
+        var timer = try std.time.Timer.start();
+        _ = try stream.writeAll(encodeClientFrame(&client_frame, request));
+        ttft_ns[i] = 0;
+        while (true) {
+            const payload = try readServerFrame(stream, frame_buf);
+            const parsed = try std.json.parseFromSlice(std.json.Value, allocator, payload, .{});
+            defer parsed.deinit();
+            const status = if (parsed.value.object.get("status")) |v| v.string else "";
+
+            if (std.mem.eql(u8, status, "streaming")) {
+                if (ttft_ns[i] == 0) ttft_ns[i] = timer.read();
+                frames += 1;
+                text_bytes += parsed.value.object.get("content").?.string.len;
+            } else if (std.mem.eql(u8, status, "complete")) {
+                break;
+            } else {
+                failures += 1;
+                break;
+            }
+        }
+        total_ns[i] = timer.read();
+    }
+
+    std.mem.sort(u64, &ttft_ns, {}, std.sort.asc(u64));
+    std.mem.sort(u64, &total_ns, {}, std.sort.asc(u64));
+    const delay_ns = @as(u64, options.first_token_delay_ms) * std.time.ns_per_ms;
+    print("tokens={d:>5} rate={d:>5}/s  ttft p50 {d:.2} ms (+{d:.2} over mock) max {d:.2} ms  answer p50 {d:.2} ms  {d} frames {d} bytes/answer  failures={d}\n", .{
+        options.answer_tokens,
+        options.tokens_per_second,
+        ms(ttft_ns[E2E_PROMPTS / 2]),
+        ms(ttft_ns[E2E_PROMPTS / 2] -| delay_ns),
+        ms(ttft_ns[E2E_PROMPTS - 1]),
+        ms(total_ns[E2E_PROMPTS / 2]),
+        frames / E2E_PROMPTS,
+        text_bytes / E2E_PROMPTS,
+        failures,
+    });
+}
+
+// ============================================================================
+// Folder ingestion
+// ============================================================================
+
+/// Synthetic tree, written to the working directory and removed afterwards
+const INGEST_TREE = "ingest-bench-tree";
+/// Source directories and files in each: 40k files that belong in a prompt
+const INGEST_DIRS: usize = 250;
+const INGEST_FILES_PER_DIR: usize = 160;
+/// Packages and files in each under an ignored node_modules: 10k more
+const INGEST_PACKAGES: usize = 100;
+const INGEST_FILES_PER_PACKAGE: usize = 100;
+
+/// Reads a 50k-file tree as a folder prompt: the serial walk the handler
+/// used before (extension filter only, node_modules included), then
+/// FileCache on one thread and on one per core, each cold and then again
+/// with nothing changed. Run twice, the tree is in the OS page cache for
+/// all of them.
+fn benchIngest(allocator: Allocator) !void {
+    var timer = try std.time.Timer.start();
+    try writeIngestTree();
+    defer std.fs.cwd().deleteTree(INGEST_TREE) catch {};
+    print("tree of {d} files written in {d:.0} ms\n", .{
+        INGEST_DIRS * (INGEST_FILES_PER_DIR + 1) + INGEST_PACKAGES * INGEST_FILES_PER_PACKAGE,
+        @as(f64, @floatFromInt(timer.lap())) / std.time.ns_per_ms,
+    });
+
+    const before = try ingestSerially(allocator);
+    print("{s:<22} {d:>6} files {d:>7.1} MiB in {d:>8.2} ms\n", .{ "serial walk (before)", before.files, mib(before.bytes), ms(before.ns) });
+
+    const cores = std.Thread.getCpuCount() catch 1;
+    for ([_]usize{ 1, cores }) |threads| {
+        var cache = AgenticAIOnWord.files.FileCache.init(allocator, .{ .max_bytes = 256 * 1024 * 1024, .threads = threads });
+        defer cache.deinit();
+
+        for ([_][]const u8{ "cold", "unchanged" }) |round| {
+            const read = try cache.read(INGEST_TREE);
+            defer read.deinit();
+            var label_buf: [32]u8 = undefined;
+            const label = try std.fmt.bufPrint(&label_buf, "{d} thread(s), {s}", .{ threads, round });
+            print("{s:<22} {d:>6} files {d:>7.1} MiB in {d:>8.2} ms  ({d} ignored, {d} binary, {d:.1} MiB from disk)\n", .{
+                label,
+                read.stats.files,
+                mib(read.text().len),
+                ms(read.stats.walk_ns),
+                read.stats.ignored,
+                read.stats.binary,
+                mib(read.stats.bytes_read),
+            });
+        }
+    }
+}
+
+fn writeIngestTree() !void {
+    var root = try std.fs.cwd().makeOpenPath(INGEST_TREE, .{});
+    defer root.close();
+    try root.writeFile(.{ .sub_path = ".gitignore", .data = "node_modules/\n*.generated.zig\n" });
+
+    var path_buf: [128]u8 = undefined;
+    var content_buf: [256]u8 = undefined;
+    for (0..INGEST_DIRS) |d| {
+        for (0..INGEST_FILES_PER_DIR) |f| {
+            const path = try std.fmt.bufPrint(&path_buf, "src/mod{d}/file{d}.zig", .{ d, f });
+            const content = try std.fmt.bufPrint(&content_buf, "// module {d}, file {d}\npub fn f{d}(x: u32) u32 {{\n    return x * {d} + {d};\n}}\n", .{ d, f, f, d, f });
+            try writeCreatingDirs(root, path, content);
+        }
+        // No telling extension: only sniffing keeps it out
+        const blob = try std.fmt.bufPrint(&path_buf, "src/mod{d}/blob", .{d});
+        try root.writeFile(.{ .sub_path = blob, .data = "\x7fELF\x02\x01\x01\x00\x00\x00" });
+    }
+    for (0..INGEST_PACKAGES) |p| {
+        for (0..INGEST_FILES_PER_PACKAGE) |f| {
+            const path = try std.fmt.bufPrint(&path_buf, "node_modules/pkg{d}/lib{d}.js", .{ p, f });
+            try writeCreatingDirs(root, path, "module.exports = function () { return 42; };\n");
+        }
+    }
+}
+
+fn writeCreatingDirs(dir: std.fs.Dir, path: []const u8, data: []const u8) !void {
+    dir.writeFile(.{ .sub_path = path, .data = data }) catch |err| switch (err) {
+        error.FileNotFound => {
+            try dir.makePath(std.fs.path.dirname(path).?);
+            try dir.writeFile(.{ .sub_path = path, .data = data });
+        },
+        else => return err,
+    };
+}
+
+/// What the handler did before FileCache and ingest: one thread, every
+/// file without a binary extension, nothing ignored
+fn ingestSerially(allocator: Allocator) !struct { files: usize, bytes: usize, ns: u64 } {
+    var timer = try std.time.Timer.start();
+    var dir = try std.fs.cwd().openDir(INGEST_TREE, .{ .iterate = true });
+    defer dir.close();
+    var walker = try dir.walk(allocator);
+    defer walker.deinit();
+
+    var text: std.ArrayList(u8) = .empty;
+    defer text.deinit(allocator);
+    var files: usize = 0;
+    while (try walker.next()) |entry| {
+        if (entry.kind != .file) continue;
+        if (entry.basename[0] == '.') continue;
+        if (AgenticAIOnWord.ingest.isLikelyBinary(entry.basename)) continue;
+
+        const file = dir.openFile(entry.path, .{}) catch continue;
+        defer file.close();
+        const content = file.readToEndAlloc(allocator, AgenticAIOnWord.files.max_folder_file_size) catch continue;
+        defer allocator.free(content);
+        try text.print(allocator, "\n--- File: {s} ---\n{s}\n", .{ entry.path, content });
+        files += 1;
+    }
+    return .{ .files = files, .bytes = text.items.len, .ns = timer.read() };
+}
+
+fn mib(bytes: usize) f64 {
+    return @as(f64, @floatFromInt(bytes)) / (1024 * 1024);
+}
+
+fn ms(ns: u64) f64 {
+    return @as(f64, @floatFromInt(ns)) / std.time.ns_per_ms;
+}
+
+// ============================================================================
+// Minimal WebSocket client helpers
+// ============================================================================
+
+/// Perform the client side of the upgrade handshake
+fn wsHandshake(stream: net.Stream) !void {
+    const request = "GET / HTTP/1.1\r\n" ++
+        "Host: localhost\r\n" ++
+        "Upgrade: websocket\r\n" ++
+        "Connection: Upgrade\r\n" ++
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n" ++
+        "Sec-WebSocket-Version: 13\r\n\r\n";
+    _ = try stream.writeAll(request);
+
+    var buf: [512]u8 = undefined;
+    var len: usize = 0;
+    while (std.mem.indexOf(u8, buf[0..len], "\r\n\r\n") == null) {
+        if (len == buf.len) return error.HandshakeTooLarge;
+        const n = try std.posix.recv(stream.handle, buf[len..], 0);
+        if (n == 0) return error.ConnectionClosed;
+        len += n;
+    }
+    if (!std.mem.startsWith(u8, buf[0..len], "HTTP/1.1 101")) return error.HandshakeRejected;
+}
+
+/// Encode a masked client text frame (zero mask key) into `buf`
+fn encodeClientFrame(buf: []u8, payload: []const u8) []const u8 {
+    std.debug.assert(payload.len < 126 and buf.len >= payload.len + 6);
+    buf[0] = 0x81;
+    buf[1] = 0x80 | @as(u8, @intCast(payload.len));
+    @memset(buf[2..6], 0);
+    @memcpy(buf[6 .. 6 + payload.len], payload);
+    return buf[0 .. 6 + payload.len];
+}
+
+/// Read one unmasked server frame and return its payload
+fn readServerFrame(stream: net.Stream, buf: []u8) ![]u8 {
+    var header: [10]u8 = undefined;
+    try recvExact(stream, header[0..2]);
+
+    var len: usize = header[1] & 0x7F;
+    if (len == 126) {
+        try recvExact(stream, header[2..4]);
+        len = (@as(usize, header[2]) << 8) | header[3];
+    } else if (len == 127) {
+        try recvExact(stream, header[2..10]);
+        len = 0;
+        for (header[2..10]) |b| len = (len << 8) | b;
+    }
+
+    if (len > buf.len) return error.FrameTooLarge;
+    try recvExact(stream, buf[0..len]);
+    return buf[0..len];
+}
+
+fn recvExact(stream: net.Stream, buf: []u8) !void {
+    var total: usize = 0;
+    while (total < buf.len) {
+        const n = try std.posix.recv(stream.handle, buf[total..], 0);
+        if (n == 0) return error.ConnectionClosed;
+        total += n;
+    }
+}
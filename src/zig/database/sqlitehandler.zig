@@ -13,6 +13,12 @@ pub const HistoryChat = struct {
     current_File: []const u8,
 };
 
+/// Size of the response cache
+pub const ResponseCacheTotals = struct {
+    entries: u64,
+    bytes: u64,
+};
+
 /// Optimized SQLite handler using low-level C API
 pub const SqliteHandler = struct {
     const Self = @This();
@@ -20,6 +26,8 @@ pub const SqliteHandler = struct {
 
     db: ?*c.sqlite3,
     allocator: std.mem.Allocator,
+    /// Serializes access from concurrent server workers
+    mutex: std.Thread.Mutex = .{},
 
     /// Initialize database connection
     pub fn init(allocator: std.mem.Allocator, db_path: [:0]const u8) !Self {
@@ -61,7 +69,17 @@ pub const SqliteHandler = struct {
             "timestamp TEXT NOT NULL," ++
             "file TEXT DEFAULT ''," ++
             "role VARCHAR(100) NOT NULL," ++
-            "current_File VARCHAR(255) NOT NULL )";
+            "current_File VARCHAR(255) NOT NULL );" ++
+            // Finished answers by request key (see MCPHandler). created_at
+            // is in seconds since the epoch; last_used counts up with every
+            // store and hit, ordering entries by recency exactly
+            "CREATE TABLE IF NOT EXISTS response_cache (" ++
+            "key BLOB PRIMARY KEY," ++
+            "content TEXT NOT NULL," ++
+            "size INTEGER NOT NULL," ++
+            "created_at INTEGER NOT NULL," ++
+            "last_used INTEGER NOT NULL );" ++
+            "CREATE INDEX IF NOT EXISTS response_cache_last_used ON response_cache (last_used)";
 
         var err_msg: [*c]u8 = null;
         const result = c.sqlite3_exec(self.db, create_sql, null, null, &err_msg);
@@ -112,6 +130,9 @@ pub const SqliteHandler = struct {
         if (self.db == null) {
             return error.SqliteNotInitialized;
         }
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
         const uuid_str = generateUuid();
         const timestampstring: [19]u8 = getCurrentTimestampString();
         // const timestamp = getCurrentTimestamp();
@@ -143,8 +164,116 @@ pub const SqliteHandler = struct {
         std.debug.print("[SQLite] Inserted message with UUID: {s}\n", .{uuid_str});
     }
 
+    /// The cached answer for `key` if it is younger than `max_age_s`,
+    /// allocated with `allocator`. A hit counts as a use for eviction.
+    pub fn getCachedResponse(self: *Self, allocator: std.mem.Allocator, key: []const u8, max_age_s: i64) !?[]u8 {
+        if (self.db == null) {
+            return error.SqliteNotInitialized;
+        }
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        const update_sql = "UPDATE response_cache SET last_used = (SELECT MAX(last_used) + 1 FROM response_cache) " ++
+            "WHERE key = ? AND created_at > ? RETURNING content";
+
+        var stmt: ?*c.sqlite3_stmt = null;
+        if (c.sqlite3_prepare_v2(self.db, update_sql, -1, &stmt, null) != c.SQLITE_OK) {
+            return error.SqlitePrepareFailed;
+        }
+        defer _ = c.sqlite3_finalize(stmt);
+
+        _ = c.sqlite3_bind_blob(stmt, 1, key.ptr, @intCast(key.len), null);
+        _ = c.sqlite3_bind_int64(stmt, 2, getCurrentTimestamp() - max_age_s);
+
+        return switch (c.sqlite3_step(stmt)) {
+            c.SQLITE_ROW => blk: {
+                const content_ptr = c.sqlite3_column_text(stmt, 0);
+                const content_len: usize = @intCast(c.sqlite3_column_bytes(stmt, 0));
+                const content = try allocator.alloc(u8, content_len);
+                if (content_ptr != null) {
+                    @memcpy(content, content_ptr[0..content_len]);
+                }
+                break :blk content;
+            },
+            c.SQLITE_DONE => null,
+            else => error.SqliteStepFailed,
+        };
+    }
+
+    /// Cache an answer under `key`, then evict entries older than
+    /// `max_age_s` and, least recently used first, whatever exceeds
+    /// `max_bytes` of content in total
+    pub fn putCachedResponse(self: *Self, key: []const u8, content: []const u8, max_age_s: i64, max_bytes: u64) !void {
+        if (self.db == null) {
+            return error.SqliteNotInitialized;
+        }
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        const now = getCurrentTimestamp();
+        const insert_sql = "INSERT OR REPLACE INTO response_cache (key, content, size, created_at, last_used) " ++
+            "VALUES (?, ?, ?, ?, (SELECT COALESCE(MAX(last_used), 0) + 1 FROM response_cache))";
+        {
+            var stmt: ?*c.sqlite3_stmt = null;
+            if (c.sqlite3_prepare_v2(self.db, insert_sql, -1, &stmt, null) != c.SQLITE_OK) {
+                return error.SqlitePrepareFailed;
+            }
+            defer _ = c.sqlite3_finalize(stmt);
+
+            _ = c.sqlite3_bind_blob(stmt, 1, key.ptr, @intCast(key.len), null);
+            _ = c.sqlite3_bind_text(stmt, 2, content.ptr, @intCast(content.len), null);
+            _ = c.sqlite3_bind_int64(stmt, 3, @intCast(content.len));
+            _ = c.sqlite3_bind_int64(stmt, 4, now);
+
+            if (c.sqlite3_step(stmt) != c.SQLITE_DONE) {
+                return error.SqliteStepFailed;
+            }
+        }
+
+        // Keeps the most recently used entries whose sizes add up to at
+        // most `max_bytes`
+        const evict_sql = "DELETE FROM response_cache WHERE created_at <= ? OR key IN (" ++
+            "SELECT key FROM (SELECT key, SUM(size) OVER (ORDER BY last_used DESC) AS kept " ++
+            "FROM response_cache) WHERE kept > ?)";
+        var stmt: ?*c.sqlite3_stmt = null;
+        if (c.sqlite3_prepare_v2(self.db, evict_sql, -1, &stmt, null) != c.SQLITE_OK) {
+            return error.SqlitePrepareFailed;
+        }
+        defer _ = c.sqlite3_finalize(stmt);
+
+        _ = c.sqlite3_bind_int64(stmt, 1, now - max_age_s);
+        _ = c.sqlite3_bind_int64(stmt, 2, @intCast(max_bytes));
+
+        if (c.sqlite3_step(stmt) != c.SQLITE_DONE) {
+            return error.SqliteStepFailed;
+        }
+    }
+
+    /// Entries in the response cache and their content bytes
+    pub fn responseCacheTotals(self: *Self) !ResponseCacheTotals {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        var stmt: ?*c.sqlite3_stmt = null;
+        if (c.sqlite3_prepare_v2(self.db, "SELECT COUNT(*), TOTAL(size) FROM response_cache", -1, &stmt, null) != c.SQLITE_OK) {
+            return error.SqlitePrepareFailed;
+        }
+        defer _ = c.sqlite3_finalize(stmt);
+
+        if (c.sqlite3_step(stmt) != c.SQLITE_ROW) {
+            return error.SqliteStepFailed;
+        }
+        return .{
+            .entries = @intCast(c.sqlite3_column_int64(stmt, 0)),
+            .bytes = @intFromFloat(c.sqlite3_column_double(stmt, 1)),
+        };
+    }
+
     /// Delete all history
     pub fn deleteAll(self: *Self) !void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
         var err_msg: [*c]u8 = null;
         const result = c.sqlite3_exec(self.db, "DELETE FROM history_chat", null, null, &err_msg);
 
@@ -159,6 +288,9 @@ pub const SqliteHandler = struct {
 
     /// Get all history chat records
     pub fn getTables(self: *Self) !std.ArrayList(HistoryChat) {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
         const select_sql = "SELECT * FROM history_chat";
 
         var stmt: ?*c.sqlite3_stmt = null;
@@ -246,7 +378,33 @@ pub const SqliteHandler = struct {
             self.allocator.free(item.message);
             self.allocator.free(item.timestamp);
             self.allocator.free(item.file);
+            self.allocator.free(item.role);
+            self.allocator.free(item.current_File);
         }
         records.deinit(self.allocator);
     }
 };
+
+test "response cache expires entries and evicts the least recently used" {
+    var db = try SqliteHandler.init(std.testing.allocator, ":memory:");
+    defer db.deinit();
+    const allocator = std.testing.allocator;
+
+    try db.putCachedResponse("a", "0123456789", 3600, 25);
+    try db.putCachedResponse("b", "0123456789", 3600, 25);
+    // Refreshes "a", so "b" is the one to go
+    allocator.free((try db.getCachedResponse(allocator, "a", 3600)).?);
+    try db.putCachedResponse("c", "0123456789", 3600, 25);
+
+    try std.testing.expect(try db.getCachedResponse(allocator, "b", 3600) == null);
+    const hit = (try db.getCachedResponse(allocator, "c", 3600)).?;
+    defer allocator.free(hit);
+    try std.testing.expectEqualStrings("0123456789", hit);
+
+    const totals = try db.responseCacheTotals();
+    try std.testing.expectEqual(@as(u64, 2), totals.entries);
+    try std.testing.expectEqual(@as(u64, 20), totals.bytes);
+
+    // Nothing is younger than a negative age
+    try std.testing.expect(try db.getCachedResponse(allocator, "c", -1) == null);
+}
@@ -0,0 +1,472 @@
+//! Contents of the files and folders that prompts are about, kept in memory
+//! between requests. An entry is revalidated with a stat of each file (and
+//! of each directory and ignore file, for a folder) instead of being read
+//! again, and its bytes are shared by every request using it at the same
+//! time. Folders are listed by ingest.zig.
+const std = @import("std");
+const Allocator = std.mem.Allocator;
+const ingest = @import("ingest.zig");
+const Stamp = ingest.Stamp;
+
+pub const Options = struct {
+    /// Content bytes kept; the least recently used entries are dropped
+    /// beyond this. An entry larger than this is used once and not kept.
+    max_bytes: usize = 64 * 1024 * 1024,
+    /// Threads that list, stat and read the files of a folder at once;
+    /// 0 for one per core
+    threads: usize = 0,
+};
+
+/// Part of a file read when it is the subject of a request
+pub const max_file_size: usize = 1024 * 1024;
+/// Part of each file read when a folder is the subject
+pub const max_folder_file_size: usize = 64 * 1024;
+
+/// How one read was served
+pub const ReadStats = struct {
+    /// Stats, walk and reads together
+    walk_ns: u64 = 0,
+    files: usize = 0,
+    /// Left out of a folder by .gitignore and .ignore rules
+    ignored: usize = 0,
+    /// Left out of a folder as their content is not text
+    binary: usize = 0,
+    /// Read from disk for this request
+    bytes_read: usize = 0,
+    /// Served from memory
+    bytes_cached: usize = 0,
+};
+
+/// The text of a file, or of every file of a folder each under a header.
+/// Shared with the cache and other requests; call deinit when done.
+pub const Content = struct {
+    entry: *Entry,
+    stats: ReadStats,
+
+    pub fn text(self: Content) []const u8 {
+        return self.entry.bytes;
+    }
+
+    pub fn deinit(self: Content) void {
+        self.entry.release();
+    }
+};
+
+const Kind = enum { file, folder };
+
+/// Never changed once cached: a newer version replaces it. Freed when the
+/// cache and every request have let go of it.
+const Entry = struct {
+    refs: std.atomic.Value(u32) = .init(1),
+    allocator: Allocator,
+    kind: Kind,
+    /// The map key, owned
+    key: []u8,
+    buffer: []u8,
+    /// The part of `buffer` in use
+    bytes: []const u8,
+    /// A file's own stamp
+    mtime: i128 = 0,
+    size: u64 = 0,
+    /// Whether a file's content looks like text
+    is_text: bool = true,
+    /// What a folder's listing depends on and the files in it, in `arena`
+    watched: []Stamp = &.{},
+    files: []Stamp = &.{},
+    /// How a folder's text was made up
+    summary: ReadStats = .{},
+    arena: std.heap.ArenaAllocator,
+    /// Place in the cache's LRU list, guarded by its mutex
+    node: std.DoublyLinkedList.Node = .{},
+
+    fn create(allocator: Allocator, kind: Kind, key: []const u8, buffer: []u8) !*Entry {
+        const entry = try allocator.create(Entry);
+        errdefer allocator.destroy(entry);
+        entry.* = .{
+            .allocator = allocator,
+            .kind = kind,
+            .key = try allocator.dupe(u8, key),
+            .buffer = buffer,
+            .bytes = buffer,
+            .arena = .init(allocator),
+        };
+        return entry;
+    }
+
+    fn retain(self: *Entry) *Entry {
+        _ = self.refs.fetchAdd(1, .monotonic);
+        return self;
+    }
+
+    fn release(self: *Entry) void {
+        if (self.refs.fetchSub(1, .acq_rel) != 1) return;
+        self.arena.deinit();
+        self.allocator.free(self.buffer);
+        self.allocator.free(self.key);
+        self.allocator.destroy(self);
+    }
+};
+
+/// Safe for concurrent use. Two requests missing the same file at once
+/// both read it; the later read replaces the earlier entry.
+pub const FileCache = struct {
+    const Self = @This();
+
+    /// Used from every worker thread; must be thread-safe
+    allocator: Allocator,
+    options: Options,
+    mutex: std.Thread.Mutex = .{},
+    map: std.StringHashMapUnmanaged(*Entry) = .empty,
+    /// Most recently used first
+    lru: std.DoublyLinkedList = .{},
+    /// Sum of the cached entries' buffers
+    bytes: usize = 0,
+
+    pub fn init(allocator: Allocator, options: Options) Self {
+        return .{ .allocator = allocator, .options = options };
+    }
+
+    pub fn deinit(self: *Self) void {
+        var it = self.map.valueIterator();
+        while (it.next()) |entry| entry.*.release();
+        self.map.deinit(self.allocator);
+    }
+
+    /// The content of `path`, a file or a folder
+    pub fn read(self: *Self, path: []const u8) !Content {
+        var timer = try std.time.Timer.start();
+        var stats: ReadStats = .{};
+
+        const stat = try std.fs.cwd().statFile(path);
+        const entry = if (stat.kind == .directory)
+            try self.readFolder(path, &stats)
+        else
+            try self.readFile(std.fs.cwd(), path, path, stampOf("", stat), max_file_size, &stats);
+        if (stat.kind != .directory) stats.files = 1;
+
+        stats.walk_ns = timer.read();
+        return .{ .entry = entry, .stats = stats };
+    }
+
+    /// At least the first `limit` bytes of `sub_path` in `dir`, cached
+    /// under `key`. `stat` is how the file was just seen.
+    fn readFile(self: *Self, dir: std.fs.Dir, sub_path: []const u8, key: []const u8, stat: Stamp, limit: usize, stats: *ReadStats) !*Entry {
+        if (self.lookup(key, .file)) |entry| {
+            if (entry.mtime == stat.mtime and entry.size == stat.size and
+                entry.bytes.len >= @min(stat.size, limit))
+            {
+                stats.bytes_cached += @min(entry.bytes.len, limit);
+                return entry;
+            }
+            entry.release();
+        }
+
+        const file = try dir.openFile(sub_path, .{});
+        defer file.close();
+        // The stamp of what is read, should the file change meanwhile
+        const opened = try file.stat();
+
+        const buffer = try self.allocator.alloc(u8, @min(opened.size, limit));
+        const entry = Entry.create(self.allocator, .file, key, buffer) catch |err| {
+            self.allocator.free(buffer);
+            return err;
+        };
+        errdefer entry.release();
+
+        entry.bytes = buffer[0..try file.readAll(buffer)];
+        entry.mtime = opened.mtime;
+        entry.size = opened.size;
+        entry.is_text = ingest.isText(entry.bytes);
+        stats.bytes_read += entry.bytes.len;
+
+        self.insert(entry);
+        return entry;
+    }
+
+    /// Every file under `path` that is not hidden, ignored or binary, each
+    /// after a header and cut to max_folder_file_size, in path order
+    fn readFolder(self: *Self, path: []const u8, stats: *ReadStats) !*Entry {
+        var dir = try std.fs.cwd().openDir(path, .{ .iterate = true });
+        defer dir.close();
+
+        var cached = self.lookup(path, .folder);
+        defer if (cached) |entry| entry.release();
+
+        // No directory gained or lost entries and no ignore file changed:
+        // the same files are listed; walk again otherwise
+        var listing_valid = false;
+        if (cached) |entry| {
+            listing_valid = for (entry.watched) |stamp| {
+                const stat = statIn(dir, stamp.path) catch break false;
+                if (stat.mtime != stamp.mtime) break false;
+            } else true;
+        }
+
+        const entry = blk: {
+            const empty = try self.allocator.alloc(u8, 0);
+            break :blk Entry.create(self.allocator, .folder, path, empty) catch |err| {
+                self.allocator.free(empty);
+                return err;
+            };
+        };
+        errdefer entry.release();
+        const arena = entry.arena.allocator();
+
+        if (listing_valid) {
+            // Copied, as the cached entry may go first
+            const before = cached.?;
+            entry.watched = try arena.alloc(Stamp, before.watched.len);
+            for (entry.watched, before.watched) |*copy, stamp| {
+                copy.* = .{ .path = try arena.dupe(u8, stamp.path), .mtime = stamp.mtime, .size = 0 };
+            }
+            entry.files = try arena.alloc(Stamp, before.files.len);
+            for (entry.files, before.files) |*copy, stamp| {
+                copy.* = .{ .path = try arena.dupe(u8, stamp.path), .mtime = 0, .size = 0 };
+            }
+            entry.summary.ignored = before.summary.ignored;
+        } else {
+            const listing = try ingest.list(self.allocator, arena, dir, self.options.threads);
+            entry.watched = listing.watched;
+            entry.files = listing.files;
+            entry.summary.ignored = listing.ignored;
+        }
+
+        const found = try self.allocator.alloc(bool, entry.files.len);
+        defer self.allocator.free(found);
+        @memset(found, false);
+        const results = try self.allocator.alloc(FolderRead.Result, entry.files.len);
+        defer {
+            for (results) |result| {
+                if (result.entry) |file| file.release();
+            }
+            self.allocator.free(results);
+        }
+        @memset(results, .{});
+
+        var folder: FolderRead = .{
+            .cache = self,
+            .dir = dir,
+            .path = path,
+            .files = entry.files,
+            .found = found,
+            .results = results,
+        };
+
+        ingest.forEach(self.options.threads, entry.files.len, &folder, FolderRead.stat);
+
+        // Nothing changed at all: the text from last time is still right
+        if (listing_valid) {
+            const unchanged = for (entry.files, found, cached.?.files) |now, ok, before| {
+                if (!ok or now.mtime != before.mtime or now.size != before.size) break false;
+            } else true;
+            if (unchanged) {
+                entry.release();
+                const hit = cached.?;
+                cached = null;
+                stats.files = hit.summary.files;
+                stats.ignored = hit.summary.ignored;
+                stats.binary = hit.summary.binary;
+                stats.bytes_cached += hit.bytes.len;
+                return hit;
+            }
+        }
+
+        ingest.forEach(self.options.threads, entry.files.len, &folder, FolderRead.read);
+
+        var text: std.ArrayList(u8) = .empty;
+        defer text.deinit(self.allocator);
+        for (entry.files, results) |stamp, result| {
+            stats.bytes_read += result.stats.bytes_read;
+            stats.bytes_cached += result.stats.bytes_cached;
+            const file = result.entry orelse continue;
+            if (!file.is_text) {
+                entry.summary.binary += 1;
+                continue;
+            }
+            entry.summary.files += 1;
+
+            try text.appendSlice(self.allocator, "\n--- File: ");
+            try text.appendSlice(self.allocator, stamp.path);
+            try text.appendSlice(self.allocator, " ---\n");
+            if (file.size > max_folder_file_size) {
+                try text.appendSlice(self.allocator, "[File too large, truncated]\n");
+            }
+            try text.appendSlice(self.allocator, file.bytes[0..@min(file.bytes.len, max_folder_file_size)]);
+            try text.appendSlice(self.allocator, "\n");
+        }
+
+        const buffer = try text.toOwnedSlice(self.allocator);
+        self.allocator.free(entry.buffer);
+        entry.buffer = buffer;
+        entry.bytes = entry.buffer;
+        stats.files = entry.summary.files;
+        stats.ignored = entry.summary.ignored;
+        stats.binary = entry.summary.binary;
+
+        self.insert(entry);
+        return entry;
+    }
+
+    /// A retained entry for `key` of this kind, now the most recently used
+    fn lookup(self: *Self, key: []const u8, kind: Kind) ?*Entry {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        const entry = self.map.get(key) orelse return null;
+        if (entry.kind != kind) return null;
+        self.lru.remove(&entry.node);
+        self.lru.prepend(&entry.node);
+        return entry.retain();
+    }
+
+    /// Keep `entry` in place of any older one for its key, then drop the
+    /// least recently used entries beyond the memory ceiling
+    fn insert(self: *Self, entry: *Entry) void {
+        if (entry.buffer.len > self.options.max_bytes) return;
+
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        const slot = self.map.getOrPut(self.allocator, entry.key) catch return;
+        if (slot.found_existing) self.drop(slot.value_ptr.*);
+        // The key now points into the new entry
+        slot.key_ptr.* = entry.key;
+        slot.value_ptr.* = entry.retain();
+        self.lru.prepend(&entry.node);
+        self.bytes += entry.buffer.len;
+
+        while (self.bytes > self.options.max_bytes) {
+            const oldest: *Entry = @fieldParentPtr("node", self.lru.last.?);
+            _ = self.map.remove(oldest.key);
+            self.drop(oldest);
+        }
+    }
+
+    /// Let go of an entry already taken out of the map
+    fn drop(self: *Self, entry: *Entry) void {
+        self.lru.remove(&entry.node);
+        self.bytes -= entry.buffer.len;
+        entry.release();
+    }
+
+    /// Memory held for the cache and its number of entries
+    pub fn usage(self: *Self) struct { bytes: usize, entries: usize } {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        return .{ .bytes = self.bytes, .entries = self.map.count() };
+    }
+};
+
+/// The files of one folder, stat'd and then read on several threads. Each
+/// thread writes only to the slots of the files it was handed.
+const FolderRead = struct {
+    cache: *FileCache,
+    dir: std.fs.Dir,
+    path: []const u8,
+    files: []Stamp,
+    /// Whether each file's stat succeeded
+    found: []bool,
+    results: []Result,
+
+    const Result = struct {
+        entry: ?*Entry = null,
+        stats: ReadStats = .{},
+    };
+
+    fn stat(self: *FolderRead, i: usize) void {
+        const file = &self.files[i];
+        const info = self.dir.statFile(file.path) catch return;
+        file.mtime = info.mtime;
+        file.size = info.size;
+        self.found[i] = true;
+    }
+
+    /// A file that cannot be read is left out
+    fn read(self: *FolderRead, i: usize) void {
+        if (!self.found[i]) return;
+        const allocator = self.cache.allocator;
+        const key = std.fs.path.join(allocator, &.{ self.path, self.files[i].path }) catch return;
+        defer allocator.free(key);
+        const result = &self.results[i];
+        result.entry = self.cache.readFile(self.dir, self.files[i].path, key, self.files[i], max_folder_file_size, &result.stats) catch null;
+    }
+};
+
+fn stampOf(path: []const u8, stat: std.fs.File.Stat) Stamp {
+    return .{ .path = path, .mtime = stat.mtime, .size = stat.size };
+}
+
+fn statIn(dir: std.fs.Dir, sub_path: []const u8) !std.fs.File.Stat {
+    return if (sub_path.len == 0) dir.stat() else dir.statFile(sub_path);
+}
+
+test "file cache serves unchanged files from memory and re-reads changed ones" {
+    const testing = std.testing;
+    var tmp = testing.tmpDir(.{ .iterate = true });
+    defer tmp.cleanup();
+
+    try tmp.dir.makePath("folder/sub");
+    try tmp.dir.writeFile(.{ .sub_path = "folder/a.txt", .data = "alpha" });
+    try tmp.dir.writeFile(.{ .sub_path = "folder/sub/b.txt", .data = "beta" });
+    try tmp.dir.writeFile(.{ .sub_path = "folder/image.png", .data = "not text" });
+    try tmp.dir.writeFile(.{ .sub_path = "folder/blob", .data = "\x00\x01binary" });
+
+    const folder = try tmp.dir.realpathAlloc(testing.allocator, "folder");
+    defer testing.allocator.free(folder);
+
+    var cache = FileCache.init(testing.allocator, .{});
+    defer cache.deinit();
+
+    const first = try cache.read(folder);
+    defer first.deinit();
+    try testing.expectEqual(@as(usize, 2), first.stats.files);
+    try testing.expectEqual(@as(usize, 1), first.stats.binary);
+    try testing.expectEqual(@as(usize, 17), first.stats.bytes_read);
+    try testing.expect(std.mem.indexOf(u8, first.text(), "alpha") != null);
+    try testing.expect(std.mem.indexOf(u8, first.text(), "not text") == null);
+    try testing.expect(std.mem.indexOf(u8, first.text(), "binary") == null);
+    // In path order
+    try testing.expect(std.mem.indexOf(u8, first.text(), "alpha").? < std.mem.indexOf(u8, first.text(), "beta").?);
+
+    // Nothing changed: the same text, nothing read
+    const second = try cache.read(folder);
+    defer second.deinit();
+    try testing.expectEqual(@as(usize, 0), second.stats.bytes_read);
+    try testing.expectEqual(first.text().ptr, second.text().ptr);
+
+    // One file changes size: only it is read again
+    try tmp.dir.writeFile(.{ .sub_path = "folder/a.txt", .data = "alpha, longer" });
+    const third = try cache.read(folder);
+    defer third.deinit();
+    try testing.expectEqual(@as(usize, 13), third.stats.bytes_read);
+    try testing.expect(std.mem.indexOf(u8, third.text(), "alpha, longer") != null);
+    // The earlier text is still intact for whoever holds it
+    try testing.expect(std.mem.indexOf(u8, first.text(), "alpha\n") != null);
+}
+
+test "file cache stays under its memory ceiling" {
+    const testing = std.testing;
+    var tmp = testing.tmpDir(.{});
+    defer tmp.cleanup();
+
+    const data = "x" ** 100;
+    try tmp.dir.writeFile(.{ .sub_path = "one", .data = data });
+    try tmp.dir.writeFile(.{ .sub_path = "two", .data = data });
+    const one = try tmp.dir.realpathAlloc(testing.allocator, "one");
+    defer testing.allocator.free(one);
+    const two = try tmp.dir.realpathAlloc(testing.allocator, "two");
+    defer testing.allocator.free(two);
+
+    var cache = FileCache.init(testing.allocator, .{ .max_bytes = 150 });
+    defer cache.deinit();
+
+    (try cache.read(one)).deinit();
+    (try cache.read(two)).deinit();
+    try testing.expectEqual(@as(usize, 1), cache.usage().entries);
+    try testing.expectEqual(@as(usize, 100), cache.usage().bytes);
+
+    // "one" was evicted, "two" was not
+    const again = try cache.read(two);
+    defer again.deinit();
+    try testing.expectEqual(@as(usize, 0), again.stats.bytes_read);
+}
@@ -0,0 +1,558 @@
+//! Listing the files of a folder for a prompt. The walk is spread over
+//! threads that take directories from each other when they run out, leaves
+//! out what .gitignore and .ignore files exclude, and is sorted by path so
+//! the same tree always gives the same prompt. Text is told from binary by
+//! looking at the bytes, not only at the extension.
+const std = @import("std");
+const Allocator = std.mem.Allocator;
+
+/// When a file or directory was last seen
+pub const Stamp = struct {
+    /// Relative to the folder, '/' separated; empty for the folder itself
+    path: []const u8,
+    mtime: i128,
+    size: u64,
+};
+
+pub const Listing = struct {
+    /// Files to include, sorted by path, not yet stat'd
+    files: []Stamp,
+    /// Every directory walked and ignore file read, sorted by path: the
+    /// listing holds as long as none of them changes
+    watched: []Stamp,
+    /// Files and directories left out by ignore rules
+    ignored: usize,
+};
+
+/// Bytes looked at to tell text from binary
+pub const sniff_size: usize = 8192;
+
+const max_threads = 64;
+/// Ignore files larger than this are not read
+const max_ignore_file_size: usize = 1024 * 1024;
+/// forEach gives each thread at least this many items
+const min_items_per_thread = 16;
+
+/// Threads to use when asked for `threads`, 0 meaning one per core
+pub fn threadCount(threads: usize) usize {
+    const count = if (threads != 0) threads else std.Thread.getCpuCount() catch 1;
+    return @min(count, max_threads);
+}
+
+/// The files below `root` to include, walked on up to `threads` threads
+/// (0 for one per core), the calling one included. Hidden files and
+/// directories are left out, as are ignored ones and those with a binary
+/// extension. The result is allocated with `arena`; `allocator` is used
+/// from every walking thread and must be thread-safe.
+pub fn list(allocator: Allocator, arena: Allocator, root: std.fs.Dir, threads: usize) !Listing {
+    const workers = try allocator.alloc(Worker, threadCount(threads));
+    defer allocator.free(workers);
+    for (workers) |*worker| worker.* = .{ .arena = .init(allocator) };
+    defer for (workers) |*worker| {
+        worker.jobs.deinit(allocator);
+        worker.arena.deinit();
+    };
+
+    var walk: Walk = .{ .allocator = allocator, .root = root, .workers = workers };
+    try walk.push(&workers[0], .{ .path = "", .ignores = null });
+
+    // A worker whose thread did not start never has jobs of its own, and
+    // the others do its share
+    var helpers: [max_threads]std.Thread = undefined;
+    var spawned: usize = 0;
+    for (1..workers.len) |index| {
+        helpers[spawned] = std.Thread.spawn(.{}, Walk.run, .{ &walk, index }) catch break;
+        spawned += 1;
+    }
+    walk.run(0);
+    for (helpers[0..spawned]) |thread| thread.join();
+
+    var files_len: usize = 0;
+    var watched_len: usize = 0;
+    var ignored: usize = 0;
+    for (workers) |worker| {
+        if (worker.err) |err| return err;
+        files_len += worker.files.items.len;
+        watched_len += worker.watched.items.len;
+        ignored += worker.ignored;
+    }
+
+    // Out of the workers' arenas, which go with them
+    const files = try arena.alloc(Stamp, files_len);
+    const watched = try arena.alloc(Stamp, watched_len);
+    var file_index: usize = 0;
+    var watched_index: usize = 0;
+    for (workers) |worker| {
+        for (worker.files.items) |stamp| {
+            files[file_index] = .{ .path = try arena.dupe(u8, stamp.path), .mtime = stamp.mtime, .size = stamp.size };
+            file_index += 1;
+        }
+        for (worker.watched.items) |stamp| {
+            watched[watched_index] = .{ .path = try arena.dupe(u8, stamp.path), .mtime = stamp.mtime, .size = stamp.size };
+            watched_index += 1;
+        }
+    }
+    std.mem.sort(Stamp, files, {}, lessByPath);
+    std.mem.sort(Stamp, watched, {}, lessByPath);
+
+    return .{ .files = files, .watched = watched, .ignored = ignored };
+}
+
+fn lessByPath(_: void, a: Stamp, b: Stamp) bool {
+    return std.mem.lessThan(u8, a.path, b.path);
+}
+
+/// A directory to visit
+const Job = struct {
+    path: []const u8,
+    /// Rules in force for its entries, from the directories above it
+    ignores: ?*const Ignores,
+};
+
+const Worker = struct {
+    /// Paths, ignore files and the lists below
+    arena: std.heap.ArenaAllocator,
+    /// Guards `jobs`, which other workers take from
+    mutex: std.Thread.Mutex = .{},
+    /// The owner takes from the end, depth first; others take from the
+    /// front, where the larger subtrees are
+    jobs: std.ArrayList(Job) = .empty,
+    files: std.ArrayList(Stamp) = .empty,
+    watched: std.ArrayList(Stamp) = .empty,
+    ignored: usize = 0,
+    err: ?anyerror = null,
+};
+
+const Walk = struct {
+    allocator: Allocator,
+    root: std.fs.Dir,
+    workers: []Worker,
+    /// Jobs queued or being visited; the walk is over when none are left
+    pending: std.atomic.Value(usize) = .init(0),
+
+    fn push(self: *Walk, worker: *Worker, job: Job) !void {
+        // Counted first: the job pushing it is still pending, so the count
+        // cannot reach zero in between
+        _ = self.pending.fetchAdd(1, .acq_rel);
+        worker.mutex.lock();
+        defer worker.mutex.unlock();
+        worker.jobs.append(self.allocator, job) catch |err| {
+            _ = self.pending.fetchSub(1, .acq_rel);
+            return err;
+        };
+    }
+
+    /// A job of worker `index`'s own, else one taken from another
+    fn take(self: *Walk, index: usize) ?Job {
+        const own = &self.workers[index];
+        own.mutex.lock();
+        const job = own.jobs.pop();
+        own.mutex.unlock();
+        if (job != null) return job;
+
+        for (1..self.workers.len) |offset| {
+            const other = &self.workers[(index + offset) % self.workers.len];
+            other.mutex.lock();
+            defer other.mutex.unlock();
+            if (other.jobs.items.len > 0) return other.jobs.orderedRemove(0);
+        }
+        return null;
+    }
+
+    fn run(self: *Walk, index: usize) void {
+        const worker = &self.workers[index];
+        while (true) {
+            const job = self.take(index) orelse {
+                if (self.pending.load(.acquire) == 0) return;
+                std.Thread.yield() catch {};
+                continue;
+            };
+            self.visit(worker, job) catch |err| switch (err) {
+                error.OutOfMemory => worker.err = err,
+                // A directory that cannot be read is left out
+                else => {},
+            };
+            _ = self.pending.fetchSub(1, .acq_rel);
+        }
+    }
+
+    fn visit(self: *Walk, worker: *Worker, job: Job) !void {
+        const arena = worker.arena.allocator();
+        var dir = try self.root.openDir(if (job.path.len == 0) "." else job.path, .{ .iterate = true });
+        defer dir.close();
+
+        const stat = try dir.stat();
+        try worker.watched.append(arena, .{ .path = job.path, .mtime = stat.mtime, .size = 0 });
+
+        var ignores = job.ignores;
+        var rules: std.ArrayList(Rule) = .empty;
+        // .ignore after .gitignore, so that its rules win
+        for ([_][]const u8{ ".gitignore", ".ignore" }) |name| {
+            const file = dir.openFile(name, .{}) catch continue;
+            defer file.close();
+            const file_stat = file.stat() catch continue;
+            const text = file.readToEndAlloc(arena, max_ignore_file_size) catch |err| switch (err) {
+                error.OutOfMemory => return err,
+                else => continue,
+            };
+            try parseRules(arena, text, &rules);
+            try worker.watched.append(arena, .{ .path = try join(arena, job.path, name), .mtime = file_stat.mtime, .size = 0 });
+        }
+        if (rules.items.len > 0) {
+            const node = try arena.create(Ignores);
+            node.* = .{ .base = job.path, .rules = rules.items, .parent = ignores };
+            ignores = node;
+        }
+
+        var it = dir.iterate();
+        while (try it.next()) |entry| {
+            // Hidden files and directories, .git among them
+            if (entry.name[0] == '.') continue;
+            if (entry.kind != .directory and entry.kind != .file) continue;
+
+            const path = try join(arena, job.path, entry.name);
+            if (isIgnored(ignores, path, entry.kind == .directory)) {
+                worker.ignored += 1;
+                continue;
+            }
+            if (entry.kind == .directory) {
+                try self.push(worker, .{ .path = path, .ignores = ignores });
+            } else if (!isLikelyBinary(entry.name)) {
+                try worker.files.append(arena, .{ .path = path, .mtime = 0, .size = 0 });
+            }
+        }
+    }
+};
+
+fn join(allocator: Allocator, dir: []const u8, name: []const u8) ![]const u8 {
+    if (dir.len == 0) return allocator.dupe(u8, name);
+    return std.mem.concat(allocator, u8, &.{ dir, "/", name });
+}
+
+/// Call `func(context, i)` for every i below `count`, spread over up to
+/// `threads` threads (0 for one per core), the calling one included
+pub fn forEach(threads: usize, count: usize, context: anytype, comptime func: fn (@TypeOf(context), usize) void) void {
+    const Shared = struct {
+        next: std.atomic.Value(usize) = .init(0),
+        count: usize,
+        context: @TypeOf(context),
+
+        fn run(shared: *@This()) void {
+            while (true) {
+                const i = shared.next.fetchAdd(1, .monotonic);
+                if (i >= shared.count) return;
+                func(shared.context, i);
+            }
+        }
+    };
+    var shared: Shared = .{ .count = count, .context = context };
+
+    const wanted = @min(threadCount(threads), std.math.divCeil(usize, count, min_items_per_thread) catch unreachable);
+    var helpers: [max_threads]std.Thread = undefined;
+    var spawned: usize = 0;
+    while (spawned + 1 < wanted) {
+        helpers[spawned] = std.Thread.spawn(.{}, Shared.run, .{&shared}) catch break;
+        spawned += 1;
+    }
+    shared.run();
+    for (helpers[0..spawned]) |thread| thread.join();
+}
+
+// ============================================================================
+// Ignore files
+// ============================================================================
+
+/// One line of an ignore file
+pub const Rule = struct {
+    pattern: []const u8,
+    /// `!pattern`: include again what an earlier rule left out
+    negate: bool = false,
+    /// `pattern/`: only directories
+    dir_only: bool = false,
+    /// A pattern with a slash is matched against the path below the
+    /// ignore file's directory; one without against the name alone, at
+    /// any depth
+    anchored: bool = false,
+};
+
+/// The rules of one directory's ignore files, over those of its parents
+const Ignores = struct {
+    /// The directory, relative to the walk's root
+    base: []const u8,
+    rules: []const Rule,
+    parent: ?*const Ignores,
+};
+
+/// Append the rules of an ignore file in .gitignore syntax. Patterns are
+/// slices of `text`.
+pub fn parseRules(allocator: Allocator, text: []const u8, rules: *std.ArrayList(Rule)) !void {
+    var lines = std.mem.splitScalar(u8, text, '\n');
+    while (lines.next()) |raw| {
+        var line = std.mem.trimRight(u8, raw, "\r");
+        // Trailing spaces do not count unless escaped
+        while (line.len > 0 and line[line.len - 1] == ' ' and
+            !(line.len > 1 and line[line.len - 2] == '\\')) line = line[0 .. line.len - 1];
+        if (line.len == 0 or line[0] == '#') continue;
+
+        var rule: Rule = .{ .pattern = line };
+        if (line[0] == '!') {
+            rule.negate = true;
+            line = line[1..];
+        } else if (line[0] == '\\' and line.len > 1 and (line[1] == '#' or line[1] == '!')) {
+            line = line[1..];
+        }
+        if (std.mem.endsWith(u8, line, "/")) {
+            rule.dir_only = true;
+            line = line[0 .. line.len - 1];
+        }
+        if (std.mem.indexOfScalar(u8, line, '/') != null) {
+            rule.anchored = true;
+            if (line[0] == '/') line = line[1..];
+        }
+        if (line.len == 0) continue;
+
+        rule.pattern = line;
+        try rules.append(allocator, rule);
+    }
+}
+
+/// Whether `path`, relative to the walk's root, is left out. The deepest
+/// ignore file with a matching rule decides, and within a file the last
+/// matching rule.
+fn isIgnored(ignores: ?*const Ignores, path: []const u8, is_dir: bool) bool {
+    var node = ignores;
+    while (node) |n| : (node = n.parent) {
+        const below = if (n.base.len == 0) path else path[n.base.len + 1 ..];
+        const name = if (std.mem.lastIndexOfScalar(u8, below, '/')) |slash| below[slash + 1 ..] else below;
+
+        var i = n.rules.len;
+        while (i > 0) {
+            i -= 1;
+            const rule = n.rules[i];
+            if (rule.dir_only and !is_dir) continue;
+            if (globMatch(rule.pattern, if (rule.anchored) below else name)) return !rule.negate;
+        }
+    }
+    return false;
+}
+
+/// Match a '/' separated path against a gitignore glob: `*` and `?` stop
+/// at '/', `[a-z]` and `[!a-z]` are classes, `\` escapes, and `**` as a
+/// whole path component matches any number of components
+pub fn globMatch(pattern: []const u8, path: []const u8) bool {
+    var p: usize = 0;
+    var s: usize = 0;
+    while (p < pattern.len) {
+        switch (pattern[p]) {
+            '*' => {
+                const double = p + 1 < pattern.len and pattern[p + 1] == '*' and
+                    (p == 0 or pattern[p - 1] == '/') and
+                    (p + 2 == pattern.len or pattern[p + 2] == '/');
+                if (double) {
+                    if (p + 2 == pattern.len) return true;
+                    // `**/`: the rest here, or after any later '/'
+                    const rest = pattern[p + 3 ..];
+                    var at = s;
+                    while (true) {
+                        if (globMatch(rest, path[at..])) return true;
+                        at = 1 + (std.mem.indexOfScalarPos(u8, path, at, '/') orelse return false);
+                    }
+                }
+                const rest = pattern[p + 1 ..];
+                var at = s;
+                while (true) {
+                    if (globMatch(rest, path[at..])) return true;
+                    if (at == path.len or path[at] == '/') return false;
+                    at += 1;
+                }
+            },
+            '?' => {
+                if (s == path.len or path[s] == '/') return false;
+                p += 1;
+                s += 1;
+            },
+            '[' => {
+                const end = classEnd(pattern, p) orelse {
+                    if (s == path.len or path[s] != '[') return false;
+                    p += 1;
+                    s += 1;
+                    continue;
+                };
+                if (s == path.len or path[s] == '/') return false;
+                if (!classMatches(pattern[p + 1 .. end], path[s])) return false;
+                p = end + 1;
+                s += 1;
+            },
+            else => |c| {
+                var literal = c;
+                if (c == '\\' and p + 1 < pattern.len) {
+                    p += 1;
+                    literal = pattern[p];
+                }
+                if (s == path.len or path[s] != literal) return false;
+                p += 1;
+                s += 1;
+            },
+        }
+    }
+    return s == path.len;
+}
+
+/// Index of the ']' closing the class opened at `open`
+fn classEnd(pattern: []const u8, open: usize) ?usize {
+    var i = open + 1;
+    if (i < pattern.len and (pattern[i] == '!' or pattern[i] == '^')) i += 1;
+    // A ']' first is part of the class
+    if (i < pattern.len and pattern[i] == ']') i += 1;
+    while (i < pattern.len) : (i += 1) {
+        if (pattern[i] == '\\') {
+            i += 1;
+        } else if (pattern[i] == ']') {
+            return i;
+        }
+    }
+    return null;
+}
+
+fn classMatches(class: []const u8, c: u8) bool {
+    var body = class;
+    const negate = body.len > 0 and (body[0] == '!' or body[0] == '^');
+    if (negate) body = body[1..];
+
+    var i: usize = 0;
+    while (i < body.len) {
+        var low = body[i];
+        if (low == '\\' and i + 1 < body.len) {
+            i += 1;
+            low = body[i];
+        }
+        i += 1;
+        var high = low;
+        if (i + 1 < body.len and body[i] == '-') {
+            high = body[i + 1];
+            if (high == '\\' and i + 2 < body.len) {
+                high = body[i + 2];
+                i += 1;
+            }
+            i += 2;
+        }
+        if (c >= low and c <= high) return !negate;
+    }
+    return negate;
+}
+
+// ============================================================================
+// Telling text from binary
+// ============================================================================
+
+/// Whether `bytes` look like text: no NUL byte and valid UTF-8 in their
+/// first sniff_size bytes. A character cut off by the end of the sample
+/// does not count against them.
+pub fn isText(bytes: []const u8) bool {
+    var sample = bytes[0..@min(bytes.len, sniff_size)];
+    if (std.mem.indexOfScalar(u8, sample, 0) != null) return false;
+    if (sample.len < bytes.len) sample = withoutPartialCharacter(sample);
+    return std.unicode.utf8ValidateSlice(sample);
+}
+
+fn withoutPartialCharacter(sample: []const u8) []const u8 {
+    // Back to the first byte of the last character
+    var start = sample.len;
+    while (start > 0 and sample.len - start < 4) {
+        start -= 1;
+        if (sample[start] & 0xC0 != 0x80) break;
+    }
+    if (start == sample.len) return sample;
+    const len = std.unicode.utf8ByteSequenceLength(sample[start]) catch return sample;
+    return if (start + len > sample.len) sample[0..start] else sample;
+}
+
+/// Check if file is likely binary based on extension. Cheaper than
+/// sniffing, as such files are not read at all.
+pub fn isLikelyBinary(basename: []const u8) bool {
+    const binary_extensions = [_][]const u8{
+        ".exe", ".dll",  ".so",   ".dylib", ".bin", ".obj",  ".o",
+        ".zip", ".tar",  ".gz",   ".rar",   ".7z",  ".db",   ".sqlite",
+        ".png", ".jpg",  ".jpeg", ".gif",   ".bmp", ".ico",  ".webp",
+        ".mp3", ".mp4",  ".avi",  ".mov",   ".wav", ".flac", ".pdf",
+        ".doc", ".docx", ".xls",  ".xlsx",  ".ppt", ".pptx",
+    };
+
+    for (binary_extensions) |ext| {
+        if (std.mem.endsWith(u8, basename, ext)) return true;
+    }
+    return false;
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+const testing = std.testing;
+
+test "globMatch follows gitignore patterns" {
+    try testing.expect(globMatch("*.log", "debug.log"));
+    try testing.expect(!globMatch("*.log", "logs/debug.log"));
+    try testing.expect(globMatch("build/*.o", "build/main.o"));
+    try testing.expect(!globMatch("build/*.o", "build/sub/main.o"));
+    try testing.expect(globMatch("**/gen", "gen"));
+    try testing.expect(globMatch("**/gen", "a/b/gen"));
+    try testing.expect(globMatch("docs/**", "docs/a/b.md"));
+    try testing.expect(globMatch("a/**/z", "a/z"));
+    try testing.expect(globMatch("a/**/z", "a/b/c/z"));
+    try testing.expect(!globMatch("a/**/z", "a/b/cz"));
+    try testing.expect(globMatch("file[0-9].txt", "file7.txt"));
+    try testing.expect(!globMatch("file[!0-9].txt", "file7.txt"));
+    try testing.expect(globMatch("?.c", "x.c"));
+    try testing.expect(globMatch("\\*literal", "*literal"));
+    try testing.expect(!globMatch("\\*literal", "xliteral"));
+}
+
+test "isText sniffs NUL bytes and UTF-8" {
+    try testing.expect(isText("plain text\n"));
+    try testing.expect(isText("caf\xc3\xa9"));
+    try testing.expect(!isText("MZ\x90\x00\x03"));
+    try testing.expect(!isText("latin-1 caf\xe9 au lait"));
+
+    // A two-byte character cut by the end of the sample
+    var long: [sniff_size + 1]u8 = undefined;
+    @memset(&long, 'a');
+    long[sniff_size - 1] = 0xc3;
+    long[sniff_size] = 0xa9;
+    try testing.expect(isText(&long));
+}
+
+test "list leaves out ignored, hidden and binary files, in path order" {
+    var tmp = testing.tmpDir(.{ .iterate = true });
+    defer tmp.cleanup();
+
+    try tmp.dir.makePath("src/gen");
+    try tmp.dir.makePath("node_modules/pkg");
+    try tmp.dir.makePath(".git");
+    try tmp.dir.writeFile(.{ .sub_path = ".gitignore", .data = "# deps\nnode_modules/\n*.log\n!keep.log\n" });
+    try tmp.dir.writeFile(.{ .sub_path = "src/.ignore", .data = "gen/\n" });
+    try tmp.dir.writeFile(.{ .sub_path = "src/main.zig", .data = "" });
+    try tmp.dir.writeFile(.{ .sub_path = "src/b.zig", .data = "" });
+    try tmp.dir.writeFile(.{ .sub_path = "src/gen/out.zig", .data = "" });
+    try tmp.dir.writeFile(.{ .sub_path = "node_modules/pkg/index.js", .data = "" });
+    try tmp.dir.writeFile(.{ .sub_path = "debug.log", .data = "" });
+    try tmp.dir.writeFile(.{ .sub_path = "keep.log", .data = "" });
+    try tmp.dir.writeFile(.{ .sub_path = "logo.png", .data = "" });
+    try tmp.dir.writeFile(.{ .sub_path = ".git/HEAD", .data = "" });
+
+    var arena = std.heap.ArenaAllocator.init(testing.allocator);
+    defer arena.deinit();
+    for ([_]usize{ 1, 4 }) |threads| {
+        const listing = try list(testing.allocator, arena.allocator(), tmp.dir, threads);
+
+        const expected = [_][]const u8{ "keep.log", "src/b.zig", "src/main.zig" };
+        try testing.expectEqual(expected.len, listing.files.len);
+        for (expected, listing.files) |path, stamp| try testing.expectEqualStrings(path, stamp.path);
+        // node_modules, debug.log and src/gen
+        try testing.expectEqual(@as(usize, 3), listing.ignored);
+
+        const watched = [_][]const u8{ "", ".gitignore", "src", "src/.ignore" };
+        try testing.expectEqual(watched.len, listing.watched.len);
+        for (watched, listing.watched) |path, stamp| try testing.expectEqualStrings(path, stamp.path);
+    }
+}
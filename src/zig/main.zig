@@ -30,8 +30,37 @@ pub fn main() !void {
     var db = try AgenticAIOnWord.database.SqliteHandler.init(allocator, "ms_word.db");
     defer db.deinit();
 
+    // `--mock` answers prompts from a local mock provider instead of the
+    // NVIDIA API; otherwise NVIDIA_API_BASE_URL in .env can point at any
+    // OpenAI-compatible endpoint
+    const args = try std.process.argsAlloc(allocator);
+    defer std.process.argsFree(allocator, args);
+    var use_mock = false;
+    for (args[1..]) |arg| {
+        if (std.mem.eql(u8, arg, "--mock")) use_mock = true;
+    }
+
+    var mock: ?*AgenticAIOnWord.mock.MockProvider = null;
+    defer if (mock) |m| m.stop();
+    var base_url_owned: ?[]const u8 = null;
+    defer if (base_url_owned) |u| allocator.free(u);
+
+    const base_url: ?[]const u8 = if (use_mock) blk: {
+        mock = try AgenticAIOnWord.mock.MockProvider.start(allocator, .{}, 0);
+        break :blk mock.?.url();
+    } else blk: {
+        base_url_owned = AgenticAIOnWord.mcp.loadEnvValue(allocator, ".env", "NVIDIA_API_BASE_URL") catch null;
+        break :blk base_url_owned;
+    };
+
     // Initialize MCP handler
-    var mcp_handler = AgenticAIOnWord.mcp.MCPHandler.init(allocator, &db, nvidia_token);
+    var api_url_owned: ?[]u8 = null;
+    defer if (api_url_owned) |u| allocator.free(u);
+    var mcp_handler = if (base_url) |base| handler: {
+        api_url_owned = try AgenticAIOnWord.mcp.chatCompletionsUrl(allocator, base);
+        print("[Server] Model API: {s}\n", .{api_url_owned.?});
+        break :handler try AgenticAIOnWord.mcp.MCPHandler.initWithUpstream(allocator, &db, nvidia_token, api_url_owned.?, .{});
+    } else AgenticAIOnWord.mcp.MCPHandler.init(allocator, &db, nvidia_token);
     defer mcp_handler.deinit();
 
     // Start WebSocket server
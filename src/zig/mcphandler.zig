@@ -2,10 +2,61 @@ const std = @import("std");
 const net = std.net;
 const Allocator = std.mem.Allocator;
 const database = @import("database/sqlitehandler.zig");
+const Channel = @import("server/channel.zig").Channel;
+const Cancellation = @import("server/cancellation.zig").Cancellation;
+const sse = @import("sse.zig");
+const upstream = @import("upstream.zig");
+const filecache = @import("filecache.zig");
 
 const NVIDIA_API_URL = "https://integrate.api.nvidia.com/v1/chat/completions";
 const NVIDIA_MODEL = "nvidia/nemotron-3-nano-30b-a3b";
 
+/// Appended to the history entry of an answer cut short by a cancel
+const CANCELLED_MARKER = "[Cancelled]";
+/// Appended to the history entry of an answer the upstream cut off
+const INCOMPLETE_MARKER = "[Incomplete]";
+
+/// How consecutive deltas of a streamed answer are merged into one
+/// `streaming` frame. Deltas are held only while more are already waiting
+/// in the upstream reader, so coalescing never delays text the client
+/// could otherwise have had; these limits bound a sustained burst.
+pub const CoalesceOptions = struct {
+    /// Send once this many content bytes are pending; 0 sends every delta
+    /// in its own frame
+    max_bytes: usize = 2048,
+    /// Send once the oldest pending delta has waited this long
+    max_delay_us: u64 = 20 * std.time.us_per_ms,
+};
+
+/// Finished answers are kept in the database and replayed for requests
+/// that would produce them again
+pub const CacheOptions = struct {
+    enabled: bool = true,
+    /// Older answers are neither replayed nor kept
+    max_age_s: i64 = 7 * std.time.s_per_day,
+    /// Content bytes kept in total; the least recently used answers are
+    /// evicted beyond this
+    max_bytes: u64 = 64 * 1024 * 1024,
+};
+
+/// Response cache lookups since start
+pub const CacheStats = struct {
+    hits: u64 = 0,
+    misses: u64 = 0,
+    stores: u64 = 0,
+
+    pub fn hitRate(self: CacheStats) f64 {
+        const lookups = self.hits + self.misses;
+        if (lookups == 0) return 0;
+        return @as(f64, @floatFromInt(self.hits)) / @as(f64, @floatFromInt(lookups));
+    }
+};
+
+const Sha256 = std.crypto.hash.sha2.Sha256;
+
+/// Names the answer to a request, see MCPHandler.cacheKey
+pub const CacheKey = [Sha256.digest_length]u8;
+
 /// MCP Handler for NVIDIA AI integration
 pub const MCPHandler = struct {
     const Self = @This();
@@ -13,17 +64,41 @@ pub const MCPHandler = struct {
     allocator: Allocator,
     api_token: []const u8,
     db: *database.SqliteHandler,
+    coalesce: CoalesceOptions = .{},
+    /// Shared by all requests, which reuse its keep-alive connections
+    upstream: upstream.Upstream,
+    cache: CacheOptions = .{},
+    cache_mutex: std.Thread.Mutex = .{},
+    cache_counters: CacheStats = .{},
+    /// What requests read from disk, kept between them
+    files: filecache.FileCache,
 
     pub fn init(allocator: Allocator, db: *database.SqliteHandler, token: []const u8) Self {
+        // The built-in URL always parses
+        return initWithUpstream(allocator, db, token, NVIDIA_API_URL, .{}) catch unreachable;
+    }
+
+    /// Like init, against another OpenAI-compatible endpoint (`url` must
+    /// outlive the handler)
+    pub fn initWithUpstream(
+        allocator: Allocator,
+        db: *database.SqliteHandler,
+        token: []const u8,
+        url: []const u8,
+        options: upstream.Options,
+    ) !Self {
         return Self{
             .allocator = allocator,
             .api_token = token,
             .db = db,
+            .upstream = try upstream.Upstream.init(allocator, url, options),
+            .files = filecache.FileCache.init(allocator, .{}),
         };
     }
 
     pub fn deinit(self: *Self) void {
-        _ = self;
+        self.files.deinit();
+        self.upstream.deinit();
         std.debug.print("[MCPHandler] Deinit\n", .{});
     }
 
@@ -31,84 +106,161 @@ pub const MCPHandler = struct {
     pub fn processRequest(
         self: *Self,
         allocator: Allocator,
-        stream: net.Stream,
+        channel: *Channel,
         id: []const u8,
         request_type: []const u8,
         file_path: []const u8,
         content: ?[]const u8,
         user_prompt: ?[]const u8,
         isStream: ?bool,
+        cancellation: *Cancellation,
     ) !void {
-        std.debug.print("[MCPHandler] Processing {s} request for path: {s}\n and content {s}", .{ request_type, file_path, content orelse "none" });
-
-        // Get file content if path is provided and content is not
-        var file_content: []const u8 = undefined;
-        var should_free_content = false;
-
-        // if (content) |c| {
-        //     file_content = c;
-        // } else if (file_path) |path| {
-        std.debug.print("File path not null {s}", .{file_path});
-        file_content = self.readFileOrFolder(allocator, file_path) catch |err| {
-            try self.sendError(stream, id, "Failed to read file/folder", err);
+        std.debug.print("[MCPHandler] Processing {s} request for path: {s}, content length: {d}\n", .{ request_type, file_path, if (content) |c| c.len else 0 });
+
+        const read = self.files.read(file_path) catch |err| {
+            try self.sendError(channel, id, "Failed to read file/folder", err);
             return;
         };
-        should_free_content = true;
-        // } else {
-        //     try self.sendError(stream, id, "No file path or content provided", error.MissingInput);
-        //     return;
-        // }
-        defer if (should_free_content) allocator.free(file_content);
+        defer read.deinit();
+        const file_content = read.text();
+        std.debug.print("[MCPHandler] Request {s}: read {d} files in {d} ms ({d} ignored, {d} binary), {d} bytes from disk, {d} from memory\n", .{
+            id,
+            read.stats.files,
+            read.stats.walk_ns / std.time.ns_per_ms,
+            read.stats.ignored,
+            read.stats.binary,
+            read.stats.bytes_read,
+            read.stats.bytes_cached,
+        });
 
         std.debug.print("[MCPHandler] Request body length: {d}\n", .{file_content.len});
-        std.debug.print("[MCPHandler] {s}\n", .{file_content});
         // Build the AI prompt
         const prompt = try self.buildPrompt(allocator, request_type, file_path, file_content, user_prompt);
 
         defer allocator.free(prompt);
 
         // Send status update
-        // try self.sendStatus(stream, id, "processing", "Sending request to NVIDIA AI...");
+        // try self.sendStatus(channel, id, "processing", "Sending request to NVIDIA AI...");
+
+        // Cancelled while it waited for a worker or read its input
+        if (cancellation.isCancelled()) {
+            try self.finishCancelled(allocator, channel, id, "");
+            return;
+        }
+
+        // The same request on the same input has been answered before
+        const cache_key: ?CacheKey = if (self.cache.enabled) self.cacheKey(request_type, file_path, user_prompt orelse "", file_content) else null;
+        if (cache_key) |*key| {
+            if (try self.replayCached(allocator, channel, id, key, isStream orelse false)) return;
+        }
 
         // Call NVIDIA API
-        self.callNvidiaAPI(allocator, stream, id, prompt, isStream) catch |err| {
-            try self.sendError(stream, id, "NVIDIA API call failed", err);
+        self.callNvidiaAPI(allocator, channel, id, prompt, isStream, cancellation, if (cache_key) |*key| key else null) catch |err| {
+            try self.sendError(channel, id, "NVIDIA API call failed", err);
             return;
         };
     }
 
-    /// Read file or folder contents
-    fn readFileOrFolder(self: *Self, allocator: Allocator, path: []const u8) ![]const u8 {
-        _ = self;
+    /// Key of the answer to a request: its type, the path it names (which
+    /// the prompt quotes), its prompt with whitespace runs collapsed, the
+    /// model and endpoint, and a hash of the content that was read for it.
+    /// A changed or renamed file is a new key.
+    pub fn cacheKey(self: *Self, request_type: []const u8, file_path: []const u8, user_prompt: []const u8, file_content: []const u8) CacheKey {
+        var content_hash: CacheKey = undefined;
+        Sha256.hash(file_content, &content_hash, .{});
+
+        var prompt_hasher = Sha256.init(.{});
+        var words = std.mem.tokenizeAny(u8, user_prompt, " \t\r\n");
+        while (words.next()) |word| {
+            prompt_hasher.update(word);
+            prompt_hasher.update(" ");
+        }
+        const prompt_hash = prompt_hasher.finalResult();
+
+        // Each part is length-prefixed, so different parts never hash alike
+        var hasher = Sha256.init(.{});
+        for ([_][]const u8{ request_type, file_path, NVIDIA_MODEL, self.upstream.url, &prompt_hash, &content_hash }) |part| {
+            var len: [8]u8 = undefined;
+            std.mem.writeInt(u64, &len, part.len, .little);
+            hasher.update(&len);
+            hasher.update(part);
+        }
+        return hasher.finalResult();
+    }
 
-        // Convert to null-terminated path for std.fs
-        const path_z = try allocator.dupeZ(u8, path);
-        defer allocator.free(path_z);
+    /// Answer from the cache if it holds `key`, the way a live answer is
+    /// sent but at full speed and marked "cached". False on a miss.
+    fn replayCached(self: *Self, allocator: Allocator, channel: *Channel, id: []const u8, key: *const CacheKey, stream: bool) !bool {
+        const cached = self.db.getCachedResponse(allocator, key, self.cache.max_age_s) catch |err| blk: {
+            std.debug.print("[MCPHandler] Cache lookup failed: {}\n", .{err});
+            break :blk null;
+        };
 
-        // Try to open as file first
-        const file = std.fs.cwd().openFile(path_z, .{}) catch |err| {
-            if (err == error.IsDir) {
-                // It's a directory, read all files
-                return try readDirectoryContents(allocator, path_z);
-            }
-            return err;
+        const stats = self.countCache(if (cached != null) .hit else .miss);
+        std.debug.print("[MCPHandler] Request {s}: cache {s}, hit rate {d:.1}% ({d} of {d})\n", .{
+            id,
+            if (cached != null) "hit" else "miss",
+            stats.hitRate() * 100,
+            stats.hits,
+            stats.hits + stats.misses,
+        });
+
+        const answer = cached orelse return false;
+        defer allocator.free(answer);
+
+        self.db.insertHistoryChat(answer, "", "assistant", "") catch |err| {
+            std.debug.print("[MCPHandler] Failed to save history: {}\n", .{err});
         };
-        defer file.close();
 
-        // Read file content
-        const stat = try file.stat();
-        const max_size: usize = 1024 * 1024; // 1MB max
-        const size = @min(stat.size, max_size);
+        if (!stream) {
+            try self.sendSuccessResponse(channel, id, answer, true);
+            return true;
+        }
 
-        const content = try allocator.alloc(u8, size);
-        errdefer allocator.free(content);
+        // Frames as large as coalescing would make them, never splitting
+        // a UTF-8 sequence
+        const piece = if (self.coalesce.max_bytes > 0) self.coalesce.max_bytes else (CoalesceOptions{}).max_bytes;
+        var frame: std.ArrayList(u8) = .empty;
+        defer frame.deinit(allocator);
+        var start: usize = 0;
+        while (start < answer.len) {
+            var end = @min(start + piece, answer.len);
+            while (end < answer.len and end > start + 1 and (answer[end] & 0xC0) == 0x80) end -= 1;
+            try self.sendChunk(allocator, channel, &frame, id, answer[start..end]);
+            start = end;
+        }
+
+        try self.sendStatus(channel, id, "complete", "", true);
+        return true;
+    }
 
-        const bytes_read = try file.readAll(content);
-        if (bytes_read < size) {
-            return allocator.realloc(content, bytes_read) catch content[0..bytes_read];
+    /// Keep a finished answer for replay
+    fn storeCached(self: *Self, key: ?*const CacheKey, answer: []const u8) void {
+        const cache_key = key orelse return;
+        if (answer.len == 0) return;
+        self.db.putCachedResponse(cache_key, answer, self.cache.max_age_s, self.cache.max_bytes) catch |err| {
+            std.debug.print("[MCPHandler] Failed to cache answer: {}\n", .{err});
+            return;
+        };
+        _ = self.countCache(.store);
+    }
+
+    fn countCache(self: *Self, event: enum { hit, miss, store }) CacheStats {
+        self.cache_mutex.lock();
+        defer self.cache_mutex.unlock();
+        switch (event) {
+            .hit => self.cache_counters.hits += 1,
+            .miss => self.cache_counters.misses += 1,
+            .store => self.cache_counters.stores += 1,
         }
+        return self.cache_counters;
+    }
 
-        return content;
+    /// Counters since start
+    pub fn cacheStats(self: *Self) CacheStats {
+        self.cache_mutex.lock();
+        defer self.cache_mutex.unlock();
+        return self.cache_counters;
     }
 
     /// Build AI prompt based on request type
@@ -161,28 +313,25 @@ pub const MCPHandler = struct {
     fn callNvidiaAPI(
         self: *Self,
         allocator: Allocator,
-        stream: net.Stream,
+        channel: *Channel,
         request_id: []const u8,
         prompt: []const u8,
         isStream: ?bool,
+        cancellation: *Cancellation,
+        cache_key: ?*const CacheKey,
     ) !void {
         // Build request body
         const use_stream = isStream orelse false;
         const request_body = try self.buildRequestBody(allocator, prompt, use_stream);
         defer allocator.free(request_body);
 
+        // Build authorization header
+        const auth_header = try std.fmt.allocPrint(allocator, "Bearer {s}", .{self.api_token});
+        defer allocator.free(auth_header);
+
         // Handle streaming mode
         if (use_stream) {
             std.debug.print("[MCPHandler] Streaming request body length: {d}\n", .{request_body.len});
-            var responseMessage = try std.ArrayList(u8).initCapacity(allocator, request_body.len + 256);
-            defer responseMessage.deinit(allocator); // free when we’re done
-            // Build authorization header
-            const auth_header = try std.fmt.allocPrint(allocator, "Bearer {s}", .{self.api_token});
-            defer allocator.free(auth_header);
-
-            // Create HTTP client
-            var client = std.http.Client{ .allocator = allocator };
-            defer client.deinit();
 
             // Set up extra headers for SSE streaming
             const extra_headers: []const std.http.Header = &.{
@@ -191,87 +340,48 @@ pub const MCPHandler = struct {
                 .{ .name = "Authorization", .value = auth_header },
             };
 
-            // Create an allocating writer to capture the SSE response
-            var response_writer_alloc: std.Io.Writer.Allocating = .init(allocator);
-            defer response_writer_alloc.deinit();
-
-            // Perform the request using fetch
-            const result = client.fetch(.{
-                .location = .{ .url = NVIDIA_API_URL },
-                .method = .POST,
-                .payload = request_body,
-                .extra_headers = extra_headers,
-                .response_writer = &response_writer_alloc.writer,
-            }) catch |err| {
-                std.debug.print("[MCPHandler] Streaming fetch failed: {}\n", .{err});
-                try self.sendStatus(stream, request_id, "error", "Failed to connect to NVIDIA API");
+            // Send the body and wait only for the response head, not the whole completion.
+            // From here a cancel shuts the upstream socket down, which ends
+            // whatever read is in progress. Leaving before the body is read
+            // also keeps req.deinit() from returning the connection to the
+            // pool, so the upstream sees it close and stops generating.
+            var req: std.http.Client.Request = undefined;
+            var setup: upstream.Setup = .{};
+            var response = self.upstream.post(&req, extra_headers, request_body, cancellation, &setup) catch |err| {
+                if (err == error.Cancelled) {
+                    try self.finishCancelled(allocator, channel, request_id, "");
+                    return;
+                }
+                std.debug.print("[MCPHandler] Streaming request failed: {}\n", .{err});
+                try self.sendStatus(channel, request_id, "error", "Failed to connect to NVIDIA API", false);
                 return;
             };
+            defer req.deinit();
+            defer cancellation.detach();
+            logSetup(request_id, setup);
 
             // Check response status
-            if (result.status != .ok) {
-                std.debug.print("[MCPHandler] Streaming API returned status: {}\n", .{result.status});
-                try self.sendStatus(stream, request_id, "error", "NVIDIA API returned error");
+            if (response.head.status != .ok) {
+                std.debug.print("[MCPHandler] Streaming API returned status: {}\n", .{response.head.status});
+                try self.sendStatus(channel, request_id, "error", "NVIDIA API returned error", false);
                 return;
             }
 
-            // Get the full SSE response and process line by line
-            const sse_body = response_writer_alloc.written();
-            std.debug.print("[MCPHandler] SSE response length: {d}\n", .{sse_body.len});
-
-            // Process SSE data lines
-            var lines = std.mem.splitScalar(u8, sse_body, '\n');
-            while (lines.next()) |line| {
-                const trimmed = std.mem.trim(u8, line, " \r\n");
-
-                // Check for SSE data prefix
-                if (std.mem.startsWith(u8, trimmed, "data: ")) {
-                    const data = trimmed[6..];
-
-                    // Skip [DONE] marker
-                    if (std.mem.eql(u8, data, "[DONE]")) {
-                        continue;
-                    }
-
-                    // Parse JSON chunk
-                    const parsed = std.json.parseFromSlice(std.json.Value, allocator, data, .{}) catch continue;
-                    defer parsed.deinit();
-
-                    // Extract content from choices[0].delta.content
-                    if (parsed.value.object.get("choices")) |choices| {
-                        if (choices.array.items.len > 0) {
-                            if (choices.array.items[0].object.get("delta")) |delta| {
-                                if (delta.object.get("content")) |content_val| {
-                                    const content_chunk = content_val.string;
-                                    // Send chunk to WebSocket
-                                    try responseMessage.appendSlice(allocator, content_chunk);
-                                    try self.sendChunk(stream, request_id, content_chunk);
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-
-            // Send completion message
-            const finalizeResponse: []const u8 = try responseMessage.toOwnedSlice(allocator);
-            self.db.insertHistoryChat(finalizeResponse, "", "assistant", "") catch |err| {
-                std.debug.print("[MCPHandler] Failed to save history: {}\n", .{err});
-            };
-            try self.sendStatus(stream, request_id, "complete", "");
+            // Forward SSE events to the WebSocket as they arrive. Time to
+            // first token counts from the request going out on a ready
+            // connection, so it is the model's latency alone.
+            var timer = try std.time.Timer.start();
+            var transfer_buffer: [8192]u8 = undefined;
+            const reader = response.reader(&transfer_buffer);
+            try self.processStreamingResponse(allocator, channel, request_id, reader, &timer, cancellation, cache_key);
+
+            // Read past [DONE] to the end of the body so the connection
+            // goes back to the pool
+            if (!cancellation.isCancelled()) _ = reader.discardRemaining() catch {};
             return;
         }
 
         std.debug.print("[MCPHandler] Request body length: {d}\n", .{request_body.len});
-        std.debug.print("[MCPHandler] {s}\n", .{request_body});
-
-        // Build authorization header
-        const auth_header = try std.fmt.allocPrint(allocator, "Bearer {s}", .{self.api_token});
-        defer allocator.free(auth_header);
-
-        // Create HTTP client
-        var client = std.http.Client{ .allocator = allocator };
-        defer client.deinit();
 
         // Set up extra headers
         const extra_headers: []const std.http.Header = &.{
@@ -280,28 +390,52 @@ pub const MCPHandler = struct {
             .{ .name = "Authorization", .value = auth_header },
         };
 
+        var req: std.http.Client.Request = undefined;
+        var setup: upstream.Setup = .{};
+        var response = self.upstream.post(&req, extra_headers, request_body, cancellation, &setup) catch |err| {
+            if (err == error.Cancelled) {
+                try self.finishCancelled(allocator, channel, request_id, "");
+                return;
+            }
+            std.debug.print("[MCPHandler] Fetch request failed: {}\n", .{err});
+            try self.sendStatus(channel, request_id, "error", "Failed to connect to NVIDIA API", false);
+            return;
+        };
+        defer req.deinit();
+        defer cancellation.detach();
+        logSetup(request_id, setup);
+
         // Create an allocating writer to capture the body
         var response_writer_alloc: std.Io.Writer.Allocating = .init(allocator);
         defer response_writer_alloc.deinit();
 
-        // Perform the request using fetch
-        const result = client.fetch(.{
-            .location = .{ .url = NVIDIA_API_URL },
-            .method = .POST,
-            .payload = request_body,
-            .extra_headers = extra_headers,
-            .response_writer = &response_writer_alloc.writer,
-        }) catch |err| {
-            std.debug.print("[MCPHandler] Fetch request failed: {}\n", .{err});
-            try self.sendStatus(stream, request_id, "error", "Failed to connect to NVIDIA API");
+        var timer = try std.time.Timer.start();
+        var transfer_buffer: [8192]u8 = undefined;
+        _ = response.reader(&transfer_buffer).streamRemaining(&response_writer_alloc.writer) catch |err| {
+            // A cancel ends the read by shutting the socket down
+            if (cancellation.isCancelled()) {
+                try self.finishCancelled(allocator, channel, request_id, "");
+                return;
+            }
+            std.debug.print("[MCPHandler] Reading response failed: {}\n", .{err});
+            try self.sendStatus(channel, request_id, "error", "Failed to connect to NVIDIA API", false);
             return;
         };
+        std.debug.print("[MCPHandler] Request {s}: model answered in {d} ms\n", .{
+            request_id,
+            timer.read() / std.time.ns_per_ms,
+        });
 
         // Check response status
-        if (result.status != .ok) {
-            std.debug.print("[MCPHandler] API returned status: {}\n", .{result.status});
+        if (response.head.status != .ok) {
+            std.debug.print("[MCPHandler] API returned status: {}\n", .{response.head.status});
             std.debug.print("[MCPHandler] Response: {s}\n", .{response_writer_alloc.written()});
-            try self.sendStatus(stream, request_id, "error", "NVIDIA API returned error");
+            try self.sendStatus(channel, request_id, "error", "NVIDIA API returned error", false);
+            return;
+        }
+
+        if (cancellation.isCancelled()) {
+            try self.finishCancelled(allocator, channel, request_id, "");
             return;
         }
 
@@ -323,6 +457,7 @@ pub const MCPHandler = struct {
                             self.db.insertHistoryChat(content, "", "assistant", "") catch |err| {
                                 std.debug.print("[MCPHandler] Failed to save history: {}\n", .{err});
                             };
+                            self.storeCached(cache_key, content);
                         }
                     }
                 }
@@ -332,7 +467,7 @@ pub const MCPHandler = struct {
         }
 
         // Process and send response to WebSocket
-        try self.processResponse(allocator, stream, request_id, body);
+        try self.processResponse(allocator, channel, request_id, body);
     }
 
     /// Build NVIDIA API request body
@@ -382,73 +517,168 @@ pub const MCPHandler = struct {
         return try body.toOwnedSlice(allocator);
     }
 
-    /// Process SSE streaming response from NVIDIA API
-    fn processStreamingResponse(
+    /// Process SSE streaming response from NVIDIA API.
+    /// Every event is decoded as soon as it is read (see sse.zig) and its delta
+    /// forwarded, merged with the deltas right behind it (see
+    /// CoalesceOptions), so the client sees the first token while the
+    /// upstream is still generating without a frame per token.
+    pub fn processStreamingResponse(
         self: *Self,
         allocator: Allocator,
-        stream: net.Stream,
+        channel: *Channel,
         request_id: []const u8,
-        reader: anytype,
+        reader: *std.Io.Reader,
+        timer: *std.time.Timer,
+        cancellation: *Cancellation,
+        cache_key: ?*const CacheKey,
     ) !void {
-        var line_buf: [8192]u8 = undefined;
         var content_accumulator: std.ArrayList(u8) = .empty;
         defer content_accumulator.deinit(allocator);
 
-        while (true) {
-            const line = reader.readUntilDelimiterOrEof(&line_buf, '\n') catch |err| {
-                std.debug.print("[MCPHandler] Read error: {}\n", .{err});
-                break;
+        var first_token_ns: ?u64 = null;
+        var chunk_count: usize = 0;
+
+        // Deltas not yet sent are the tail of the accumulator
+        var sent_len: usize = 0;
+        var pending_since_ns: u64 = 0;
+        var frame_count: usize = 0;
+        var frame: std.ArrayList(u8) = .empty;
+        defer frame.deinit(allocator);
+
+        var decoder: sse.Decoder = .{};
+        defer decoder.deinit(allocator);
+        var done = false;
+        var at_end = false;
+        var finish_reason_buf: [32]u8 = undefined;
+        var finish_reason: []const u8 = "";
+        var usage: ?sse.Usage = null;
+
+        while (!done and !at_end and !cancellation.isCancelled()) {
+            // Everything the reader holds, reading only when it holds nothing
+            const bytes: []const u8 = reader.peekGreedy(1) catch |err| switch (err) {
+                // Ends an event the upstream cut off, like Decoder.finish()
+                error.EndOfStream => blk: {
+                    at_end = true;
+                    break :blk "\n\n";
+                },
+                else => {
+                    // Also how a cancel ends a read in progress
+                    if (!cancellation.isCancelled()) {
+                        std.debug.print("[MCPHandler] Read error: {}\n", .{err});
+                    }
+                    break;
+                },
             };
+            decoder.feed(bytes);
+            defer if (!at_end) reader.toss(bytes.len);
 
-            if (line == null) break;
-
-            const trimmed = std.mem.trim(u8, line.?, " \r\n");
-
-            // Skip empty lines
-            if (trimmed.len == 0) continue;
-
-            // Check for SSE data prefix
-            if (std.mem.startsWith(u8, trimmed, "data: ")) {
-                const data = trimmed[6..];
-
+            while (try decoder.next(allocator)) |data| {
                 // Check for stream end
-                if (std.mem.eql(u8, data, "[DONE]")) {
+                if (std.mem.eql(u8, data, sse.DONE)) {
                     std.debug.print("[MCPHandler] Stream complete\n", .{});
+                    done = true;
                     break;
                 }
 
-                // Parse JSON chunk
-                const parsed = std.json.parseFromSlice(std.json.Value, allocator, data, .{}) catch {
-                    continue; // Skip malformed chunks
-                };
-                defer parsed.deinit();
-
-                // Extract content from choices[0].delta.content
-                if (parsed.value.object.get("choices")) |choices| {
-                    if (choices.array.items.len > 0) {
-                        if (choices.array.items[0].object.get("delta")) |delta| {
-                            if (delta.object.get("content")) |content_val| {
-                                const content_chunk = content_val.string;
-                                try content_accumulator.appendSlice(allocator, content_chunk);
-
-                                // Send chunk to WebSocket
-                                try self.sendChunk(stream, request_id, content_chunk);
-                            }
-                        }
-                    }
+                const chunk = sse.parseChunk(data) catch continue; // Skip malformed chunks
+                if (chunk.finish_reason) |reason| {
+                    const len = @min(reason.len, finish_reason_buf.len);
+                    @memcpy(finish_reason_buf[0..len], reason[0..len]);
+                    finish_reason = finish_reason_buf[0..len];
+                }
+                if (chunk.usage) |reported| usage = reported;
+
+                const escaped = chunk.content orelse continue;
+                if (escaped.len == 0) continue;
+
+                if (content_accumulator.items.len == sent_len) {
+                    pending_since_ns = timer.read();
+                }
+                try sse.appendUnescaped(allocator, &content_accumulator, escaped);
+                chunk_count += 1;
+
+                // The first token always goes out alone
+                const pending = content_accumulator.items[sent_len..];
+                if (first_token_ns == null or
+                    shouldFlush(self.coalesce, pending.len, timer.read() - pending_since_ns, decoder.hasBufferedLine()))
+                {
+                    try self.sendChunk(allocator, channel, &frame, request_id, pending);
+                    sent_len = content_accumulator.items.len;
+                    frame_count += 1;
+                }
+
+                if (first_token_ns == null) {
+                    first_token_ns = timer.read();
+                    std.debug.print("[MCPHandler] Request {s}: time to first token {d} ms\n", .{
+                        request_id,
+                        first_token_ns.? / std.time.ns_per_ms,
+                    });
                 }
             }
         }
 
+        if (finish_reason.len > 0 and !std.mem.eql(u8, finish_reason, "stop")) {
+            std.debug.print("[MCPHandler] Request {s}: model stopped early ({s})\n", .{ request_id, finish_reason });
+        }
+        if (usage) |tokens| {
+            std.debug.print("[MCPHandler] Request {s}: {d} prompt + {d} completion tokens\n", .{
+                request_id,
+                tokens.prompt_tokens,
+                tokens.completion_tokens,
+            });
+        }
+
+        // Whatever was held back goes out before the terminal status; a
+        // cancelled answer is no longer being written
+        if (sent_len < content_accumulator.items.len and !cancellation.isCancelled()) {
+            try self.sendChunk(allocator, channel, &frame, request_id, content_accumulator.items[sent_len..]);
+            frame_count += 1;
+        }
+
+        const total_ns = timer.read();
+        std.debug.print("[MCPHandler] Request {s}: {d} chunks in {d} frames, {d} bytes, ttft {d} ms, total {d} ms\n", .{
+            request_id,
+            chunk_count,
+            frame_count,
+            content_accumulator.items.len,
+            (first_token_ns orelse total_ns) / std.time.ns_per_ms,
+            total_ns / std.time.ns_per_ms,
+        });
+
+        if (cancellation.isCancelled()) {
+            std.debug.print("[MCPHandler] Request {s}: cancelled\n", .{request_id});
+            try self.finishCancelled(allocator, channel, request_id, content_accumulator.items);
+            return;
+        }
+
+        // A read error or an end without [DONE]: what arrived is not a
+        // finished answer, and the client must not take it for one
+        if (!done) {
+            std.debug.print("[MCPHandler] Request {s}: stream ended before [DONE]\n", .{request_id});
+            try self.savePartial(allocator, content_accumulator.items, INCOMPLETE_MARKER);
+            try self.sendStatus(channel, request_id, "error", "The answer was cut off before it was finished", false);
+            return;
+        }
+
+        // Save the assembled answer to history
+        self.db.insertHistoryChat(content_accumulator.items, "", "assistant", "") catch |err| {
+            std.debug.print("[MCPHandler] Failed to save history: {}\n", .{err});
+        };
+
+        // Only an answer the model finished is replayed later
+        if (finish_reason.len == 0 or std.mem.eql(u8, finish_reason, "stop")) {
+            self.storeCached(cache_key, content_accumulator.items);
+        }
+
         // Send completion message
-        try self.sendStatus(stream, request_id, "complete", "");
+        try self.sendStatus(channel, request_id, "complete", "", false);
     }
 
     /// Process non-streaming response from NVIDIA API
     fn processResponse(
         self: *Self,
         allocator: Allocator,
-        stream: net.Stream,
+        channel: *Channel,
         request_id: []const u8,
         response_body: []const u8,
     ) !void {
@@ -458,7 +688,7 @@ pub const MCPHandler = struct {
         var parser = std.json.parseFromSlice(std.json.Value, self.allocator, response_body, .{}) catch |err| {
             std.debug.print("[MCPHandler] Failed to parse response: {}\n", .{err});
             std.debug.print("[MCPHandler] Response body: {s}\n", .{response_body[0..@min(response_body.len, 500)]});
-            try self.sendErrorResponse(stream, request_id, "Failed to parse API response");
+            try self.sendErrorResponse(channel, request_id, "Failed to parse API response");
             return;
         };
         defer parser.deinit();
@@ -473,7 +703,7 @@ pub const MCPHandler = struct {
                         const content = content_val.string;
 
                         // Send the complete response wrapped in success format
-                        try self.sendSuccessResponse(stream, request_id, content);
+                        try self.sendSuccessResponse(channel, request_id, content, false);
                         return;
                     }
                 }
@@ -483,223 +713,176 @@ pub const MCPHandler = struct {
         // Check for error in response
         if (root.get("error")) |error_obj| {
             if (error_obj.object.get("message")) |msg| {
-                try self.sendErrorResponse(stream, request_id, msg.string);
+                try self.sendErrorResponse(channel, request_id, msg.string);
                 return;
             }
         }
 
-        try self.sendErrorResponse(stream, request_id, "Unexpected API response format");
+        try self.sendErrorResponse(channel, request_id, "Unexpected API response format");
     }
 
     /// Send success response with content
-    fn sendSuccessResponse(self: *Self, stream: net.Stream, id: []const u8, content: []const u8) !void {
+    fn sendSuccessResponse(self: *Self, channel: *Channel, id: []const u8, content: []const u8, cached: bool) !void {
         // Use dynamic buffer for potentially large content
         var json_builder = try std.ArrayList(u8).initCapacity(self.allocator, content.len + 256);
         defer json_builder.deinit(self.allocator);
 
         try json_builder.appendSlice(self.allocator, "{\"id\":\"");
-        try json_builder.appendSlice(self.allocator, id);
+        try appendEscaped(self.allocator, &json_builder, id);
         try json_builder.appendSlice(self.allocator, "\",\"success\":true,\"content\":\"");
+        try appendEscaped(self.allocator, &json_builder, content);
 
-        // Escape content for JSON
-        for (content) |ch| {
-            switch (ch) {
-                '"' => try json_builder.appendSlice(self.allocator, "\\\""),
-                '\\' => try json_builder.appendSlice(self.allocator, "\\\\"),
-                '\n' => try json_builder.appendSlice(self.allocator, "\\n"),
-                '\r' => try json_builder.appendSlice(self.allocator, "\\r"),
-                '\t' => try json_builder.appendSlice(self.allocator, "\\t"),
-                else => {
-                    if (ch < 0x20) {
-                        // Skip control characters
-                    } else {
-                        try json_builder.append(self.allocator, ch);
-                    }
-                },
-            }
-        }
-
-        try json_builder.appendSlice(self.allocator, "\"}");
+        try json_builder.appendSlice(self.allocator, if (cached) "\",\"cached\":true}" else "\"}");
 
-        try self.sendWebSocketFrame(stream, json_builder.items);
+        try channel.sendText(json_builder.items);
     }
 
     /// Send error response
-    fn sendErrorResponse(self: *Self, stream: net.Stream, id: []const u8, error_msg: []const u8) !void {
+    fn sendErrorResponse(self: *Self, channel: *Channel, id: []const u8, error_msg: []const u8) !void {
+        _ = self;
         var json_buf: [4096]u8 = undefined;
         var fbs = std.io.fixedBufferStream(&json_buf);
         const writer = fbs.writer();
 
         try writer.writeAll("{\"id\":\"");
-        try writer.writeAll(id);
+        try writeEscaped(writer, id);
         try writer.writeAll("\",\"success\":false,\"error\":\"");
-        try writer.writeAll(error_msg);
+        try writeEscaped(writer, error_msg);
         try writer.writeAll("\"}");
 
-        try self.sendWebSocketFrame(stream, fbs.getWritten());
+        try channel.sendText(fbs.getWritten());
     }
 
-    /// Send a content chunk through WebSocket
-    fn sendChunk(self: *Self, stream: net.Stream, id: []const u8, content: []const u8) !void {
-        var json_buf: [8192]u8 = undefined;
-        var fbs = std.io.fixedBufferStream(&json_buf);
-        const writer = fbs.writer();
-
-        try writer.writeAll("{\"id\":\"");
-        try writer.writeAll(id);
-        try writer.writeAll("\",\"status\":\"streaming\",\"content\":\"");
-
-        // Escape content
-        for (content) |ch| {
-            switch (ch) {
-                '"' => try writer.writeAll("\\\""),
-                '\\' => try writer.writeAll("\\\\"),
-                '\n' => try writer.writeAll("\\n"),
-                '\r' => try writer.writeAll("\\r"),
-                '\t' => try writer.writeAll("\\t"),
-                else => try writer.writeByte(ch),
-            }
-        }
+    /// Send a content chunk through WebSocket. The frame is built in
+    /// `frame`, reused across the chunks of one answer, since merged deltas
+    /// have no fixed upper size.
+    fn sendChunk(self: *Self, allocator: Allocator, channel: *Channel, frame: *std.ArrayList(u8), id: []const u8, content: []const u8) !void {
+        _ = self;
+        frame.clearRetainingCapacity();
 
-        try writer.writeAll("\"}");
+        try frame.appendSlice(allocator, "{\"id\":\"");
+        try appendEscaped(allocator, frame, id);
+        try frame.appendSlice(allocator, "\",\"status\":\"streaming\",\"content\":\"");
+        try appendEscaped(allocator, frame, content);
+        try frame.appendSlice(allocator, "\"}");
 
-        try self.sendWebSocketFrame(stream, fbs.getWritten());
+        try channel.sendText(frame.items);
     }
 
-    /// Send status message through WebSocket
-    fn sendStatus(self: *Self, stream: net.Stream, id: []const u8, status: []const u8, message: []const u8) !void {
+    /// Send status message through WebSocket; `cached` marks a replayed answer
+    fn sendStatus(self: *Self, channel: *Channel, id: []const u8, status: []const u8, message: []const u8, cached: bool) !void {
+        _ = self;
         var json_buf: [4096]u8 = undefined;
         var fbs = std.io.fixedBufferStream(&json_buf);
         const writer = fbs.writer();
 
         try writer.writeAll("{\"id\":\"");
-        try writer.writeAll(id);
+        try writeEscaped(writer, id);
         try writer.writeAll("\",\"status\":\"");
         try writer.writeAll(status);
         try writer.writeAll("\",\"content\":\"");
+        try writeEscaped(writer, message);
 
-        // Escape message
-        for (message) |ch| {
-            switch (ch) {
-                '"' => try writer.writeAll("\\\""),
-                '\\' => try writer.writeAll("\\\\"),
-                '\n' => try writer.writeAll("\\n"),
-                '\r' => try writer.writeAll("\\r"),
-                '\t' => try writer.writeAll("\\t"),
-                else => try writer.writeByte(ch),
-            }
-        }
+        try writer.writeAll(if (cached) "\",\"cached\":true}" else "\"}");
 
-        try writer.writeAll("\"}");
+        try channel.sendText(fbs.getWritten());
+    }
 
-        try self.sendWebSocketFrame(stream, fbs.getWritten());
+    /// End a cancelled request. What was generated goes to history, marked,
+    /// so the prompt saved earlier keeps an answer; the terminal status then
+    /// tells the client nothing more will come for this id.
+    fn finishCancelled(self: *Self, allocator: Allocator, channel: *Channel, id: []const u8, partial: []const u8) !void {
+        try self.savePartial(allocator, partial, CANCELLED_MARKER);
+        try self.sendStatus(channel, id, "cancelled", "", false);
+    }
+
+    /// Save an unfinished answer to history, followed by `marker`
+    fn savePartial(self: *Self, allocator: Allocator, partial: []const u8, marker: []const u8) !void {
+        const separator: []const u8 = if (partial.len > 0) "\n\n" else "";
+        const saved = try std.mem.concat(allocator, u8, &.{ partial, separator, marker });
+        defer allocator.free(saved);
+
+        self.db.insertHistoryChat(saved, "", "assistant", "") catch |err| {
+            std.debug.print("[MCPHandler] Failed to save history: {}\n", .{err});
+        };
     }
 
     /// Send error message through WebSocket
-    fn sendError(self: *Self, stream: net.Stream, id: []const u8, message: []const u8, err: anyerror) !void {
+    fn sendError(self: *Self, channel: *Channel, id: []const u8, message: []const u8, err: anyerror) !void {
         var error_msg_buf: [512]u8 = undefined;
         const error_msg = std.fmt.bufPrint(&error_msg_buf, "{s}: {}", .{ message, err }) catch message;
-        try self.sendStatus(stream, id, "error", error_msg);
+        try self.sendStatus(channel, id, "error", error_msg, false);
     }
+};
 
-    /// Send WebSocket text frame
-    fn sendWebSocketFrame(self: *Self, stream: net.Stream, payload: []const u8) !void {
-        _ = self;
-
-        var header: [10]u8 = undefined;
-        var header_len: usize = 2;
-
-        // FIN bit + text opcode
-        header[0] = 0x81;
-
-        // Payload length
-        if (payload.len < 126) {
-            header[1] = @intCast(payload.len);
-        } else if (payload.len < 65536) {
-            header[1] = 126;
-            header[2] = @intCast((payload.len >> 8) & 0xFF);
-            header[3] = @intCast(payload.len & 0xFF);
-            header_len = 4;
-        } else {
-            header[1] = 127;
-            var len = payload.len;
-            for (0..8) |i| {
-                header[9 - i] = @intCast(len & 0xFF);
-                len >>= 8;
-            }
-            header_len = 10;
+/// Append `text` to a JSON string being built in `list`. The client's
+/// request id goes through here as well as the content: it is echoed
+/// verbatim and may hold any character.
+fn appendEscaped(allocator: Allocator, list: *std.ArrayList(u8), text: []const u8) !void {
+    for (text) |ch| {
+        switch (ch) {
+            '"' => try list.appendSlice(allocator, "\\\""),
+            '\\' => try list.appendSlice(allocator, "\\\\"),
+            '\n' => try list.appendSlice(allocator, "\\n"),
+            '\r' => try list.appendSlice(allocator, "\\r"),
+            '\t' => try list.appendSlice(allocator, "\\t"),
+            else => {
+                if (ch < 0x20) {
+                    var buf: [6]u8 = undefined;
+                    try list.appendSlice(allocator, std.fmt.bufPrint(&buf, "\\u{x:0>4}", .{ch}) catch unreachable);
+                } else {
+                    try list.append(allocator, ch);
+                }
+            },
         }
-
-        _ = try stream.writeAll(header[0..header_len]);
-        _ = try stream.writeAll(payload);
     }
-};
-
-/// Read all files from a directory recursively
-fn readDirectoryContents(allocator: Allocator, path: [:0]const u8) ![]const u8 {
-    var content: std.ArrayList(u8) = .empty;
-    errdefer content.deinit(allocator);
-
-    var dir = try std.fs.cwd().openDir(path, .{ .iterate = true });
-    defer dir.close();
-
-    var walker = try dir.walk(allocator);
-    defer walker.deinit();
-
-    while (try walker.next()) |entry| {
-        // Only process files
-        if (entry.kind != .file) continue;
-
-        // Skip hidden files and common binary files
-        if (entry.basename[0] == '.') continue;
-        if (isLikelyBinary(entry.basename)) continue;
-
-        // Build full path
-        try content.appendSlice(allocator, "\n--- File: ");
-        try content.appendSlice(allocator, entry.path);
-        try content.appendSlice(allocator, " ---\n");
-
-        // Read file content
-        const file = dir.openFile(entry.path, .{}) catch continue;
-        defer file.close();
-
-        const stat = file.stat() catch continue;
-        const max_file_size: usize = 64 * 1024; // 64KB per file max
+}
 
-        if (stat.size > max_file_size) {
-            try content.appendSlice(allocator, "[File too large, truncated]\n");
+/// appendEscaped for a fixed buffer's writer
+fn writeEscaped(writer: anytype, text: []const u8) !void {
+    for (text) |ch| {
+        switch (ch) {
+            '"' => try writer.writeAll("\\\""),
+            '\\' => try writer.writeAll("\\\\"),
+            '\n' => try writer.writeAll("\\n"),
+            '\r' => try writer.writeAll("\\r"),
+            '\t' => try writer.writeAll("\\t"),
+            else => {
+                if (ch < 0x20) {
+                    try writer.print("\\u{x:0>4}", .{ch});
+                } else {
+                    try writer.writeByte(ch);
+                }
+            },
         }
-
-        const size: usize = @min(stat.size, max_file_size);
-        const file_buf = try allocator.alloc(u8, size);
-        defer allocator.free(file_buf);
-
-        const bytes_read = file.readAll(file_buf) catch continue;
-        try content.appendSlice(allocator, file_buf[0..bytes_read]);
-        try content.appendSlice(allocator, "\n");
     }
+}
 
-    return try content.toOwnedSlice(allocator);
+/// Whether the pending deltas go out now. Besides the size and age limits
+/// they do whenever no further complete line has been received: the next
+/// read may block, and text is never held back waiting for the upstream.
+fn shouldFlush(options: CoalesceOptions, pending_len: usize, pending_ns: u64, more_received: bool) bool {
+    if (pending_len >= options.max_bytes) return true;
+    if (pending_ns >= options.max_delay_us * std.time.ns_per_us) return true;
+    return !more_received;
 }
 
-/// Check if file is likely binary based on extension
-fn isLikelyBinary(basename: []const u8) bool {
-    const binary_extensions = [_][]const u8{
-        ".exe", ".dll",  ".so",   ".dylib", ".bin", ".obj",  ".o",
-        ".zip", ".tar",  ".gz",   ".rar",   ".7z",  ".db",   ".sqlite",
-        ".png", ".jpg",  ".jpeg", ".gif",   ".bmp", ".ico",  ".webp",
-        ".mp3", ".mp4",  ".avi",  ".mov",   ".wav", ".flac", ".pdf",
-        ".doc", ".docx", ".xls",  ".xlsx",  ".ppt", ".pptx",
-    };
-
-    for (binary_extensions) |ext| {
-        if (std.mem.endsWith(u8, basename, ext)) return true;
-    }
-    return false;
+/// Connection setup, reported apart from the model's own latency
+fn logSetup(request_id: []const u8, setup: upstream.Setup) void {
+    std.debug.print("[MCPHandler] Request {s}: {s} upstream connection, setup {d} ms\n", .{
+        request_id,
+        if (setup.reused) "reused" else "new",
+        setup.connect_ns / std.time.ns_per_ms,
+    });
 }
 
 /// Load NVIDIA API token from .env file
 pub fn loadNvidiaToken(allocator: Allocator, path: []const u8) ![]const u8 {
+    return loadEnvValue(allocator, path, "NVIDIA_API_KEY");
+}
+
+/// Read `name`=value from a .env file; the value is allocated
+pub fn loadEnvValue(allocator: Allocator, path: []const u8, name: []const u8) ![]const u8 {
     const path_z = try allocator.dupeZ(u8, path);
     defer allocator.free(path_z);
 
@@ -709,15 +892,88 @@ pub fn loadNvidiaToken(allocator: Allocator, path: []const u8) ![]const u8 {
     const content = try file.readToEndAlloc(allocator, 4096);
     defer allocator.free(content);
 
-    // Find NVIDIA_API_KEY=
+    // Find NAME=
     var lines = std.mem.splitScalar(u8, content, '\n');
     while (lines.next()) |line| {
         const trimmed = std.mem.trim(u8, line, " \r");
-        if (std.mem.startsWith(u8, trimmed, "NVIDIA_API_KEY=")) {
-            const token = std.mem.trim(u8, trimmed[15..], " \r\n\"'");
-            return try allocator.dupe(u8, token);
+        if (std.mem.startsWith(u8, trimmed, name) and trimmed.len > name.len and trimmed[name.len] == '=') {
+            const value = std.mem.trim(u8, trimmed[name.len + 1 ..], " \r\n\"'");
+            return try allocator.dupe(u8, value);
         }
     }
 
     return error.TokenNotFound;
 }
+
+/// Chat completions endpoint under an OpenAI-style base URL such as
+/// http://127.0.0.1:8099/v1; allocated
+pub fn chatCompletionsUrl(allocator: Allocator, base_url: []const u8) ![]u8 {
+    return std.fmt.allocPrint(allocator, "{s}/chat/completions", .{std.mem.trimRight(u8, base_url, "/")});
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+const testing = std.testing;
+
+test "a stream cut off before [DONE] ends in an error and is saved as incomplete" {
+    const allocator = testing.allocator;
+    var db = try database.SqliteHandler.init(allocator, ":memory:");
+    defer db.deinit();
+    var handler = MCPHandler.init(allocator, &db, "");
+    defer handler.deinit();
+
+    const address = net.Address.initIp4(.{ 127, 0, 0, 1 }, 0);
+    var listener = try address.listen(.{ .reuse_address = true });
+    defer listener.deinit();
+    const client = try net.tcpConnectToAddress(listener.listen_address);
+    defer client.close();
+    const conn = try listener.accept();
+
+    // Two deltas, then the upstream goes away in the middle of the third
+    const cut = "data: {\"choices\":[{\"delta\":{\"content\":\"Hello\"}}]}\n\n" ++
+        "data: {\"choices\":[{\"delta\":{\"content\":\", wor\"}}]}\n\n" ++
+        "data: {\"choices\":[{\"delta\":{\"cont";
+    var channel = Channel.init(conn.stream);
+    var cancellation: Cancellation = .{};
+    var reader = std.Io.Reader.fixed(cut);
+    var timer = try std.time.Timer.start();
+    try handler.processStreamingResponse(allocator, &channel, "7", &reader, &timer, &cancellation, null);
+    conn.stream.close();
+
+    // The frames are small and unmasked: their JSON is in the raw bytes
+    var received: std.ArrayList(u8) = .empty;
+    defer received.deinit(allocator);
+    var buf: [1024]u8 = undefined;
+    while (true) {
+        const n = try std.posix.recv(client.handle, &buf, 0);
+        if (n == 0) break;
+        try received.appendSlice(allocator, buf[0..n]);
+    }
+    try testing.expect(std.mem.indexOf(u8, received.items, "\"content\":\"Hello\"") != null);
+    try testing.expect(std.mem.indexOf(u8, received.items, "\"status\":\"error\"") != null);
+    try testing.expect(std.mem.indexOf(u8, received.items, "\"status\":\"complete\"") == null);
+
+    var history = try db.getTables();
+    defer db.freeHistory(&history);
+    try testing.expectEqual(@as(usize, 1), history.items.len);
+    try testing.expectEqualStrings("Hello, wor\n\n" ++ INCOMPLETE_MARKER, history.items[0].message);
+    try testing.expectEqualStrings("assistant", history.items[0].role);
+}
+
+test "ids and content are escaped the same way in both frame builders" {
+    const allocator = testing.allocator;
+    const id = "a\"b\\c\n\x01";
+    const expected = "a\\\"b\\\\c\\n\\u0001";
+
+    var list: std.ArrayList(u8) = .empty;
+    defer list.deinit(allocator);
+    try appendEscaped(allocator, &list, id);
+    try testing.expectEqualStrings(expected, list.items);
+
+    var buf: [64]u8 = undefined;
+    var fbs = std.io.fixedBufferStream(&buf);
+    try writeEscaped(fbs.writer(), id);
+    try testing.expectEqualStrings(expected, fbs.getWritten());
+}
@@ -0,0 +1,379 @@
+//! A local stand-in for the model API. Answers chat completion requests the
+//! way the real endpoint does, as an SSE stream of chunks or one JSON body,
+//! with generated text at a configurable pace, so the whole pipeline can be
+//! run and benchmarked offline and with repeatable timing.
+const std = @import("std");
+const net = std.net;
+const Allocator = std.mem.Allocator;
+
+pub const Options = struct {
+    /// Time from the end of the request to the first token
+    first_token_delay_ms: u32 = 200,
+    /// Pace of the answer after its first token; 0 sends it as fast as the
+    /// socket takes it
+    tokens_per_second: u32 = 50,
+    /// Tokens in every answer
+    answer_tokens: u32 = 200,
+    /// Tokens sent together in one chunk
+    tokens_per_chunk: u32 = 1,
+    /// Every nth request fails with `failure`; 0 never
+    fail_every: u32 = 0,
+    failure: Failure = .server_error,
+};
+
+pub const Failure = enum {
+    /// A 500 with an error body, before any token
+    server_error,
+    /// A stream that stops halfway, without finish_reason or [DONE]
+    cut_stream,
+    /// The connection is closed without an answer
+    drop,
+};
+
+/// Requests are served on a thread per connection; connections are kept
+/// alive for as long as the client wants them.
+pub const MockProvider = struct {
+    const Self = @This();
+
+    allocator: Allocator,
+    options: Options,
+    listener: net.Server,
+    accept_thread: std.Thread = undefined,
+    running: std.atomic.Value(bool) = .init(true),
+    /// Requests received so far, also numbering them for `fail_every`
+    requests: std.atomic.Value(u32) = .init(0),
+
+    /// Open connections and the threads serving them
+    mutex: std.Thread.Mutex = .{},
+    connections: std.ArrayList(Connection) = .empty,
+
+    url_buf: [48]u8 = undefined,
+    url_len: usize = 0,
+
+    const Connection = struct {
+        thread: std.Thread,
+        stream: net.Stream,
+    };
+
+    /// Listen on `port` on the loopback interface (0 picks a free one) and
+    /// start serving
+    pub fn start(allocator: Allocator, options: Options, port: u16) !*Self {
+        const self = try allocator.create(Self);
+        errdefer allocator.destroy(self);
+
+        const address = net.Address.initIp4(.{ 127, 0, 0, 1 }, port);
+        self.* = .{
+            .allocator = allocator,
+            .options = options,
+            .listener = try address.listen(.{ .reuse_address = true }),
+        };
+        errdefer self.listener.deinit();
+
+        self.url_len = (try std.fmt.bufPrint(&self.url_buf, "http://127.0.0.1:{d}/v1", .{
+            self.listener.listen_address.getPort(),
+        })).len;
+
+        self.accept_thread = try std.Thread.spawn(.{}, acceptLoop, .{self});
+        return self;
+    }
+
+    /// Stop serving, ending answers in progress, and free the provider
+    pub fn stop(self: *Self) void {
+        self.running.store(false, .release);
+        std.posix.shutdown(self.listener.stream.handle, .both) catch {};
+        self.accept_thread.join();
+
+        // No new connections from here on
+        self.mutex.lock();
+        for (self.connections.items) |conn| {
+            std.posix.shutdown(conn.stream.handle, .both) catch {};
+        }
+        self.mutex.unlock();
+        for (self.connections.items) |conn| {
+            conn.thread.join();
+            conn.stream.close();
+        }
+
+        self.connections.deinit(self.allocator);
+        self.listener.deinit();
+        self.allocator.destroy(self);
+    }
+
+    /// Base URL of the API, to be followed by /chat/completions
+    pub fn url(self: *const Self) []const u8 {
+        return self.url_buf[0..self.url_len];
+    }
+
+    fn acceptLoop(self: *Self) void {
+        while (self.running.load(.acquire)) {
+            const conn = self.listener.accept() catch return;
+
+            self.mutex.lock();
+            defer self.mutex.unlock();
+            self.connections.ensureUnusedCapacity(self.allocator, 1) catch {
+                conn.stream.close();
+                continue;
+            };
+            const thread = std.Thread.spawn(.{}, serveConnection, .{ self, conn.stream }) catch {
+                conn.stream.close();
+                continue;
+            };
+            self.connections.appendAssumeCapacity(.{ .thread = thread, .stream = conn.stream });
+        }
+    }
+
+    fn serveConnection(self: *Self, stream: net.Stream) void {
+        while (self.running.load(.acquire)) {
+            const keep_open = self.serveRequest(stream) catch return;
+            if (!keep_open) {
+                // Closed for the client; the socket itself goes in stop()
+                std.posix.shutdown(stream.handle, .both) catch {};
+                return;
+            }
+        }
+    }
+
+    /// Read one request from `stream` and answer it. False once the
+    /// connection should be closed. Requests are not pipelined by the
+    /// clients this stands in for, so nothing follows the body.
+    fn serveRequest(self: *Self, stream: net.Stream) !bool {
+        var head_buf: [8192]u8 = undefined;
+        var len: usize = 0;
+        const head_end = while (true) {
+            if (std.mem.indexOf(u8, head_buf[0..len], "\r\n\r\n")) |end| break end + 4;
+            if (len == head_buf.len) return error.HeadTooLarge;
+            const n = try std.posix.recv(stream.handle, head_buf[len..], 0);
+            if (n == 0) return false;
+            len += n;
+        };
+
+        const content_length = try contentLength(head_buf[0..head_end]);
+        if (content_length > max_body) return error.BodyTooLarge;
+        const body = try self.allocator.alloc(u8, content_length);
+        defer self.allocator.free(body);
+        const received = @min(len - head_end, content_length);
+        @memcpy(body[0..received], head_buf[head_end..][0..received]);
+        var filled = received;
+        while (filled < body.len) {
+            const n = try std.posix.recv(stream.handle, body[filled..], 0);
+            if (n == 0) return false;
+            filled += n;
+        }
+        const streaming = std.mem.indexOf(u8, body, "\"stream\":true") != null;
+
+        const number = self.requests.fetchAdd(1, .monotonic) + 1;
+        const fail = self.options.fail_every != 0 and number % self.options.fail_every == 0;
+        if (fail and self.options.failure == .drop) return false;
+        if (fail and self.options.failure == .server_error) {
+            const error_body = "{\"error\":{\"message\":\"Injected failure\",\"type\":\"server_error\"}}";
+            var head: [160]u8 = undefined;
+            try stream.writeAll(try std.fmt.bufPrint(&head, "HTTP/1.1 500 Internal Server Error\r\n" ++
+                "Content-Type: application/json\r\n" ++
+                "Content-Length: {d}\r\n\r\n", .{error_body.len}));
+            try stream.writeAll(error_body);
+            return true;
+        }
+
+        var timer = try std.time.Timer.start();
+        self.sleepUntil(&timer, @as(u64, self.options.first_token_delay_ms) * std.time.ns_per_ms);
+        if (streaming) {
+            // A cut stream ends its connection
+            try self.streamAnswer(stream, &timer, number, fail);
+            return !fail;
+        }
+        try self.sendAnswer(stream, number);
+        return true;
+    }
+
+    /// The answer as SSE, one chunk per `tokens_per_chunk` tokens, paced by
+    /// `tokens_per_second` from the first token on
+    fn streamAnswer(self: *Self, stream: net.Stream, timer: *std.time.Timer, number: u32, cut: bool) !void {
+        try stream.writeAll("HTTP/1.1 200 OK\r\n" ++
+            "Content-Type: text/event-stream\r\n" ++
+            "Cache-Control: no-cache\r\n" ++
+            "Transfer-Encoding: chunked\r\n\r\n");
+
+        const options = self.options;
+        const first_token_ns = timer.read();
+        const tokens = if (cut) options.answer_tokens / 2 else options.answer_tokens;
+        const per_chunk = @max(options.tokens_per_chunk, 1);
+
+        var event: std.ArrayList(u8) = .empty;
+        defer event.deinit(self.allocator);
+
+        var sent: u32 = 0;
+        while (sent < tokens) {
+            if (!self.running.load(.acquire)) return error.Stopped;
+            if (options.tokens_per_second != 0) {
+                self.sleepUntil(timer, first_token_ns + @as(u64, sent) * std.time.ns_per_s / options.tokens_per_second);
+            }
+
+            const count = @min(per_chunk, tokens - sent);
+            event.clearRetainingCapacity();
+            try self.appendChunkStart(&event, number);
+            try event.appendSlice(self.allocator, "\"delta\":{\"content\":\"");
+            for (sent..sent + count) |i| try event.appendSlice(self.allocator, token(i));
+            try event.appendSlice(self.allocator, "\"},\"finish_reason\":null}]}");
+            try writeEvent(stream, event.items);
+            sent += count;
+        }
+        if (cut) return;
+
+        event.clearRetainingCapacity();
+        try self.appendChunkStart(&event, number);
+        try event.appendSlice(self.allocator, "\"delta\":{\"content\":\"\"},\"finish_reason\":\"stop\"}]}");
+        try writeEvent(stream, event.items);
+
+        event.clearRetainingCapacity();
+        try event.print(self.allocator, "{{\"id\":\"mock-{d}\",\"object\":\"chat.completion.chunk\",\"model\":\"mock\",\"choices\":[]," ++
+            "\"usage\":{{\"prompt_tokens\":0,\"completion_tokens\":{d},\"total_tokens\":{d}}}}}", .{ number, tokens, tokens });
+        try writeEvent(stream, event.items);
+
+        try writeEvent(stream, "[DONE]");
+        try stream.writeAll("0\r\n\r\n");
+    }
+
+    fn appendChunkStart(self: *Self, event: *std.ArrayList(u8), number: u32) !void {
+        try event.print(self.allocator, "{{\"id\":\"mock-{d}\",\"object\":\"chat.completion.chunk\",\"model\":\"mock\",\"choices\":[{{\"index\":0,", .{number});
+    }
+
+    /// The whole answer in one chat completion body
+    fn sendAnswer(self: *Self, stream: net.Stream, number: u32) !void {
+        var body: std.ArrayList(u8) = .empty;
+        defer body.deinit(self.allocator);
+        try body.print(self.allocator, "{{\"id\":\"mock-{d}\",\"object\":\"chat.completion\",\"model\":\"mock\",\"choices\":[{{\"index\":0," ++
+            "\"message\":{{\"role\":\"assistant\",\"content\":\"", .{number});
+        for (0..self.options.answer_tokens) |i| try body.appendSlice(self.allocator, token(i));
+        try body.appendSlice(self.allocator, "\"},\"finish_reason\":\"stop\"}]}");
+
+        var head: [128]u8 = undefined;
+        try stream.writeAll(try std.fmt.bufPrint(&head, "HTTP/1.1 200 OK\r\n" ++
+            "Content-Type: application/json\r\n" ++
+            "Content-Length: {d}\r\n\r\n", .{body.items.len}));
+        try stream.writeAll(body.items);
+    }
+
+    /// Sleep until `timer` reads `target_ns`, waking early when stopped
+    fn sleepUntil(self: *Self, timer: *std.time.Timer, target_ns: u64) void {
+        while (self.running.load(.acquire)) {
+            const now = timer.read();
+            if (now >= target_ns) return;
+            std.Thread.sleep(@min(target_ns - now, 10 * std.time.ns_per_ms));
+        }
+    }
+};
+
+/// Largest request body accepted
+const max_body = 16 * 1024 * 1024;
+
+/// Text of the answer's tokens, already JSON-escaped. Some carry markdown
+/// and line breaks so the client's renderer has real work to do.
+const tokens_text = [_][]const u8{
+    "## ",    "Summary", "\\n\\n",  "The ",  "code ",  "reads ",  "the ",
+    "**input** ", "once", ", ",     "then ", "writes ", "`out` ", "per ",
+    "line.",  "\\n",     "- ",      "Fast ", "path ",  "stays ",  "linear",
+    "\\n",    "- ",      "Errors ", "are ",  "logged", "\\n\\n",
+};
+
+fn token(i: usize) []const u8 {
+    return tokens_text[i % tokens_text.len];
+}
+
+/// One SSE event as one HTTP chunk
+fn writeEvent(stream: net.Stream, data: []const u8) !void {
+    var prefix: [32]u8 = undefined;
+    try stream.writeAll(try std.fmt.bufPrint(&prefix, "{x}\r\ndata: ", .{data.len + "data: ".len + 2}));
+    try stream.writeAll(data);
+    try stream.writeAll("\n\n\r\n");
+}
+
+fn contentLength(head: []const u8) !usize {
+    var lines = std.mem.splitSequence(u8, head, "\r\n");
+    while (lines.next()) |line| {
+        const colon = std.mem.indexOfScalar(u8, line, ':') orelse continue;
+        if (!std.ascii.eqlIgnoreCase(line[0..colon], "content-length")) continue;
+        return std.fmt.parseInt(usize, std.mem.trim(u8, line[colon + 1 ..], " "), 10);
+    }
+    return 0;
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+const testing = std.testing;
+const Upstream = @import("upstream.zig").Upstream;
+const Setup = @import("upstream.zig").Setup;
+const sse = @import("sse.zig");
+
+test "mock provider paces its answer and injects failures" {
+    const allocator = testing.allocator;
+    const provider = try MockProvider.start(allocator, .{
+        .first_token_delay_ms = 20,
+        .tokens_per_second = 0,
+        .answer_tokens = 10,
+        .tokens_per_chunk = 3,
+        .fail_every = 2,
+    }, 0);
+    defer provider.stop();
+
+    var url_buf: [96]u8 = undefined;
+    const url = try std.fmt.bufPrint(&url_buf, "{s}/chat/completions", .{provider.url()});
+    var upstream = try Upstream.init(allocator, url, .{});
+    defer upstream.deinit();
+
+    var transfer_buffer: [1024]u8 = undefined;
+    var setup: Setup = .{};
+    {
+        var timer = try std.time.Timer.start();
+        var req: std.http.Client.Request = undefined;
+        var response = try upstream.post(&req, &.{}, "{\"stream\":true}", null, &setup);
+        defer req.deinit();
+        try testing.expect(response.head.status == .ok);
+        try testing.expect(timer.read() >= 20 * std.time.ns_per_ms);
+
+        const body = try response.reader(&transfer_buffer).allocRemaining(allocator, .unlimited);
+        defer allocator.free(body);
+
+        var decoder: sse.Decoder = .{};
+        defer decoder.deinit(allocator);
+        var text: std.ArrayList(u8) = .empty;
+        defer text.deinit(allocator);
+        var chunks: usize = 0;
+        var stopped = false;
+        var usage: ?sse.Usage = null;
+        var done = false;
+        decoder.feed(body);
+        while (try decoder.next(allocator)) |data| {
+            if (std.mem.eql(u8, data, sse.DONE)) {
+                done = true;
+                continue;
+            }
+            const chunk = try sse.parseChunk(data);
+            if (chunk.content) |raw| {
+                if (raw.len > 0) chunks += 1;
+                try sse.appendUnescaped(allocator, &text, raw);
+            }
+            if (chunk.finish_reason) |reason| stopped = std.mem.eql(u8, reason, "stop");
+            if (chunk.usage) |reported| usage = reported;
+        }
+
+        var expected: std.ArrayList(u8) = .empty;
+        defer expected.deinit(allocator);
+        for (0..10) |i| try sse.appendUnescaped(allocator, &expected, token(i));
+        try testing.expectEqualStrings(expected.items, text.items);
+        try testing.expectEqual(@as(usize, 4), chunks);
+        try testing.expect(stopped);
+        try testing.expectEqual(@as(u64, 10), usage.?.completion_tokens);
+        try testing.expect(done);
+    }
+    {
+        // The second request is the injected failure, on the same connection
+        var req: std.http.Client.Request = undefined;
+        var response = try upstream.post(&req, &.{}, "{\"stream\":true}", null, &setup);
+        defer req.deinit();
+        try testing.expect(setup.reused);
+        try testing.expect(response.head.status == .internal_server_error);
+        _ = try response.reader(&transfer_buffer).discardRemaining();
+    }
+}
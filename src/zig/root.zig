@@ -10,15 +10,44 @@ pub const database = struct {
 // Re-export server module
 pub const server = struct {
     pub const Server = @import("server/server.zig").Server;
+    pub const Options = @import("server/server.zig").Options;
     pub const startServer = @import("server/server.zig").startServer;
+    pub const Channel = @import("server/channel.zig").Channel;
+    pub const Cancellation = @import("server/cancellation.zig").Cancellation;
 };
 
 // Re-export MCP handler module
 pub const mcp = struct {
     pub const MCPHandler = @import("mcphandler.zig").MCPHandler;
+    pub const CoalesceOptions = @import("mcphandler.zig").CoalesceOptions;
+    pub const CacheOptions = @import("mcphandler.zig").CacheOptions;
+    pub const CacheStats = @import("mcphandler.zig").CacheStats;
     pub const loadNvidiaToken = @import("mcphandler.zig").loadNvidiaToken;
+    pub const loadEnvValue = @import("mcphandler.zig").loadEnvValue;
+    pub const chatCompletionsUrl = @import("mcphandler.zig").chatCompletionsUrl;
 };
 
+// Re-export mock model provider
+pub const mock = struct {
+    pub const MockProvider = @import("mockprovider.zig").MockProvider;
+    pub const Options = @import("mockprovider.zig").Options;
+    pub const Failure = @import("mockprovider.zig").Failure;
+};
+
+// Re-export file and folder content cache
+pub const files = struct {
+    pub const FileCache = @import("filecache.zig").FileCache;
+    pub const Options = @import("filecache.zig").Options;
+    pub const ReadStats = @import("filecache.zig").ReadStats;
+    pub const max_folder_file_size = @import("filecache.zig").max_folder_file_size;
+};
+
+// Re-export folder ingestion: parallel walk, ignore rules, sniffing
+pub const ingest = @import("ingest.zig");
+
+// Re-export SSE decoder
+pub const sse = @import("sse.zig");
+
 pub fn add(a: i32, b: i32) i32 {
     return a + b;
 }
@@ -26,3 +55,13 @@ pub fn add(a: i32, b: i32) i32 {
 test "basic add functionality" {
     try std.testing.expect(add(3, 7) == 10);
 }
+
+test {
+    _ = sse;
+    _ = @import("upstream.zig");
+    _ = @import("mcphandler.zig");
+    _ = @import("mockprovider.zig");
+    _ = @import("filecache.zig");
+    _ = ingest;
+    _ = @import("database/sqlitehandler.zig");
+}
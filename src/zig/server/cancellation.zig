@@ -0,0 +1,44 @@
+const std = @import("std");
+
+/// Cancel state of one prompt request, shared by the frame loop that
+/// receives the client's cancel and the job running the request. While the
+/// job waits on the model API its upstream socket is attached, so a cancel
+/// interrupts a blocked read instead of waiting for the next token.
+pub const Cancellation = struct {
+    const Self = @This();
+
+    cancelled: std.atomic.Value(bool) = .init(false),
+    mutex: std.Thread.Mutex = .{},
+    upstream: ?std.posix.socket_t = null,
+
+    pub fn cancel(self: *Self) void {
+        self.cancelled.store(true, .release);
+
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        if (self.upstream) |handle| {
+            std.posix.shutdown(handle, .both) catch {};
+        }
+    }
+
+    pub fn isCancelled(self: *const Self) bool {
+        return self.cancelled.load(.acquire);
+    }
+
+    /// The job is about to block on `handle`. False if the request has
+    /// already been cancelled.
+    pub fn attach(self: *Self, handle: std.posix.socket_t) bool {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        if (self.isCancelled()) return false;
+        self.upstream = handle;
+        return true;
+    }
+
+    /// Must be called before the attached socket is closed
+    pub fn detach(self: *Self) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        self.upstream = null;
+    }
+};
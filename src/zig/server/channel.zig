@@ -0,0 +1,97 @@
+const std = @import("std");
+const net = std.net;
+
+/// WebSocket opcodes
+pub const Opcode = enum(u4) {
+    continuation = 0x0,
+    text = 0x1,
+    binary = 0x2,
+    close = 0x8,
+    ping = 0x9,
+    pong = 0xA,
+};
+
+/// Outgoing side of one WebSocket connection. Several requests of the same
+/// client run at once and all write here; each frame goes out whole under
+/// the lock, so frames of different requests never interleave on the wire.
+pub const Channel = struct {
+    const Self = @This();
+
+    stream: net.Stream,
+    mutex: std.Thread.Mutex = .{},
+    /// Frames sent and write calls made for them, guarded by `mutex`
+    frames_sent: u64 = 0,
+    write_calls: u64 = 0,
+
+    pub fn init(stream: net.Stream) Self {
+        return .{ .stream = stream };
+    }
+
+    /// Send one unfragmented text frame
+    pub fn sendText(self: *Self, payload: []const u8) !void {
+        try self.sendFrame(.text, payload);
+    }
+
+    /// Send one unfragmented frame (server frames are not masked). Header
+    /// and payload go out in a single vectored write (writev, WSASend on
+    /// Windows) rather than one write each.
+    pub fn sendFrame(self: *Self, opcode: Opcode, payload: []const u8) !void {
+        var header: [10]u8 = undefined;
+        const header_len = encodeHeader(&header, opcode, payload.len);
+        var parts = [_][]const u8{ header[0..header_len], payload };
+
+        self.mutex.lock();
+        defer self.mutex.unlock();
+
+        // Unbuffered, so each writeVec is one call into the socket; it is
+        // only repeated for what a short write left over
+        var writer = self.stream.writer(&.{});
+        var first: usize = 0; // first part not fully written
+        var offset: usize = 0; // bytes of parts[first] already written
+        while (first < parts.len) {
+            const whole = parts[first];
+            parts[first] = whole[offset..];
+            const written = writer.interface.writeVec(parts[first..]);
+            parts[first] = whole;
+            self.write_calls += 1;
+
+            offset += try written;
+            while (first < parts.len and offset >= parts[first].len) {
+                offset -= parts[first].len;
+                first += 1;
+            }
+        }
+        self.frames_sent += 1;
+    }
+
+    /// Counters since init, for benchmarks
+    pub fn stats(self: *Self) struct { frames: u64, write_calls: u64 } {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        return .{ .frames = self.frames_sent, .write_calls = self.write_calls };
+    }
+};
+
+/// Write the header of a final frame into `header`; returns its length
+pub fn encodeHeader(header: *[10]u8, opcode: Opcode, payload_len: usize) usize {
+    // FIN bit + opcode
+    header[0] = 0x80 | @as(u8, @intFromEnum(opcode));
+
+    if (payload_len < 126) {
+        header[1] = @intCast(payload_len);
+        return 2;
+    } else if (payload_len < 65536) {
+        header[1] = 126;
+        header[2] = @intCast((payload_len >> 8) & 0xFF);
+        header[3] = @intCast(payload_len & 0xFF);
+        return 4;
+    }
+
+    header[1] = 127;
+    var len = payload_len;
+    for (0..8) |i| {
+        header[9 - i] = @intCast(len & 0xFF);
+        len >>= 8;
+    }
+    return 10;
+}
@@ -2,6 +2,10 @@ const std = @import("std");
 const net = std.net;
 const database = @import("../database/sqlitehandler.zig");
 const mcp = @import("../mcphandler.zig");
+const channel_mod = @import("channel.zig");
+const Channel = channel_mod.Channel;
+const Opcode = channel_mod.Opcode;
+const Cancellation = @import("cancellation.zig").Cancellation;
 const Sha1 = std.crypto.hash.Sha1;
 const base64 = std.base64;
 
@@ -9,16 +13,6 @@ const MAX_HEADER_SIZE: usize = 8192;
 const MAX_FRAME_SIZE: usize = 65536;
 const WEBSOCKET_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
 
-/// WebSocket opcodes
-const Opcode = enum(u4) {
-    continuation = 0x0,
-    text = 0x1,
-    binary = 0x2,
-    close = 0x8,
-    ping = 0x9,
-    pong = 0xA,
-};
-
 /// WebSocket frame structure
 const WebSocketFrame = struct {
     fin: bool,
@@ -27,6 +21,43 @@ const WebSocketFrame = struct {
     payload: []const u8,
 };
 
+/// A prompt request from the moment it is accepted until its job ends
+const ActiveRequest = struct {
+    /// The client's id for it, owned
+    id: []const u8,
+    cancellation: Cancellation = .{},
+};
+
+/// Per-connection state, one per accepted socket
+const Connection = struct {
+    id: u64,
+    stream: net.Stream,
+    /// Shared by the frame loop and every in-flight request
+    channel: Channel,
+    /// Prompt requests still running on the request pool; the socket is not
+    /// closed until they are done with it
+    in_flight: std.Thread.WaitGroup = .{},
+    /// The same requests, looked up by id to cancel them
+    requests_mutex: std.Thread.Mutex = .{},
+    requests: std.ArrayList(*ActiveRequest) = .empty,
+};
+
+/// Server tuning options
+pub const Options = struct {
+    /// Worker threads serving connections. An upgraded WebSocket keeps its
+    /// worker for as long as the client stays connected, so this also bounds
+    /// the number of Word windows that can be served at once.
+    /// Null picks a default from the CPU count.
+    worker_count: ?usize = null,
+    /// Threads running prompt requests, shared by all connections. A client
+    /// can have several requests in flight on one socket; long ones (streamed
+    /// answers) run here so its frame loop keeps serving the others.
+    /// Null picks a default from the CPU count.
+    request_worker_count: ?usize = null,
+    /// Log every received frame (noisy under load)
+    verbose: bool = true,
+};
+
 /// WebSocket Server for Agentic AI on Word
 pub const Server = struct {
     const Self = @This();
@@ -34,60 +65,213 @@ pub const Server = struct {
     allocator: std.mem.Allocator,
     db: *database.SqliteHandler,
     mcp_handler: *mcp.MCPHandler,
+    options: Options,
     server: ?net.Server,
-    active_connection: ?net.Stream,
-
-    pub fn init(allocator: std.mem.Allocator, db: *database.SqliteHandler, mcp_handler: *mcp.MCPHandler) Self {
+    pool: std.Thread.Pool,
+    request_pool: std.Thread.Pool,
+    pool_started: bool,
+    running: std.atomic.Value(bool),
+    connections_mutex: std.Thread.Mutex,
+    connections: std.ArrayList(*Connection),
+    next_connection_id: std.atomic.Value(u64),
+
+    pub fn init(allocator: std.mem.Allocator, db: *database.SqliteHandler, mcp_handler: *mcp.MCPHandler, options: Options) Self {
         return Self{
             .allocator = allocator,
             .db = db,
             .mcp_handler = mcp_handler,
+            .options = options,
             .server = null,
-            .active_connection = null,
+            .pool = undefined,
+            .request_pool = undefined,
+            .pool_started = false,
+            .running = std.atomic.Value(bool).init(false),
+            .connections_mutex = .{},
+            .connections = .empty,
+            .next_connection_id = std.atomic.Value(u64).init(1),
         };
     }
 
     pub fn deinit(self: *Self) void {
-        if (self.active_connection) |conn| {
-            conn.close();
+        self.stop();
+        // Joins the workers; stop() has already unblocked their sockets.
+        // Connection workers wait for their requests, so the request pool
+        // goes last.
+        if (self.pool_started) {
+            self.pool.deinit();
+            self.request_pool.deinit();
+            self.pool_started = false;
         }
         if (self.server) |*s| {
             s.deinit();
         }
+        self.server = null;
+        self.connections.deinit(self.allocator);
     }
 
     /// Start the WebSocket server
     pub fn run(self: *Self, port: u16) !void {
+        _ = try self.listen(port);
+        try self.serve();
+    }
+
+    /// Bind the listening socket. Port 0 picks a free port; the bound
+    /// address is returned so callers can connect to it.
+    pub fn listen(self: *Self, port: u16) !net.Address {
         const address = net.Address.initIp4(.{ 127, 0, 0, 1 }, port);
         self.server = try address.listen(.{
             .reuse_address = true,
         });
 
-        std.debug.print("[WebSocket] Listening on ws://localhost:{d}\n", .{port});
+        const bound = self.server.?.listen_address;
+        std.debug.print("[WebSocket] Listening on ws://localhost:{d}\n", .{bound.getPort()});
+        return bound;
+    }
 
-        while (true) {
+    /// Accept connections and hand each one to a worker thread until stop() is called
+    pub fn serve(self: *Self) !void {
+        const worker_count = self.options.worker_count orelse
+            @max((std.Thread.getCpuCount() catch 1) * 4, 16);
+
+        const request_worker_count = self.options.request_worker_count orelse
+            @max((std.Thread.getCpuCount() catch 1) * 2, 8);
+
+        try self.pool.init(.{
+            .allocator = self.allocator,
+            .n_jobs = worker_count,
+        });
+        self.request_pool.init(.{
+            .allocator = self.allocator,
+            .n_jobs = request_worker_count,
+        }) catch |err| {
+            self.pool.deinit();
+            return err;
+        };
+        self.pool_started = true;
+        self.running.store(true, .release);
+
+        std.debug.print("[WebSocket] Serving with {d} worker threads, {d} request threads\n", .{ worker_count, request_worker_count });
+
+        while (self.running.load(.acquire)) {
             const conn = self.server.?.accept() catch |err| {
+                if (!self.running.load(.acquire)) break;
                 std.debug.print("[WebSocket] Accept error: {}\n", .{err});
                 continue;
             };
 
-            self.handleConnection(conn) catch |err| {
-                std.debug.print("[WebSocket] Handler error: {}\n", .{err});
+            self.pool.spawn(serveConnection, .{ self, conn }) catch |err| {
+                std.debug.print("[WebSocket] Failed to dispatch connection: {}\n", .{err});
+                conn.stream.close();
             };
         }
     }
 
+    /// Stop accepting and unblock every worker waiting on a client socket
+    pub fn stop(self: *Self) void {
+        if (!self.running.swap(false, .acq_rel)) return;
+
+        if (self.server) |s| {
+            std.posix.shutdown(s.stream.handle, .both) catch {};
+        }
+
+        self.connections_mutex.lock();
+        defer self.connections_mutex.unlock();
+        for (self.connections.items) |connection| {
+            std.posix.shutdown(connection.stream.handle, .both) catch {};
+        }
+    }
+
+    /// Worker entry point: owns the socket for its whole lifetime
+    fn serveConnection(self: *Self, conn: net.Server.Connection) void {
+        const connection = self.registerConnection(conn.stream) catch |err| {
+            std.debug.print("[WebSocket] Failed to register connection: {}\n", .{err});
+            conn.stream.close();
+            return;
+        };
+        defer {
+            // Requests still writing to this client fail fast once the
+            // socket is shut down; wait for them before it can be reused
+            std.posix.shutdown(conn.stream.handle, .both) catch {};
+            // Nobody is left to read their answers
+            cancelRequests(connection, null);
+            connection.in_flight.wait();
+            self.unregisterConnection(connection);
+            conn.stream.close();
+        }
+
+        self.handleConnection(connection) catch |err| {
+            std.debug.print("[WebSocket] Handler error on connection {d}: {}\n", .{ connection.id, err });
+        };
+    }
+
+    fn registerConnection(self: *Self, stream: net.Stream) !*Connection {
+        const connection = try self.allocator.create(Connection);
+        errdefer self.allocator.destroy(connection);
+        connection.* = .{
+            .id = self.next_connection_id.fetchAdd(1, .monotonic),
+            .stream = stream,
+            .channel = Channel.init(stream),
+        };
+
+        // Checked under the lock stop() takes after clearing `running`: a
+        // connection accepted before stop() but only picked up by a worker
+        // now would otherwise be missed by its shutdown and block forever
+        self.connections_mutex.lock();
+        defer self.connections_mutex.unlock();
+        if (!self.running.load(.acquire)) return error.ServerStopped;
+        try self.connections.append(self.allocator, connection);
+        return connection;
+    }
+
+    fn unregisterConnection(self: *Self, connection: *Connection) void {
+        self.connections_mutex.lock();
+        for (self.connections.items, 0..) |item, i| {
+            if (item == connection) {
+                _ = self.connections.swapRemove(i);
+                break;
+            }
+        }
+        self.connections_mutex.unlock();
+        connection.requests.deinit(self.allocator);
+        self.allocator.destroy(connection);
+    }
+
+    /// Make a prompt request cancellable until endRequest()
+    fn beginRequest(self: *Self, connection: *Connection, id: []const u8) !*ActiveRequest {
+        const active = try self.allocator.create(ActiveRequest);
+        errdefer self.allocator.destroy(active);
+        active.* = .{ .id = try self.allocator.dupe(u8, id) };
+        errdefer self.allocator.free(active.id);
+
+        connection.requests_mutex.lock();
+        defer connection.requests_mutex.unlock();
+        try connection.requests.append(self.allocator, active);
+        return active;
+    }
+
+    fn endRequest(self: *Self, connection: *Connection, active: *ActiveRequest) void {
+        connection.requests_mutex.lock();
+        for (connection.requests.items, 0..) |item, i| {
+            if (item == active) {
+                _ = connection.requests.swapRemove(i);
+                break;
+            }
+        }
+        connection.requests_mutex.unlock();
+        self.allocator.free(active.id);
+        self.allocator.destroy(active);
+    }
+
     /// Handle incoming connection
-    fn handleConnection(self: *Self, conn: net.Server.Connection) !void {
+    fn handleConnection(self: *Self, connection: *Connection) !void {
+        const stream = connection.stream;
         var buffer: [MAX_HEADER_SIZE]u8 = undefined;
-        const len = std.posix.recv(conn.stream.handle, &buffer, 0) catch |err| {
+        const len = std.posix.recv(stream.handle, &buffer, 0) catch |err| {
             std.debug.print("[WebSocket] recv error: {}\n", .{err});
-            conn.stream.close();
             return err;
         };
 
         if (len == 0) {
-            conn.stream.close();
             return;
         }
 
@@ -97,27 +281,26 @@ pub const Server = struct {
         if (std.mem.indexOf(u8, request, "Upgrade: websocket") != null or
             std.mem.indexOf(u8, request, "Upgrade: Websocket") != null)
         {
-            try self.handleWebSocketUpgrade(conn.stream, request);
+            try self.handleWebSocketUpgrade(connection, request);
         } else {
             // Handle as regular HTTP request
-            try self.handleHttpRequest(conn.stream, request);
-            conn.stream.close();
+            try self.handleHttpRequest(stream, request);
         }
     }
 
     /// Handle WebSocket upgrade handshake
-    fn handleWebSocketUpgrade(self: *Self, stream: net.Stream, request: []const u8) !void {
+    fn handleWebSocketUpgrade(self: *Self, connection: *Connection, request: []const u8) !void {
+        const stream = connection.stream;
+
         // Extract Sec-WebSocket-Key
         const key_header = "Sec-WebSocket-Key: ";
         const key_start = std.mem.indexOf(u8, request, key_header) orelse {
             std.debug.print("[WebSocket] No Sec-WebSocket-Key found\n", .{});
-            stream.close();
             return;
         };
 
         const key_value_start = key_start + key_header.len;
         const key_end = std.mem.indexOfPos(u8, request, key_value_start, "\r\n") orelse {
-            stream.close();
             return;
         };
 
@@ -142,22 +325,17 @@ pub const Server = struct {
         _ = try stream.writeAll(&accept_key);
         _ = try stream.writeAll("\r\n\r\n");
 
-        std.debug.print("[WebSocket] Connection upgraded successfully\n", .{});
-
-        // Store active connection
-        self.active_connection = stream;
+        std.debug.print("[WebSocket] Connection {d} upgraded successfully\n", .{connection.id});
 
         // Handle WebSocket frames
-        self.handleWebSocketFrames(stream) catch |err| {
-            std.debug.print("[WebSocket] Frame handling error: {}\n", .{err});
+        self.handleWebSocketFrames(connection) catch |err| {
+            std.debug.print("[WebSocket] Frame handling error on connection {d}: {}\n", .{ connection.id, err });
         };
-
-        self.active_connection = null;
-        stream.close();
     }
 
     /// Handle WebSocket frames in a loop
-    fn handleWebSocketFrames(self: *Self, stream: net.Stream) !void {
+    fn handleWebSocketFrames(self: *Self, connection: *Connection) !void {
+        const stream = connection.stream;
         var frame_buffer: [MAX_FRAME_SIZE]u8 = undefined;
 
         while (true) {
@@ -228,8 +406,10 @@ pub const Server = struct {
             // Handle frame by opcode
             switch (opcode) {
                 .text => {
-                    std.debug.print("[WebSocket] Received text: {s}\n", .{payload});
-                    try self.handleTextMessage(stream, payload);
+                    if (self.options.verbose) {
+                        std.debug.print("[WebSocket] Received text: {s}\n", .{payload});
+                    }
+                    try self.handleTextMessage(connection, payload);
                 },
                 .binary => {
                     std.debug.print("[WebSocket] Received binary frame\n", .{});
@@ -237,12 +417,12 @@ pub const Server = struct {
                 .close => {
                     std.debug.print("[WebSocket] Close frame received\n", .{});
                     // Send close frame back
-                    try self.sendFrame(stream, .close, "");
+                    try connection.channel.sendFrame(.close, "");
                     return;
                 },
                 .ping => {
                     std.debug.print("[WebSocket] Ping received, sending pong\n", .{});
-                    try self.sendFrame(stream, .pong, payload);
+                    try connection.channel.sendFrame(.pong, payload);
                 },
                 .pong => {
                     std.debug.print("[WebSocket] Pong received\n", .{});
@@ -256,60 +436,92 @@ pub const Server = struct {
         }
     }
 
-    /// Handle text message from WebSocket client
-    fn handleTextMessage(self: *Self, stream: net.Stream, message: []const u8) !void {
+    /// Handle text message from WebSocket client. Replies carry the id of
+    /// the request they answer, so a client can have several requests in
+    /// flight on this socket: prompts run on the request pool, health and
+    /// history are answered here right away, even while a prompt streams.
+    fn handleTextMessage(self: *Self, connection: *Connection, message: []const u8) !void {
         // Parse JSON message
         const parsed = std.json.parseFromSlice(std.json.Value, self.allocator, message, .{}) catch {
-            try self.sendJsonResponse(stream, .{
+            try self.sendJsonResponse(&connection.channel, .{
                 .id = "unknown",
                 .status = "error",
                 .content = "Invalid JSON format",
             });
             return;
         };
-        defer parsed.deinit();
+        var handed_off = false;
+        defer if (!handed_off) parsed.deinit();
 
+        if (parsed.value != .object) {
+            try self.sendJsonResponse(&connection.channel, .{
+                .id = "unknown",
+                .status = "error",
+                .content = "Invalid JSON format",
+            });
+            return;
+        }
         const root = parsed.value.object;
 
         // Extract request fields
-        const id = if (root.get("id")) |v| v.string else "unknown";
-        const msg_type = if (root.get("type")) |v| v.string else "unknown";
+        var id_buf: [20]u8 = undefined;
+        const id = requestId(root, &id_buf);
+        var bad_field: []const u8 = "";
+        const msg_type = (requestField([]const u8, root, "type", &bad_field) catch null) orelse "unknown";
 
-        std.debug.print("[WebSocket] Processing request: id={s}, type={s}\n", .{ id, msg_type });
+        if (self.options.verbose) {
+            std.debug.print("[WebSocket] Processing request: id={s}, type={s}\n", .{ id, msg_type });
+        }
 
         // Route to appropriate handler
-        if (std.mem.eql(u8, msg_type, "analyze") or
-            std.mem.eql(u8, msg_type, "explain") or
-            std.mem.eql(u8, msg_type, "review") or
-            std.mem.eql(u8, msg_type, "refactor"))
-        {
-            const file_path: []const u8 = if (root.get("file_path")) |v| v.string else "";
-            const currentFile: []const u8 = if (root.get("current_file")) |v| v.string else "";
-            const content: []const u8 = if (root.get("content")) |v| v.string else "";
-            const prompt: []const u8 = if (root.get("prompt")) |v| v.string else "";
-            const isStream: ?bool = if (root.get("isStream")) |v| v.bool else null;
-
-            try self.db.insertHistoryChat(prompt, file_path, "user", currentFile);
-            try self.mcp_handler.processRequest(
-                self.allocator,
-                stream,
-                id,
-                msg_type,
-                file_path,
-                content,
-                prompt,
-                isStream,
-            );
+        if (isPromptType(msg_type)) {
+            // Checked here, as reading a field of another type would panic
+            // the worker
+            const request = PromptRequest.read(root, &bad_field) catch {
+                var content_buf: [64]u8 = undefined;
+                try self.sendJsonResponse(&connection.channel, .{
+                    .id = id,
+                    .status = "error",
+                    .content = std.fmt.bufPrint(&content_buf, "Field \"{s}\" has the wrong type", .{bad_field}) catch "A field has the wrong type",
+                });
+                return;
+            };
+            // Registered here, on the frame loop, so a cancel read after
+            // this message always finds it
+            const active = self.beginRequest(connection, id) catch {
+                try self.sendJsonResponse(&connection.channel, .{
+                    .id = id,
+                    .status = "error",
+                    .content = "Out of memory",
+                });
+                return;
+            };
+            // The job owns the parsed request from here on
+            self.request_pool.spawnWg(&connection.in_flight, runPromptRequest, .{ self, connection, parsed, msg_type, request, active });
+            handed_off = true;
         } else if (std.mem.eql(u8, msg_type, "health")) {
-            try self.sendJsonResponse(stream, .{
+            try self.sendJsonResponse(&connection.channel, .{
                 .id = id,
                 .status = "ok",
                 .content = "WebSocket server is running",
             });
         } else if (std.mem.eql(u8, msg_type, "history")) {
-            try self.handleGetHistory(stream);
+            try self.handleGetHistory(&connection.channel, id);
+        } else if (std.mem.eql(u8, msg_type, "stats")) {
+            try self.handleGetStats(&connection.channel, id);
+        } else if (std.mem.eql(u8, msg_type, "cancel")) {
+            // `id` names the request to stop; its job ends it with a
+            // "cancelled" status. One that has already finished gets that
+            // status here, so the client is never left waiting.
+            if (!cancelRequests(connection, id)) {
+                try self.sendJsonResponse(&connection.channel, .{
+                    .id = id,
+                    .status = "cancelled",
+                    .content = "",
+                });
+            }
         } else {
-            try self.sendJsonResponse(stream, .{
+            try self.sendJsonResponse(&connection.channel, .{
                 .id = id,
                 .status = "error",
                 .content = "Unknown message type",
@@ -317,6 +529,55 @@ pub const Server = struct {
         }
     }
 
+    /// Response cache counters, as text for display
+    fn handleGetStats(self: *Self, channel: *Channel, id: []const u8) !void {
+        const stats = self.mcp_handler.cacheStats();
+        const totals = self.db.responseCacheTotals() catch database.ResponseCacheTotals{ .entries = 0, .bytes = 0 };
+
+        var content_buf: [256]u8 = undefined;
+        const content = try std.fmt.bufPrint(&content_buf, "Response cache: {d} hits, {d} misses ({d:.1}% hit rate), {d} stored; {d} entries, {d} KiB", .{
+            stats.hits,
+            stats.misses,
+            stats.hitRate() * 100,
+            stats.stores,
+            totals.entries,
+            totals.bytes / 1024,
+        });
+        try self.sendJsonResponse(channel, .{
+            .id = id,
+            .status = "ok",
+            .content = content,
+        });
+    }
+
+    /// Request pool job: answers one prompt on its connection's channel
+    /// `msg_type` and `request` are slices of `parsed`, which the job owns
+    fn runPromptRequest(self: *Self, connection: *Connection, parsed: std.json.Parsed(std.json.Value), msg_type: []const u8, request: PromptRequest, active: *ActiveRequest) void {
+        defer parsed.deinit();
+        defer self.endRequest(connection, active);
+        const root = parsed.value.object;
+
+        var id_buf: [20]u8 = undefined;
+        const id = requestId(root, &id_buf);
+
+        self.db.insertHistoryChat(request.prompt, request.file_path, "user", request.current_file) catch |err| {
+            std.debug.print("[WebSocket] Failed to save prompt {s}: {}\n", .{ id, err });
+        };
+        self.mcp_handler.processRequest(
+            self.allocator,
+            &connection.channel,
+            id,
+            msg_type,
+            request.file_path,
+            request.content,
+            request.prompt,
+            request.is_stream,
+            &active.cancellation,
+        ) catch |err| {
+            std.debug.print("[WebSocket] Request {s} on connection {d} failed: {}\n", .{ id, connection.id, err });
+        };
+    }
+
     /// Escape a string for JSON output
     fn escapeJsonString(self: *Self, builder: *std.ArrayList(u8), str: []const u8) !void {
         for (str) |ch| {
@@ -343,9 +604,10 @@ pub const Server = struct {
     }
 
     /// Handle history request
-    fn handleGetHistory(self: *Self, stream: net.Stream) !void {
+    fn handleGetHistory(self: *Self, channel: *Channel, id: []const u8) !void {
         var records = self.db.getTables() catch {
-            try self.sendJsonResponse(stream, .{
+            try self.sendJsonResponse(channel, .{
+                .id = id,
                 .status = "error",
                 .content = "Database error",
             });
@@ -358,7 +620,9 @@ pub const Server = struct {
         defer json_builder.deinit(self.allocator);
 
         // Start JSON object
-        try json_builder.appendSlice(self.allocator, "{\"type\":\"history\",\"status\":\"ok\",\"data\":[");
+        try json_builder.appendSlice(self.allocator, "{\"id\":\"");
+        try self.escapeJsonString(&json_builder, id);
+        try json_builder.appendSlice(self.allocator, "\",\"type\":\"history\",\"status\":\"ok\",\"data\":[");
 
         // Limit records to prevent excessive response size
         const max_records: usize = 50;
@@ -390,11 +654,12 @@ pub const Server = struct {
         try json_builder.appendSlice(self.allocator, "]}");
 
         std.debug.print("[WebSocket] History response: {d} records, {d} bytes\n", .{ record_count, json_builder.items.len });
-        try self.sendFrame(stream, .text, json_builder.items);
+        try channel.sendText(json_builder.items);
     }
 
     /// Send JSON response helper
-    fn sendJsonResponse(self: *Self, stream: net.Stream, response: anytype) !void {
+    fn sendJsonResponse(self: *Self, channel: *Channel, response: anytype) !void {
+        _ = self;
         var json_buf: [4096]u8 = undefined;
         var fbs = std.io.fixedBufferStream(&json_buf);
         const writer = fbs.writer();
@@ -422,43 +687,7 @@ pub const Server = struct {
         }
         try writer.writeAll("}");
 
-        try self.sendFrame(stream, .text, fbs.getWritten());
-    }
-
-    /// Send WebSocket frame
-    pub fn sendFrame(self: *Self, stream: net.Stream, opcode: Opcode, payload: []const u8) !void {
-        _ = self;
-        var header: [10]u8 = undefined;
-        var header_len: usize = 2;
-
-        // FIN bit + opcode
-        header[0] = 0x80 | @as(u8, @intFromEnum(opcode));
-
-        // Payload length (server frames are not masked)
-        if (payload.len < 126) {
-            header[1] = @intCast(payload.len);
-        } else if (payload.len < 65536) {
-            header[1] = 126;
-            header[2] = @intCast((payload.len >> 8) & 0xFF);
-            header[3] = @intCast(payload.len & 0xFF);
-            header_len = 4;
-        } else {
-            header[1] = 127;
-            var len = payload.len;
-            for (0..8) |i| {
-                header[9 - i] = @intCast(len & 0xFF);
-                len >>= 8;
-            }
-            header_len = 10;
-        }
-
-        // Send header
-        _ = try stream.writeAll(header[0..header_len]);
-
-        // Send payload
-        if (payload.len > 0) {
-            _ = try stream.writeAll(payload);
-        }
+        try channel.sendText(fbs.getWritten());
     }
 
     /// Handle regular HTTP request (for backwards compatibility)
@@ -506,6 +735,77 @@ pub const Server = struct {
     }
 };
 
+/// Request types answered by the model
+fn isPromptType(msg_type: []const u8) bool {
+    return std.mem.eql(u8, msg_type, "analyze") or
+        std.mem.eql(u8, msg_type, "explain") or
+        std.mem.eql(u8, msg_type, "review") or
+        std.mem.eql(u8, msg_type, "refactor");
+}
+
+/// Cancel the connection's running prompt requests with this id, or all of
+/// them for null. False if none matched.
+fn cancelRequests(connection: *Connection, id: ?[]const u8) bool {
+    connection.requests_mutex.lock();
+    defer connection.requests_mutex.unlock();
+
+    var found = false;
+    for (connection.requests.items) |active| {
+        if (id) |wanted| {
+            if (!std.mem.eql(u8, active.id, wanted)) continue;
+        }
+        active.cancellation.cancel();
+        found = true;
+    }
+    return found;
+}
+
+/// The fields of a prompt request
+const PromptRequest = struct {
+    file_path: []const u8 = "",
+    current_file: []const u8 = "",
+    content: []const u8 = "",
+    prompt: []const u8 = "",
+    is_stream: ?bool = null,
+
+    /// error.WrongType with the name of the field at fault in `bad_field`
+    fn read(root: std.json.ObjectMap, bad_field: *[]const u8) error{WrongType}!PromptRequest {
+        return .{
+            .file_path = (try requestField([]const u8, root, "file_path", bad_field)) orelse "",
+            .current_file = (try requestField([]const u8, root, "current_file", bad_field)) orelse "",
+            .content = (try requestField([]const u8, root, "content", bad_field)) orelse "",
+            .prompt = (try requestField([]const u8, root, "prompt", bad_field)) orelse "",
+            .is_stream = try requestField(bool, root, "isStream", bad_field),
+        };
+    }
+};
+
+/// Field `name` of a request as a string ([]const u8) or a bool; null if
+/// it is missing or null. Any other type is error.WrongType, with `name`
+/// in `bad_field`.
+fn requestField(comptime T: type, root: std.json.ObjectMap, name: []const u8, bad_field: *[]const u8) error{WrongType}!?T {
+    const value = root.get(name) orelse return null;
+    switch (value) {
+        .null => return null,
+        .string => |text| if (T == []const u8) return text,
+        .bool => |flag| if (T == bool) return flag,
+        else => {},
+    }
+    bad_field.* = name;
+    return error.WrongType;
+}
+
+/// The request's id as the client sent it: strings verbatim, integers in
+/// decimal. Every frame answering the request echoes it.
+fn requestId(root: std.json.ObjectMap, buf: *[20]u8) []const u8 {
+    const value = root.get("id") orelse return "unknown";
+    return switch (value) {
+        .string => |text| text,
+        .integer => |number| std.fmt.bufPrint(buf, "{d}", .{number}) catch "unknown",
+        else => "unknown",
+    };
+}
+
 /// Start the WebSocket server with given database and MCP handler
 pub fn startServer(
     allocator: std.mem.Allocator,
@@ -513,7 +813,7 @@ pub fn startServer(
     mcp_handler: *mcp.MCPHandler,
     port: u16,
 ) !void {
-    var server = Server.init(allocator, db, mcp_handler);
+    var server = Server.init(allocator, db, mcp_handler, .{});
     defer server.deinit();
     try server.run(port);
 }
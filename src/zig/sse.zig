@@ -0,0 +1,624 @@
+//! Server-sent events from the model API, decoded without building a JSON
+//! tree. `Decoder` splits the byte stream into events, `parseChunk` pulls
+//! the few fields the server uses out of one chat completion chunk.
+const std = @import("std");
+const Allocator = std.mem.Allocator;
+
+/// Data of the event that ends an OpenAI-style stream
+pub const DONE = "[DONE]";
+
+/// Splits a server-sent event stream into the data of each event. Bytes are
+/// fed as they arrive, split anywhere. An event is normally returned as a
+/// slice of the fed bytes; only a line split across feeds, or the data of a
+/// multi-line event, is copied into buffers that are kept and reused, so a
+/// stream allocates only until its longest event has been seen once.
+/// Fields other than `data` (event, id, retry, comments) are skipped.
+pub const Decoder = struct {
+    const Self = @This();
+
+    /// Start of a line whose end has not arrived yet
+    carry: std.ArrayList(u8) = .empty,
+    /// Data lines of the current event, joined with '\n'
+    data: std.ArrayList(u8) = .empty,
+    has_data: bool = false,
+    /// Fed bytes not looked at yet
+    input: []const u8 = &.{},
+    /// `carry` / `data` hold what the last next() returned
+    carry_taken: bool = false,
+    data_taken: bool = false,
+
+    pub fn deinit(self: *Self, allocator: Allocator) void {
+        self.carry.deinit(allocator);
+        self.data.deinit(allocator);
+    }
+
+    /// Hand over the next bytes. The previous ones must have been used up
+    /// (next() returned null); `bytes` must stay valid until that happens
+    /// for these.
+    pub fn feed(self: *Self, bytes: []const u8) void {
+        std.debug.assert(self.input.len == 0);
+        self.input = bytes;
+    }
+
+    /// The data of the next complete event, valid until the next call.
+    /// Null once the fed bytes are used up.
+    pub fn next(self: *Self, allocator: Allocator) !?[]const u8 {
+        if (self.data_taken) {
+            self.data.clearRetainingCapacity();
+            self.has_data = false;
+            self.data_taken = false;
+        }
+
+        while (try self.takeLine(allocator)) |line| {
+            if (line.len == 0) {
+                // A blank line ends the event
+                if (!self.has_data) continue;
+                self.data_taken = true;
+                return self.data.items;
+            }
+
+            const value = dataValue(line) orelse continue;
+
+            // The usual shape, one data line and its blank line together:
+            // hand out the line where it is
+            if (!self.has_data) {
+                if (blankLineLength(self.input)) |blank| {
+                    self.input = self.input[blank..];
+                    return value;
+                }
+            }
+
+            if (self.has_data) try self.data.append(allocator, '\n');
+            try self.data.appendSlice(allocator, value);
+            self.has_data = true;
+        }
+        return null;
+    }
+
+    /// True if the fed bytes still hold a complete line, i.e. next() can
+    /// make progress without more input
+    pub fn hasBufferedLine(self: *const Self) bool {
+        return std.mem.indexOfScalar(u8, self.input, '\n') != null;
+    }
+
+    /// End of stream, once next() has returned null: an event cut off
+    /// before its blank line (or its last newline), if there is one
+    pub fn finish(self: *Self, allocator: Allocator) !?[]const u8 {
+        self.input = "\n\n";
+        const data = try self.next(allocator);
+        self.input = &.{};
+        return data;
+    }
+
+    fn takeLine(self: *Self, allocator: Allocator) !?[]const u8 {
+        if (self.carry_taken) {
+            self.carry.clearRetainingCapacity();
+            self.carry_taken = false;
+        }
+
+        const end = std.mem.indexOfScalar(u8, self.input, '\n') orelse {
+            try self.carry.appendSlice(allocator, self.input);
+            self.input = &.{};
+            return null;
+        };
+
+        var line = self.input[0..end];
+        self.input = self.input[end + 1 ..];
+        if (self.carry.items.len > 0) {
+            try self.carry.appendSlice(allocator, line);
+            line = self.carry.items;
+            self.carry_taken = true;
+        }
+        return trimCr(line);
+    }
+};
+
+fn trimCr(line: []const u8) []const u8 {
+    return if (line.len > 0 and line[line.len - 1] == '\r') line[0 .. line.len - 1] else line;
+}
+
+/// The value of a `data` field line, null for any other line
+fn dataValue(line: []const u8) ?[]const u8 {
+    if (!std.mem.startsWith(u8, line, "data")) return null;
+    const rest = line[4..];
+    if (rest.len == 0) return rest;
+    if (rest[0] != ':') return null;
+    // One space after the colon is part of the syntax
+    return if (rest.len > 1 and rest[1] == ' ') rest[2..] else rest[1..];
+}
+
+/// Length of a blank line at the start of `bytes`, if one is there
+fn blankLineLength(bytes: []const u8) ?usize {
+    if (bytes.len >= 1 and bytes[0] == '\n') return 1;
+    if (bytes.len >= 2 and bytes[0] == '\r' and bytes[1] == '\n') return 2;
+    return null;
+}
+
+/// Token counts reported with the last chunk
+pub const Usage = struct {
+    prompt_tokens: u64 = 0,
+    completion_tokens: u64 = 0,
+    total_tokens: u64 = 0,
+};
+
+/// What the server needs from one chat completion chunk
+pub const Chunk = struct {
+    /// choices[0].delta.content, still JSON-escaped (see appendUnescaped)
+    content: ?[]const u8 = null,
+    /// choices[0].finish_reason, once the model has stopped
+    finish_reason: ?[]const u8 = null,
+    usage: ?Usage = null,
+};
+
+pub const ParseError = error{Malformed};
+
+/// Scan one chunk for the fields of `Chunk`, skipping everything else
+/// without allocating. Values of unexpected types are treated as absent;
+/// anything that is not a well-formed object is Malformed.
+pub fn parseChunk(data: []const u8) ParseError!Chunk {
+    var scanner = Scanner{ .text = data };
+    var chunk: Chunk = .{};
+
+    try scanner.expect('{');
+    if (try scanner.objectEmpty()) return chunk;
+    while (true) {
+        const key = try scanner.key();
+        if (std.mem.eql(u8, key, "choices")) {
+            try scanChoices(&scanner, &chunk);
+        } else if (std.mem.eql(u8, key, "usage")) {
+            chunk.usage = try scanUsage(&scanner);
+        } else {
+            try scanner.skipValue();
+        }
+        if (!try scanner.more('}')) break;
+    }
+    scanner.skipSpace();
+    if (scanner.pos != scanner.text.len) return error.Malformed;
+    return chunk;
+}
+
+/// choices: only the first element is read
+fn scanChoices(scanner: *Scanner, chunk: *Chunk) ParseError!void {
+    if (scanner.peek() != '[') return scanner.skipValue();
+    scanner.pos += 1;
+    if (try scanner.arrayEmpty()) return;
+
+    var first = true;
+    while (true) {
+        if (first and scanner.peek() == '{') {
+            scanner.pos += 1;
+            if (!try scanner.objectEmpty()) {
+                while (true) {
+                    const key = try scanner.key();
+                    if (std.mem.eql(u8, key, "delta")) {
+                        chunk.content = try scanDelta(scanner);
+                    } else if (std.mem.eql(u8, key, "finish_reason")) {
+                        chunk.finish_reason = try scanner.optionalString();
+                    } else {
+                        try scanner.skipValue();
+                    }
+                    if (!try scanner.more('}')) break;
+                }
+            }
+        } else {
+            try scanner.skipValue();
+        }
+        first = false;
+        if (!try scanner.more(']')) break;
+    }
+}
+
+/// delta: returns its content
+fn scanDelta(scanner: *Scanner) ParseError!?[]const u8 {
+    if (scanner.peek() != '{') {
+        try scanner.skipValue();
+        return null;
+    }
+    scanner.pos += 1;
+    var content: ?[]const u8 = null;
+    if (try scanner.objectEmpty()) return content;
+    while (true) {
+        const key = try scanner.key();
+        if (std.mem.eql(u8, key, "content")) {
+            content = try scanner.optionalString();
+        } else {
+            try scanner.skipValue();
+        }
+        if (!try scanner.more('}')) break;
+    }
+    return content;
+}
+
+fn scanUsage(scanner: *Scanner) ParseError!?Usage {
+    if (scanner.peek() != '{') {
+        try scanner.skipValue();
+        return null;
+    }
+    scanner.pos += 1;
+    var usage: Usage = .{};
+    if (try scanner.objectEmpty()) return usage;
+    while (true) {
+        const key = try scanner.key();
+        if (std.mem.eql(u8, key, "prompt_tokens")) {
+            usage.prompt_tokens = try scanner.optionalCount();
+        } else if (std.mem.eql(u8, key, "completion_tokens")) {
+            usage.completion_tokens = try scanner.optionalCount();
+        } else if (std.mem.eql(u8, key, "total_tokens")) {
+            usage.total_tokens = try scanner.optionalCount();
+        } else {
+            try scanner.skipValue();
+        }
+        if (!try scanner.more('}')) break;
+    }
+    return usage;
+}
+
+/// Cursor over one JSON text. Strings are returned raw (escapes intact);
+/// skipped values are checked for structure, not for every JSON rule.
+const Scanner = struct {
+    text: []const u8,
+    pos: usize = 0,
+
+    fn skipSpace(self: *Scanner) void {
+        while (self.pos < self.text.len) : (self.pos += 1) {
+            switch (self.text[self.pos]) {
+                ' ', '\t', '\n', '\r' => {},
+                else => return,
+            }
+        }
+    }
+
+    fn peek(self: *Scanner) u8 {
+        self.skipSpace();
+        return if (self.pos < self.text.len) self.text[self.pos] else 0;
+    }
+
+    fn expect(self: *Scanner, ch: u8) ParseError!void {
+        if (self.peek() != ch) return error.Malformed;
+        self.pos += 1;
+    }
+
+    /// Right after '{': true (and consumed) if the object is empty
+    fn objectEmpty(self: *Scanner) ParseError!bool {
+        if (self.peek() != '}') return false;
+        self.pos += 1;
+        return true;
+    }
+
+    fn arrayEmpty(self: *Scanner) ParseError!bool {
+        if (self.peek() != ']') return false;
+        self.pos += 1;
+        return true;
+    }
+
+    /// After a member or element: true on ',', false on `close`
+    fn more(self: *Scanner, close: u8) ParseError!bool {
+        const ch = self.peek();
+        self.pos += 1;
+        if (ch == ',') return true;
+        if (ch == close) return false;
+        return error.Malformed;
+    }
+
+    /// A member name and its colon
+    fn key(self: *Scanner) ParseError![]const u8 {
+        const name = try self.string();
+        try self.expect(':');
+        return name;
+    }
+
+    /// A string's raw contents, without the quotes
+    fn string(self: *Scanner) ParseError![]const u8 {
+        try self.expect('"');
+        const start = self.pos;
+        while (self.pos < self.text.len) : (self.pos += 1) {
+            switch (self.text[self.pos]) {
+                '\\' => self.pos += 1,
+                '"' => {
+                    const raw = self.text[start..self.pos];
+                    self.pos += 1;
+                    return raw;
+                },
+                else => {},
+            }
+        }
+        return error.Malformed;
+    }
+
+    /// A string, or null for any other value
+    fn optionalString(self: *Scanner) ParseError!?[]const u8 {
+        if (self.peek() == '"') return try self.string();
+        try self.skipValue();
+        return null;
+    }
+
+    /// A non-negative integer, or 0 for any other value
+    fn optionalCount(self: *Scanner) ParseError!u64 {
+        self.skipSpace();
+        const start = self.pos;
+        while (self.pos < self.text.len and std.ascii.isDigit(self.text[self.pos])) self.pos += 1;
+        if (self.pos > start and (self.pos == self.text.len or !isNumberChar(self.text[self.pos]))) {
+            return std.fmt.parseInt(u64, self.text[start..self.pos], 10) catch 0;
+        }
+        self.pos = start;
+        try self.skipValue();
+        return 0;
+    }
+
+    fn skipValue(self: *Scanner) ParseError!void {
+        switch (self.peek()) {
+            '"' => _ = try self.string(),
+            '{', '[' => {
+                // Brackets are counted, strings skipped whole
+                var depth: usize = 0;
+                while (self.pos < self.text.len) {
+                    switch (self.text[self.pos]) {
+                        '"' => {
+                            _ = try self.string();
+                            continue;
+                        },
+                        '{', '[' => depth += 1,
+                        '}', ']' => {
+                            depth -= 1;
+                            if (depth == 0) {
+                                self.pos += 1;
+                                return;
+                            }
+                        },
+                        else => {},
+                    }
+                    self.pos += 1;
+                }
+                return error.Malformed;
+            },
+            else => {
+                // Number, true, false or null
+                const start = self.pos;
+                while (self.pos < self.text.len and isNumberChar(self.text[self.pos])) self.pos += 1;
+                if (self.pos == start) return error.Malformed;
+            },
+        }
+    }
+
+    fn isNumberChar(ch: u8) bool {
+        return std.ascii.isAlphanumeric(ch) or ch == '-' or ch == '+' or ch == '.';
+    }
+};
+
+/// Append the text of a raw JSON string (as returned in `Chunk.content`)
+/// to `out`. Malformed escapes and unpaired surrogates become U+FFFD.
+pub fn appendUnescaped(allocator: Allocator, out: *std.ArrayList(u8), raw: []const u8) !void {
+    var i: usize = 0;
+    while (i < raw.len) {
+        const run_end = std.mem.indexOfScalarPos(u8, raw, i, '\\') orelse raw.len;
+        try out.appendSlice(allocator, raw[i..run_end]);
+        i = run_end;
+        if (i == raw.len) break;
+
+        // raw[i] is a backslash
+        if (i + 1 == raw.len) {
+            try appendReplacement(allocator, out);
+            break;
+        }
+        const escape = raw[i + 1];
+        i += 2;
+        switch (escape) {
+            '"', '\\', '/' => try out.append(allocator, escape),
+            'b' => try out.append(allocator, 0x08),
+            'f' => try out.append(allocator, 0x0C),
+            'n' => try out.append(allocator, '\n'),
+            'r' => try out.append(allocator, '\r'),
+            't' => try out.append(allocator, '\t'),
+            'u' => {
+                var code: u21 = hex4(raw, i) orelse {
+                    try appendReplacement(allocator, out);
+                    continue;
+                };
+                i += 4;
+                if (code >= 0xD800 and code <= 0xDBFF) {
+                    // A high surrogate needs its low half right after it
+                    const low: ?u21 = if (i + 6 <= raw.len and raw[i] == '\\' and raw[i + 1] == 'u') hex4(raw, i + 2) else null;
+                    if (low != null and low.? >= 0xDC00 and low.? <= 0xDFFF) {
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low.? - 0xDC00);
+                        i += 6;
+                    } else {
+                        code = 0xFFFD;
+                    }
+                } else if (code >= 0xDC00 and code <= 0xDFFF) {
+                    code = 0xFFFD;
+                }
+                var buf: [4]u8 = undefined;
+                const len = std.unicode.utf8Encode(code, &buf) catch unreachable;
+                try out.appendSlice(allocator, buf[0..len]);
+            },
+            else => try appendReplacement(allocator, out),
+        }
+    }
+}
+
+fn appendReplacement(allocator: Allocator, out: *std.ArrayList(u8)) !void {
+    try out.appendSlice(allocator, "\u{FFFD}");
+}
+
+fn hex4(raw: []const u8, at: usize) ?u21 {
+    if (at + 4 > raw.len) return null;
+    return std.fmt.parseInt(u21, raw[at .. at + 4], 16) catch null;
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+const testing = std.testing;
+
+/// Feed `stream` in pieces ending at `cuts` and collect the events
+fn decodeAll(allocator: Allocator, stream: []const u8, cuts: []const usize, events: *std.ArrayList([]u8)) !void {
+    var decoder: Decoder = .{};
+    defer decoder.deinit(allocator);
+
+    var start: usize = 0;
+    for (cuts) |cut| {
+        const end = @min(@max(cut, start), stream.len);
+        decoder.feed(stream[start..end]);
+        while (try decoder.next(allocator)) |data| {
+            try events.append(allocator, try allocator.dupe(u8, data));
+        }
+        start = end;
+    }
+    decoder.feed(stream[start..]);
+    while (try decoder.next(allocator)) |data| {
+        try events.append(allocator, try allocator.dupe(u8, data));
+    }
+    if (try decoder.finish(allocator)) |data| {
+        try events.append(allocator, try allocator.dupe(u8, data));
+    }
+}
+
+fn freeEvents(allocator: Allocator, events: *std.ArrayList([]u8)) void {
+    for (events.items) |event| allocator.free(event);
+    events.deinit(allocator);
+}
+
+test "sse decoder splits events at any byte" {
+    const allocator = testing.allocator;
+    const stream = ": keep-alive\r\n\r\n" ++
+        "data: {\"a\":1}\n\n" ++
+        "event: message\ndata: first\ndata: second\n\n" ++
+        "data:no-space\r\n\r\n" ++
+        "data: " ++ DONE ++ "\n\n";
+    const expected = [_][]const u8{ "{\"a\":1}", "first\nsecond", "no-space", DONE };
+
+    for (0..stream.len + 1) |cut| {
+        var events: std.ArrayList([]u8) = .empty;
+        defer freeEvents(allocator, &events);
+        try decodeAll(allocator, stream, &.{cut}, &events);
+
+        try testing.expectEqual(expected.len, events.items.len);
+        for (expected, events.items) |want, got| {
+            try testing.expectEqualStrings(want, got);
+        }
+    }
+}
+
+test "sse chunk fields are found without a tree" {
+    const chunk = try parseChunk(
+        \\{"id":"x","choices":[{"index":0,"delta":{"role":"assistant","content":"Hi \"there\"\n"},
+        \\"logprobs":null,"finish_reason":"stop"},{"delta":{"content":"ignored"}}],
+        \\"usage":{"prompt_tokens":12,"completion_tokens":3,"total_tokens":15,"details":{"x":[1,2]}}}
+    );
+    try testing.expectEqualStrings("Hi \\\"there\\\"\\n", chunk.content.?);
+    try testing.expectEqualStrings("stop", chunk.finish_reason.?);
+    try testing.expectEqual(@as(u64, 15), chunk.usage.?.total_tokens);
+
+    const empty = try parseChunk("{\"choices\":[{\"delta\":{},\"finish_reason\":null}]}");
+    try testing.expect(empty.content == null and empty.finish_reason == null and empty.usage == null);
+
+    try testing.expectError(error.Malformed, parseChunk("{\"choices\":[{\"delta\":"));
+    try testing.expectError(error.Malformed, parseChunk("[]"));
+
+    var text: std.ArrayList(u8) = .empty;
+    defer text.deinit(testing.allocator);
+    try appendUnescaped(testing.allocator, &text, "a\\u00e9\\ud83d\\ude00\\ud800!");
+    try testing.expectEqualStrings("a\u{e9}\u{1F600}\u{FFFD}!", text.items);
+}
+
+test "sse decoder reads a recorded answer" {
+    const allocator = testing.allocator;
+    const stream = @embedFile("testdata/nvidia_stream.sse");
+
+    var events: std.ArrayList([]u8) = .empty;
+    defer freeEvents(allocator, &events);
+    try decodeAll(allocator, stream, &.{ 7, 1000, 4093 }, &events);
+
+    var text: std.ArrayList(u8) = .empty;
+    defer text.deinit(allocator);
+    var finish_reason: ?[]const u8 = null;
+    var usage: ?Usage = null;
+    for (events.items[0 .. events.items.len - 1]) |event| {
+        const chunk = try parseChunk(event);
+        if (chunk.content) |raw| try appendUnescaped(allocator, &text, raw);
+        if (chunk.finish_reason) |reason| finish_reason = reason;
+        if (chunk.usage) |reported| usage = reported;
+    }
+
+    try testing.expectEqualStrings(DONE, events.items[events.items.len - 1]);
+    try testing.expect(std.mem.startsWith(u8, text.items, "**Summary**\n\nThe report"));
+    try testing.expect(std.mem.endsWith(u8, text.items, "\tCaf\u{e9} \u{fc}ber \\path \u{1F680}"));
+    try testing.expectEqualStrings("stop", finish_reason.?);
+    try testing.expectEqual(@as(u64, 128), usage.?.completion_tokens);
+}
+
+test "fuzz sse decoder against split points and escaped content" {
+    const Context = struct {
+        fn testOne(context: @This(), input: []const u8) anyerror!void {
+            _ = context;
+            const allocator = testing.allocator;
+
+            // Arbitrary bytes must never crash either half
+            {
+                var events: std.ArrayList([]u8) = .empty;
+                defer freeEvents(allocator, &events);
+                try decodeAll(allocator, input, &.{ input.len / 3, input.len / 2 }, &events);
+                for (events.items) |event| {
+                    if (parseChunk(event)) |chunk| {
+                        var text: std.ArrayList(u8) = .empty;
+                        defer text.deinit(allocator);
+                        if (chunk.content) |raw| try appendUnescaped(allocator, &text, raw);
+                    } else |_| {}
+                }
+            }
+
+            // Input as content: one event per 16 bytes, escaped the way a
+            // JSON writer would, fed in pieces; the text must come back
+            var stream: std.ArrayList(u8) = .empty;
+            defer stream.deinit(allocator);
+            var at: usize = 0;
+            while (at < input.len) : (at += 16) {
+                try stream.appendSlice(allocator, "data: {\"choices\":[{\"delta\":{\"content\":\"");
+                try appendEscaped(allocator, &stream, input[at..@min(at + 16, input.len)]);
+                try stream.appendSlice(allocator, "\"}}]}\r\n\r\n");
+            }
+            try stream.appendSlice(allocator, "data: " ++ DONE ++ "\n\n");
+
+            var cuts: [8]usize = undefined;
+            for (&cuts, 0..) |*cut, i| {
+                cut.* = if (i < input.len) (@as(usize, input[i]) * stream.items.len) / 255 else stream.items.len;
+            }
+            std.mem.sort(usize, &cuts, {}, std.sort.asc(usize));
+
+            var events: std.ArrayList([]u8) = .empty;
+            defer freeEvents(allocator, &events);
+            try decodeAll(allocator, stream.items, &cuts, &events);
+
+            var text: std.ArrayList(u8) = .empty;
+            defer text.deinit(allocator);
+            for (events.items) |event| {
+                if (std.mem.eql(u8, event, DONE)) break;
+                const chunk = try parseChunk(event);
+                try appendUnescaped(allocator, &text, chunk.content.?);
+            }
+            try testing.expectEqualSlices(u8, input, text.items);
+        }
+    };
+    try testing.fuzz(Context{}, Context.testOne, .{ .corpus = &.{
+        "",
+        "plain ascii text that spans more than one event",
+        "quotes \" and \\ backslashes\nnewlines\r\ttabs\x00\x1f",
+        "caf\xc3\xa9 \xf0\x9f\x98\x80 and a stray \xff byte",
+    } });
+}
+
+/// JSON string escaping as a writer that leaves non-ASCII bytes alone
+fn appendEscaped(allocator: Allocator, out: *std.ArrayList(u8), text: []const u8) !void {
+    for (text) |ch| {
+        switch (ch) {
+            '"' => try out.appendSlice(allocator, "\\\""),
+            '\\' => try out.appendSlice(allocator, "\\\\"),
+            0...0x1F => {
+                var buf: [6]u8 = undefined;
+                try out.appendSlice(allocator, std.fmt.bufPrint(&buf, "\\u{x:0>4}", .{ch}) catch unreachable);
+            },
+            else => try out.append(allocator, ch),
+        }
+    }
+}
@@ -0,0 +1,381 @@
+//! The model API as seen from the server: one long-lived HTTP client shared
+//! by every request, so prompts reuse keep-alive connections instead of
+//! paying DNS, TCP and TLS setup before each answer.
+const std = @import("std");
+const http = std.http;
+const Allocator = std.mem.Allocator;
+const Cancellation = @import("server/cancellation.zig").Cancellation;
+
+pub const Options = struct {
+    /// Idle connections kept open for later requests. Requests that
+    /// overlap open as many as they need; whatever is left over beyond
+    /// this once they finish is closed.
+    max_idle_connections: usize = 4,
+};
+
+/// How the connection of one request was obtained
+pub const Setup = struct {
+    /// An idle keep-alive connection was used
+    reused: bool = false,
+    /// Time until the connection was ready to send on: DNS, TCP and TLS
+    /// for a new one, next to nothing for a reused one
+    connect_ns: u64 = 0,
+};
+
+pub const Stats = struct {
+    requests: u64 = 0,
+    connections_opened: u64 = 0,
+    /// Requests repeated on a new connection after a pooled one had been
+    /// closed by the other end
+    retries: u64 = 0,
+};
+
+/// Safe for concurrent use: std.http.Client hands out pooled connections
+/// under its own lock, and each request then has its connection to itself.
+pub const Upstream = struct {
+    const Self = @This();
+
+    client: http.Client,
+    /// The URL passed to init and slices of it
+    url: []const u8,
+    uri: std.Uri,
+    host: []const u8,
+    port: u16,
+    protocol: http.Client.Protocol,
+    stats_mutex: std.Thread.Mutex = .{},
+    counters: Stats = .{},
+
+    /// `url` must outlive the Upstream. `allocator` is used from every
+    /// worker thread and must be thread-safe.
+    pub fn init(allocator: Allocator, url: []const u8, options: Options) !Self {
+        const uri = try std.Uri.parse(url);
+        const protocol: http.Client.Protocol = if (std.ascii.eqlIgnoreCase(uri.scheme, "https"))
+            .tls
+        else if (std.ascii.eqlIgnoreCase(uri.scheme, "http"))
+            .plain
+        else
+            return error.UnsupportedUriScheme;
+        const host = switch (uri.host orelse return error.UriMissingHost) {
+            .raw, .percent_encoded => |name| name,
+        };
+
+        var client = http.Client{ .allocator = allocator };
+        client.connection_pool.free_size = options.max_idle_connections;
+
+        return .{
+            .client = client,
+            .url = url,
+            .uri = uri,
+            .host = host,
+            .port = uri.port orelse switch (protocol) {
+                .plain => 80,
+                .tls => 443,
+            },
+            .protocol = protocol,
+        };
+    }
+
+    pub fn deinit(self: *Self) void {
+        self.client.deinit();
+    }
+
+    /// POST `payload` and wait for the response head. `req` receives the
+    /// request, which the caller reads the body of and deinits; a body read
+    /// to the end leaves the connection in the pool for the next request.
+    /// With a `cancellation` the connection is attached to it, and stays
+    /// attached on success: detach before req.deinit(). error.Cancelled if
+    /// it was cancelled first.
+    ///
+    /// A pooled connection the upstream has closed while it sat idle only
+    /// fails once used; the request is then repeated on a new connection,
+    /// after every other idle one has been closed.
+    pub fn post(
+        self: *Self,
+        req: *http.Client.Request,
+        headers: []const http.Header,
+        payload: []const u8,
+        cancellation: ?*Cancellation,
+        setup: *Setup,
+    ) !http.Client.Response {
+        while (true) {
+            try self.open(req, headers, setup);
+
+            if (cancellation) |c| {
+                if (!c.attach(req.connection.?.getStream().handle)) {
+                    req.deinit();
+                    return error.Cancelled;
+                }
+            }
+
+            if (sendAndReceiveHead(req, payload)) |response| {
+                return response;
+            } else |err| {
+                if (cancellation) |c| c.detach();
+                // Not back into the pool
+                req.connection.?.closing = true;
+                req.deinit();
+                if (cancellation) |c| {
+                    if (c.isCancelled()) return error.Cancelled;
+                }
+                if (!setup.reused) return err;
+            }
+
+            // The other idle connections sat as long as the one that was
+            // closed, so they go too and the retry connects anew
+            self.dropIdle();
+            self.stats_mutex.lock();
+            self.counters.retries += 1;
+            self.stats_mutex.unlock();
+        }
+    }
+
+    fn open(self: *Self, req: *http.Client.Request, headers: []const http.Header, setup: *Setup) !void {
+        var timer = try std.time.Timer.start();
+
+        // Taken from the pool here rather than by request(), so that what
+        // the request gets is known. connectTcp looks in the pool as well,
+        // and only finds a connection another request released in between,
+        // which has just served a response.
+        const pooled = self.client.connection_pool.findConnection(self.criteria());
+        const connection = pooled orelse try self.client.connectTcp(self.host, self.port, self.protocol);
+
+        req.* = try self.client.request(.POST, self.uri, .{
+            .connection = connection,
+            .redirect_behavior = .unhandled,
+            // The body is read as it arrives, undecoded
+            .headers = .{ .accept_encoding = .omit },
+            .extra_headers = headers,
+        });
+        setup.* = .{ .reused = pooled != null, .connect_ns = timer.read() };
+
+        self.stats_mutex.lock();
+        defer self.stats_mutex.unlock();
+        self.counters.requests += 1;
+        if (pooled == null) self.counters.connections_opened += 1;
+    }
+
+    /// Close every idle connection to the upstream
+    fn dropIdle(self: *Self) void {
+        const pool = &self.client.connection_pool;
+        while (pool.findConnection(self.criteria())) |connection| {
+            connection.closing = true;
+            pool.release(connection);
+        }
+    }
+
+    fn criteria(self: *Self) http.Client.ConnectionPool.Criteria {
+        return .{ .host = self.host, .port = self.port, .protocol = self.protocol };
+    }
+
+    /// Counters since init
+    pub fn stats(self: *Self) Stats {
+        self.stats_mutex.lock();
+        defer self.stats_mutex.unlock();
+        return self.counters;
+    }
+};
+
+fn sendAndReceiveHead(req: *http.Client.Request, payload: []const u8) !http.Client.Response {
+    req.transfer_encoding = .{ .content_length = payload.len };
+    var body = try req.sendBodyUnflushed(&.{});
+    try body.writer.writeAll(payload);
+    try body.end();
+    try req.connection.?.flush();
+
+    return try req.receiveHead(&.{});
+}
+
+// ============================================================================
+// Tests, against a local stand-in for the model API
+// ============================================================================
+
+const testing = std.testing;
+const net = std.net;
+
+/// Answers every POST with a short SSE body. Serves each of the
+/// `connections` it expects on its own thread until the client closes it.
+const StandIn = struct {
+    listener: net.Server,
+    connections: usize,
+    /// Close each connection after one response without saying so, like
+    /// an upstream whose idle timeout has passed
+    drop_after_response: bool = false,
+    served: std.atomic.Value(usize) = .init(0),
+
+    const body = "data: {\"choices\":[{\"delta\":{\"content\":\"Hi\"}}]}\n\ndata: [DONE]\n\n";
+    const max_connections = 4;
+
+    fn start(connections: usize, drop_after_response: bool) !StandIn {
+        std.debug.assert(connections <= max_connections);
+        const address = net.Address.initIp4(.{ 127, 0, 0, 1 }, 0);
+        return .{
+            .listener = try address.listen(.{ .reuse_address = true }),
+            .connections = connections,
+            .drop_after_response = drop_after_response,
+        };
+    }
+
+    fn url(self: *StandIn, buf: []u8) ![]const u8 {
+        return std.fmt.bufPrint(buf, "http://127.0.0.1:{d}/v1/chat/completions", .{self.listener.listen_address.getPort()});
+    }
+
+    fn run(self: *StandIn) void {
+        var threads: [max_connections]std.Thread = undefined;
+        var spawned: usize = 0;
+        defer for (threads[0..spawned]) |thread| thread.join();
+
+        while (spawned < self.connections) {
+            const conn = self.listener.accept() catch return;
+            threads[spawned] = std.Thread.spawn(.{}, serveConnection, .{ self, conn.stream }) catch {
+                conn.stream.close();
+                return;
+            };
+            spawned += 1;
+        }
+    }
+
+    fn serveConnection(self: *StandIn, stream: net.Stream) void {
+        defer stream.close();
+        while (true) {
+            serveOne(stream) catch return;
+            _ = self.served.fetchAdd(1, .monotonic);
+            if (self.drop_after_response) return;
+        }
+    }
+
+    fn serveOne(stream: net.Stream) !void {
+        var buf: [4096]u8 = undefined;
+        var len: usize = 0;
+        const head_end = while (true) {
+            if (std.mem.indexOf(u8, buf[0..len], "\r\n\r\n")) |end| break end + 4;
+            if (len == buf.len) return error.HeadTooLarge;
+            const n = try std.posix.recv(stream.handle, buf[len..], 0);
+            if (n == 0) return error.ConnectionClosed;
+            len += n;
+        };
+
+        const marker = "content-length: ";
+        const head = buf[0..head_end];
+        var content_length: usize = 0;
+        if (std.ascii.indexOfIgnoreCase(head, marker)) |at| {
+            const digits = head[at + marker.len ..];
+            const digits_end = std.mem.indexOfScalar(u8, digits, '\r') orelse return error.BadHead;
+            content_length = try std.fmt.parseInt(usize, digits[0..digits_end], 10);
+        }
+        var remaining = content_length -| (len - head_end);
+        while (remaining > 0) {
+            const n = try std.posix.recv(stream.handle, buf[0..@min(remaining, buf.len)], 0);
+            if (n == 0) return error.ConnectionClosed;
+            remaining -= n;
+        }
+
+        var response: [512]u8 = undefined;
+        try stream.writeAll(try std.fmt.bufPrint(&response, "HTTP/1.1 200 OK\r\n" ++
+            "Content-Type: text/event-stream\r\n" ++
+            "Transfer-Encoding: chunked\r\n\r\n" ++
+            "{x}\r\n{s}\r\n0\r\n\r\n", .{ body.len, body }));
+    }
+};
+
+fn postAndRead(upstream: *Upstream, allocator: Allocator) !Setup {
+    var req: http.Client.Request = undefined;
+    var setup: Setup = .{};
+    var response = try upstream.post(&req, &.{}, "{}", null, &setup);
+    defer req.deinit();
+
+    var transfer_buffer: [256]u8 = undefined;
+    const text = try response.reader(&transfer_buffer).allocRemaining(allocator, .unlimited);
+    defer allocator.free(text);
+    try testing.expectEqualStrings(StandIn.body, text);
+    return setup;
+}
+
+test "upstream keeps connections alive up to the idle bound" {
+    const allocator = testing.allocator;
+    var stand_in = try StandIn.start(2, false);
+    defer stand_in.listener.deinit();
+    const server_thread = try std.Thread.spawn(.{}, StandIn.run, .{&stand_in});
+
+    var url_buf: [64]u8 = undefined;
+    var upstream = try Upstream.init(allocator, try stand_in.url(&url_buf), .{ .max_idle_connections = 1 });
+
+    // One after the other: a single connection serves both
+    try testing.expect(!(try postAndRead(&upstream, allocator)).reused);
+    try testing.expect((try postAndRead(&upstream, allocator)).reused);
+
+    // Two at once need a second connection, of which only one stays idle
+    var first: http.Client.Request = undefined;
+    var second: http.Client.Request = undefined;
+    var setup: Setup = .{};
+    var first_response = try upstream.post(&first, &.{}, "{}", null, &setup);
+    var second_response = try upstream.post(&second, &.{}, "{}", null, &setup);
+    var transfer_buffer: [256]u8 = undefined;
+    _ = try first_response.reader(&transfer_buffer).discardRemaining();
+    _ = try second_response.reader(&transfer_buffer).discardRemaining();
+    first.deinit();
+    second.deinit();
+
+    try testing.expect((try postAndRead(&upstream, allocator)).reused);
+
+    const stats = upstream.stats();
+    // Closes the idle connection, which ends the stand-in
+    upstream.deinit();
+    server_thread.join();
+
+    try testing.expectEqual(@as(usize, 5), stand_in.served.load(.monotonic));
+    try testing.expectEqual(@as(u64, 5), stats.requests);
+    try testing.expectEqual(@as(u64, 2), stats.connections_opened);
+    try testing.expectEqual(@as(u64, 0), stats.retries);
+}
+
+test "upstream retries once when a pooled connection was closed" {
+    const allocator = testing.allocator;
+    var stand_in = try StandIn.start(2, true);
+    defer stand_in.listener.deinit();
+    const server_thread = try std.Thread.spawn(.{}, StandIn.run, .{&stand_in});
+
+    var url_buf: [64]u8 = undefined;
+    var upstream = try Upstream.init(allocator, try stand_in.url(&url_buf), .{});
+    defer upstream.deinit();
+
+    _ = try postAndRead(&upstream, allocator);
+    // The pooled connection is dead by now; the request still succeeds
+    try testing.expect(!(try postAndRead(&upstream, allocator)).reused);
+
+    server_thread.join();
+    try testing.expectEqual(@as(usize, 2), stand_in.served.load(.monotonic));
+    try testing.expectEqual(@as(u64, 1), upstream.stats().retries);
+}
+
+test "upstream retries on a new connection when every idle one was closed" {
+    const allocator = testing.allocator;
+    var stand_in = try StandIn.start(3, true);
+    defer stand_in.listener.deinit();
+    const server_thread = try std.Thread.spawn(.{}, StandIn.run, .{&stand_in});
+
+    var url_buf: [64]u8 = undefined;
+    var upstream = try Upstream.init(allocator, try stand_in.url(&url_buf), .{ .max_idle_connections = 2 });
+    defer upstream.deinit();
+
+    // Two at once leave two idle connections, both dead by the next request
+    var first: http.Client.Request = undefined;
+    var second: http.Client.Request = undefined;
+    var setup: Setup = .{};
+    var first_response = try upstream.post(&first, &.{}, "{}", null, &setup);
+    var second_response = try upstream.post(&second, &.{}, "{}", null, &setup);
+    var transfer_buffer: [256]u8 = undefined;
+    _ = try first_response.reader(&transfer_buffer).discardRemaining();
+    _ = try second_response.reader(&transfer_buffer).discardRemaining();
+    first.deinit();
+    second.deinit();
+
+    // One retry, which does not land on the second dead connection
+    try testing.expect(!(try postAndRead(&upstream, allocator)).reused);
+
+    server_thread.join();
+    const stats = upstream.stats();
+    try testing.expectEqual(@as(usize, 3), stand_in.served.load(.monotonic));
+    try testing.expectEqual(@as(u64, 1), stats.retries);
+    try testing.expectEqual(@as(u64, 4), stats.requests);
+    try testing.expectEqual(@as(u64, 3), stats.connections_opened);
+}